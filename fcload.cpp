@@ -0,0 +1,758 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * The name of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+/** Find the load at which a libfc UDP collector starts to drop.
+ *
+ * This program replays an IPFIX stream over loopback UDP to libfc
+ * collectors running in the same process, at increasing rates.  For
+ * each rate, it counts what was lost, both from sequence number gaps
+ * seen by the collectors and from the kernel's socket drop counters,
+ * and it reports the knee: the highest rate at which the loss stayed
+ * within a tolerance.
+ *
+ * The stream is either generated (one template with seven common
+ * fields) or read from an IPFIX file.  It is replayed in a loop as
+ * needed, with sequence numbers adjusted so that the collectors see
+ * one continuous stream per exporter.  Each rate step starts a fresh
+ * set of collectors on fresh sockets.
+ *
+ * Collector configurations are compared by running this program
+ * with different options, e.g. the socket receive buffer size, the
+ * number of receiving sockets and threads (with SO_REUSEPORT), or
+ * whether records are decoded or only counted.
+ *
+ * Results are written as JSON.
+ *
+ * Syntax: fcload [options]
+ *
+ * E.g. ./fcload --exporters=4 --threads=4 --rcvbuf=4194304 > load.json
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "Constants.h"
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementCollector.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "SequenceTracker.h"
+#include "UDPInputSource.h"
+
+using namespace libfc;
+
+static std::string input_file_name;
+static std::string output_file_name;
+static unsigned int n_generated_records = 200000;
+static size_t message_size = 1400;
+static double start_rate = 10000;
+static double max_rate = 2000000;
+static double step_factor = 1.5;
+static double step_seconds = 1.0;
+static double tolerance = 0.001;
+static unsigned int n_exporters = 1;
+static unsigned int n_threads = 1;
+static unsigned int send_batch = 32;
+static int rcvbuf = 0;
+static int no_decode_flag = false;
+static int help_flag = false;
+
+enum {
+  opt_start_rate = 256,
+  opt_max_rate,
+  opt_step_factor,
+  opt_step_seconds,
+  opt_tolerance,
+  opt_exporters,
+  opt_threads,
+  opt_send_batch,
+  opt_rcvbuf,
+  opt_message_size,
+  opt_records,
+};
+
+static double parse_positive(const char* name, const char* arg) {
+  char* end;
+  double ret = strtod(arg, &end);
+  if (*arg == '\0' || *end != '\0' || ret <= 0) {
+    std::cerr << name << " must be positive, got \"" << arg << "\""
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return ret;
+}
+
+/* Code patterned after http://www.gnu.org/software/libc/
+ * manual/html_node/Getopt-Long-Option-Example.html
+ * #Getopt-Long-Option-Example */
+static void parse_options(int argc, char* const* argv) {
+
+  while (1) {
+    static struct option options[] = {
+      { "help", no_argument, &help_flag, 1 },
+      { "no-decode", no_argument, &no_decode_flag, 1 },
+      { "input", required_argument, 0, 'i' },
+      { "output", required_argument, 0, 'o' },
+      { "start-rate", required_argument, 0, opt_start_rate },
+      { "max-rate", required_argument, 0, opt_max_rate },
+      { "step-factor", required_argument, 0, opt_step_factor },
+      { "step-seconds", required_argument, 0, opt_step_seconds },
+      { "tolerance", required_argument, 0, opt_tolerance },
+      { "exporters", required_argument, 0, opt_exporters },
+      { "threads", required_argument, 0, opt_threads },
+      { "send-batch", required_argument, 0, opt_send_batch },
+      { "rcvbuf", required_argument, 0, opt_rcvbuf },
+      { "message-size", required_argument, 0, opt_message_size },
+      { "records", required_argument, 0, opt_records },
+      { 0, 0, 0, 0 },
+    };
+
+    int option_index = 0;
+
+    int c = getopt_long(argc, argv, "hi:o:", options, &option_index);
+
+    if (c == -1)
+      break;
+
+    switch(c) {
+    case 0:
+      break;
+    case 'h':
+      help_flag = true;
+      break;
+    case 'i':
+      input_file_name = optarg;
+      break;
+    case 'o':
+      output_file_name = optarg;
+      break;
+    case opt_start_rate:
+      start_rate = parse_positive("--start-rate", optarg);
+      break;
+    case opt_max_rate:
+      max_rate = parse_positive("--max-rate", optarg);
+      break;
+    case opt_step_factor:
+      step_factor = parse_positive("--step-factor", optarg);
+      if (step_factor <= 1) {
+        std::cerr << "--step-factor must be greater than 1" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case opt_step_seconds:
+      step_seconds = parse_positive("--step-seconds", optarg);
+      break;
+    case opt_tolerance:
+      tolerance = atof(optarg);
+      if (tolerance < 0 || tolerance >= 1) {
+        std::cerr << "--tolerance must be in [0, 1)" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case opt_exporters:
+      n_exporters = parse_positive("--exporters", optarg);
+      break;
+    case opt_threads:
+      n_threads = parse_positive("--threads", optarg);
+      break;
+    case opt_send_batch:
+      send_batch = parse_positive("--send-batch", optarg);
+      break;
+    case opt_rcvbuf:
+      rcvbuf = parse_positive("--rcvbuf", optarg);
+      break;
+    case opt_message_size:
+      message_size = parse_positive("--message-size", optarg);
+      break;
+    case opt_records:
+      n_generated_records = parse_positive("--records", optarg);
+      break;
+    default:
+      std::cerr << "Unrecognised option character '" << c 
+                << "', aborting" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static void help() {
+  std::cerr << "usage: ./fcload [options]" << std::endl
+            << "Options:" << std::endl
+            << "  -i file|--input=file\treplay IPFIX FILE instead of"
+            << " a generated stream" << std::endl
+            << "  -o file|--output=file\twrite JSON results to FILE"
+            << std::endl
+            << "  --records=n\trecords in the generated stream"
+            << " (default 200000)" << std::endl
+            << "  --message-size=n\tsize of generated messages"
+            << " (default 1400)" << std::endl
+            << "  --start-rate=n\tfirst rate, in messages per second"
+            << " (default 10000)" << std::endl
+            << "  --max-rate=n\tlast rate (default 2000000)" << std::endl
+            << "  --step-factor=f\tmultiply the rate by F in each step"
+            << " (default 1.5)" << std::endl
+            << "  --step-seconds=n\tduration of a step (default 1)"
+            << std::endl
+            << "  --tolerance=f\tacceptable fraction of lost records"
+            << " (default 0.001)" << std::endl
+            << "  --exporters=n\tnumber of sending sockets (default 1)"
+            << std::endl
+            << "  --threads=n\tnumber of receiving sockets and collector"
+            << " threads (default 1)" << std::endl
+            << "  --send-batch=n\tmessages per sendmmsg() call (default 32)"
+            << std::endl
+            << "  --rcvbuf=n\tsocket receive buffer size (default: system"
+            << " default)" << std::endl
+            << "  --no-decode\tonly parse and count, don't decode records"
+            << std::endl
+            << "  -h|--help\tprint this help text" << std::endl;
+}
+
+/** An IPFIX stream, split into messages, that can be replayed in a
+ * loop. */
+struct Stream {
+  struct Message {
+    size_t offset;
+    uint16_t length;
+    uint32_t domain;
+    uint32_t sequence_number;
+    /** Number of data records in this message. */
+    uint32_t n_records;
+  };
+
+  std::vector<uint8_t> bytes;
+  std::vector<Message> messages;
+
+  /** Number of records per pass through the stream, per domain.
+   * This is what the sequence numbers advance by in each pass. */
+  std::map<uint32_t, uint32_t> span;
+};
+
+static uint16_t get16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (static_cast<uint32_t>(get16(p)) << 16) | get16(p + 2);
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/** Splits a stream into messages.
+ *
+ * The number of records in a message is the difference between its
+ * sequence number and that of the next message in the same domain.
+ * That isn't known for the last message of each domain, so these
+ * messages are not replayed. */
+static bool split_stream(Stream& s) {
+  std::map<uint32_t, size_t> previous;
+
+  for (size_t off = 0; off + kIpfixMessageHeaderLen <= s.bytes.size(); ) {
+    const uint8_t* p = s.bytes.data() + off;
+    uint16_t length = get16(p + 2);
+
+    if (get16(p) != kIpfixVersion || length < kIpfixMessageHeaderLen
+        || off + length > s.bytes.size()) {
+      std::cerr << "Not an IPFIX stream at offset " << off << std::endl;
+      return false;
+    }
+
+    Stream::Message m;
+    m.offset = off;
+    m.length = length;
+    m.sequence_number = get32(p + 8);
+    m.domain = get32(p + 12);
+    m.n_records = 0;
+
+    auto prev = previous.find(m.domain);
+    if (prev != previous.end()) {
+      Stream::Message& pm = s.messages[prev->second];
+      pm.n_records = m.sequence_number - pm.sequence_number;
+      s.span[m.domain] += pm.n_records;
+    }
+    previous[m.domain] = s.messages.size();
+    s.messages.push_back(m);
+    off += length;
+  }
+
+  std::vector<Stream::Message> replayable;
+  for (size_t i = 0; i < s.messages.size(); i++) {
+    auto last = previous.find(s.messages[i].domain);
+    if (last->second != i)
+      replayable.push_back(s.messages[i]);
+  }
+  s.messages.swap(replayable);
+
+  if (s.messages.empty()) {
+    std::cerr << "Stream needs at least two messages per domain"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static const char* const kFieldNames[] = {
+  "sourceIPv4Address", "destinationIPv4Address", "sourceTransportPort",
+  "destinationTransportPort", "protocolIdentifier", "octetDeltaCount",
+  "packetDeltaCount",
+};
+
+/** Values of a generated or collected record. */
+struct Record {
+  uint32_t source_address;
+  uint32_t destination_address;
+  uint16_t source_port;
+  uint16_t destination_port;
+  uint8_t protocol;
+  uint64_t octets;
+  uint64_t packets;
+};
+
+static PlacementTemplate* make_template(Record* r) {
+  void* locations[] = {
+    &r->source_address, &r->destination_address, &r->source_port,
+    &r->destination_port, &r->protocol, &r->octets, &r->packets,
+  };
+  PlacementTemplate* ret = new PlacementTemplate();
+  for (unsigned int i = 0; i < sizeof(locations)/sizeof(locations[0]); i++)
+    ret->register_placement(InfoModel::instance().lookupIE(kFieldNames[i]),
+                            locations[i], 0);
+  return ret;
+}
+
+static void generate_stream(Stream& s) {
+  Record r;
+  std::unique_ptr<PlacementTemplate> t(make_template(&r));
+  MemoryExportDestination d(true, message_size);
+  uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+  {
+    PlacementExporter e(d, 1);
+    for (unsigned int i = 0; i < n_generated_records; i++) {
+      x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+      r.source_address = 0x0a000000 | (x & 0xffff);
+      r.destination_address = 0x0a010000 | ((x >> 16) & 0xffff);
+      r.source_port = x >> 32;
+      r.destination_port = 443;
+      r.protocol = 6;
+      r.octets = x >> 48;
+      r.packets = 1 + (x >> 56);
+
+      /* Collectors that miss a template can't count records, so send
+       * templates often. */
+      if (i % 1000 == 999)
+        e.refresh_templates();
+      e.place_values(t.get());
+    }
+  }
+  s.bytes = d.get_buffer();
+}
+
+static bool read_stream(Stream& s, const std::string& file_name) {
+  std::ifstream is(file_name.c_str(), std::ios::binary);
+  if (!is) {
+    std::cerr << "Can't open " << file_name << std::endl;
+    return false;
+  }
+  s.bytes.assign(std::istreambuf_iterator<char>(is),
+                 std::istreambuf_iterator<char>());
+  return true;
+}
+
+/** Collector that counts (and optionally decodes) records. */
+class LoadCollector : public PlacementCollector {
+public:
+  LoadCollector(bool decode)
+    : PlacementCollector(PlacementCollector::ipfix), n_records(0),
+      tmpl(decode ? make_template(&record) : 0) {
+    if (tmpl != 0)
+      register_placement_template(tmpl);
+  }
+
+  ~LoadCollector() {
+    delete tmpl;
+  }
+
+  std::shared_ptr<ErrorContext> start_message(uint16_t version,
+                                              uint16_t length,
+                                              uint32_t export_time,
+                                              uint32_t sequence_number,
+                                              uint32_t observation_domain,
+                                              uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate* t) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate* t) {
+    n_records++;
+    LIBFC_RETURN_OK();
+  }
+
+  /** Number of decoded records. */
+  uint64_t n_records;
+
+private:
+  Record record;
+  PlacementTemplate* tmpl;
+};
+
+/** A receiving socket and the collector that reads from it. */
+struct Receiver {
+  Receiver() : fd(-1), socket_drops(0) {}
+
+  int fd;
+  std::unique_ptr<UDPInputSource> is;
+  std::unique_ptr<LoadCollector> collector;
+  uint32_t socket_drops;
+  std::thread thread;
+};
+
+/** How long a collector waits for more messages before it decides
+ * that the step is over. */
+static const int kIdleMilliseconds = 200;
+
+static int open_receiver(uint16_t* port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  if (rcvbuf > 0)
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct timeval tv;
+  tv.tv_sec = 0;
+  tv.tv_usec = kIdleMilliseconds * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(*port);
+
+  socklen_t sa_len = sizeof(sa);
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) < 0
+      || getsockname(fd, reinterpret_cast<struct sockaddr*>(&sa),
+                     &sa_len) < 0) {
+    perror("bind");
+    close(fd);
+    return -1;
+  }
+  *port = ntohs(sa.sin_port);
+  return fd;
+}
+
+/** Sending state of one exporter. */
+struct Sender {
+  int fd;
+  size_t next;
+  uint32_t pass;
+};
+
+/** Result of one rate step. */
+struct Step {
+  double offered_rate;
+  double achieved_rate;
+  uint64_t sent_messages;
+  uint64_t sent_records;
+  uint64_t received_messages;
+  uint64_t received_records;
+  uint64_t decoded_records;
+  uint64_t sequence_lost;
+  uint64_t socket_drops;
+  double loss;
+};
+
+/** Sends n messages, round robin over the senders, at the given rate.
+ *
+ * @return the number of seconds that this took
+ */
+static double send_messages(const Stream& s, std::vector<Sender>& senders,
+                            uint64_t n, double rate, Step* step) {
+  const unsigned int batch = std::min<uint64_t>(send_batch, n);
+  std::vector<struct mmsghdr> msgs(batch);
+  std::vector<struct iovec> iovecs(2*batch);
+  std::vector<uint8_t> headers(kIpfixMessageHeaderLen*batch);
+
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+
+  for (uint64_t i = 0; i < n; ) {
+    std::this_thread::sleep_until(
+      start + std::chrono::nanoseconds(static_cast<uint64_t>(i*1e9/rate)));
+
+    Sender& sender = senders[(i/batch) % senders.size()];
+    unsigned int k;
+
+    for (k = 0; k < batch && i + k < n; k++) {
+      const Stream::Message& m = s.messages[sender.next];
+      uint8_t* header = &headers[k*kIpfixMessageHeaderLen];
+
+      /* Later passes continue the sequence numbers of earlier ones. */
+      memcpy(header, s.bytes.data() + m.offset, kIpfixMessageHeaderLen);
+      put32(header + 8, m.sequence_number
+                          + sender.pass*s.span.find(m.domain)->second);
+
+      iovecs[2*k].iov_base = header;
+      iovecs[2*k].iov_len = kIpfixMessageHeaderLen;
+      iovecs[2*k + 1].iov_base
+        = const_cast<uint8_t*>(s.bytes.data() + m.offset
+                               + kIpfixMessageHeaderLen);
+      iovecs[2*k + 1].iov_len = m.length - kIpfixMessageHeaderLen;
+
+      memset(&msgs[k], 0, sizeof(msgs[k]));
+      msgs[k].msg_hdr.msg_iov = &iovecs[2*k];
+      msgs[k].msg_hdr.msg_iovlen = 2;
+
+      step->sent_records += m.n_records;
+      if (++sender.next == s.messages.size()) {
+        sender.next = 0;
+        sender.pass++;
+      }
+    }
+
+    /* Loopback sends only fail when the receiving socket is gone, or
+     * with ENOBUFS; either way, the message counts as sent and lost. */
+    for (unsigned int sent = 0; sent < k; ) {
+      int ret = sendmmsg(sender.fd, &msgs[sent], k - sent, 0);
+      if (ret <= 0) {
+        if (ret < 0 && errno != ENOBUFS && errno != EAGAIN)
+          perror("sendmmsg");
+        break;
+      }
+      sent += ret;
+    }
+
+    step->sent_messages += k;
+    i += k;
+  }
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - start).count();
+}
+
+static bool run_step(const Stream& s, double rate, Step* step) {
+  memset(step, 0, sizeof(*step));
+  step->offered_rate = rate;
+
+  std::vector<Receiver> receivers(n_threads);
+  uint16_t port = 0;
+  for (auto r = receivers.begin(); r != receivers.end(); ++r) {
+    r->fd = open_receiver(&port);
+    if (r->fd < 0)
+      return false;
+  }
+
+  struct sockaddr_in collector;
+  memset(&collector, 0, sizeof(collector));
+  collector.sin_family = AF_INET;
+  collector.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  collector.sin_port = htons(port);
+
+  for (auto r = receivers.begin(); r != receivers.end(); ++r) {
+    r->is.reset(new UDPInputSource(
+      reinterpret_cast<struct sockaddr*>(&collector), sizeof(collector),
+      r->fd));
+    r->collector.reset(new LoadCollector(!no_decode_flag));
+    Receiver* rp = &*r;
+    r->thread = std::thread([rp]() {
+      rp->collector->collect(*rp->is);
+      rp->socket_drops = rp->is->get_socket_drops();
+    });
+  }
+
+  std::vector<Sender> senders(n_exporters);
+  for (auto e = senders.begin(); e != senders.end(); ++e) {
+    e->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    e->next = 0;
+    e->pass = 0;
+    if (e->fd < 0
+        || connect(e->fd, reinterpret_cast<struct sockaddr*>(&collector),
+                   sizeof(collector)) < 0) {
+      perror("connect");
+      return false;
+    }
+  }
+
+  uint64_t n = std::max<uint64_t>(1, rate*step_seconds);
+  double seconds = send_messages(s, senders, n, rate, step);
+  step->achieved_rate = step->sent_messages/seconds;
+
+  for (auto r = receivers.begin(); r != receivers.end(); ++r) {
+    r->thread.join();
+
+    SequenceTracker::Stats t = r->collector->get_sequence_tracker().get_totals();
+    step->received_messages += t.messages;
+    step->received_records += t.records;
+    step->sequence_lost += t.lost;
+    step->decoded_records += r->collector->n_records;
+    step->socket_drops += r->socket_drops;
+    close(r->fd);
+  }
+  for (auto e = senders.begin(); e != senders.end(); ++e)
+    close(e->fd);
+
+  step->loss = step->sent_records == 0 ? 0
+    : 1.0 - static_cast<double>(step->received_records)/step->sent_records;
+  if (step->loss < 0)
+    step->loss = 0;
+  return true;
+}
+
+static void print_json(std::ostream& os, const Stream& s,
+                       const std::vector<Step>& steps, const Step* knee) {
+  os << "{" << std::endl
+     << "  \"benchmark\": \"fcload\"," << std::endl
+     << "  \"input\": \""
+     << (input_file_name.empty() ? "<generated>" : input_file_name) << "\","
+     << std::endl
+     << "  \"messages\": " << s.messages.size() << "," << std::endl
+     << "  \"exporters\": " << n_exporters << "," << std::endl
+     << "  \"threads\": " << n_threads << "," << std::endl
+     << "  \"rcvbuf\": " << rcvbuf << "," << std::endl
+     << "  \"decode\": " << (no_decode_flag ? "false" : "true") << ","
+     << std::endl
+     << "  \"tolerance\": " << tolerance << "," << std::endl
+     << std::fixed << std::setprecision(1)
+     << "  \"knee_messages_per_second\": "
+     << (knee == 0 ? 0 : knee->achieved_rate) << "," << std::endl
+     << "  \"steps\": [" << std::endl;
+
+  for (auto st = steps.begin(); st != steps.end(); ++st) {
+    os << std::setprecision(1)
+       << "    { \"offered_rate\": " << st->offered_rate
+       << ", \"achieved_rate\": " << st->achieved_rate
+       << ", \"sent_messages\": " << st->sent_messages
+       << ", \"sent_records\": " << st->sent_records
+       << ", \"received_messages\": " << st->received_messages
+       << ", \"received_records\": " << st->received_records
+       << ", \"decoded_records\": " << st->decoded_records
+       << ", \"sequence_lost\": " << st->sequence_lost
+       << ", \"socket_drops\": " << st->socket_drops
+       << std::setprecision(6)
+       << ", \"loss\": " << st->loss
+       << " }" << (st + 1 == steps.end() ? "" : ",") << std::endl;
+  }
+
+  os << "  ]" << std::endl
+     << "}" << std::endl;
+  os.unsetf(std::ios_base::floatfield);
+}
+
+int main(int argc, char* const* argv) {
+  parse_options(argc, argv);
+
+  if (help_flag) {
+    help();
+    return EXIT_SUCCESS;
+  }
+
+  InfoModel::instance().default5103();
+
+  Stream s;
+  if (input_file_name.empty())
+    generate_stream(s);
+  else if (!read_stream(s, input_file_name))
+    return EXIT_FAILURE;
+  if (!split_stream(s))
+    return EXIT_FAILURE;
+
+  std::vector<Step> steps;
+  const Step* knee = 0;
+  size_t knee_index = 0;
+
+  for (double rate = start_rate; rate <= max_rate; rate *= step_factor) {
+    Step step;
+    if (!run_step(s, rate, &step))
+      return EXIT_FAILURE;
+    steps.push_back(step);
+
+    std::cerr << std::fixed << std::setprecision(0)
+              << "offered " << step.offered_rate
+              << " msg/s, achieved " << step.achieved_rate
+              << " msg/s, loss " << std::setprecision(4)
+              << 100*step.loss << "% (" << step.sequence_lost
+              << " records in sequence gaps, " << step.socket_drops
+              << " socket drops)" << std::endl;
+
+    if (step.loss <= tolerance)
+      knee_index = steps.size();
+    else if (step.loss > 0.5)
+      break;
+
+    /* Once the sender can't keep up, higher rates tell us nothing. */
+    if (step.achieved_rate < 0.9*step.offered_rate)
+      break;
+  }
+  if (knee_index > 0)
+    knee = &steps[knee_index - 1];
+
+  if (output_file_name.empty())
+    print_json(std::cout, s, steps, knee);
+  else {
+    std::ofstream os(output_file_name.c_str());
+    print_json(os, s, steps, knee);
+    if (!os) {
+      std::cerr << "Can't write " << output_file_name << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
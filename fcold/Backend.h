@@ -1,26 +1,26 @@
 /* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
- * Redistribution and use in source and binary forms, with or without
+ * Redistribution and use in source and binary forms, with or without 
  * modification, are permitted provided that the following conditions are met:
  *    * Redistributions of source code must retain the above copyright
  *      notice, this list of conditions and the following disclaimer.
  *    * Redistributions in binary form must reproduce the above copyright
  *      notice, this list of conditions and the following disclaimer in the
  *      documentation and/or other materials provided with the distribution.
- *    * Neither the names of ETH Zürich nor the names of other contributors
- *      may be used to endorse or promote products derived from this software
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
  *      without specific prior written permission.
  *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
- * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
- * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
- * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
- * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
- * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
@@ -33,14 +33,66 @@
 #ifndef _FCOLD_BACKEND_H_
 #  define _FCOLD_BACKEND_H_
 
-#include "Backend.h"
+#include <memory>
+
+#include "ErrorContext.h"
+#include "FlowRecord.h"
+#include "PlacementTemplate.h"
 
 namespace fcold {
+
+    /**
+     * Where an Imp puts the records it collects.  Every session has
+     * a backend of its own, which is only ever used by one thread at
+     * a time, so backends need no locking of their own.
+     */
     class Backend {
-        /* FIXME: it is presently not at all clear what \
-           common services a backend provides. So maybe this goes away,
-           and backend configurability is something done inside an imp. */
+    public:
+        virtual ~Backend() {}
+
+        /**
+         * Signals that a new message has started.
+         *
+         * @param observation_domain  observation domain of the message
+         * @param export_time         export time of the message, in
+         *                            seconds since the epoch
+         */
+        virtual std::shared_ptr<libfc::ErrorContext>
+                start_message(uint32_t observation_domain,
+                              uint32_t export_time) {
+            LIBFC_RETURN_OK();
+        }
+
+        /**
+         * Takes a record.
+         *
+         * @param tmpl  the placement template with which the record
+         *              was placed; its placements point into rec, so
+         *              it can be passed to a PlacementExporter as is
+         * @param rec   the record
+         */
+        virtual std::shared_ptr<libfc::ErrorContext>
+                record(const libfc::PlacementTemplate* tmpl,
+                       const FlowRecord& rec) = 0;
+
+        /**
+         * Signals that the session has ended and that no more
+         * records will come.
+         */
+        virtual std::shared_ptr<libfc::ErrorContext> finish() {
+            LIBFC_RETURN_OK();
+        }
+    };
+
+    /** A backend that drops all records. */
+    class NullBackend : public Backend {
+    public:
+        std::shared_ptr<libfc::ErrorContext>
+                record(const libfc::PlacementTemplate* tmpl,
+                       const FlowRecord& rec) {
+            LIBFC_RETURN_OK();
+        }
     };
 }
 
-#endif
\ No newline at end of file
+#endif /* defined(_FCOLD_BACKEND_H_) */
@@ -1,4 +1,3 @@
-/* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -25,27 +24,347 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "Configuration.h"
+/**
+ * @file
+ * @author Brian Trammell <trammell@tik.ee.ethz.ch>
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 #include <getopt.h>
+#include <pthread.h>
+
+#include "Configuration.h"
+#include "DirectoryListener.h"
+#include "IPFIXBackend.h"
+#include "Numa.h"
+#include "TCPListener.h"
+#include "UDPListener.h"
 
 namespace fcold {
     
+    /** Default number of message buffers per listener. */
+    static const size_t kDefaultBuffers = 1024;
+    /** Most worker threads one may ask for. */
+    static const unsigned long kMaxWorkers = 1024;
+    /** Most message buffers per listener one may ask for, 4 GiB
+        worth. */
+    static const unsigned long kMaxBuffers = 65536;
+    /** Longest idle time of UDP sessions one may ask for, a week. */
+    static const unsigned long kMaxIdleSeconds = 7 * 24 * 3600;
+    /** Most UDP sessions per listener one may ask for. */
+    static const unsigned long kMaxSessions = 1 << 20;
+
+    /**
+     * Parses a count given on the command line, which must be a
+     * decimal number from 1 to max.  Complains on standard error if
+     * it isn't.
+     */
+    static bool parse_count(const char* what, const char* arg,
+                            unsigned long max, unsigned long& n) {
+        char* end;
+
+        errno = 0;
+        n = strtoul(arg, &end, 10);
+        if (arg[strspn(arg, " \t")] == '-' || *arg == '\0' || *end != '\0'
+            || errno != 0 || n == 0 || n > max) {
+            std::cerr << "Number of " << what << " must be from 1 to "
+                      << max << ", got " << arg << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static void help() {
+        std::cerr
+            << "usage: fcold [options]" << std::endl
+            << "Options:" << std::endl
+            << "  -u [a:]p|--udp=[a:]p\tcollect IPFIX and NetFlow v9 over UDP"
+            << " on address A, port P" << std::endl
+            << "  -t [a:]p|--tcp=[a:]p\tcollect IPFIX over TCP"
+            << " on address A, port P" << std::endl
+            << "  -d dir|--directory=dir\tcollect files as they appear"
+            << " in DIR" << std::endl
+            << "  -b b|--backend=b\tput records into backend B:" << std::endl
+            << "\t\t\tnull (default) drops them," << std::endl
+            << "\t\t\tipfix:DIR writes an IPFIX file per session to DIR"
+            << std::endl
+            << "  -w n|--workers=n\tcollect on N worker threads"
+            << " (default: one per CPU)" << std::endl
+            << "  -n n|--buffers=n\tbuffer up to N messages per listener"
+            << " (default " << kDefaultBuffers << ")" << std::endl
+            << "  -i s|--idle=s\tclose UDP sessions after S seconds"
+            << " without messages (default "
+            << unsigned(UDPListener::kDefaultIdleSeconds) << ")" << std::endl
+            << "  -m n|--max-sessions=n\tcollect at most N UDP sessions"
+            << " per listener at a time" << std::endl
+            << "\t\t\t(default "
+            << size_t(UDPListener::kDefaultMaxSessions) << ")" << std::endl
+            << "  -H|--hugepages\tput message buffers in huge pages"
+            << std::endl
+            << "  -N|--numa\tspread listeners over the NUMA nodes, each"
+            << " running on and" << std::endl
+            << "\t\t\tbuffering messages in the memory of its node"
+            << std::endl
+            << "  -v|--verbose\treport every session when it ends"
+            << std::endl
+            << "  -h|--help\tprint this help text" << std::endl
+            << "Options -u, -t and -d may be given more than once."
+            << std::endl;
+    }
+
     Configuration::Configuration(int nargc, const char *nargv[]) :
+        backends(nullptr),
+        pool(nullptr),
+        impfact(nullptr),
         argc(nargc),
-        argv(nargv) {
+        argv(nargv),
+        backend("null"),
+        n_workers(0),
+        n_buffers(kDefaultBuffers),
+        idle_s(UDPListener::kDefaultIdleSeconds),
+        max_sessions(UDPListener::kDefaultMaxSessions),
+        hugepages(false),
+        numa(false),
+        verbose(false) {
         
     }
 
     Configuration::~Configuration() {
-        
+        for (auto l = listeners.begin(); l != listeners.end(); ++l)
+            delete *l;
+        delete pool;
+        delete impfact;
+        delete backends;
     }
 
-    void Configuration::start() {
+    void Configuration::split_address(const std::string& spec,
+                                      std::string&       address,
+                                      std::string&       port) {
+        std::string::size_type colon;
 
+        if (!spec.empty() && spec[0] == '[') {
+            std::string::size_type bracket = spec.find(']');
+            address = spec.substr(1, bracket - 1);
+            colon = spec.find(':', bracket);
+        } else {
+            colon = spec.rfind(':');
+            address = colon == std::string::npos ? "" : spec.substr(0, colon);
+        }
+        port = colon == std::string::npos ? spec : spec.substr(colon + 1);
+    }
+
+    bool Configuration::parse() {
+        static struct option options[] = {
+            { "udp", required_argument, 0, 'u' },
+            { "tcp", required_argument, 0, 't' },
+            { "directory", required_argument, 0, 'd' },
+            { "backend", required_argument, 0, 'b' },
+            { "workers", required_argument, 0, 'w' },
+            { "buffers", required_argument, 0, 'n' },
+            { "idle", required_argument, 0, 'i' },
+            { "max-sessions", required_argument, 0, 'm' },
+            { "hugepages", no_argument, 0, 'H' },
+            { "numa", no_argument, 0, 'N' },
+            { "verbose", no_argument, 0, 'v' },
+            { "help", no_argument, 0, 'h' },
+            { 0, 0, 0, 0 },
+        };
+
+        unsigned long n;
+
+        while (true) {
+            int option_index = 0;
+            int c = getopt_long(argc, const_cast<char* const*>(argv),
+                                "u:t:d:b:w:n:i:m:HNvh", options, &option_index);
+
+            if (c == -1)
+                break;
+
+            switch (c) {
+            case 'u':
+                udp_addresses.push_back(optarg);
+                break;
+            case 't':
+                tcp_addresses.push_back(optarg);
+                break;
+            case 'd':
+                directories.push_back(optarg);
+                break;
+            case 'b':
+                backend = optarg;
+                break;
+            case 'w':
+                if (!parse_count("workers", optarg, kMaxWorkers, n))
+                    return false;
+                n_workers = n;
+                break;
+            case 'n':
+                if (!parse_count("buffers", optarg, kMaxBuffers, n))
+                    return false;
+                n_buffers = n;
+                break;
+            case 'i':
+                if (!parse_count("idle seconds", optarg, kMaxIdleSeconds, n))
+                    return false;
+                idle_s = n;
+                break;
+            case 'm':
+                if (!parse_count("sessions", optarg, kMaxSessions, n))
+                    return false;
+                max_sessions = n;
+                break;
+            case 'H':
+                hugepages = true;
+                break;
+            case 'N':
+                numa = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+                help();
+                return false;
+            default:
+                help();
+                return false;
+            }
+        }
+
+        if (optind < argc) {
+            std::cerr << "Unexpected argument " << argv[optind] << std::endl;
+            help();
+            return false;
+        }
+
+        if (udp_addresses.empty() && tcp_addresses.empty()
+            && directories.empty()) {
+            std::cerr << "Nothing to listen to; give -u, -t or -d" << std::endl;
+            help();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Configuration::create_backends() {
+        if (backend == "null") {
+            backends = new NullBackendFactory();
+        } else if (backend.compare(0, 6, "ipfix:") == 0
+                   && backend.size() > 6) {
+            backends = new IPFIXBackendFactory(backend.substr(6));
+        } else {
+            std::cerr << "Unknown backend " << backend << std::endl;
+            help();
+            return false;
+        }
+        return true;
+    }
+
+    bool Configuration::add_listener(Listener* l, const std::string& what) {
+        listeners.push_back(l);
+        if (!l->is_good()) {
+            std::cerr << "Can't listen on " << what;
+            if (l->get_errno() != 0)
+                std::cerr << ": " << strerror(l->get_errno());
+            std::cerr << std::endl;
+            return false;
+        }
+        if (verbose && hugepages && !l->uses_hugepages())
+            std::cerr << "fcold: no reserved huge pages for " << what
+                      << ", using transparent ones" << std::endl;
+        if (verbose && numa && l->get_buffer_numa_node() < 0)
+            std::cerr << "fcold: can't bind buffers for " << what
+                      << " to its NUMA node" << std::endl;
+        return true;
+    }
+
+    int Configuration::next_numa_node() const {
+        if (nodes.empty())
+            return -1;
+        return nodes[listeners.size() % nodes.size()];
+    }
+
+    bool Configuration::start() {
+        if (!parse() || !create_backends())
+            return false;
+
+        /* Block the signals that end the daemon before any threads
+         * are created, so that only join() gets them. */
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, 0);
+        signal(SIGPIPE, SIG_IGN);
+
+        if (numa) {
+            nodes = numa_nodes();
+            if (nodes.empty()) {
+                std::cerr << "Can't find the NUMA nodes" << std::endl;
+                return false;
+            }
+        }
+
+        pool = new WorkerPool(n_workers);
+        impfact = new ImpFactory(*backends, *pool, verbose);
+
+        std::string address;
+        std::string port;
+        for (auto a = udp_addresses.begin(); a != udp_addresses.end(); ++a) {
+            split_address(*a, address, port);
+            if (!add_listener(new UDPListener(*impfact, address, port,
+                                              n_buffers, hugepages,
+                                              next_numa_node(), idle_s,
+                                              max_sessions),
+                              "UDP " + *a))
+                return false;
+        }
+        for (auto a = tcp_addresses.begin(); a != tcp_addresses.end(); ++a) {
+            split_address(*a, address, port);
+            if (!add_listener(new TCPListener(*impfact, address, port,
+                                              n_buffers, hugepages,
+                                              next_numa_node()),
+                              "TCP " + *a))
+                return false;
+        }
+        for (auto d = directories.begin(); d != directories.end(); ++d) {
+            if (!add_listener(new DirectoryListener(*impfact, *d, n_buffers,
+                                                    hugepages,
+                                                    next_numa_node()),
+                              "directory " + *d))
+                return false;
+        }
+
+        for (auto l = listeners.begin(); l != listeners.end(); ++l)
+            (*l)->start();
+
+        if (verbose)
+            std::cerr << "fcold: " << listeners.size() << " listeners, "
+                      << pool->size() << " workers" << std::endl;
+        return true;
     }
 
     void Configuration::join() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+
+        int sig;
+        sigwait(&signals, &sig);
+
+        if (verbose)
+            std::cerr << "fcold: caught " << strsignal(sig)
+                      << ", stopping" << std::endl;
 
+        for (auto l = listeners.begin(); l != listeners.end(); ++l)
+            (*l)->stop();
+        pool->stop();
     }
 }
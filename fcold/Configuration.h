@@ -1,26 +1,26 @@
 /* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
- * Redistribution and use in source and binary forms, with or without
+ * Redistribution and use in source and binary forms, with or without 
  * modification, are permitted provided that the following conditions are met:
  *    * Redistributions of source code must retain the above copyright
  *      notice, this list of conditions and the following disclaimer.
  *    * Redistributions in binary form must reproduce the above copyright
  *      notice, this list of conditions and the following disclaimer in the
  *      documentation and/or other materials provided with the distribution.
- *    * Neither the names of ETH Zürich nor the names of other contributors
- *      may be used to endorse or promote products derived from this software
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
  *      without specific prior written permission.
  *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
- * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
- * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
- * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
- * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
- * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
@@ -34,30 +34,86 @@
 #  define _FCOLD_CONFIGURATION_H_
 
 #  include <memory>
+#  include <string>
 #  include <vector>
 
-#  include "Frontend.h"
+#  include "BackendFactory.h"
+#  include "ImpFactory.h"
 #  include "Listener.h"
+#  include "WorkerPool.h"
 
 namespace fcold {
     
+    /**
+     * The configuration of an fcold daemon, as given on the command
+     * line: which listeners to run, how many workers to run the Imps
+     * on, and which backend to put the records into.
+     */
     class Configuration {
     private:
         
         std::vector<Listener*>  listeners;
         
+        BackendFactory*         backends;
+        WorkerPool*             pool;
         ImpFactory*             impfact;
         
         int                     argc;
         const char              **argv;
 
+        std::vector<std::string> udp_addresses;
+        std::vector<std::string> tcp_addresses;
+        std::vector<std::string> directories;
+        std::string             backend;
+        unsigned int            n_workers;
+        size_t                  n_buffers;
+        unsigned int            idle_s;
+        size_t                  max_sessions;
+        bool                    hugepages;
+        bool                    numa;
+        /** NUMA nodes over which to spread the listeners. */
+        std::vector<int>        nodes;
+        bool                    verbose;
+
+        bool parse();
+        bool create_backends();
+        bool add_listener(Listener* l, const std::string& what);
+        /** Returns the NUMA node for the next listener, or -1. */
+        int next_numa_node() const;
+
     public:
         Configuration(int nargc, const char *nargv[]);
         
         ~Configuration();
         
-        void start();
+        /**
+         * Parses the command line, and starts the workers and
+         * listeners.  Blocks SIGINT and SIGTERM in all threads, so
+         * that join() can wait for them.
+         *
+         * @return true if everything started, false if there was an
+         *         error, which has been reported on standard error
+         */
+        bool start();
+
+        /**
+         * Waits for SIGINT or SIGTERM, then stops the listeners,
+         * which close their sessions, and the workers.
+         */
         void join();
+
+        /**
+         * Splits an address as given on the command line,
+         * "[address:]port", where an IPv6 address is put in
+         * brackets.
+         *
+         * @param spec     the address given
+         * @param address  set to the address, or to "" if there is none
+         * @param port     set to the port
+         */
+        static void split_address(const std::string& spec,
+                                  std::string&       address,
+                                  std::string&       port);
     };
 }
 
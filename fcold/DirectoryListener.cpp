@@ -1,4 +1,3 @@
-/* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without 
@@ -32,21 +31,34 @@
 #include <cassert>
 #include <cerrno>
 #include <cstdlib>
+#include <iostream>
 
+#include <unistd.h>
 
 #if defined (__linux__)
 #  include <linux/limits.h>
 #  include <sys/inotify.h>
-#  include <sys/select.h>
 #endif /* defined (__linux__) */
 
 #include "DirectoryListener.h"
+#include "Frontend.h"
+#include "StatDatInputSource.h"
+#include "WandioInputSource.h"
 
 namespace fcold {
 
+  static bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size()
+      && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
   DirectoryListener::DirectoryListener(ImpFactory& impfact,
-                     const std::string& directory_name):
-    Listener(impfact)
+                                       const std::string& ndirectory_name,
+                                       size_t n_buffers,
+                                       bool hugepages,
+                                       int numa_node)
+    : Listener(impfact, n_buffers, hugepages, numa_node),
+      directory_name(ndirectory_name)
 #if defined (__linux__)
                              ,
       listener_fd(-1),
@@ -57,109 +69,120 @@ namespace fcold {
     errno = 0;
 
 #if defined (__linux__)
-    listener_fd = ::inotify_init();
+    listener_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (listener_fd < 0) {
       system_errno = errno;
       return;
     }
 
     watching_fd = inotify_add_watch(listener_fd, directory_name.c_str(),
-                                    IN_CLOSE_WRITE);
+                                    IN_CLOSE_WRITE | IN_MOVED_TO);
     if (watching_fd < 0) {
       system_errno = errno;
       return;
     }
-#endif /* defined (__linux__) */
 
     good = true;
+#endif /* defined (__linux__) */
   }
 
   DirectoryListener::~DirectoryListener() {
+    stop();
 #if defined (__linux__)
-    if (good) {
-      if (watching_fd >= 0 && inotify_rm_watch(listener_fd, watching_fd) < 0)
-        ; // Ignore for now;
-      if (listener_fd >= 0 && close(listener_fd) < 0)
-        ; // Ignore for now
-    }
+    if (watching_fd >= 0 && inotify_rm_watch(listener_fd, watching_fd) < 0)
+      ; // Ignore for now;
+    if (listener_fd >= 0 && close(listener_fd) < 0)
+      ; // Ignore for now
 #endif /* defined (__linux__) */
   }
 
+  void DirectoryListener::collect_file(const std::string& filename) {
+    if (filename.empty() || filename[0] == '.' || ends_with(filename, ".dat"))
+      return;
+
+    std::string path = directory_name + "/" + filename;
+    libfc::InputSource* is;
+    std::string name;
+
+    if (ends_with(filename, ".stat")) {
+      std::string dat = path.substr(0, path.size() - 5) + ".dat";
+      libfc::StatDatInputSource* sd = new libfc::StatDatInputSource(dat, path);
+
+      /* Move to the first datagram, so that its version can be
+       * peeked at. */
+      if (!sd->next_datagram()) {
+        report(sd->get_error());
+        delete sd;
+        return;
+      }
+      is = sd;
+    } else {
+      libfc::WandioInputSource* wis = new libfc::WandioInputSource(path);
+      if (wis->get_error()) {
+        report(wis->get_error());
+        delete wis;
+        return;
+      }
+      is = wis;
+      name = filename;
+    }
+
+    Frontend frontend(impfact, pool, is, name);
+    report(frontend.run());
+  }
+
   void DirectoryListener::listen() {
 #if defined (__linux__)
-    /* I don't like this, but this is how it's done; see `man inotify(7)'
-     * and `man 7 pthread'. 
-     *
-     * First, the inotify API needs to transport variable-length
+    /* The inotify API needs to transport variable-length
      * information, and they solve it by having that as the last
      * element of the struct with zero length.  Nice. (Hence the
-     * weird-looking size for BUF below.
-     *
-     * And then there seems to be no clean way to break a thread out
-     * of a blocking system call.  Apparently, something can and
-     * will always go wrong. Memory leaks are just one among the
-     * many horrors of interrupting threads.  So i'm closing the file
-     * descriptor on which this thread will be blocking. Ugh!
+     * weird-looking size for BUF below.)
      */
-    uint8_t buf[sizeof(struct inotify_event) + PATH_MAX];
-    struct inotify_event *current_event 
-      = reinterpret_cast<struct inotify_event*>(&buf[0]);
+    uint8_t buf[sizeof(struct inotify_event) + PATH_MAX]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
     
-    while (good && listening) {
+    while (wait_readable(listener_fd)) {
       errno = 0;
       ssize_t nbytes = read(listener_fd, buf, sizeof buf);
       if (nbytes < 0) {
-        if (errno == EAGAIN)
+        if (errno == EAGAIN || errno == EINTR)
           continue;
-        else if (errno == EINTR)
-          break;
         else {
           good = false;
           system_errno = errno; // EINVAL == buffer too short
           break;
         }
       }
-      
-      /* Assume no short reads */
-      assert(nbytes > 0 // To make static_cast safe
-             && static_cast<size_t>(nbytes) >= sizeof(struct inotify_event));
-      
-       /* No idea what IN_IGNORED means, but it's what happens when
-        * you close the watching_fd under this thread's nose. */
-      if (current_event->mask & IN_IGNORED)
-        break;
-
-      /* IN_UNMOUNT happens when the filesystem in question is
-       * unmounted, and IN_Q_OVERFLOW means there were too many
-       * unfetched events, and in both cases there's nothing more to
-       * do here. */
-      if (current_event->mask & IN_Q_OVERFLOW
-          || current_event->mask & IN_UNMOUNT)
-        /* TODO: warn here */
-        break;
-
-      assert(current_event->mask & IN_CLOSE_WRITE);
-
-      /* This is a null-terminated string. */
-      std::string filename{current_event->name};
-      
-      /* TODO: now do something with filename */
-    }
-#endif /* defined (__linux__) */
-  }
 
-  void DirectoryListener::stop() {
-    listening = false;
-#if defined (__linux__)
-    errno = 0;
-    if (watching_fd >= 0 && inotify_rm_watch(listener_fd, watching_fd) < 0) {
-      good = false;
-      system_errno = errno;
+      for (uint8_t* p = buf; p < buf + nbytes; ) {
+        struct inotify_event *current_event 
+          = reinterpret_cast<struct inotify_event*>(p);
+        p += sizeof(struct inotify_event) + current_event->len;
+
+        /* IN_IGNORED happens when the directory is removed, IN_UNMOUNT
+         * when the filesystem in question is unmounted, and in both
+         * cases there's nothing more to do here. */
+        if (current_event->mask & (IN_IGNORED | IN_UNMOUNT)) {
+          good = false;
+          return;
+        }
+
+        /* IN_Q_OVERFLOW means there were too many unfetched events;
+         * the files of the lost events can't be named. */
+        if (current_event->mask & IN_Q_OVERFLOW) {
+          std::cerr << directory_name
+                    << ": inotify event queue overflowed, files lost"
+                    << std::endl;
+          continue;
+        }
+
+        assert(current_event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO));
+
+        /* This is a null-terminated string. */
+        collect_file(current_event->name);
+      }
     }
 #endif /* defined (__linux__) */
-    listener.join();
   }
 
-
 } // namespace fcold
-
@@ -38,6 +38,18 @@
 
 namespace fcold {
 
+  /** Collects files as they appear in a directory.
+   *
+   * Files that are written to the directory, or moved into it, are
+   * read as IPFIX or NetFlow v9 message streams, each file being a
+   * session named after the file.  Files whose names start with a
+   * dot are ignored.
+   *
+   * Captures made as stat+dat pairs are collected when their stat
+   * file appears, which should therefore be written after the dat
+   * file; every exporter in the capture is a session then.  Dat
+   * files themselves are left alone.
+   */
   class DirectoryListener : public Listener {
   public:
     /** Creates a directory listener.
@@ -47,17 +59,29 @@ namespace fcold {
      * get_errno() will return something nonzero if the reason was a
      * system error.
      *
-     * @param directory name name of directory to listen to
+     * @param impfact creates the Imps of the sessions
+     * @param directory_name name of directory to listen to
+     * @param n_buffers number of message buffers
+     * @param hugepages whether to back the buffers with huge pages
+     * @param numa_node NUMA node to run on and to put the buffers
+     *   on, or -1 for none in particular
      */
     DirectoryListener(ImpFactory& impfact,
-                      const std::string& directory_name);
+                      const std::string& directory_name,
+                      size_t n_buffers,
+                      bool hugepages = false,
+                      int numa_node = -1);
     ~DirectoryListener();
 
+  protected:
     /* From Listener */
     void listen();
-    void stop();
 
   private:
+    /** Collects a file that has appeared in the directory. */
+    void collect_file(const std::string& filename);
+
+    std::string directory_name;
 #if defined (__linux__)
     int listener_fd;
     int watching_fd;
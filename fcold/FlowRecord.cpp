@@ -0,0 +1,71 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Fields of the fcold flow record
+ */
+
+#include "FlowRecord.h"
+
+#define FCOLD_FLOW_FIELD(name) { #name, offsetof(FlowRecord, name) }
+
+namespace fcold {
+
+    const FlowField kFlowFields[] = {
+        FCOLD_FLOW_FIELD(packetDeltaCount),
+        FCOLD_FLOW_FIELD(octetDeltaCount),
+        FCOLD_FLOW_FIELD(flowStartMilliseconds),
+        FCOLD_FLOW_FIELD(flowEndMilliseconds),
+        FCOLD_FLOW_FIELD(flowStartSeconds),
+        FCOLD_FLOW_FIELD(flowEndSeconds),
+        FCOLD_FLOW_FIELD(flowStartSysUpTime),
+        FCOLD_FLOW_FIELD(flowEndSysUpTime),
+        FCOLD_FLOW_FIELD(sourceIPv6Address),
+        FCOLD_FLOW_FIELD(destinationIPv6Address),
+        FCOLD_FLOW_FIELD(ipNextHopIPv6Address),
+        FCOLD_FLOW_FIELD(sourceIPv4Address),
+        FCOLD_FLOW_FIELD(destinationIPv4Address),
+        FCOLD_FLOW_FIELD(ipNextHopIPv4Address),
+        FCOLD_FLOW_FIELD(ingressInterface),
+        FCOLD_FLOW_FIELD(egressInterface),
+        FCOLD_FLOW_FIELD(bgpSourceAsNumber),
+        FCOLD_FLOW_FIELD(bgpDestinationAsNumber),
+        FCOLD_FLOW_FIELD(sourceTransportPort),
+        FCOLD_FLOW_FIELD(destinationTransportPort),
+        FCOLD_FLOW_FIELD(tcpControlBits),
+        FCOLD_FLOW_FIELD(protocolIdentifier),
+        FCOLD_FLOW_FIELD(ipClassOfService),
+        FCOLD_FLOW_FIELD(sourceIPv4PrefixLength),
+        FCOLD_FLOW_FIELD(destinationIPv4PrefixLength),
+        FCOLD_FLOW_FIELD(sourceIPv6PrefixLength),
+        FCOLD_FLOW_FIELD(destinationIPv6PrefixLength),
+        FCOLD_FLOW_FIELD(flowDirection),
+    };
+
+    const size_t kNFlowFields = sizeof(kFlowFields) / sizeof(kFlowFields[0]);
+
+} /* namespace fcold */
@@ -0,0 +1,93 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * The flow record into which Imps place the values of the data
+ * records they collect.
+ */
+
+#ifndef _FCOLD_FLOWRECORD_H_
+#  define _FCOLD_FLOWRECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace fcold {
+
+    /** This structure contains storage for the fields of an IPFIX or
+        NetFlow version 9 flow record that fcold knows about.  An Imp
+        places into it the fields of each data record that the data
+        record's template has; all other fields are zero.
+     */
+    struct FlowRecord {
+        uint64_t packetDeltaCount;
+        uint64_t octetDeltaCount;
+        uint64_t flowStartMilliseconds;
+        uint64_t flowEndMilliseconds;
+        uint32_t flowStartSeconds;
+        uint32_t flowEndSeconds;
+        uint32_t flowStartSysUpTime;
+        uint32_t flowEndSysUpTime;
+        uint8_t  sourceIPv6Address[16];
+        uint8_t  destinationIPv6Address[16];
+        uint8_t  ipNextHopIPv6Address[16];
+        uint32_t sourceIPv4Address;
+        uint32_t destinationIPv4Address;
+        uint32_t ipNextHopIPv4Address;
+        uint32_t ingressInterface;
+        uint32_t egressInterface;
+        uint32_t bgpSourceAsNumber;
+        uint32_t bgpDestinationAsNumber;
+        uint16_t sourceTransportPort;
+        uint16_t destinationTransportPort;
+        uint8_t  tcpControlBits;
+        uint8_t  protocolIdentifier;
+        uint8_t  ipClassOfService;
+        uint8_t  sourceIPv4PrefixLength;
+        uint8_t  destinationIPv4PrefixLength;
+        uint8_t  sourceIPv6PrefixLength;
+        uint8_t  destinationIPv6PrefixLength;
+        uint8_t  flowDirection;
+    };
+
+    /** A field of a FlowRecord: the name of its information element,
+        and where it is in the record. */
+    struct FlowField {
+        const char* name;
+        size_t      offset;
+    };
+
+    /** The fields of a FlowRecord, in order. */
+    extern const FlowField kFlowFields[];
+
+    /** The number of fields in a FlowRecord. */
+    extern const size_t kNFlowFields;
+
+} /* namespace fcold */
+
+#endif /* defined(_FCOLD_FLOWRECORD_H_) */
@@ -28,9 +28,12 @@
  * @file
  * @author Brian Trammell <trammell@tik.ee.ethz.ch>
  */
+#include <chrono>
+#include <cstring>
 #include <memory>
 
 #include <arpa/inet.h>
+#include <poll.h>
 
 #include "ErrorContext.h"
 #include "Frontend.h"
@@ -40,10 +43,10 @@
 
 namespace fcold {
 
-    static const size_t kNetflow5Mtu = 1500;
-    static const size_t kNetflow9Mtu = 1500;
-    static const size_t kIpfixMtu = 65536;
-    
+    /** How often a Frontend without input looks for buffers that its
+        Imps have returned, in milliseconds. */
+    static const int kIdlePollMs = 10;
+
     /** Structure for decoding IPFIX message headers */
     struct __attribute__((packed)) v10pduhdr_st {
         uint16_t    version;
@@ -75,26 +78,12 @@ namespace fcold {
 
     typedef struct v9sethdr_st v9sethdr_t;
     
-    /** Structure for decoding NetFlow V5 PDU headers */
-    struct __attribute__((packed)) v5pduhdr_st {
-        uint16_t    version;
-        uint16_t    count;
-        uint32_t    sysuptime_ms;
-        uint32_t    export_s;
-        uint32_t    export_ns;
-        uint32_t    sequence;
-        uint8_t     gentype;
-        uint8_t     genid;
-    };
-    
-    typedef struct v5sethdr_st v5sethdr_t;
-    
     static int peek_next_pdu_version(libfc::InputSource *is) {
         int         rv;
         uint16_t    version;
         
         rv = is->peek(reinterpret_cast<uint8_t*>(&version), sizeof(version));
-        if (rv > 0) {
+        if (rv == sizeof(version)) {
             return ntohs(version);
         } else {
             return rv;
@@ -103,7 +92,7 @@ namespace fcold {
     
     static int peek_next_set_header(libfc::InputSource *is, uint16_t& id, uint16_t& len) {
         int             rv;
-        v9sethdr_t      sethdr; // FIXME: Speculative: sethdr_t -> v9sethdr_t
+        v9sethdr_t      sethdr;
         
         rv = is->peek(reinterpret_cast<uint8_t*>(&sethdr), sizeof(sethdr));
         if (rv > 0) {
@@ -113,10 +102,13 @@ namespace fcold {
         return rv;
     }
     
+    static uint64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
     
     static std::shared_ptr<libfc::ErrorContext>
-            next_pdu_v5(libfc::InputSource              *is,
-                        std::shared_ptr<MessageBuffer>& mb)
+            next_pdu_v5(libfc::InputSource *is, MessageBuffer& mb)
     {
         LIBFC_RETURN_ERROR(fatal, inconsistent_state,
                            "fcold V5 deframe not yet implemented ",
@@ -124,8 +116,7 @@ namespace fcold {
     }
 
     static std::shared_ptr<libfc::ErrorContext>
-            next_pdu_v9(libfc::InputSource              *is,
-                        std::shared_ptr<MessageBuffer>& mb)
+            next_pdu_v9(libfc::InputSource *is, MessageBuffer& mb)
     {
         int rv;
         uint16_t setid, setlen;
@@ -136,12 +127,9 @@ namespace fcold {
                                "fcold needs peekable input source for V9", 0, is, 0, 0, 0);
         }
         
-        /* make a new shared message buffer */
-        mb = std::make_shared<MessageBuffer>(kNetflow9Mtu);
-        
-        uint8_t *base_pdubuf = mb->bufptr();
+        uint8_t *base_pdubuf = mb.bufptr();
         uint8_t *pdubuf = base_pdubuf;
-        size_t  pdumaxsz = mb->bufsz();
+        size_t  pdumaxsz = mb.bufsz();
         
         /* Read header */
         rv = is->read(pdubuf, sizeof(v9pduhdr_t));
@@ -150,6 +138,9 @@ namespace fcold {
             LIBFC_RETURN_ERROR(fatal, system_error,
                                "Error reading V9 PDU header",
                                errno, is, 0, 0, 0);
+        } else if (rv == 0) {
+            /* End of input; the buffer stays empty */
+            LIBFC_RETURN_OK();
         } else if ((size_t)rv < sizeof(v9pduhdr_t)) {
             LIBFC_RETURN_ERROR(recoverable, short_header,
                                "Short read in V9 PDU header: expected "
@@ -170,32 +161,35 @@ namespace fcold {
                                0, is, 0, 0, 0);
         }
         
-        /* Count is useless. Read sets in a loop. */
+        /* Count is useless. Read sets in a loop, until the input
+         * source ends the message (as datagram-based sources do) or
+         * the next PDU header, whose version field takes the place
+         * of a set ID, comes along. */
         while (true) {
-            if ((rv = peek_next_set_header(is, setid, setlen)) > 0) {
-                if (setid < 256) {
-                    /* Probably a next PDU header. Exit */
-                    LIBFC_RETURN_OK();
-                }
-            } else {
+            rv = peek_next_set_header(is, setid, setlen);
+            if (rv < 0) {
                 LIBFC_RETURN_ERROR(fatal, system_error,
                                    "Error peeking at V9 set header",
                                    errno, is, 0, 0, 0);
+            } else if (rv == 0 || setid == 9) {
+                break;
+            } else if ((size_t)rv < sizeof(v9sethdr_t)) {
+                LIBFC_RETURN_ERROR(recoverable, short_body,
+                                   "Short read in V9 set header: expected "
+                                   << sizeof(v9sethdr_t) << " , got " << rv,
+                                   0, is, 0, 0, 0);
+            } else if (setlen < sizeof(v9sethdr_t)) {
+                LIBFC_RETURN_ERROR(recoverable, format_error,
+                                   "V9 set length " << setlen << " too short",
+                                   0, is, 0, 0, 0);
             }
             
-            if (((pdubuf + setlen) - base_pdubuf) > pdumaxsz) {
-              /* FIXME: the original code doesn't compile because of msglen:
-
-                LIBFC_RETURN_ERROR(fatal, inconsistent_state,
-                                   "fcold V9 deframe overran internal buffer limit of " << pdumaxsz <<
-                                   "; need " << msglen - pdumaxsz << "extra",
-                                   0, is, 0, 0, 0);
-
-                I've replaced it with this:
-              */
+            if (static_cast<size_t>((pdubuf + setlen) - base_pdubuf) > pdumaxsz) {
                 LIBFC_RETURN_ERROR(fatal, inconsistent_state,
-                                   "fcold V9 deframe overran internal buffer limit of " << pdumaxsz <<
-                                   "; need some extra",
+                                   "fcold V9 deframe overran internal buffer limit of "
+                                   << pdumaxsz << "; need "
+                                   << (pdubuf + setlen) - base_pdubuf - pdumaxsz
+                                   << " extra",
                                    0, is, 0, 0, 0);
             }
             
@@ -212,20 +206,20 @@ namespace fcold {
             }
             pdubuf += setlen;
         }
+
+        mb.setbuflen(pdubuf - base_pdubuf);
+
+        LIBFC_RETURN_OK();
     }
     
     static std::shared_ptr<libfc::ErrorContext>
-            next_pdu_v10(libfc::InputSource             *is,
-                         std::shared_ptr<MessageBuffer>& mb)
+            next_pdu_v10(libfc::InputSource *is, MessageBuffer& mb)
     {
         int rv;
 
-        /* make a new shared message buffer FIXME allow sizing */
-        mb = std::make_shared<MessageBuffer>(kIpfixMtu);
-        
-        uint8_t *base_pdubuf = mb->bufptr();
+        uint8_t *base_pdubuf = mb.bufptr();
         uint8_t *pdubuf = base_pdubuf;
-        size_t  pdumaxsz = mb->bufsz();
+        size_t  pdumaxsz = mb.bufsz();
         
         /* Read header */
         rv = is->read(pdubuf, sizeof(v10pduhdr_t));
@@ -234,6 +228,9 @@ namespace fcold {
             LIBFC_RETURN_ERROR(fatal, system_error,
                                "Error reading IPFIX message header",
                                errno, is, 0, 0, 0);
+        } else if (rv == 0) {
+            /* End of input; the buffer stays empty */
+            LIBFC_RETURN_OK();
         } else if ((size_t)rv < sizeof(v10pduhdr_t)) {
             LIBFC_RETURN_ERROR(recoverable, short_header,
                                "Short read in IPFIX message header: expected "
@@ -265,7 +262,7 @@ namespace fcold {
         if (msglen > pdumaxsz) {
             LIBFC_RETURN_ERROR(fatal, inconsistent_state,
                                "fcold IPFIX deframe overran internal buffer limit of " << pdumaxsz <<
-                               "; need " << msglen - pdumaxsz << "extra",
+                               "; need " << msglen - pdumaxsz << " extra",
                                0, is, 0, 0, 0);
         }
 
@@ -285,49 +282,322 @@ namespace fcold {
                                0, is, 0, 0, 0);
         }
 
-        mb->setbuflen(msglen);
+        mb.setbuflen(msglen);
 
                                
         LIBFC_RETURN_OK();
     }
     
-  Frontend::Frontend(ImpFactory&         nimpfact,
-                     libfc::InputSource* nis,
-                     int                 npdu_version):
-      impfact(nimpfact),
-      is(nis),
-      pdu_version(npdu_version)
+    Frontend::Frontend(ImpFactory&         nimpfact,
+                       MessageBufferPool&  npool,
+                       libfc::InputSource* nis,
+                       const std::string&  nname,
+                       int                 npdu_version,
+                       int                 nfd):
+        impfact(nimpfact),
+        pool(npool),
+        progress(npool.get_waiter()),
+        is(nis),
+        fd(nfd),
+        name(nname),
+        pdu_version(npdu_version),
+        stream_pos(0),
+        last_session(sessions.end()),
+        max_sessions(0),
+        n_dropped(0),
+        at_limit(false)
     {
+        free_mbufs.reserve(pool.size());
     }
     
     Frontend::~Frontend() {
+        finish();
         if (is) delete is;
     }
 
+    void Frontend::reclaim() {
+        for (auto s = sessions.begin(); s != sessions.end(); ++s) {
+            if (s->second.imp != nullptr)
+                s->second.imp->reclaim_mbufs(free_mbufs);
+        }
+    }
+
+    void Frontend::trim(Imp* imp) {
+        if (imp != nullptr)
+            imp->reclaim_mbufs(free_mbufs);
+
+        /* Let other Frontends of the same listener have the rest, or
+         * everything if one of them is waiting. */
+        size_t keep = pool.is_wanted() ? 0 : kMaxFreeMbufs;
+        if (free_mbufs.size() > keep) {
+            pool.put(free_mbufs.data() + keep, free_mbufs.size() - keep);
+            free_mbufs.resize(keep);
+        }
+    }
+
+    MessageBuffer* Frontend::take_mbuf() {
+        if (free_mbufs.empty())
+            reclaim();
+        if (free_mbufs.empty())
+            return pool.get();
+
+        MessageBuffer* mb = free_mbufs.back();
+        free_mbufs.pop_back();
+        return mb;
+    }
+
+    MessageBuffer* Frontend::get_mbuf() {
+        MessageBuffer* mb = take_mbuf();
+
+        if (mb == nullptr) {
+            /* All buffers are in use: have the other Frontends give
+             * back the ones they keep. */
+            pool.add_waiter();
+            progress->wait([this, &mb] {
+                mb = take_mbuf();
+                return mb != nullptr;
+            });
+            pool.remove_waiter();
+        }
+        mb->reset();
+        return mb;
+    }
+
+    void Frontend::wait_input() {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (fd < 0 || poll(&pfd, 1, 0) != 0)
+            return;
+
+        /* Reading would block, maybe for as long as the exporter
+         * keeps the connection open without sending anything.  Until
+         * the input is readable again, give back every buffer as the
+         * Imps return it. */
+        while (true) {
+            bool idle = true;
+            for (auto s = sessions.begin(); s != sessions.end(); ++s) {
+                if (s->second.imp != nullptr && !s->second.imp->is_idle())
+                    idle = false;
+            }
+            reclaim();
+            if (!free_mbufs.empty()) {
+                pool.put(free_mbufs.data(), free_mbufs.size());
+                free_mbufs.clear();
+            }
+            if (idle || poll(&pfd, 1, kIdlePollMs) != 0)
+                return;
+        }
+    }
+
+    void Frontend::put_mbuf(MessageBuffer* mb) {
+        mb->reset();
+        free_mbufs.push_back(mb);
+    }
+
     std::shared_ptr<libfc::ErrorContext>
-            Frontend::deframe_next(std::shared_ptr<MessageBuffer>& mb)
+            Frontend::deframe_next(MessageBuffer*& mb)
     {
+        std::shared_ptr<libfc::ErrorContext> e;
+
+        mb = nullptr;
         if (!pdu_version) {
             if (!is->can_peek()) {
                 LIBFC_RETURN_ERROR(fatal, input_source_cant_peek,
                                    "fcold can't peek at next PDU version", 0, is, 0, 0, 0);
             }
             
-            pdu_version = peek_next_pdu_version(is);
+            int rv = peek_next_pdu_version(is);
+            if (rv == 0) {
+                LIBFC_RETURN_OK();
+            } else if (rv < 0) {
+                LIBFC_RETURN_ERROR(fatal, system_error,
+                                   "Error peeking at PDU version",
+                                   errno, is, 0, 0, 0);
+            }
+            pdu_version = rv;
         }
         
+        mb = get_mbuf();
+
+        uint32_t export_s = 0;
         switch (pdu_version) {
             case 5:
-                return next_pdu_v5(is, mb);
+                e = next_pdu_v5(is, *mb);
+                break;
             case 9:
-                return next_pdu_v9(is, mb);
+                e = next_pdu_v9(is, *mb);
+                if (!e && mb->buflen() > 0)
+                    export_s = ntohl(reinterpret_cast<v9pduhdr_t*>(
+                                         mb->bufptr())->export_s);
+                break;
             case 10:
-                return next_pdu_v10(is, mb);
+                e = next_pdu_v10(is, *mb);
+                if (!e && mb->buflen() > 0)
+                    export_s = ntohl(reinterpret_cast<v10pduhdr_t*>(
+                                         mb->bufptr())->export_s);
+                break;
             default:
-                LIBFC_RETURN_ERROR(recoverable, message_version_number,
-                                   "Expected V5, V9, or IPFIX message header, got"
+                put_mbuf(mb);
+                mb = nullptr;
+                LIBFC_RETURN_ERROR(fatal, message_version_number,
+                                   "Expected V5, V9, or IPFIX message header, got "
                                     << LIBFC_HEX(4) << pdu_version, 0, is, 0, 0, 0);
         }
+
+        if (e || mb->buflen() == 0) {
+            put_mbuf(mb);
+            mb = nullptr;
+            return e;
+        }
+
+        /* Stat+dat input sources know the exporter only once its
+         * datagram has been read from. */
+        mb->set_metadata(stream_pos, now_ms(), uint64_t(export_s) * 1000,
+                         name.empty() ? is->get_name() : name.c_str());
+        stream_pos += mb->buflen();
+        LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            Frontend::dispatch(MessageBuffer* mb)
+    {
+        const char* session_name = mb->get_name();
+
+        if (last_session == sessions.end()
+            || last_session->first != session_name) {
+            /* Reuse the key's storage, rather than making a new
+             * string for every message of interleaved sessions. */
+            lookup_name.assign(session_name);
+            last_session = sessions.find(lookup_name);
+            if (last_session == sessions.end()) {
+                if (max_sessions != 0 && sessions.size() >= max_sessions) {
+                    put_mbuf(mb);
+                    n_dropped++;
+                    if (at_limit)
+                        LIBFC_RETURN_OK();
+                    at_limit = true;
+                    LIBFC_RETURN_ERROR(recoverable, inconsistent_state,
+                                       "Too many sessions (" << max_sessions
+                                       << "); dropping messages of new ones,"
+                                       " such as " << lookup_name,
+                                       0, 0, 0, 0, 0);
+                }
+
+                uint16_t version = 0;
+                if (mb->buflen() >= sizeof(version)) {
+                    memcpy(&version, mb->bufptr(), sizeof(version));
+                    version = ntohs(version);
+                }
+
+                libfc::PlacementCollector::Protocol protocol;
+                switch (version) {
+                    case 9:
+                        protocol = libfc::PlacementCollector::netflowv9;
+                        break;
+                    case 10:
+                        protocol = libfc::PlacementCollector::ipfix;
+                        break;
+                    default:
+                        put_mbuf(mb);
+                        LIBFC_RETURN_ERROR(recoverable, message_version_number,
+                                           "Expected V9 or IPFIX message from "
+                                           << lookup_name << ", got version "
+                                           << LIBFC_HEX(4) << version,
+                                           0, 0, 0, 0, 0);
+                }
+
+                Imp* imp = impfact.create_imp(session_name, protocol,
+                                              progress, pool.size());
+                Session session = { imp, mb->get_recv_ms() };
+                last_session = sessions.insert(
+                    std::make_pair(lookup_name, session)).first;
+                if (imp == nullptr) {
+                    put_mbuf(mb);
+                    LIBFC_RETURN_ERROR(fatal, inconsistent_state,
+                                       "Can't create Imp for " << lookup_name
+                                       << "; dropping its messages",
+                                       0, 0, 0, 0, 0);
+                }
+            }
+        }
+
+        last_session->second.last_ms = mb->get_recv_ms();
+        Imp* imp = last_session->second.imp;
+        if (imp == nullptr) {
+            put_mbuf(mb);
+            LIBFC_RETURN_OK();
+        }
+
+        if (!imp->enqueue_mbuf(mb)) {
+            progress->wait([this, imp, mb] {
+                trim(imp);
+                return imp->enqueue_mbuf(mb);
+            });
+        }
+        trim(imp);
+        LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<libfc::ErrorContext> Frontend::run() {
+        MessageBuffer* mb;
+        std::shared_ptr<libfc::ErrorContext> e;
+
+        while (true) {
+            wait_input();
+            e = deframe_next(mb);
+            if (e)
+                return e;
+            if (!mb)
+                LIBFC_RETURN_OK();
+
+            e = dispatch(mb);
+            if (e)
+                return e;
+        }
+    }
+
+    void Frontend::close_session(Session& session) {
+        if (session.imp == nullptr)
+            return;
+        session.imp->stop();
+        session.imp->reclaim_mbufs(free_mbufs);
+        impfact.session_closed(*session.imp);
+        delete session.imp;
+        session.imp = nullptr;
+    }
+
+    void Frontend::finish() {
+        for (auto s = sessions.begin(); s != sessions.end(); ++s)
+            close_session(s->second);
+        sessions.clear();
+        last_session = sessions.end();
+
+        pool.put(free_mbufs.data(), free_mbufs.size());
+        free_mbufs.clear();
+    }
+
+    size_t Frontend::expire_sessions(uint64_t before_ms) {
+        size_t n_expired = 0;
+
+        for (auto s = sessions.begin(); s != sessions.end(); ) {
+            if (s->second.last_ms >= before_ms) {
+                ++s;
+                continue;
+            }
+            close_session(s->second);
+            if (last_session == s)
+                last_session = sessions.end();
+            s = sessions.erase(s);
+            n_expired++;
+        }
+
+        if (n_expired > 0) {
+            at_limit = false;
+            trim(nullptr);
+        }
+        return n_expired;
     }
 
 } // namespace fcold
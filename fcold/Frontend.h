@@ -33,29 +33,208 @@
 #ifndef _FCOLD_FRONTEND_H_
 #  define _FCOLD_FRONTEND_H_
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "InputSource.h"
 #include "ImpFactory.h"
 #include "MessageBuffer.h"
+#include "MessageBufferPool.h"
+#include "Waiter.h"
 #include "ErrorContext.h"
 
 namespace fcold {
 
+    /**
+     * Splits the messages of a listener's input into MessageBuffers
+     * and hands each to the Imp of its session.
+     *
+     * A stream input source, such as a TCP connection or a file, is
+     * deframed by run().  Listeners that receive whole messages, like
+     * the UDP listener, fill buffers from get_mbuf() themselves and
+     * dispatch() them.
+     *
+     * Buffers that the Imps have collected come back to the Frontend
+     * that queued them, which keeps a few for the next messages.  In
+     * the steady state, messages thus go round between a Frontend and
+     * its Imps without touching the pool or taking a lock.  When all
+     * buffers are in use, or an Imp's queue is full, the Frontend
+     * waits for its Imps to catch up.
+     *
+     * The Frontends of a listener share its pool, so a Frontend gives
+     * back the buffers it keeps as soon as another one waits for a
+     * buffer, and gives back all of them before it blocks waiting for
+     * input.
+     */
     class Frontend {
     public:
+        /**
+         * Creates a Frontend.
+         *
+         * @param impfact      creates the Imps of new sessions
+         * @param pool         pool from which to take buffers
+         * @param is           input source to deframe, or 0 if
+         *                     messages are dispatched directly; the
+         *                     Frontend takes ownership
+         * @param name         name of the session, or empty to name
+         *                     sessions after the input source's
+         *                     name at each message, as for stat+dat
+         *                     input sources
+         * @param pdu_version  version of the messages to deframe, or
+         *                     0 to guess from the first message
+         * @param fd           descriptor from which the input source
+         *                     reads, polled so that the Frontend can
+         *                     give back its buffers before blocking;
+         *                     -1 if reading never blocks
+         */
         Frontend(ImpFactory&         impfact,
-                 libfc::InputSource* is,
-                 int                 pdu_version);
+                 MessageBufferPool&  pool,
+                 libfc::InputSource* is = 0,
+                 const std::string&  name = "",
+                 int                 pdu_version = 0,
+                 int                 fd = -1);
 
-        /** Destroys a Frontend. */
+        /** Destroys a Frontend, closing its sessions. */
         virtual ~Frontend();
 
+        /**
+         * Gets an empty buffer, waiting for one if all are in use.
+         * The buffer must be handed to dispatch() or put_mbuf().
+         */
+        MessageBuffer* get_mbuf();
+
+        /** Gives back a buffer from get_mbuf() that is not needed. */
+        void put_mbuf(MessageBuffer* mb);
+
+        /**
+         * Deframes the next message of the input source.
+         *
+         * @param mb  set to the message, or to null at the end of
+         *            the input or on error
+         */
         virtual std::shared_ptr<libfc::ErrorContext>
-                     deframe_next(std::shared_ptr<MessageBuffer>& mb);
+                     deframe_next(MessageBuffer*& mb);
+
+        /**
+         * Hands a message to the Imp of its session, as named by the
+         * message buffer, creating the Imp if the session is new.
+         * The Frontend takes the buffer back in any case.
+         */
+        std::shared_ptr<libfc::ErrorContext>
+                     dispatch(MessageBuffer* mb);
+
+        /**
+         * Deframes and dispatches all messages of the input source.
+         *
+         * @return the error that stopped deframing, or 0 at the end
+         *         of the input
+         */
+        std::shared_ptr<libfc::ErrorContext> run();
+
+        /**
+         * Closes all sessions, waiting for their Imps to collect the
+         * messages queued for them.
+         */
+        void finish();
+
+        /**
+         * Closes the sessions that have had no message since a given
+         * time, as for UDP exporters, which never say that they are
+         * done.
+         *
+         * @param before_ms  receive time, in milliseconds since the
+         *                   epoch, before which the last message of a
+         *                   session must be
+         * @return the number of sessions closed
+         */
+        size_t expire_sessions(uint64_t before_ms);
+
+        /**
+         * Limits the number of open sessions.  Messages of new
+         * sessions beyond that are dropped, and the first one dropped
+         * after the limit was reached is reported.
+         *
+         * @param max_sessions  most open sessions, or 0 for no limit
+         */
+        void limit_sessions(size_t max_sessions) {
+            this->max_sessions = max_sessions;
+        }
+
+        /** Returns the number of open sessions. */
+        size_t get_n_sessions() const { return sessions.size(); }
+
+        /** Returns the number of messages dropped because there were
+            too many sessions. */
+        uint64_t get_n_dropped() const { return n_dropped; }
 
     private:
-        ImpFactory& impfact;
-        libfc::InputSource* is;
-        int pdu_version;
+        Frontend(const Frontend&) = delete;
+        Frontend& operator=(const Frontend&) = delete;
+
+        /** Most buffers a Frontend keeps for itself while no other
+            Frontend of the listener waits for one. */
+        static const size_t kMaxFreeMbufs = WorkerPool::kImpBatch;
+
+        /** Takes a buffer, if one is free, without waiting. */
+        MessageBuffer* take_mbuf();
+
+        /** Takes back the buffers of collected messages. */
+        void reclaim();
+
+        /**
+         * Takes back the buffers an Imp has collected, and gives the
+         * pool those that the Frontend may not keep.
+         *
+         * @param imp  the Imp, or 0 to only give back buffers
+         */
+        void trim(Imp* imp);
+
+        /**
+         * Returns once the input is readable.  If it isn't, gives all
+         * buffers back to the pool first, including those that the
+         * Imps are still collecting.
+         */
+        void wait_input();
+
+        ImpFactory&                 impfact;
+        MessageBufferPool&          pool;
+        /** Woken by the Imps whenever they have collected messages,
+            and by the pool whenever buffers come back; shared with
+            them, see Imp::run(). */
+        std::shared_ptr<Waiter>     progress;
+        std::vector<MessageBuffer*> free_mbufs;
+        libfc::InputSource*         is;
+        int                         fd;
+        std::string                 name;
+        int                         pdu_version;
+        size_t                      stream_pos;
+
+        struct Session {
+            /** 0 if the Imp could not be created, so that the
+                session's messages are dropped. */
+            Imp*        imp;
+            /** When the last message was received. */
+            uint64_t    last_ms;
+        };
+
+        /** Closes a session, once its Imp has collected the messages
+            queued for it. */
+        void close_session(Session& session);
+
+        /** Sessions by name. */
+        std::map<std::string, Session>
+                                    sessions;
+        /** The session of the last message. */
+        std::map<std::string, Session>::iterator
+                                    last_session;
+        size_t                      max_sessions;
+        uint64_t                    n_dropped;
+        /** Whether messages have been dropped since the number of
+            sessions last dropped below the limit. */
+        bool                        at_limit;
+        /** Scratch key for looking up sessions. */
+        std::string                 lookup_name;
   };
 
 } // namespace fcold
@@ -0,0 +1,118 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Backend writing each session to an IPFIX file
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "IPFIXBackend.h"
+
+namespace fcold {
+
+    IPFIXBackend::IPFIXBackend(int nfd, const std::string& npath)
+        : fd(nfd),
+          path(npath),
+          dest(fd),
+          exporter(dest, 0)
+    {
+    }
+
+    IPFIXBackend::~IPFIXBackend() {
+        finish();
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            IPFIXBackend::start_message(uint32_t observation_domain,
+                                        uint32_t export_time)
+    {
+        exporter.change_observation_domain(observation_domain);
+        LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            IPFIXBackend::record(const libfc::PlacementTemplate* tmpl,
+                                 const FlowRecord& rec)
+    {
+        exporter.place_values(tmpl);
+        LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<libfc::ErrorContext> IPFIXBackend::finish() {
+        if (fd < 0)
+            LIBFC_RETURN_OK();
+
+        exporter.flush();
+        int rv = close(fd);
+        int close_errno = errno;
+        fd = -1;
+
+        if (rv < 0) {
+            LIBFC_RETURN_ERROR(fatal, system_error,
+                               "Error closing " << path,
+                               close_errno, 0, 0, 0, 0);
+        }
+        LIBFC_RETURN_OK();
+    }
+
+    IPFIXBackendFactory::IPFIXBackendFactory(const std::string& ndirectory)
+        : directory(ndirectory)
+    {
+    }
+
+    std::string IPFIXBackendFactory::file_name(
+                                const std::string& session_name) const
+    {
+        std::string name = session_name;
+        for (auto c = name.begin(); c != name.end(); ++c) {
+            if (!isalnum(static_cast<unsigned char>(*c))
+                && *c != '.' && *c != '-')
+                *c = '_';
+        }
+        return directory + "/" + name + ".ipfix";
+    }
+
+    Backend* IPFIXBackendFactory::create_backend(
+                                const std::string& session_name)
+    {
+        std::string path = file_name(session_name);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+        if (fd < 0) {
+            std::cerr << "Can't open " << path << ": " << strerror(errno)
+                      << std::endl;
+            return 0;
+        }
+        return new IPFIXBackend(fd, path);
+    }
+}
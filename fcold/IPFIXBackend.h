@@ -0,0 +1,108 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Writes the records of each session to an IPFIX file.
+ */
+
+#ifndef _FCOLD_IPFIXBACKEND_H_
+#  define _FCOLD_IPFIXBACKEND_H_
+
+#include <string>
+
+#include "BackendFactory.h"
+#include "FileExportDestination.h"
+#include "PlacementExporter.h"
+
+namespace fcold {
+
+    /**
+     * A backend that exports records through a PlacementExporter to
+     * an IPFIX file, keeping their observation domains.
+     */
+    class IPFIXBackend : public Backend {
+    public:
+        /**
+         * Creates an IPFIX backend.
+         *
+         * @param fd    file descriptor of the file to write to; the
+         *              backend closes it when the session finishes
+         * @param path  name of the file, for error messages
+         */
+        IPFIXBackend(int fd, const std::string& path);
+        ~IPFIXBackend();
+
+        std::shared_ptr<libfc::ErrorContext>
+                start_message(uint32_t observation_domain,
+                              uint32_t export_time);
+        std::shared_ptr<libfc::ErrorContext>
+                record(const libfc::PlacementTemplate* tmpl,
+                       const FlowRecord& rec);
+        std::shared_ptr<libfc::ErrorContext> finish();
+
+    private:
+        int                              fd;
+        std::string                      path;
+        libfc::FileExportDestination     dest;
+        libfc::PlacementExporter         exporter;
+    };
+
+    /**
+     * Creates an IPFIXBackend per session, writing to a file named
+     * after the session in a directory.  Characters other than
+     * letters, digits, '.' and '-' in the session name become '_'.
+     * Files are appended to, so that an exporter that reconnects
+     * continues its file.
+     */
+    class IPFIXBackendFactory : public BackendFactory {
+    public:
+        /**
+         * Creates an IPFIX backend factory.
+         *
+         * @param directory  directory in which to put the files
+         */
+        IPFIXBackendFactory(const std::string& directory);
+
+        Backend* create_backend(const std::string& session_name);
+
+        /**
+         * Returns the name of the file for a session.
+         *
+         * @param session_name  name of the session
+         *
+         * @return the path of the file to which the records of the
+         *         session go
+         */
+        std::string file_name(const std::string& session_name) const;
+
+    private:
+        std::string directory;
+    };
+}
+
+#endif /* defined(_FCOLD_IPFIXBACKEND_H_) */
@@ -0,0 +1,216 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @author Brian Trammell <trammell@tik.ee.ethz.ch>
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "InfoModel.h"
+#include "Imp.h"
+
+namespace fcold {
+    
+    Imp::Imp(libfc::PlacementCollector::Protocol protocol,
+             const std::string&                  nname,
+             Backend*                            nbackend,
+             WorkerPool&                         npool,
+             std::shared_ptr<Waiter>             nproducer,
+             size_t                              n_mbufs):
+        PlacementCollector(protocol),
+        name(nname),
+        backend(nbackend),
+        pool(npool),
+        producer(nproducer),
+        mbq(kQueueLen),
+        retq(n_mbufs),
+        pending(0),
+        last_tmpl(nullptr),
+        n_messages(0),
+        n_records(0),
+        n_errors(0)
+    {
+        libfc::InfoModel& model = libfc::InfoModel::instance();
+
+        assert(kNFlowFields <= 64);
+        for (size_t i = 0; i < kNFlowFields; i++) {
+            const libfc::InfoElement* ie = model.lookupIE(kFlowFields[i].name);
+            assert(ie != nullptr);
+            field_ies.push_back(ie);
+        }
+        memset(&rec, 0, sizeof(rec));
+        batch.reserve(WorkerPool::kImpBatch);
+    }
+    
+    Imp::~Imp() {
+        for (auto i = placements.begin(); i != placements.end(); ++i)
+            delete i->second;
+        delete backend;
+    }
+
+    void* Imp::operator new(size_t sz) {
+        void* p;
+        if (posix_memalign(&p, alignof(Imp), sz) != 0)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void Imp::operator delete(void* p) {
+        free(p);
+    }
+
+    void Imp::error(std::shared_ptr<libfc::ErrorContext> e) {
+        n_errors++;
+        last_error = e;
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            Imp::start_message(uint16_t version,
+                               uint16_t length,
+                               uint32_t export_time,
+                               uint32_t sequence_number,
+                               uint32_t observation_domain,
+                               uint64_t base_time)
+    {
+        return backend->start_message(observation_domain, export_time);
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            Imp::start_placement(const libfc::PlacementTemplate* tmpl)
+    {
+        /* A template always places the same fields, so the others
+         * only need clearing when the template changes. */
+        if (tmpl != last_tmpl) {
+            memset(&rec, 0, sizeof(rec));
+            last_tmpl = tmpl;
+        }
+        LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<libfc::ErrorContext>
+            Imp::end_placement(const libfc::PlacementTemplate* tmpl)
+    {
+        n_records++;
+        return backend->record(tmpl, rec);
+    }
+
+    const libfc::PlacementTemplate*
+            Imp::unmatched_template(uint32_t observation_domain,
+                                    uint16_t id,
+                                    const libfc::IETemplate* wire_template)
+    {
+        uint64_t fields = 0;
+        for (auto ie = wire_template->begin();
+             ie != wire_template->end(); ++ie) {
+            for (size_t i = 0; i < kNFlowFields; i++) {
+                if ((*ie)->pen() == field_ies[i]->pen()
+                    && (*ie)->number() == field_ies[i]->number()) {
+                    fields |= uint64_t(1) << i;
+                    break;
+                }
+            }
+        }
+
+        if (fields == 0)
+            return nullptr;
+
+        auto p = placements.find(fields);
+        if (p != placements.end())
+            return p->second;
+
+        libfc::PlacementTemplate* tmpl = new libfc::PlacementTemplate();
+        uint8_t* base = reinterpret_cast<uint8_t*>(&rec);
+        for (size_t i = 0; i < kNFlowFields; i++) {
+            if (fields & (uint64_t(1) << i))
+                tmpl->register_placement(field_ies[i],
+                                         base + kFlowFields[i].offset, 0);
+        }
+        placements[fields] = tmpl;
+        return tmpl;
+    }
+
+    bool Imp::enqueue_mbuf(MessageBuffer* mb) {
+        if (!mbq.try_enqueue(mb))
+            return false;
+        if (pending.fetch_add(1) == 0)
+            pool.schedule(this);
+        return true;
+    }
+
+    void Imp::reclaim_mbufs(std::vector<MessageBuffer*>& mbufs) {
+        MessageBuffer* mb;
+        while (retq.try_dequeue(mb))
+            mbufs.push_back(mb);
+    }
+
+    void Imp::run(size_t max_messages) {
+        /* Everything counted in pending is already in the queue, so
+         * the whole batch can be taken at once. */
+        size_t n = std::min(pending.load(), max_messages);
+        for (size_t i = 0; i < n; i++) {
+            MessageBuffer* mb;
+            bool dequeued = mbq.try_dequeue(mb);
+            assert(dequeued);
+            (void)dequeued;
+            batch.push_back(mb);
+        }
+
+        for (auto mb = batch.begin(); mb != batch.end(); ++mb) {
+            n_messages++;
+            std::shared_ptr<libfc::ErrorContext> e = collect(**mb);
+            if (e && e->get_error() != libfc::Error::no_error)
+                error(e);
+            bool returned = retq.try_enqueue(*mb);
+            assert(returned);
+            (void)returned;
+        }
+        batch.clear();
+
+        /* Once pending drops to zero, the frontend may stop and
+         * delete the Imp, and then go away itself, at any time.  So
+         * nothing of the Imp may be touched after that, and the
+         * frontend's waiter is kept alive by a reference of our own. */
+        std::shared_ptr<Waiter> w = producer;
+        if (pending.fetch_sub(n) != n)
+            pool.schedule(this);
+        w->notify();
+    }
+    
+    void Imp::stop() {
+        producer->wait([this] { return pending.load() == 0; });
+
+        std::shared_ptr<libfc::ErrorContext> e = backend->finish();
+        if (e && e->get_error() != libfc::Error::no_error)
+            error(e);
+    }
+
+}
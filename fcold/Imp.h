@@ -1,26 +1,26 @@
 /* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
- * Redistribution and use in source and binary forms, with or without
+ * Redistribution and use in source and binary forms, with or without 
  * modification, are permitted provided that the following conditions are met:
  *    * Redistributions of source code must retain the above copyright
  *      notice, this list of conditions and the following disclaimer.
  *    * Redistributions in binary form must reproduce the above copyright
  *      notice, this list of conditions and the following disclaimer in the
  *      documentation and/or other materials provided with the distribution.
- *    * Neither the names of ETH Zürich nor the names of other contributors
- *      may be used to endorse or promote products derived from this software
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
  *      without specific prior written permission.
  *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
- * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
- * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
- * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
- * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
- * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
@@ -33,42 +33,177 @@
 #ifndef _FCOLD_IMP_H_
 #  define _FCOLD_IMP_H_
 
-#include <condition_variable>
-#include <queue>
-#include <thread>    
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "Backend.h"
 #include "ErrorContext.h"
+#include "FlowRecord.h"
 #include "MessageBuffer.h"
 #include "PlacementCollector.h"
 #include "ReaderWriterQueue.h"
+#include "Waiter.h"
+#include "WorkerPool.h"
 
 namespace fcold {
 
+    /**
+     * The Intermediate Process of a session.  An Imp collects the
+     * messages of one exporter, in order, placing the fields of each
+     * data record that it knows about into a FlowRecord and handing
+     * the record to the session's backend.
+     *
+     * The frontend of the session queues messages with enqueue_mbuf();
+     * the Imp is then run on a worker of the WorkerPool until its
+     * queue is empty.  Collected buffers go back to the frontend
+     * through a return queue, from which it takes them with
+     * reclaim_mbufs().  Both queues are single-producer,
+     * single-consumer and lock-free: only the frontend's thread
+     * queues messages and reclaims buffers, and only one worker at a
+     * time runs the Imp.
+     */
     class Imp : public libfc::PlacementCollector {
 
     private:
-        std::thread                     worker;
-        std::queue<std::shared_ptr<MessageBuffer> >
+        std::string                     name;
+        Backend*                        backend;
+        WorkerPool&                     pool;
+
+        std::shared_ptr<Waiter>         producer;
+
+        moodycamel::ReaderWriterQueue<MessageBuffer*>
                                         mbq;
-        std::mutex                      mbqmtx;
-        std::shared_ptr<libfc::ErrorContext>   worker_ectx;
-        std::condition_variable         mbqcv;
-        bool                            run;
-
-        std::shared_ptr<MessageBuffer>  next_mbuf();
-        void                            work();
-    
+        /** Sized to hold every buffer of the frontend, so that
+            returning a buffer never needs to allocate. */
+        moodycamel::ReaderWriterQueue<MessageBuffer*>
+                                        retq;
+        /** Number of queued messages not yet collected.  The Imp is
+            on the run queue or being run exactly while this is not
+            zero. */
+        std::atomic<size_t>             pending;
+        /** Messages taken from mbq in the current run. */
+        std::vector<MessageBuffer*>     batch;
+
+        FlowRecord                      rec;
+        /** The InfoElements of the FlowRecord fields. */
+        std::vector<const libfc::InfoElement*>
+                                        field_ies;
+        /** Placement templates by the set of FlowRecord fields
+            they place, as a bit mask. */
+        std::map<uint64_t, libfc::PlacementTemplate*>
+                                        placements;
+        const libfc::PlacementTemplate* last_tmpl;
+
+        uint64_t                        n_messages;
+        uint64_t                        n_records;
+        uint64_t                        n_errors;
+        std::shared_ptr<libfc::ErrorContext>
+                                        last_error;
+
+        void error(std::shared_ptr<libfc::ErrorContext> e);
+
     protected:
         virtual std::shared_ptr<libfc::ErrorContext>
-                start_message(std::shared_ptr<MessageBuffer> msg);
-        
+                start_message(uint16_t version,
+                              uint16_t length,
+                              uint32_t export_time,
+                              uint32_t sequence_number,
+                              uint32_t observation_domain,
+                              uint64_t base_time);
+        virtual std::shared_ptr<libfc::ErrorContext>
+                start_placement(const libfc::PlacementTemplate* tmpl);
+        virtual std::shared_ptr<libfc::ErrorContext>
+                end_placement(const libfc::PlacementTemplate* tmpl);
+        virtual const libfc::PlacementTemplate*
+                unmatched_template(uint32_t observation_domain,
+                                   uint16_t id,
+                                   const libfc::IETemplate* wire_template);
+
     public:
-        Imp(libfc::PlacementCollector::Protocol protocol);
+        /** Number of messages that can be queued for an Imp. */
+        static const size_t kQueueLen = 256;
+
+        /**
+         * Creates an Imp.
+         *
+         * @param protocol  protocol of the session's messages
+         * @param name      name of the session
+         * @param backend   where to put the records; the Imp takes
+         *                  ownership
+         * @param pool      the workers on which to run
+         * @param producer  notified whenever the Imp has collected
+         *                  messages, so that its frontend can wait for
+         *                  room in the queue or for returned buffers;
+         *                  shared, since a worker may still notify it
+         *                  when the Imp and its frontend are gone
+         * @param n_mbufs   number of buffers the frontend has in all,
+         *                  which is the most that can wait on the
+         *                  return queue at a time
+         */
+        Imp(libfc::PlacementCollector::Protocol protocol,
+            const std::string&                  name,
+            Backend*                            backend,
+            WorkerPool&                         pool,
+            std::shared_ptr<Waiter>             producer,
+            size_t                              n_mbufs);
         virtual ~Imp();
-        
-        void enqueue_mbuf(std::shared_ptr<MessageBuffer> mbuf);
-        void start();
+
+        /* The queues are cache-line aligned, which plain new doesn't
+           honour before C++17. */
+        static void* operator new(size_t sz);
+        static void operator delete(void* p);
+
+        /**
+         * Queues a message for collection, unless the queue is full.
+         * The buffer comes back through reclaim_mbufs() once the
+         * message has been collected.
+         *
+         * @return true if the message was queued
+         */
+        bool enqueue_mbuf(MessageBuffer* mbuf);
+
+        /**
+         * Takes the buffers of collected messages off the return
+         * queue.
+         *
+         * @param mbufs  where to append the buffers
+         */
+        void reclaim_mbufs(std::vector<MessageBuffer*>& mbufs);
+
+        /** Returns whether all queued messages have been collected. */
+        bool is_idle() const { return pending.load() == 0; }
+
+        /**
+         * Waits until all queued messages have been collected, then
+         * finishes the backend.  Call this after the last message has
+         * been queued, and before reclaiming the last buffers and
+         * deleting the Imp.
+         */
         void stop();
+
+        /**
+         * Collects queued messages, and puts the Imp back on the run
+         * queue if some remain.  Called by the WorkerPool.
+         *
+         * @param max_messages  maximum number of messages to collect
+         */
+        void run(size_t max_messages);
+
+        const std::string& get_name() const { return name; }
+        uint64_t get_n_messages() const { return n_messages; }
+        uint64_t get_n_records() const { return n_records; }
+
+        /** Returns the number of messages in which errors occurred,
+            including errors in the backend. */
+        uint64_t get_n_errors() const { return n_errors; }
+
+        /** Returns the most recent error, or 0. */
+        std::shared_ptr<libfc::ErrorContext> get_last_error() const {
+            return last_error;
+        }
     };
 } /* namespace fcold */
 
@@ -0,0 +1,85 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Creation of the Imps of fcold sessions
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include "ImpFactory.h"
+
+namespace fcold {
+
+    ImpFactory::ImpFactory(BackendFactory& nbackends,
+                           WorkerPool&     npool,
+                           bool            nverbose)
+        : backends(nbackends),
+          pool(npool),
+          verbose(nverbose)
+    {
+    }
+
+    ImpFactory::~ImpFactory() {
+    }
+
+    Imp* ImpFactory::create_imp(const std::string&                  name,
+                                libfc::PlacementCollector::Protocol protocol,
+                                std::shared_ptr<Waiter>             producer,
+                                size_t                              n_mbufs)
+    {
+        Backend* backend = backends.create_backend(name);
+        if (backend == nullptr)
+            return nullptr;
+        return new Imp(protocol, name, backend, pool, producer,
+                       n_mbufs);
+    }
+
+    void ImpFactory::session_closed(const Imp& imp) {
+        if (!verbose && imp.get_n_errors() == 0)
+            return;
+
+        /* Put the report together first, so that the reports of
+         * concurrently closing sessions don't get mixed up. */
+        uint64_t lost = 0;
+        auto stats = imp.get_sequence_tracker().get_all_stats();
+        for (auto s = stats.begin(); s != stats.end(); ++s)
+            lost += s->second.lost;
+
+        std::ostringstream report;
+        report << imp.get_name() << ": "
+               << imp.get_n_messages() << " messages, "
+               << imp.get_n_records() << " records, "
+               << lost << " lost, "
+               << imp.get_n_errors() << " errors";
+        if (imp.get_last_error())
+            report << "; last error: " << imp.get_last_error()->to_string();
+        report << std::endl;
+        std::cerr << report.str();
+    }
+}
@@ -1,26 +1,26 @@
 /* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
- * Redistribution and use in source and binary forms, with or without
+ * Redistribution and use in source and binary forms, with or without 
  * modification, are permitted provided that the following conditions are met:
  *    * Redistributions of source code must retain the above copyright
  *      notice, this list of conditions and the following disclaimer.
  *    * Redistributions in binary form must reproduce the above copyright
  *      notice, this list of conditions and the following disclaimer in the
  *      documentation and/or other materials provided with the distribution.
- *    * Neither the names of ETH Zürich nor the names of other contributors
- *      may be used to endorse or promote products derived from this software
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
  *      without specific prior written permission.
  *
- * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
- * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
- * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
- * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
- * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
- * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
@@ -33,12 +33,65 @@
 #ifndef _FCOLD_IMPFACTORY_H_
 #  define _FCOLD_IMPFACTORY_H_
 
+#include <string>
+
+#include "BackendFactory.h"
 #include "Imp.h"
+#include "WorkerPool.h"
 
 namespace fcold {
+
+    /**
+     * Creates an Imp for every session, with a backend from a
+     * BackendFactory, running on a WorkerPool.  Frontends on
+     * different listener threads share an ImpFactory, so its member
+     * functions must be thread-safe.
+     */
     class ImpFactory {
-        virtual Imp* create_imp() = 0;
+    public:
+        /**
+         * Creates an Imp factory.
+         *
+         * @param backends  creates the backends of the sessions
+         * @param pool      the workers on which the Imps run
+         * @param verbose   whether to report on every session that
+         *                  ends, not only on those that had errors
+         */
+        ImpFactory(BackendFactory& backends,
+                   WorkerPool&     pool,
+                   bool            verbose = false);
+        virtual ~ImpFactory();
+
+        /**
+         * Creates the Imp of a new session.
+         *
+         * @param name      name of the session
+         * @param protocol  protocol of the session's messages
+         * @param producer  the waiter of the frontend that will queue
+         *                  messages for the Imp
+         * @param n_mbufs   number of buffers the frontend has in all
+         *
+         * @return the Imp, or 0 if it can't be created
+         */
+        virtual Imp* create_imp(const std::string&                  name,
+                                libfc::PlacementCollector::Protocol protocol,
+                                std::shared_ptr<Waiter>             producer,
+                                size_t                              n_mbufs);
+
+        /**
+         * Called after a session has ended and its Imp has stopped,
+         * just before the Imp is deleted.  Reports the session on
+         * standard error.
+         *
+         * @param imp  the Imp of the session
+         */
+        virtual void session_closed(const Imp& imp);
+
+    protected:
+        BackendFactory& backends;
+        WorkerPool&     pool;
+        bool            verbose;
     };
 }
 
-#endif
\ No newline at end of file
+#endif /* defined(_FCOLD_IMPFACTORY_H_) */
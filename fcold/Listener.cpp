@@ -28,23 +28,167 @@
  * @file
  * @author Stephan Neuhaus <neuhaust@tik.ee.ethz.ch>
  */
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
 #include "Listener.h"
+#include "Numa.h"
 
 namespace fcold {
 
-  Listener::Listener(ImpFactory& nimpfact)
+  Listener::Listener(ImpFactory& nimpfact, size_t n_buffers, bool hugepages,
+                     int nnuma_node)
     : impfact(nimpfact),
+      pool(n_buffers, kMBufSz, hugepages, nnuma_node),
       good(false),
       system_errno(0),
-      listening(true),
-      listener(&Listener::listen, this) {
+      numa_node(nnuma_node),
+      listening(false) {
+    /* There is no clean way to break a thread out of a blocking
+     * system call, so listeners wait for their input and for this
+     * pipe at the same time, and stop() writes to it. */
+    if (pipe(stop_pipe) < 0) {
+      system_errno = errno;
+      stop_pipe[0] = stop_pipe[1] = -1;
+    }
   }
 
   Listener::~Listener() {
+    stop();
+    if (stop_pipe[0] >= 0)
+      close(stop_pipe[0]);
+    if (stop_pipe[1] >= 0)
+      close(stop_pipe[1]);
   }
 
   bool Listener::is_good() const {
     return good;
   }
 
+  int Listener::get_errno() const {
+    return system_errno;
+  }
+
+  void Listener::start() {
+    listening = true;
+    listener = std::thread(&Listener::run, this);
+  }
+
+  void Listener::run() {
+    /* Before anything else, so that the readers of TCP connections
+     * inherit the CPUs. */
+    if (numa_node >= 0 && !pin_to_numa_node(numa_node))
+      std::cerr << "fcold: can't keep listener to NUMA node " << numa_node
+                << ": " << strerror(errno) << std::endl;
+    listen();
+  }
+
+  void Listener::stop() {
+    if (!listener.joinable())
+      return;
+
+    listening = false;
+    char c = 0;
+    while (write(stop_pipe[1], &c, 1) < 0 && errno == EINTR)
+      ;
+    listener.join();
+  }
+
+  bool Listener::wait_readable(int fd, int timeout_ms) {
+    struct pollfd fds[2];
+
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    while (listening) {
+      int rv = poll(fds, 2, timeout_ms);
+      if (rv < 0 && errno == EINTR)
+        continue;
+      if (rv == 0)
+        return true;
+      if (rv < 0) {
+        good = false;
+        system_errno = errno;
+        return false;
+      }
+      if (fds[1].revents != 0)
+        return false;
+      if (fds[0].revents != 0)
+        return true;
+    }
+    return false;
+  }
+
+  void Listener::report(const std::shared_ptr<libfc::ErrorContext>& e) const {
+    if (e && e->get_error() != libfc::Error::no_error)
+      std::cerr << e->to_string() << std::endl;
+  }
+
+  int Listener::bind_socket(const std::string& address,
+                            const std::string& port, int socktype) {
+    struct addrinfo hints;
+    struct addrinfo* res;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+    hints.ai_flags = AI_PASSIVE;
+
+    int rv = getaddrinfo(address.empty() ? 0 : address.c_str(),
+                         port.c_str(), &hints, &res);
+    if (rv != 0) {
+      std::cerr << "Can't resolve " << address << ":" << port << ": "
+                << gai_strerror(rv) << std::endl;
+      return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai != 0; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) {
+        system_errno = errno;
+        continue;
+      }
+
+      int on = 1;
+      if (socktype == SOCK_STREAM)
+        (void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        break;
+
+      system_errno = errno;
+      close(fd);
+      fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0)
+      (void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+  }
+
+  uint16_t Listener::socket_port(int fd) {
+    struct sockaddr_storage sa;
+    socklen_t sa_len = sizeof sa;
+
+    if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&sa), &sa_len) < 0)
+      return 0;
+    if (sa.ss_family == AF_INET)
+      return ntohs(reinterpret_cast<struct sockaddr_in*>(&sa)->sin_port);
+    if (sa.ss_family == AF_INET6)
+      return ntohs(reinterpret_cast<struct sockaddr_in6*>(&sa)->sin6_port);
+    return 0;
+  }
+
 } // namespace fcold
@@ -32,26 +32,34 @@
 #ifndef _FCOLD_LISTENER_H_
 #  define _FCOLD_LISTENER_H_
 
+#  include <atomic>
+#  include <memory>
+#  include <string>
 #  include <thread>
 
+#include "ErrorContext.h"
 #include "ImpFactory.h"
+#include "MessageBufferPool.h"
 
 namespace fcold {
 
   class Listener {
   public:
-    /** Creates a Listener. */
-    Listener(ImpFactory& nimpfact);
-
-    /** Destroys a Listener. */
-    virtual ~Listener() = 0;
-
-    /** Listens for an event.
+    /** Creates a Listener.
      *
-     * This member function blocks until an event that this object
-     * listens for occurs, and then acts appropriately.
+     * @param impfact creates the Imps of the sessions
+     * @param n_buffers number of message buffers in this listener's
+     *   pool, which bounds the number of messages received but not
+     *   yet collected
+     * @param hugepages whether to back the buffers with huge pages
+     * @param numa_node NUMA node to run on and to put the buffers on,
+     *   or -1 for none in particular
      */
-    virtual void listen() = 0;
+    Listener(ImpFactory& nimpfact, size_t n_buffers, bool hugepages = false,
+             int numa_node = -1);
+
+    /** Destroys a Listener, stopping it if need be. */
+    virtual ~Listener();
 
     /** Returns the state of this listener.
      *
@@ -72,25 +80,89 @@ namespace fcold {
      */
     int get_errno() const;
 
+    /** Returns whether this listener's buffers are in reserved huge
+     * pages.
+     */
+    bool uses_hugepages() const { return pool.uses_hugepages(); }
+
+    /** Returns the NUMA node to which this listener's buffers are
+     * bound, or -1 if they aren't.
+     */
+    int get_buffer_numa_node() const { return pool.get_numa_node(); }
+
+    /** Starts listening, in a thread of its own.
+     *
+     * If the listener has a NUMA node, the thread, and the threads it
+     * starts, only run on the CPUs of that node.
+     */
+    void start();
+
     /** Tells the listener to stop listening.
      *
-     * This will interrupt the thread that is currently running
-     * listen().
+     * This wakes up the thread that is currently running listen(),
+     * and waits until it has closed all of its sessions.
      */
-    virtual void stop() = 0;
+    void stop();
 
   protected:
+    /** Listens for events.
+     *
+     * This member function runs in the listener's thread.  It
+     * waits for events with wait_readable(), acts on them, and
+     * returns when wait_readable() returns false, after closing its
+     * sessions.
+     */
+    virtual void listen() = 0;
+
+    /** Waits until a file descriptor is readable.
+     *
+     * @param fd the file descriptor
+     * @param timeout_ms how long to wait at most, in milliseconds, or
+     *   -1 to wait for as long as it takes
+     *
+     * @return true if fd is readable or the timeout has passed, false
+     *   if the listener has been told to stop or if waiting failed
+     */
+    bool wait_readable(int fd, int timeout_ms = -1);
+
+    /** Reports an error on standard error. */
+    void report(const std::shared_ptr<libfc::ErrorContext>& e) const;
+
+    /** Opens a socket and binds it to an address.
+     *
+     * On failure, sets system_errno.
+     *
+     * @param address numeric address or host name to bind to, or
+     *   empty for all addresses
+     * @param port port number or service name
+     * @param socktype SOCK_DGRAM or SOCK_STREAM
+     *
+     * @return the socket, or -1 on failure
+     */
+    int bind_socket(const std::string& address, const std::string& port,
+                    int socktype);
+
+    /** Returns the port a socket is bound to, in host byte order. */
+    static uint16_t socket_port(int fd);
+
     /** ImpFactory owned by Configuration, 
         passed to Frontends to create Imps per session */
-    ImpFactory&     impfact;
+    ImpFactory&         impfact;
 
+    /** The buffers into which messages are received. */
+    MessageBufferPool   pool;
 
-    bool            good;
-    int             system_errno;
-    bool            listening;
-    std::thread     listener;
+    bool                good;
+    int                 system_errno;
 
+  private:
+    /** Keeps the thread to its NUMA node, then listens. */
+    void run();
 
+    int                 numa_node;
+    std::atomic<bool>   listening;
+    int                 stop_pipe[2];
+    std::thread         listener;
   };
 
 } // namespace fcold
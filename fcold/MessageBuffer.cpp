@@ -24,8 +24,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <cassert>
+#include <cstdio>
 #include <cstring>
-#include <sstream>
 
 #include "MessageBuffer.h"
 
@@ -39,8 +39,10 @@ namespace fcold {
           stream_pos(0),
           recv_ms(0),
           msgclk_ms(0),
-          source_name(nullptr),
-          off(0) {}
+          off(0)
+    {
+        source_name[0] = '\0';
+    }
     
     MessageBuffer::MessageBuffer(size_t sz)
         : buf(new uint8_t[sz]),
@@ -50,8 +52,10 @@ namespace fcold {
           stream_pos(0),
           recv_ms(0),
           msgclk_ms(0),
-          source_name(nullptr),
-          off(0) {}
+          off(0)
+    {
+        source_name[0] = '\0';
+    }
     
     MessageBuffer::MessageBuffer(uint8_t* ibuf, size_t sz, bool own, bool copy)
           : buf(ibuf),
@@ -61,9 +65,9 @@ namespace fcold {
             stream_pos(0),
             recv_ms(0),
             msgclk_ms(0),
-            source_name(nullptr),
             off(0)
     {
+        source_name[0] = '\0';
         if (copy) {
             buf = new uint8_t[sz];
             memcpy(buf, ibuf, sz);
@@ -74,10 +78,6 @@ namespace fcold {
         if (buf_owned) {
             delete[] buf;
         }
-        // FYI: Check unnecessary; free() will free null pointers --neuhaust
-        if (source_name) {
-            free(const_cast<char*>(source_name));
-        }
     }
     
     void MessageBuffer::setbuflen(size_t len) {
@@ -95,7 +95,17 @@ namespace fcold {
         stream_pos = n_stream_pos;
         recv_ms = n_recv_ms;
         msgclk_ms = n_msgclk_ms;
-        source_name = strndup(n_name, kSrcNameLen);
+        strncpy(source_name, n_name, kSrcNameLen);
+        source_name[kSrcNameLen] = '\0';
+    }
+
+    void MessageBuffer::reset() {
+        buf_len = 0;
+        off = 0;
+        stream_pos = 0;
+        recv_ms = 0;
+        msgclk_ms = 0;
+        source_name[0] = '\0';
     }
     
   ssize_t MessageBuffer::read(uint8_t* result_buf, uint16_t result_len) {
@@ -109,10 +119,10 @@ namespace fcold {
   }
 
   ssize_t MessageBuffer::peek(uint8_t* result_buf, uint16_t result_len) {
-    assert(off <= buf_sz);
+    assert(off <= buf_len);
 
-    size_t bytes_to_copy = off + result_len > buf_sz 
-      ? buf_sz - off 
+    size_t bytes_to_copy = off + result_len > buf_len 
+      ? buf_len - off 
       : result_len;
     
     /* This assert is to make sure that bytes_to_copy can fit into a
@@ -140,23 +150,10 @@ namespace fcold {
   void MessageBuffer::advance_message_offset() {}
 
   const char* MessageBuffer::get_name() const {
-    if (source_name == 0) {
-      std::ostringstream sstr;
-
-      sstr << "MessageBuffer(address=0x" << static_cast<const void*>(buf) 
-	   << ",length=" << buf_sz << ')';
-      std::string s = sstr.str();
-
-      source_name = strndup(s.c_str(), kSrcNameLen);
-      
-      /* Old code:
-       *
-       *   source_name = new char[s.length() + 1];
-       *   std::strcpy(const_cast<char*>(source_name), s.c_str());
-       *
-       * Deleted because source_name is already strndup()'d above and
-       * also free()'d in the destructor.
-       */
+    if (source_name[0] == '\0') {
+      snprintf(source_name, sizeof source_name,
+               "MessageBuffer(address=%p,length=%zu)",
+               static_cast<const void*>(buf), buf_len);
     }
     
     return source_name;
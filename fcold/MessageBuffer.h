@@ -58,7 +58,9 @@ namespace fcold {
         uint64_t            recv_ms;
         uint64_t            msgclk_ms;
         
-        mutable const char* source_name;
+        /** Name of the message's session, kept in the buffer so that
+            naming a message allocates nothing. */
+        mutable char        source_name[kSrcNameLen + 1];
         size_t              off;
         
     public:
@@ -108,6 +110,12 @@ namespace fcold {
                           uint64_t msgclk_ms,
                           const char *name);
 
+        /**
+         * Empty this MessageBuffer and clear its metadata, so that it
+         * can take the next message.
+         */
+        void reset();
+
         size_t get_stream_pos() { return stream_pos;}
         uint64_t get_recv_ms() { return recv_ms; }
         uint64_t get_msgclk_ms() { return msgclk_ms; }
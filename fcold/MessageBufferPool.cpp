@@ -0,0 +1,147 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Preallocated message buffers of a listener
+ */
+
+#include <cassert>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "MessageBufferPool.h"
+#include "Numa.h"
+
+namespace fcold {
+
+    /** Size of a huge page, to which reserved huge page mappings
+        must be rounded. */
+    static const size_t kHugePageSz = 2 * 1024 * 1024;
+
+    MessageBufferPool::MessageBufferPool(size_t n_n_buffers, size_t n_buf_sz,
+                                         bool hugepages, int n_numa_node)
+        : waiter(std::make_shared<Waiter>()),
+          n_waiters(0),
+          region(nullptr),
+          huge(false),
+          numa_node(-1),
+          n_buffers(n_n_buffers),
+          buf_sz(n_buf_sz)
+    {
+        assert(n_buffers > 0);
+
+        /* The buffers, then the MessageBuffer objects. */
+        size_t objs_off = (n_buffers * buf_sz + alignof(MessageBuffer) - 1)
+                          / alignof(MessageBuffer) * alignof(MessageBuffer);
+        region_sz = objs_off + n_buffers * sizeof(MessageBuffer);
+
+        void* p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        if (hugepages) {
+            size_t huge_sz = (region_sz + kHugePageSz - 1)
+                             / kHugePageSz * kHugePageSz;
+            p = mmap(0, huge_sz, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                region_sz = huge_sz;
+                huge = true;
+            }
+        }
+#endif
+        if (p == MAP_FAILED) {
+            p = mmap(0, region_sz, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+            if (hugepages)
+                (void)madvise(p, region_sz, MADV_HUGEPAGE);
+#endif
+        }
+        region = static_cast<uint8_t*>(p);
+
+        /* Nothing has touched the mapping yet, so all of it will go
+         * to the node. */
+        if (n_numa_node >= 0 && bind_to_numa_node(region, region_sz,
+                                                  n_numa_node))
+            numa_node = n_numa_node;
+
+        buffers.reserve(n_buffers);
+        for (size_t i = 0; i < n_buffers; i++) {
+            void* obj = region + objs_off + i * sizeof(MessageBuffer);
+            MessageBuffer* mb = new (obj) MessageBuffer(region + i * buf_sz,
+                                                        buf_sz, false, false);
+            mb->reset();
+            buffers.push_back(mb);
+        }
+
+        /* get() takes from the back, so hand out the first buffers
+         * first. */
+        free_buffers.assign(buffers.rbegin(), buffers.rend());
+    }
+
+    MessageBufferPool::~MessageBufferPool() {
+        assert(free_buffers.size() == n_buffers);
+        for (auto i = buffers.begin(); i != buffers.end(); ++i)
+            (*i)->~MessageBuffer();
+        munmap(region, region_sz);
+    }
+
+    MessageBuffer* MessageBufferPool::get() {
+        std::unique_lock<std::mutex> lock(mtx);
+
+        if (free_buffers.empty())
+            return nullptr;
+
+        MessageBuffer* mb = free_buffers.back();
+        free_buffers.pop_back();
+        return mb;
+    }
+
+    void MessageBufferPool::put(MessageBuffer* mb) {
+        mb->reset();
+
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            free_buffers.push_back(mb);
+        }
+        waiter->notify();
+    }
+
+    void MessageBufferPool::put(MessageBuffer* const* mbs, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            mbs[i]->reset();
+
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            free_buffers.insert(free_buffers.end(), mbs, mbs + n);
+        }
+        waiter->notify();
+    }
+
+} // namespace fcold
@@ -0,0 +1,149 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Preallocated message buffers of a listener
+ */
+
+#ifndef _FCOLD_MESSAGEBUFFERPOOL_H_
+#  define _FCOLD_MESSAGEBUFFERPOOL_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "MessageBuffer.h"
+#include "Waiter.h"
+
+namespace fcold {
+
+    /**
+     * A bounded pool of MessageBuffers.  Frontends deframe messages
+     * into buffers from a pool, and keep buffers that their Imps hand
+     * back for the next messages, so that memory use is bounded by
+     * the pool size no matter how far the Imps fall behind.  Buffers
+     * only go back to the pool when a frontend has more than it needs
+     * or finishes.
+     *
+     * All buffers are allocated up front, in one mapping together
+     * with their MessageBuffer objects, so that receiving and
+     * collecting messages allocates nothing.  The mapping is not
+     * populated up front, and may be bound to the NUMA node of the
+     * listener, so that its pages are placed there when first
+     * touched.  Free buffers are reused most recently returned first,
+     * so that a lightly loaded listener only ever touches a few of
+     * them.
+     *
+     * Frontends that wait for a buffer say so with add_waiter(), and
+     * the others then give back all the buffers they keep.
+     *
+     * A pool must outlive all buffers taken from it.
+     */
+    class MessageBufferPool {
+    public:
+        /**
+         * Create a pool.
+         *
+         * @param n_buffers  maximum number of buffers in use at a time
+         * @param buf_sz     size of each buffer
+         * @param hugepages  back the buffers with huge pages: reserved
+         *                   ones if there are enough, transparent ones
+         *                   otherwise
+         * @param numa_node  NUMA node on which to place the buffers, or
+         *                   -1 to leave that to the kernel
+         */
+        MessageBufferPool(size_t n_buffers, size_t buf_sz = kMBufSz,
+                          bool hugepages = false, int numa_node = -1);
+
+        /** Destroy this pool and its buffers. */
+        ~MessageBufferPool();
+
+        /**
+         * Get an empty buffer, if there is one.
+         *
+         * @return an empty buffer, or 0 if all buffers are in use
+         */
+        MessageBuffer* get();
+
+        /** Return a buffer to the pool. */
+        void put(MessageBuffer* mb);
+
+        /** Return several buffers to the pool at once. */
+        void put(MessageBuffer* const* mbs, size_t n);
+
+        /**
+         * Get the waiter that is notified whenever buffers come back
+         * to the pool.  The Frontends of the pool share it with their
+         * Imps, so that a Frontend waiting for a buffer wakes up when
+         * one comes back from any of them.
+         */
+        std::shared_ptr<Waiter> get_waiter() const { return waiter; }
+
+        /** Note that a Frontend waits for a buffer. */
+        void add_waiter() { n_waiters.fetch_add(1); }
+
+        /** Note that a Frontend no longer waits for a buffer. */
+        void remove_waiter() { n_waiters.fetch_sub(1); }
+
+        /** Returns whether a Frontend waits for a buffer. */
+        bool is_wanted() const { return n_waiters.load() != 0; }
+
+        /** Get the size of the buffers in this pool. */
+        size_t bufsz() const { return buf_sz; }
+
+        /** Get the maximum number of buffers in use at a time. */
+        size_t size() const { return n_buffers; }
+
+        /** Returns whether the buffers are in reserved huge pages. */
+        bool uses_hugepages() const { return huge; }
+
+        /** Returns the NUMA node to which the buffers are bound, or
+            -1 if they aren't. */
+        int get_numa_node() const { return numa_node; }
+
+    private:
+        MessageBufferPool(const MessageBufferPool&) = delete;
+        MessageBufferPool& operator=(const MessageBufferPool&) = delete;
+
+        std::mutex                  mtx;
+        std::shared_ptr<Waiter>     waiter;
+        std::atomic<unsigned int>   n_waiters;
+        std::vector<MessageBuffer*> free_buffers;
+        std::vector<MessageBuffer*> buffers;
+        uint8_t*                    region;
+        size_t                      region_sz;
+        bool                        huge;
+        int                         numa_node;
+        size_t                      n_buffers;
+        size_t                      buf_sz;
+    };
+
+} // namespace fcold
+
+#endif /* defined(_FCOLD_MESSAGEBUFFERPOOL_H_) */
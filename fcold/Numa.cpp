@@ -0,0 +1,123 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__linux__)
+#  include <sys/syscall.h>
+#endif
+
+#include "Numa.h"
+
+#if !defined(MPOL_PREFERRED)
+#  define MPOL_PREFERRED 1
+#endif
+
+namespace fcold {
+
+    static const char* kNodeDir = "/sys/devices/system/node/";
+
+    /** Parses a list like "0-3,8,10-11", as the kernel writes them
+        into sysfs. */
+    static std::vector<int> parse_list(const std::string& list) {
+        std::vector<int> numbers;
+        std::istringstream in(list);
+        std::string range;
+
+        while (std::getline(in, range, ',')) {
+            char* end;
+            long first = strtol(range.c_str(), &end, 10);
+            if (end == range.c_str())
+                continue;
+            long last = first;
+            if (*end == '-')
+                last = strtol(end + 1, &end, 10);
+            for (long i = first; i <= last && i < INT_MAX; i++)
+                numbers.push_back(static_cast<int>(i));
+        }
+        return numbers;
+    }
+
+    static std::vector<int> read_list(const std::string& path) {
+        std::ifstream in(path.c_str());
+        std::string list;
+        std::getline(in, list);
+        return parse_list(list);
+    }
+
+    std::vector<int> numa_nodes() {
+        return read_list(std::string(kNodeDir) + "online");
+    }
+
+    bool pin_to_numa_node(int node) {
+        std::vector<int> cpus = read_list(std::string(kNodeDir) + "node"
+                                          + std::to_string(node) + "/cpulist");
+        if (cpus.empty()) {
+            errno = ENOENT;
+            return false;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto c = cpus.begin(); c != cpus.end(); ++c) {
+            if (*c < CPU_SETSIZE)
+                CPU_SET(*c, &set);
+        }
+
+        int rv = pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+        if (rv != 0) {
+            errno = rv;
+            return false;
+        }
+        return true;
+    }
+
+    bool bind_to_numa_node(void* p, size_t len, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+        const size_t bits = CHAR_BIT * sizeof(unsigned long);
+        std::vector<unsigned long> mask(node / bits + 1, 0);
+        mask[node / bits] |= 1UL << (node % bits);
+
+        /* Preferred rather than strictly bound, so that a node that
+         * runs out of memory, or of reserved huge pages, doesn't make
+         * faulting in a buffer fail. */
+        return syscall(SYS_mbind, p, len, MPOL_PREFERRED, mask.data(),
+                       mask.size() * bits + 1, 0) == 0;
+#else
+        errno = ENOSYS;
+        return false;
+#endif
+    }
+
+} // namespace fcold
@@ -0,0 +1,66 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Placing listener threads and their buffers on NUMA nodes.
+ */
+
+#ifndef _FCOLD_NUMA_H_
+#  define _FCOLD_NUMA_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace fcold {
+
+    /**
+     * Returns the NUMA nodes that are online, in ascending order, or
+     * nothing if the system doesn't say.
+     */
+    std::vector<int> numa_nodes();
+
+    /**
+     * Restricts the calling thread to the CPUs of a NUMA node.
+     * Threads that it creates afterwards inherit the restriction.
+     *
+     * @return true on success; on failure, errno says why
+     */
+    bool pin_to_numa_node(int node);
+
+    /**
+     * Asks for the pages of a memory region to be placed on a NUMA
+     * node when they are first touched.  Pages already in memory stay
+     * where they are.
+     *
+     * @return true on success; on failure, errno says why
+     */
+    bool bind_to_numa_node(void* p, size_t len, int node);
+
+} // namespace fcold
+
+#endif /* defined(_FCOLD_NUMA_H_) */
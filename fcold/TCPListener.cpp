@@ -0,0 +1,147 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Listener collecting IPFIX over TCP
+ */
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "Frontend.h"
+#include "TCPInputSource.h"
+#include "TCPListener.h"
+
+namespace fcold {
+
+  /** Length of the queue of connections not yet accepted. */
+  static const int kListenBacklog = 64;
+
+  TCPListener::TCPListener(ImpFactory& impfact, const std::string& address,
+                           const std::string& port, size_t n_buffers,
+                           bool hugepages, int numa_node)
+    : Listener(impfact, n_buffers, hugepages, numa_node),
+      fd(-1) {
+    fd = bind_socket(address, port, SOCK_STREAM);
+    if (fd < 0)
+      return;
+
+    if (::listen(fd, kListenBacklog) < 0) {
+      system_errno = errno;
+      return;
+    }
+
+    good = true;
+  }
+
+  TCPListener::~TCPListener() {
+    stop();
+    if (fd >= 0)
+      close(fd);
+  }
+
+  uint16_t TCPListener::get_port() const {
+    return socket_port(fd);
+  }
+
+  void TCPListener::read_connection(Connection* c) {
+    /* IPFIX is the only protocol that runs over TCP. */
+    Frontend frontend(impfact, pool, new libfc::TCPInputSource(c->fd),
+                      c->name, 10, c->fd);
+    report(frontend.run());
+
+    /* The frontend closes the socket when it goes out of scope, so
+     * mark the connection done before that, lest reap() shut down a
+     * descriptor that has been closed and reused. */
+    std::unique_lock<std::mutex> lock(connections_mtx);
+    c->done = true;
+  }
+
+  void TCPListener::reap(bool all) {
+    for (auto i = connections.begin(); i != connections.end(); ) {
+      Connection* c = *i;
+      {
+        std::unique_lock<std::mutex> lock(connections_mtx);
+        if (!c->done && !all) {
+          ++i;
+          continue;
+        }
+        /* Wake up a reader that waits for more input. */
+        if (!c->done)
+          shutdown(c->fd, SHUT_RDWR);
+      }
+      c->reader.join();
+      delete c;
+      i = connections.erase(i);
+    }
+  }
+
+  void TCPListener::listen() {
+    while (wait_readable(fd)) {
+      struct sockaddr_storage sa;
+      socklen_t sa_len = sizeof sa;
+
+      int cfd = accept(fd, reinterpret_cast<struct sockaddr*>(&sa), &sa_len);
+      if (cfd < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED)
+          continue;
+        good = false;
+        system_errno = errno;
+        break;
+      }
+      (void) fcntl(cfd, F_SETFD, FD_CLOEXEC);
+
+      char host[NI_MAXHOST];
+      char serv[NI_MAXSERV];
+      char name[NI_MAXHOST + NI_MAXSERV + 4];
+      if (getnameinfo(reinterpret_cast<struct sockaddr*>(&sa), sa_len,
+                      host, sizeof host, serv, sizeof serv,
+                      NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        snprintf(name, sizeof name, "<TCP peer %d>", cfd);
+      else if (sa.ss_family == AF_INET6)
+        snprintf(name, sizeof name, "[%s]:%s", host, serv);
+      else
+        snprintf(name, sizeof name, "%s:%s", host, serv);
+
+      reap(false);
+
+      Connection* c = new Connection;
+      c->fd = cfd;
+      c->name = name;
+      c->done = false;
+      connections.push_back(c);
+      c->reader = std::thread(&TCPListener::read_connection, this, c);
+    }
+
+    reap(true);
+  }
+
+} // namespace fcold
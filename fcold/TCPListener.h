@@ -0,0 +1,101 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Listener collecting IPFIX over TCP
+ */
+#ifndef _FCOLD_TCPLISTENER_H_
+#  define _FCOLD_TCPLISTENER_H_
+
+#  include <list>
+#  include <mutex>
+#  include <string>
+#  include <thread>
+
+#  include "Listener.h"
+
+namespace fcold {
+
+  /** Accepts IPFIX connections over TCP.
+   *
+   * Every connection is a session, read by a thread of its own.
+   * The session ends when the exporter closes the connection or
+   * when its message stream has an error.
+   */
+  class TCPListener : public Listener {
+  public:
+    /** Creates a TCP listener.
+     *
+     * If the socket can't be opened, the is_good() member function
+     * will return false, and get_errno() will return something
+     * nonzero if the reason was a system error.
+     *
+     * @param impfact creates the Imps of the sessions
+     * @param address address to listen on, or empty for all
+     * @param port port to listen on; "0" picks a free port
+     * @param n_buffers number of message buffers, shared by all
+     *   connections
+     * @param hugepages whether to back the buffers with huge pages
+     * @param numa_node NUMA node to run on and to put the buffers
+     *   on, or -1 for none in particular
+     */
+    TCPListener(ImpFactory& impfact, const std::string& address,
+                const std::string& port, size_t n_buffers,
+                bool hugepages = false, int numa_node = -1);
+    ~TCPListener();
+
+    /** Returns the port this listener is bound to. */
+    uint16_t get_port() const;
+
+  protected:
+    /* From Listener */
+    void listen();
+
+  private:
+    struct Connection {
+      int fd;
+      std::string name;
+      /** Whether the session has ended and fd is closed. */
+      bool done;
+      std::thread reader;
+    };
+
+    void read_connection(Connection* c);
+
+    /** Joins the readers of the connections that are done. */
+    void reap(bool all);
+
+    int fd;
+    std::list<Connection*> connections;
+    /** Protects the done flags of the connections. */
+    std::mutex connections_mtx;
+  };
+
+} // namespace fcold
+
+#endif /* _FCOLD_TCPLISTENER_H_ */
@@ -0,0 +1,159 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Listener collecting IPFIX and NetFlow v9 over UDP
+ */
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include <netdb.h>
+#include <unistd.h>
+
+#include "Frontend.h"
+#include "UDPListener.h"
+
+namespace fcold {
+
+  /** Receive buffer size asked for, so that bursts don't get lost
+   * while the listener waits for buffers. */
+  static const int kReceiveBufferSize = 4 * 1024 * 1024;
+
+  /** Maximum number of datagrams received between checks for being
+   * told to stop. */
+  static const int kDrainBatch = 64;
+
+  /** Returns the time in milliseconds since the epoch. */
+  static uint64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  UDPListener::UDPListener(ImpFactory& impfact, const std::string& address,
+                           const std::string& port, size_t n_buffers,
+                           bool hugepages, int numa_node,
+                           unsigned int nidle_s, size_t nmax_sessions)
+    : Listener(impfact, n_buffers, hugepages, numa_node),
+      fd(-1),
+      idle_s(nidle_s),
+      max_sessions(nmax_sessions) {
+    fd = bind_socket(address, port, SOCK_DGRAM);
+    if (fd < 0)
+      return;
+
+    int size = kReceiveBufferSize;
+    (void) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+
+    good = true;
+  }
+
+  UDPListener::~UDPListener() {
+    stop();
+    if (fd >= 0)
+      close(fd);
+  }
+
+  uint16_t UDPListener::get_port() const {
+    return socket_port(fd);
+  }
+
+  void UDPListener::listen() {
+    Frontend frontend(impfact, pool);
+    frontend.limit_sessions(max_sessions);
+
+    /* Idle sessions are looked for every half idle time, so they are
+     * closed within one and a half idle times of their last
+     * message. */
+    uint64_t idle_ms = uint64_t(idle_s) * 1000;
+    int check_ms = idle_s == 0 ? -1 : static_cast<int>(
+      std::min<uint64_t>(idle_ms / 2, std::numeric_limits<int>::max()));
+    uint64_t next_check = now_ms() + check_ms;
+
+    /* The name of the most recent peer, which is usually the next
+     * one too. */
+    struct sockaddr_storage last_sa;
+    socklen_t last_sa_len = 0;
+    char name[NI_MAXHOST + NI_MAXSERV + 4];
+
+    while (wait_readable(fd, check_ms)) {
+      /* Drain the socket before waiting again. */
+      for (int i = 0; i < kDrainBatch; i++) {
+        MessageBuffer* mb = frontend.get_mbuf();
+        struct sockaddr_storage sa;
+        socklen_t sa_len = sizeof sa;
+
+        ssize_t n = recvfrom(fd, mb->bufptr(), mb->bufsz(), MSG_DONTWAIT,
+                             reinterpret_cast<struct sockaddr*>(&sa), &sa_len);
+        if (n < 0) {
+          int recv_errno = errno;
+          frontend.put_mbuf(mb);
+          if (recv_errno == EINTR)
+            continue;
+          if (recv_errno != EAGAIN && recv_errno != EWOULDBLOCK) {
+            good = false;
+            system_errno = recv_errno;
+          }
+          break;
+        }
+
+        if (sa_len != last_sa_len || memcmp(&sa, &last_sa, sa_len) != 0) {
+          char host[NI_MAXHOST];
+          char serv[NI_MAXSERV];
+          if (getnameinfo(reinterpret_cast<struct sockaddr*>(&sa), sa_len,
+                          host, sizeof host, serv, sizeof serv,
+                          NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+            snprintf(name, sizeof name, "<UDP peer>");
+          else if (sa.ss_family == AF_INET6)
+            snprintf(name, sizeof name, "[%s]:%s", host, serv);
+          else
+            snprintf(name, sizeof name, "%s:%s", host, serv);
+          memcpy(&last_sa, &sa, sa_len);
+          last_sa_len = sa_len;
+        }
+
+        mb->setbuflen(n);
+        mb->set_metadata(0, now_ms(), 0, name);
+        report(frontend.dispatch(mb));
+      }
+
+      if (!good)
+        break;
+
+      uint64_t now = now_ms();
+      if (idle_s != 0 && now >= next_check) {
+        frontend.expire_sessions(now - idle_ms);
+        next_check = now + check_ms;
+      }
+    }
+
+    frontend.finish();
+  }
+
+} // namespace fcold
@@ -0,0 +1,98 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Listener collecting IPFIX and NetFlow v9 over UDP
+ */
+#ifndef _FCOLD_UDPLISTENER_H_
+#  define _FCOLD_UDPLISTENER_H_
+
+#  include <string>
+
+#  include <sys/socket.h>
+
+#  include "Listener.h"
+
+namespace fcold {
+
+  /** Receives IPFIX and NetFlow v9 messages on a UDP socket.
+   *
+   * Every datagram is a message, and every exporter, as identified
+   * by its address and port, is a session.  Sessions last until the
+   * listener is stopped.
+   */
+  class UDPListener : public Listener {
+  public:
+    /** Default for the idle time after which sessions are closed. */
+    static const unsigned int kDefaultIdleSeconds = 600;
+
+    /** Default for the most sessions open at a time. */
+    static const size_t kDefaultMaxSessions = 4096;
+
+    /** Creates a UDP listener.
+     *
+     * If the socket can't be opened, the is_good() member function
+     * will return false, and get_errno() will return something
+     * nonzero if the reason was a system error.
+     *
+     * @param impfact creates the Imps of the sessions
+     * @param address address to listen on, or empty for all
+     * @param port port to listen on; "0" picks a free port
+     * @param n_buffers number of message buffers
+     * @param hugepages whether to back the buffers with huge pages
+     * @param numa_node NUMA node to run on and to put the buffers
+     *   on, or -1 for none in particular
+     * @param idle_s seconds after which a session without messages is
+     *   closed, since UDP exporters never say that they are done, or 0
+     *   to keep sessions open until the listener stops
+     * @param max_sessions most sessions open at a time, or 0 for no
+     *   limit; messages from further exporters are dropped
+     */
+    UDPListener(ImpFactory& impfact, const std::string& address,
+                const std::string& port, size_t n_buffers,
+                bool hugepages = false, int numa_node = -1,
+                unsigned int idle_s = kDefaultIdleSeconds,
+                size_t max_sessions = kDefaultMaxSessions);
+    ~UDPListener();
+
+    /** Returns the port this listener is bound to. */
+    uint16_t get_port() const;
+
+  protected:
+    /* From Listener */
+    void listen();
+
+  private:
+    int fd;
+    unsigned int idle_s;
+    size_t max_sessions;
+  };
+
+} // namespace fcold
+
+#endif /* _FCOLD_UDPLISTENER_H_ */
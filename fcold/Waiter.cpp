@@ -1,4 +1,3 @@
-/* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -27,22 +26,29 @@
 
 /**
  * @file
- * @author Brian Trammell <trammell@tik.ee.ethz.ch>
+ * @brief Waiting for conditions that lock-free code brings about
  */
 
-#ifndef _FCOLD_WANDFILEFRONTEND_H_
-#  define _FCOLD_WANDFILEFRONTEND_H_
+#include "Waiter.h"
 
 namespace fcold {
-    class WandFileFrontend: public Frontend {
 
-    public:
-        WandFileFrontend(ImpFactory&            impfact,
-                         const std::string&     filename):
-        Frontend(impfact, new libfc::WandioInputSource(filename))
-        {}
-    };
-}
+    Waiter::Waiter()
+        : sleepers(0),
+          can_spin(std::thread::hardware_concurrency() > 1)
+    {
+        spins = can_spin ? kMinSpins : 0;
+    }
 
-#endif /* idem hack */
+    void Waiter::spun() {
+        unsigned int n_spins = spins.load(std::memory_order_relaxed);
+        if (n_spins < kMaxSpins)
+            spins.store(n_spins * 2, std::memory_order_relaxed);
+    }
 
+    void Waiter::parked() {
+        unsigned int n_spins = spins.load(std::memory_order_relaxed);
+        if (can_spin && n_spins > kMinSpins)
+            spins.store(n_spins / 2, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,127 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Waiting for conditions that lock-free code brings about
+ */
+
+#ifndef _FCOLD_WAITER_H_
+#  define _FCOLD_WAITER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace fcold {
+
+    /**
+     * Waits for a condition that other threads bring about without
+     * taking a lock, such as room or buffers appearing in a lock-free
+     * queue.  A waiter first spins, re-checking the condition, then
+     * yields the processor a few times, and only then parks on a
+     * condition variable.  Threads that may have made the condition
+     * true call notify(), which costs a single load unless a thread is
+     * actually parked.
+     *
+     * The spin budget adapts: it grows when conditions tend to come
+     * true while spinning and shrinks when waits end up parked, so
+     * that short waits stay off the scheduler and long ones don't burn
+     * CPU.  On a single processor, waiters never spin.
+     */
+    class Waiter {
+    public:
+        Waiter();
+
+        /**
+         * Waits until ready() returns true.  ready() is called
+         * repeatedly, from the waiting thread only, and may have
+         * side effects, such as taking an element from a queue.
+         */
+        template <typename Ready> void wait(Ready ready) {
+            unsigned int n_spins = spins.load(std::memory_order_relaxed);
+            for (unsigned int i = 0; i < n_spins; i++) {
+                if (ready()) {
+                    spun();
+                    return;
+                }
+                relax();
+            }
+            for (unsigned int i = 0; i < kYields; i++) {
+                if (ready())
+                    return;
+                std::this_thread::yield();
+            }
+
+            parked();
+            std::unique_lock<std::mutex> lock(mtx);
+            sleepers.fetch_add(1);
+            /* The timeout only guards against conditions that come
+             * true without a notify(); it is not needed otherwise. */
+            while (!ready())
+                cv.wait_for(lock, std::chrono::milliseconds(kParkMs));
+            sleepers.fetch_sub(1);
+        }
+
+        /** Wakes parked waiters, after the condition may have changed. */
+        void notify() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_relaxed) != 0) {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.notify_all();
+            }
+        }
+
+    private:
+        Waiter(const Waiter&) = delete;
+        Waiter& operator=(const Waiter&) = delete;
+
+        static const unsigned int kMinSpins = 16;
+        static const unsigned int kMaxSpins = 16384;
+        static const unsigned int kYields = 4;
+        static const unsigned int kParkMs = 10;
+
+        static void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+
+        void spun();
+        void parked();
+
+        std::atomic<unsigned int>   spins;
+        std::atomic<unsigned int>   sleepers;
+        bool                        can_spin;
+        std::mutex                  mtx;
+        std::condition_variable     cv;
+    };
+}
+
+#endif /* defined(_FCOLD_WAITER_H_) */
@@ -1,4 +1,3 @@
-/* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -27,49 +26,65 @@
 
 /**
  * @file
- * @author Brian Trammell <trammell@tik.ee.ethz.ch>
+ * @brief Worker threads on which fcold runs its Imps
  */
 
+#include "Imp.h"
+#include "WorkerPool.h"
+
 namespace fcold {
 
+    WorkerPool::WorkerPool(unsigned int n_workers)
+        : n_runnable(0),
+          stopping(false)
+    {
+        if (n_workers == 0)
+            n_workers = std::thread::hardware_concurrency();
+        if (n_workers == 0)
+            n_workers = 1;
 
-    static std::string filename_to_stat(const std::String& filename) {
-        auto datidx = filename.rfind(".dat", filename.size() - 1);
-        if (datidx == std::string::npos)
-            // This will probably never work, but hey at least we tried.
-            return filename + ".stat";
-        else
-            return filename.substr(0, datidx) + ".stat" +
-                   filename.substr(datidx + 4, filename.size() - (datidx + 4));
+        for (unsigned int i = 0; i < n_workers; i++)
+            workers.push_back(std::thread(&WorkerPool::work, this));
     }
-    
-    StatdatFrontend::next_statline()
-    {
-        // fixme do stuff
+
+    WorkerPool::~WorkerPool() {
+        stop();
     }
-    
-    StatdatFrontend::StatdatFrontend(ImpFactory&        impfact,
-                                     const std::string& filename):
-        WandioFrontend(impfact, filename)
-    {
-        // Attempt to open the associated statfile
-        stat_filename = filename_to_stat(filename);
-        stat_is = new WandioInputSource(stat_filename);
-        if (stat_is->get_error()) {
-            // FIXME report error: can't open statfile
-            delete stat_is;
-            stat_is = nullptr;
+
+    void WorkerPool::schedule(Imp* imp) {
+        {
+            std::unique_lock<std::mutex> lock(runqmtx);
+            runq.push_back(imp);
+            n_runnable++;
         }
-        
+        idle.notify();
     }
-    
-    std::shared_ptr<libfc::ErrorContext>
-        StatdatFrontend::deframe_next(std::shared_ptr<MessageBuffer>& mb)
-    {
-        // get the message first
-        WandioFrontend::deframe_next(mb);
-        
-        // now get the next stat line if we can
-        if (stat_is) next_statline();
+
+    void WorkerPool::stop() {
+        stopping = true;
+        idle.notify();
+        for (auto i = workers.begin(); i != workers.end(); ++i)
+            if (i->joinable())
+                i->join();
+    }
+
+    void WorkerPool::work() {
+        while (true) {
+            idle.wait([this] { return n_runnable > 0 || stopping; });
+
+            Imp* imp = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(runqmtx);
+                if (!runq.empty()) {
+                    imp = runq.front();
+                    runq.pop_front();
+                    n_runnable--;
+                }
+            }
+            if (imp != nullptr)
+                imp->run(kImpBatch);
+            else if (stopping)
+                return;
+        }
     }
-}
\ No newline at end of file
+}
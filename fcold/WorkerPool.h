@@ -0,0 +1,102 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY 
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING 
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Worker threads on which fcold runs its Imps
+ */
+
+#ifndef _FCOLD_WORKERPOOL_H_
+#  define _FCOLD_WORKERPOOL_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Waiter.h"
+
+namespace fcold {
+
+    class Imp;
+
+    /**
+     * A fixed number of worker threads that run Imps.  An Imp with
+     * queued messages schedules itself on the pool, and a worker then
+     * collects a batch of its messages before moving on to the next
+     * Imp, so that any number of sessions share the workers fairly.
+     * An Imp is run by at most one worker at a time.
+     *
+     * Idle workers spin for a while before they park, so that a
+     * steady stream of messages keeps them awake.
+     */
+    class WorkerPool {
+    public:
+        /** Maximum number of messages an Imp collects per turn. */
+        static const size_t kImpBatch = 64;
+
+        /**
+         * Creates a worker pool and starts its workers.
+         *
+         * @param n_workers  number of worker threads, or 0 for one
+         *                   per hardware thread
+         */
+        WorkerPool(unsigned int n_workers = 0);
+
+        /** Stops the workers, see stop(). */
+        ~WorkerPool();
+
+        /**
+         * Puts an Imp on the run queue.  Imps call this themselves
+         * when a message is queued for them.
+         */
+        void schedule(Imp* imp);
+
+        /**
+         * Runs the Imps still on the run queue, then stops the
+         * workers.  No Imp may be scheduled after this.
+         */
+        void stop();
+
+        /** Returns the number of worker threads. */
+        size_t size() const { return workers.size(); }
+
+    private:
+        void work();
+
+        std::vector<std::thread>    workers;
+        std::deque<Imp*>            runq;
+        std::mutex                  runqmtx;
+        /** Length of the run queue, for idle workers to watch. */
+        std::atomic<size_t>         n_runnable;
+        std::atomic<bool>           stopping;
+        Waiter                      idle;
+    };
+}
+
+#endif /* defined(_FCOLD_WORKERPOOL_H_) */
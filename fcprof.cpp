@@ -25,9 +25,1556 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
  */
 
-/* This file remains only as a skeleton since the Great API Cleanup of
-   April 2014.  Please look at repository versions before that date to
-   see what was originally in here. */
+/** Benchmark libfc's collection and export paths.
+ *
+ * This program measures the throughput of parsing and decoding IPFIX
+ * and NetFlow v9 message streams, in records per second, bytes per
+ * second and nanoseconds per record, for a number of representative
+ * workloads.  The message streams are generated in memory before
+ * measurement starts and are read through a BufferInputSource, so that
+ * I/O does not enter into the measurement.
+ *
+ * It also measures PlacementExporter writing to a
+ * MemoryExportDestination, and round trips that export to memory,
+ * collect the result again and check that every value survived.
+ *
+ * The ftrace/ benchmarks read an exported file through libftrace,
+ * which hands uniflows from its reader thread to the caller.
+ *
+ * Finally, there are microbenchmarks for single DecodePlan and
+ * EncodePlan decision types, which report nanoseconds per decoded or
+ * encoded field ("ns_per_op").  Use -f decode/ or -f encode/ to run
+ * only those.
+ *
+ * Results are written as JSON, so that they can be tracked over time.
+ *
+ * Syntax: fcprof [-t seconds] [-f filter] [-o output-file]
+ *
+ * E.g. ./fcprof -t 2 -f ipfix/ > fcprof-ipfix.json
+ *
+ * @author Stephan Neuhaus <neuhaust@tik.ee.ethz.ch>
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "BasicOctetArray.h"
+#include "BufferInputSource.h"
+#include "Constants.h"
+#include "DecodePlan.h"
+#include "EncodePlan.h"
+#include "IETemplate.h"
+#include "IEType.h"
+#include "InfoElement.h"
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementCollector.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "RecordMapper.h"
+#include "StaticPlacementCollector.h"
+
+#include "exceptions/ExportError.h"
+#include "exceptions/FormatError.h"
+
+#include "libftrace.h"
+
+using namespace libfc;
+
+static double min_seconds = 1.0;
+static int help_flag = false;
+static std::string filter;
+static std::string output_file_name;
+
+/** Maximum message size that generated messages may have.
+ *
+ * This is what would fit into a UDP datagram on an Ethernet. */
+static const size_t kBenchMessageSize = 1400;
+
+/** Export time in generated message headers. */
+static const uint32_t kBenchExportTime = 1400000000;
+
+/* Code patterned after http://www.gnu.org/software/libc/
+ * manual/html_node/Getopt-Long-Option-Example.html
+ * #Getopt-Long-Option-Example */
+static void parse_options(int argc, char* const* argv) {
+
+  while (1) {
+    static struct option options[] = {
+      { "help", no_argument, &help_flag, 1 },
+      { "filter", required_argument, 0, 'f' },
+      { "output", required_argument, 0, 'o' },
+      { "time", required_argument, 0, 't' },
+      { 0, 0, 0, 0 },
+    };
+
+    int option_index = 0;
+
+    int c = getopt_long(argc, argv, "hf:o:t:", options, &option_index);
+
+    if (c == -1)
+      break;
+
+    switch(c) {
+    case 0:
+      break;
+    case 'h':
+      help_flag = true;
+      break;
+    case 'f':
+      filter = optarg;
+      break;
+    case 'o':
+      output_file_name = optarg;
+      break;
+    case 't':
+      min_seconds = atof(optarg);
+      if (min_seconds <= 0) {
+        std::cerr << "Measurement time must be positive, got "
+                  << optarg << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      std::cerr << "Unrecognised option character '" << c 
+                << "', aborting" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+static void help() {
+  std::cerr << "usage: ./fcprof [options]" << std::endl
+            << "Options:" << std::endl
+            << "  -f s|--filter=s\trun only benchmarks whose name contains S"
+            << std::endl
+            << "  -o file|--output=file\twrite JSON results to FILE"
+            << std::endl
+            << "  -t n|--time=n\tmeasure each benchmark for at least N seconds"
+            << " (default 1)" << std::endl
+            << "  -h|--help\tprint this help text" << std::endl;
+}
+
+/** Small and fast pseudo-random number generator (xorshift64*).
+ *
+ * We don't need good randomness, but we need the same message
+ * streams on every run, so that results are comparable. */
+class Random {
+public:
+  Random(uint64_t seed = 0x9e3779b97f4a7c15ULL) : state(seed) {}
+
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+  }
+
+  uint32_t below(uint32_t n) {
+    return static_cast<uint32_t>(next() % n);
+  }
+
+private:
+  uint64_t state;
+};
+
+/** A field in a generated template. */
+struct Field {
+  const InfoElement* ie;
+  /** Length on the wire, or kIpfixVarlen. */
+  uint16_t length;
+};
+
+typedef std::vector<Field> FieldList;
+
+static Field field(const char* name, uint16_t length = 0) {
+  const InfoElement* ie = InfoModel::instance().lookupIE(name);
+  if (ie == 0) {
+    std::cerr << "Unknown IE " << name << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  Field ret = { ie, length == 0 ? ie->len() : length };
+  return ret;
+}
+
+/** Describes one collection benchmark. */
+struct Workload {
+  std::string name;
+  PlacementCollector::Protocol protocol;
+  std::vector<FieldList> templates;
+  unsigned int n_domains;
+  /** Maximum number of records per data set, or 0 for no limit. */
+  unsigned int records_per_set;
+  /** Maximum length of varlen fields. */
+  uint16_t max_varlen;
+};
+
+static void put16(std::vector<uint8_t>& buf, uint16_t v) {
+  buf.push_back(static_cast<uint8_t>(v >> 8));
+  buf.push_back(static_cast<uint8_t>(v));
+}
+
+static void put32(std::vector<uint8_t>& buf, uint32_t v) {
+  put16(buf, static_cast<uint16_t>(v >> 16));
+  put16(buf, static_cast<uint16_t>(v));
+}
+
+static void patch16(std::vector<uint8_t>& buf, size_t off, uint16_t v) {
+  buf[off] = static_cast<uint8_t>(v >> 8);
+  buf[off + 1] = static_cast<uint8_t>(v);
+}
+
+/** Assembles IPFIX or v9 messages directly in wire format. */
+class MessageBuilder {
+public:
+  MessageBuilder(PlacementCollector::Protocol protocol,
+                 std::vector<uint8_t>& out)
+    : protocol(protocol), out(out), message_start(0), set_start(0),
+      set_id(0), set_open(false), n_records(0) {
+  }
+
+  void start_message(uint32_t domain, uint32_t sequence_number) {
+    message_start = out.size();
+    n_records = 0;
+
+    if (protocol == PlacementCollector::ipfix) {
+      put16(out, kIpfixVersion);
+      put16(out, 0); /* Length, patched in end_message() */
+      put32(out, kBenchExportTime);
+      put32(out, sequence_number);
+      put32(out, domain);
+    } else {
+      put16(out, kV9Version);
+      put16(out, 0); /* Count, patched in end_message() */
+      put32(out, 123456); /* System uptime */
+      put32(out, kBenchExportTime);
+      put32(out, sequence_number);
+      put32(out, domain);
+    }
+  }
+
+  void add_template(uint16_t id, const FieldList& fields) {
+    start_set(protocol == PlacementCollector::ipfix ? kIpfixTemplateSetID
+                                                   : kV9TemplateSetID);
+    put16(out, id);
+    put16(out, fields.size());
+    for (auto f = fields.begin(); f != fields.end(); ++f) {
+      if (f->ie->pen() != 0) {
+        put16(out, f->ie->number() | 0x8000);
+        put16(out, f->length);
+        put32(out, f->ie->pen());
+      } else {
+        put16(out, f->ie->number());
+        put16(out, f->length);
+      }
+    }
+    n_records++;
+  }
+
+  /** Generates a record and appends it to the current message if it
+   * fits into size_limit bytes.  The first record of a message is
+   * always added, so that no message is empty.
+   *
+   * @return true if the record was added, false if it didn't fit
+   */
+  bool add_record(uint16_t id, const FieldList& fields, Random& r,
+                  uint16_t max_varlen, size_t size_limit) {
+    record.clear();
+    for (auto f = fields.begin(); f != fields.end(); ++f) {
+      size_t length = f->length;
+      if (length == kIpfixVarlen) {
+        length = max_varlen == 0 ? 0 : r.below(max_varlen + 1);
+        if (length < 255)
+          record.push_back(static_cast<uint8_t>(length));
+        else {
+          record.push_back(255);
+          put16(record, static_cast<uint16_t>(length));
+        }
+      }
+      for (size_t i = 0; i < length; i++)
+        record.push_back(static_cast<uint8_t>(r.next() >> 56));
+    }
+
+    size_t new_bytes = record.size()
+      + (set_open && id == set_id ? 0 : kIpfixSetHeaderLen);
+    if (n_records > 0 && message_size() + new_bytes > size_limit)
+      return false;
+
+    start_set(id);
+    out.insert(out.end(), record.begin(), record.end());
+    n_records++;
+    return true;
+  }
+
+  size_t message_size() const { return out.size() - message_start; }
+
+  /** Starts a new data set, even if the current one has the same ID. */
+  void break_set() { finish_set(); }
+
+  void end_message() {
+    finish_set();
+    if (protocol == PlacementCollector::ipfix)
+      patch16(out, message_start + 2, message_size());
+    else
+      patch16(out, message_start + 2, n_records);
+  }
+
+private:
+  void start_set(uint16_t id) {
+    if (set_open && id == set_id)
+      return;
+    finish_set();
+    set_start = out.size();
+    set_id = id;
+    set_open = true;
+    put16(out, id);
+    put16(out, 0);  /* Length, patched in finish_set() */
+  }
+
+  void finish_set() {
+    if (set_open)
+      patch16(out, set_start + 2, out.size() - set_start);
+    set_open = false;
+  }
+
+  PlacementCollector::Protocol protocol;
+  std::vector<uint8_t>& out;
+  std::vector<uint8_t> record;
+  size_t message_start;
+  size_t set_start;
+  uint16_t set_id;
+  bool set_open;
+  uint16_t n_records;
+};
+
+/** Generates a message stream for a workload.
+ *
+ * @param w the workload
+ * @param target_bytes approximate size of the stream, in bytes
+ * @param n_records is set to the number of data records in the stream
+ *
+ * @return the message stream
+ */
+static std::vector<uint8_t>
+make_stream(const Workload& w, size_t target_bytes, uint64_t* n_records) {
+  std::vector<uint8_t> ret;
+  ret.reserve(target_bytes + kMaxMessageLen);
+
+  MessageBuilder b(w.protocol, ret);
+  Random r;
+  std::vector<uint32_t> sequence_numbers(w.n_domains, 0);
+  std::vector<unsigned int> next_template(w.n_domains, 0);
+  const bool is_ipfix = w.protocol == PlacementCollector::ipfix;
+
+  *n_records = 0;
+
+  /* One message per domain with all templates in it. */
+  for (unsigned int d = 0; d < w.n_domains; d++) {
+    b.start_message(d + 1, 0);
+    for (unsigned int t = 0; t < w.templates.size(); t++)
+      b.add_template(kMinDataSetId + t, w.templates[t]);
+    b.end_message();
+    if (!is_ipfix)
+      sequence_numbers[d]++;
+  }
+
+  for (unsigned int m = 0; ret.size() < target_bytes; m++) {
+    const unsigned int d = m % w.n_domains;
+    unsigned int n_message_records = 0;
+
+    b.start_message(d + 1, sequence_numbers[d]);
+
+    bool full = false;
+    while (!full) {
+      const unsigned int t = next_template[d];
+      next_template[d] = (t + 1) % w.templates.size();
+
+      unsigned int n = 0;
+      while (w.records_per_set == 0 || n < w.records_per_set) {
+        if (!b.add_record(kMinDataSetId + t, w.templates[t], r, w.max_varlen,
+                          kBenchMessageSize)) {
+          full = true;
+          break;
+        }
+        n++;
+      }
+      b.break_set();
+      n_message_records += n;
+    }
+
+    b.end_message();
+    sequence_numbers[d] += is_ipfix ? n_message_records : 1;
+    *n_records += n_message_records;
+  }
+
+  return ret;
+}
+
+/** Memory locations for the fields of a set of templates.
+ *
+ * Every field gets its own slot, which is large enough for any
+ * fixlen IE and contains a BasicOctetArray for octetArray and string
+ * IEs. */
+class Placements {
+public:
+  /** Creates placement templates for a list of field lists.
+   *
+   * @param templates the field lists
+   * @param for_export if true, register fields with their wire
+   *   lengths, as needed by PlacementExporter; if false, register
+   *   them with the default length, as suffices for collection
+   */
+  Placements(const std::vector<FieldList>& templates, bool for_export)
+    : fields(templates) {
+    for (auto t = templates.begin(); t != templates.end(); ++t) {
+      PlacementTemplate* tmpl = new PlacementTemplate();
+      std::vector<Slot*> s;
+
+      for (auto f = t->begin(); f != t->end(); ++f) {
+        Slot* slot = new Slot();
+        memset(slot->bytes, 0, sizeof(slot->bytes));
+        s.push_back(slot);
+        tmpl->register_placement(f->ie, location(*f, slot),
+                                 for_export ? f->length : 0);
+      }
+
+      index[tmpl] = this->templates.size();
+      this->templates.push_back(tmpl);
+      slots.push_back(s);
+    }
+  }
+
+  ~Placements() {
+    for (auto i = templates.begin(); i != templates.end(); ++i)
+      delete *i;
+    for (auto i = slots.begin(); i != slots.end(); ++i)
+      for (auto j = i->begin(); j != i->end(); ++j)
+        delete *j;
+  }
+
+  size_t size() const { return templates.size(); }
+
+  PlacementTemplate* get(size_t i) const { return templates[i]; }
+
+  /** Returns the index of a placement template, or size() if the
+   * template doesn't belong to this object. */
+  size_t index_of(const PlacementTemplate* t) const {
+    auto i = index.find(t);
+    return i == index.end() ? templates.size() : i->second;
+  }
+
+  /** Fills the slots of a template with random values. */
+  void fill(size_t i, Random& r, uint16_t max_varlen) {
+    for (size_t j = 0; j < slots[i].size(); j++) {
+      const Field& f = fields[i][j];
+      Slot* slot = slots[i][j];
+
+      if (f.length == kIpfixVarlen) {
+        uint8_t buf[kMaxMessageLen];
+        size_t length = max_varlen == 0 ? 0 : r.below(max_varlen + 1);
+        for (size_t k = 0; k < length; k++)
+          buf[k] = static_cast<uint8_t>(r.next() >> 56);
+        slot->octets.copy_content(buf, length);
+      } else {
+        uint64_t v[2] = { r.next(), r.next() };
+        memcpy(slot->bytes, v, std::min<size_t>(f.length, sizeof(v)));
+      }
+    }
+  }
+
+  /** Computes a hash over the values in the slots of a template. */
+  uint64_t hash(size_t i) const {
+    uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+
+    for (size_t j = 0; j < slots[i].size(); j++) {
+      const Field& f = fields[i][j];
+      const Slot* slot = slots[i][j];
+      const uint8_t* p = slot->bytes;
+      size_t length = f.length;
+
+      if (is_octets(f)) {
+        p = slot->octets.get_buf();
+        length = slot->octets.get_length();
+      }
+      for (size_t k = 0; k < length; k++)
+        h = (h ^ p[k]) * 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+private:
+  struct Slot {
+    union {
+      uint64_t align;
+      uint8_t bytes[16];
+    };
+    BasicOctetArray octets;
+  };
+
+  static bool is_octets(const Field& f) {
+    unsigned int type = f.ie->ietype()->number();
+    return type == IEType::kOctetArray || type == IEType::kString;
+  }
+
+  static void* location(const Field& f, Slot* slot) {
+    return is_octets(f) ? static_cast<void*>(&slot->octets)
+                        : static_cast<void*>(slot->bytes);
+  }
+
+  std::vector<FieldList> fields;
+  std::vector<PlacementTemplate*> templates;
+  std::vector<std::vector<Slot*> > slots;
+  std::map<const PlacementTemplate*, size_t> index;
+};
+
+/** Returns the order in which to register the placement templates
+ * for a workload with a collector.
+ *
+ * Placement templates are matched first come, first served, so the
+ * large ones come first to make sure that each wire template is
+ * matched by the placement template built for it.
+ */
+static std::vector<size_t> registration_order(const Workload& w) {
+  std::vector<size_t> order;
+  for (size_t i = 0; i < w.templates.size(); i++)
+    order.push_back(i);
+  std::stable_sort(order.begin(), order.end(),
+                   [&w](size_t a, size_t b) {
+                     return w.templates[a].size() > w.templates[b].size();
+                   });
+
+  return order;
+}
+
+/** Collector that decodes every field of every record.
+ *
+ * For every template of a workload, this collector registers a
+ * placement template that contains all of the template's fields, so
+ * that every field is transferred, not skipped. */
+class BenchCollector : public PlacementCollector {
+public:
+  /** Creates a collector.
+   *
+   * @param w the workload
+   * @param verify if true, compute a hash over all decoded values
+   */
+  BenchCollector(const Workload& w, bool verify = false)
+    : PlacementCollector(w.protocol), n_records(0), value_hash(0),
+      verify(verify), placements(w.templates, false) {
+    std::vector<size_t> order = registration_order(w);
+    for (auto i = order.begin(); i != order.end(); ++i)
+      register_placement_template(placements.get(*i));
+  }
+
+  std::shared_ptr<ErrorContext> start_message(uint16_t version,
+                                              uint16_t length,
+                                              uint32_t export_time,
+                                              uint32_t sequence_number,
+                                              uint32_t observation_domain,
+                                              uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate* t) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate* t) {
+    n_records++;
+    if (verify)
+      value_hash += placements.hash(placements.index_of(t));
+    LIBFC_RETURN_OK();
+  }
+
+  uint64_t n_records;
+
+  /** Sum of the hashes of all decoded records. */
+  uint64_t value_hash;
+
+private:
+  bool verify;
+  Placements placements;
+};
+
+/** Like BenchCollector, but with statically dispatched callbacks. */
+class StaticBenchCollector
+  : public StaticPlacementCollector<StaticBenchCollector> {
+public:
+  StaticBenchCollector(const Workload& w)
+    : StaticPlacementCollector<StaticBenchCollector>(w.protocol),
+      n_records(0), placements(w.templates, false) {
+    std::vector<size_t> order = registration_order(w);
+    for (auto i = order.begin(); i != order.end(); ++i)
+      register_placement_template(placements.get(*i));
+  }
+
+  bool end_record(const PlacementTemplate* t) {
+    n_records++;
+    return true;
+  }
+
+  uint64_t n_records;
+
+private:
+  Placements placements;
+};
+
+/** Measurement result for one benchmark. */
+struct Result {
+  std::string name;
+  std::map<std::string, std::string> parameters;
+  uint64_t iterations;
+  uint64_t records;
+  /** Number of fields decoded or encoded, for plan benchmarks, or 0. */
+  uint64_t ops;
+  uint64_t bytes;
+  double seconds;
+};
+
+static void start_result(Result* result, const Workload& w) {
+  result->name = w.name;
+  result->parameters["protocol"]
+    = w.protocol == PlacementCollector::ipfix ? "\"ipfix\"" : "\"netflowv9\"";
+  result->parameters["templates"] = std::to_string(w.templates.size());
+  result->parameters["domains"] = std::to_string(w.n_domains);
+  result->iterations = 0;
+  result->records = 0;
+  result->ops = 0;
+  result->bytes = 0;
+  result->seconds = 0;
+}
+
+static bool measurement_done(const Result& result) {
+  return result.seconds >= min_seconds && result.iterations >= 3;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - start).count();
+}
+
+template <typename Collector>
+static bool collect(Collector& c, const Workload& w,
+                    const std::vector<uint8_t>& stream,
+                    uint64_t expected_records, double* seconds) {
+  BufferInputSource is(stream.data(), stream.size());
+
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+  std::shared_ptr<ErrorContext> e = c.collect(is);
+  *seconds = seconds_since(start);
+
+  if (e != 0 && e->get_error() != Error::no_error) {
+    std::cerr << w.name << ": " << e->to_string() << std::endl;
+    return false;
+  }
+  if (c.n_records != expected_records) {
+    std::cerr << w.name << ": decoded " << c.n_records
+              << " records, expected " << expected_records << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename Collector>
+static bool bench_collect(const Workload& w, Result* result) {
+  uint64_t n_records;
+  std::vector<uint8_t> stream = make_stream(w, 8 << 20, &n_records);
+
+  double seconds;
+  {
+    Collector c(w); /* Warm up */
+    if (!collect(c, w, stream, n_records, &seconds))
+      return false;
+  }
+
+  start_result(result, w);
+  result->parameters["stream_bytes"] = std::to_string(stream.size());
+
+  while (!measurement_done(*result)) {
+    Collector c(w);
+    if (!collect(c, w, stream, n_records, &seconds))
+      return false;
+    result->iterations++;
+    result->records += n_records;
+    result->bytes += stream.size();
+    result->seconds += seconds;
+  }
+  return true;
+}
+
+/** Number of records exported per iteration. */
+static const unsigned int kExportRecords = 100000;
+
+/** Exports records for a workload.
+ *
+ * Records cycle through the workload's templates, w.records_per_set
+ * records at a time (or one at a time if that is 0), and through its
+ * observation domains, 16 records at a time.
+ *
+ * @param w the workload
+ * @param p placements for the workload, created for export
+ * @param d where to export to
+ * @param r random numbers for values, or 0 to export the values
+ *   already present in p
+ * @param value_hash if not 0, the hashes of all exported records are
+ *   added to this
+ */
+static void export_records(const Workload& w, Placements& p,
+                           ExportDestination& d, Random* r,
+                           uint64_t* value_hash) {
+  PlacementExporter e(d, 1);
+  const unsigned int run = w.records_per_set == 0 ? 1 : w.records_per_set;
+
+  for (unsigned int i = 0; i < kExportRecords; i++) {
+    const size_t t = (i / run) % p.size();
+
+    if (w.n_domains > 1)
+      e.change_observation_domain(1 + (i / 16) % w.n_domains);
+    if (r != 0)
+      p.fill(t, *r, w.max_varlen);
+    if (value_hash != 0)
+      *value_hash += p.hash(t);
+    e.place_values(p.get(t));
+  }
+}
+
+static bool bench_export(const Workload& w, Result* result) {
+  Placements p(w.templates, true);
+  Random r;
+  for (size_t t = 0; t < p.size(); t++)
+    p.fill(t, r, w.max_varlen);
+
+  MemoryExportDestination d;
+  export_records(w, p, d, 0, 0); /* Warm up */
+
+  start_result(result, w);
+
+  while (!measurement_done(*result)) {
+    d.clear();
+
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+    export_records(w, p, d, 0, 0);
+    result->seconds += seconds_since(start);
+
+    result->iterations++;
+    result->records += kExportRecords;
+    result->bytes += d.get_buffer().size();
+  }
+  return true;
+}
+
+static bool bench_roundtrip(const Workload& w, Result* result) {
+  Placements p(w.templates, true);
+  MemoryExportDestination d;
+
+  start_result(result, w);
+
+  double export_seconds = 0;
+  double collect_seconds = 0;
+
+  while (!measurement_done(*result)) {
+    Random r(0x9e3779b97f4a7c15ULL + result->iterations);
+    uint64_t exported_hash = 0;
+    double seconds;
+
+    d.clear();
+
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+    export_records(w, p, d, &r, &exported_hash);
+    seconds = seconds_since(start);
+    result->seconds += seconds;
+    export_seconds += seconds;
+
+    BenchCollector c(w, true);
+    if (!collect(c, w, d.get_buffer(), kExportRecords, &seconds))
+      return false;
+    result->seconds += seconds;
+    collect_seconds += seconds;
+
+    if (c.value_hash != exported_hash) {
+      std::cerr << w.name << ": collected values differ from exported values"
+                << std::endl;
+      return false;
+    }
+
+    result->iterations++;
+    result->records += kExportRecords;
+    result->bytes += d.get_buffer().size();
+  }
+
+  std::ostringstream sstr;
+  sstr << std::fixed << std::setprecision(6) << export_seconds;
+  result->parameters["export_seconds"] = sstr.str();
+  sstr.str("");
+  sstr << collect_seconds;
+  result->parameters["collect_seconds"] = sstr.str();
+  return true;
+}
+
+static bool bench_ftrace(const Workload& w, Result* result) {
+  Placements p(w.templates, true);
+  Random r;
+  MemoryExportDestination d;
+  export_records(w, p, d, &r, 0);
+
+  char file_name[] = "/tmp/fcprof-ftrace-XXXXXX";
+  int fd = mkstemp(file_name);
+  if (fd < 0
+      || write(fd, d.get_buffer().data(), d.get_buffer().size())
+         != static_cast<ssize_t>(d.get_buffer().size())) {
+    std::cerr << w.name << ": can't write " << file_name << std::endl;
+    if (fd >= 0) {
+      close(fd);
+      unlink(file_name);
+    }
+    return false;
+  }
+  close(fd);
+
+  start_result(result, w);
+  bool ok = true;
+
+  while (ok && !measurement_done(*result)) {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+
+    libftrace_t* ft = ftrace_create(file_name, 10, 0);
+    libftrace_uniflow_t* uf = ft == 0 ? 0 : ftrace_start_uniflow(ft);
+    uint64_t n_records = 0;
+    if (uf != 0) {
+      while (ftrace_next_uniflow(uf) == 1)
+        n_records++;
+      ftrace_destroy_uniflow(uf);
+    }
+    if (ft != 0)
+      ftrace_destroy(ft);
+
+    result->seconds += seconds_since(start);
+
+    if (n_records != kExportRecords) {
+      std::cerr << w.name << ": read " << n_records
+                << " uniflows, expected " << kExportRecords << std::endl;
+      ok = false;
+    }
+    result->iterations++;
+    result->records += n_records;
+    result->bytes += d.get_buffer().size();
+  }
+
+  unlink(file_name);
+  return ok;
+}
+
+/** Number of fields per record in plan benchmarks.
+ *
+ * All fields of a record have the same type, so that each plan
+ * consists of a single kind of decision. */
+static const unsigned int kPlanFields = 16;
+
+/** Size of the buffer that plan benchmarks decode from or encode
+ * into.  This is small enough to stay in the L1 or L2 cache, so that
+ * what we measure is the plan, not the memory. */
+static const size_t kPlanBufferSize = 16384;
+
+/** Describes a plan benchmark. */
+struct PlanCase {
+  /** IE type name, e.g., "unsigned32". */
+  const char* type;
+  /** Default length of the IE, or kIpfixVarlen. */
+  uint16_t ie_length;
+  /** Length on the wire; less than ie_length for reduced-length
+   * encoding. */
+  uint16_t wire_length;
+  /** If false, the fields are skipped instead of transferred (for
+   * decoding only). */
+  bool transfer;
+  /** Length of variable-length values. */
+  uint16_t value_length;
+};
+
+/** Returns kPlanFields distinct IEs of the given type and length.
+ *
+ * These are made up for the benchmark, in the PEN reserved for
+ * documentation (RFC 5612). */
+static std::vector<const InfoElement*> plan_ies(const PlanCase& c) {
+  static unsigned int next_number = 1;
+  std::vector<const InfoElement*> ret;
+
+  for (unsigned int i = 0; i < kPlanFields; i++) {
+    std::ostringstream spec;
+    spec << "fcprofPlanField" << next_number << "(32473/" << next_number
+         << ")<" << c.type << ">[" << c.ie_length << "]";
+    InfoModel::instance().add(spec.str());
+    ret.push_back(InfoModel::instance().lookupIE(32473, next_number,
+                                                 c.ie_length));
+    next_number++;
+  }
+  return ret;
+}
+
+/** Fills a slot with a valid value for its type.  Booleans must be
+ * true or false, the rest doesn't matter. */
+static void fill_plan_slot(const PlanCase& c, uint8_t* slot,
+                           BasicOctetArray* octets) {
+  if (strcmp(c.type, "boolean") == 0)
+    *reinterpret_cast<bool*>(slot) = true;
+  else if (strcmp(c.type, "float64") == 0)
+    *reinterpret_cast<double*>(slot) = 0.5;
+  else if (c.ie_length == kIpfixVarlen
+           || strcmp(c.type, "octetArray") == 0) {
+    std::vector<uint8_t> v(c.ie_length == kIpfixVarlen
+                           ? c.value_length : c.ie_length, 0x5a);
+    octets->copy_content(v.data(), v.size());
+  } else
+    memset(slot, 0x5a, 16);
+}
+
+static bool bench_decode_plan(const std::string& name, const PlanCase& c,
+                              Result* result) {
+  std::vector<const InfoElement*> ies = plan_ies(c);
+
+  IETemplate wire_template;
+  PlacementTemplate placement_template;
+  union { uint64_t align; uint8_t bytes[16]; } slots[kPlanFields];
+  BasicOctetArray octets[kPlanFields];
+
+  for (unsigned int i = 0; i < kPlanFields; i++) {
+    const InfoElement* ie = ies[i];
+    wire_template.add(c.wire_length == ie->len() ? ie
+                                                 : ie->forLen(c.wire_length));
+    if (c.transfer) {
+      void* p = c.ie_length == kIpfixVarlen
+                || strcmp(c.type, "octetArray") == 0
+        ? static_cast<void*>(&octets[i]) : static_cast<void*>(slots[i].bytes);
+      placement_template.register_placement(ie, p, 0);
+    }
+  }
+
+  /* Encode records by hand, so that the encoder isn't part of what
+   * is being tested. */
+  std::vector<uint8_t> record;
+  for (unsigned int i = 0; i < kPlanFields; i++) {
+    if (c.ie_length == kIpfixVarlen) {
+      if (c.value_length < 255)
+        record.push_back(c.value_length);
+      else {
+        record.push_back(255);
+        record.push_back(c.value_length >> 8);
+        record.push_back(c.value_length & 0xff);
+      }
+      record.insert(record.end(), c.value_length, 0x5a);
+    } else if (strcmp(c.type, "boolean") == 0)
+      record.push_back(1);
+    else
+      record.insert(record.end(), c.wire_length, 0x5a);
+  }
+
+  std::vector<uint8_t> buf;
+  uint64_t n_records = 0;
+  while (buf.size() + record.size() <= kPlanBufferSize || n_records == 0) {
+    buf.insert(buf.end(), record.begin(), record.end());
+    n_records++;
+  }
+
+  DecodePlan plan(&placement_template, &wire_template);
+
+  result->name = name;
+  result->parameters["fields"] = std::to_string(kPlanFields);
+  result->iterations = 0;
+  result->records = 0;
+  result->ops = 0;
+  result->bytes = 0;
+  result->seconds = 0;
+
+  while (!measurement_done(*result)) {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+
+    /* Many passes per time measurement, to make clock overhead
+     * negligible. */
+    for (unsigned int pass = 0; pass < 64; pass++) {
+      const uint8_t* p = buf.data();
+      const uint8_t* end = p + buf.size();
+      while (p < end)
+        p += plan.execute(p, end - p);
+      if (p != end) {
+        std::cerr << name << ": decoded past end of buffer" << std::endl;
+        return false;
+      }
+    }
+
+    result->seconds += seconds_since(start);
+    result->iterations++;
+    result->records += 64*n_records;
+    result->ops += 64*n_records*kPlanFields;
+    result->bytes += 64*buf.size();
+  }
+  return true;
+}
+
+static bool bench_encode_plan(const std::string& name, const PlanCase& c,
+                              Result* result) {
+  std::vector<const InfoElement*> ies = plan_ies(c);
+
+  PlacementTemplate placement_template;
+  union { uint64_t align; uint8_t bytes[16]; } slots[kPlanFields];
+  BasicOctetArray octets[kPlanFields];
+
+  for (unsigned int i = 0; i < kPlanFields; i++) {
+    bool is_octets = c.ie_length == kIpfixVarlen
+      || strcmp(c.type, "octetArray") == 0;
+    void* p = is_octets ? static_cast<void*>(&octets[i])
+                        : static_cast<void*>(slots[i].bytes);
+    fill_plan_slot(c, slots[i].bytes, &octets[i]);
+    placement_template.register_placement(ies[i], p, c.wire_length);
+  }
+
+  const size_t record_size = placement_template.data_record_size();
+  uint64_t n_records = std::max<size_t>(1, kPlanBufferSize / record_size);
+  std::vector<uint8_t> buf(n_records * record_size);
+
+  EncodePlan plan(&placement_template);
+
+  result->name = name;
+  result->parameters["fields"] = std::to_string(kPlanFields);
+  result->iterations = 0;
+  result->records = 0;
+  result->ops = 0;
+  result->bytes = 0;
+  result->seconds = 0;
+
+  while (!measurement_done(*result)) {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+
+    for (unsigned int pass = 0; pass < 64; pass++) {
+      size_t offset = 0;
+      for (uint64_t i = 0; i < n_records; i++)
+        offset += plan.execute(buf.data(), offset, buf.size());
+      if (offset != buf.size()) {
+        std::cerr << name << ": encoded " << offset << " bytes, expected "
+                  << buf.size() << std::endl;
+        return false;
+      }
+    }
+
+    result->seconds += seconds_since(start);
+    result->iterations++;
+    result->records += 64*n_records;
+    result->ops += 64*n_records*kPlanFields;
+    result->bytes += 64*buf.size();
+  }
+  return true;
+}
+
+/** The small workload's record, for the RecordMapper benchmarks. */
+struct SmallFlow {
+  uint32_t sip;
+  uint32_t dip;
+  uint16_t sp;
+  uint16_t dp;
+  uint8_t proto;
+  uint64_t octets;
+  uint64_t packets;
+};
+
+LIBFC_MAPPED_FIELD(SmallSip, SmallFlow, sip, "sourceIPv4Address",
+                   IEType::kIpv4Address);
+LIBFC_MAPPED_FIELD(SmallDip, SmallFlow, dip, "destinationIPv4Address",
+                   IEType::kIpv4Address);
+LIBFC_MAPPED_FIELD(SmallSp, SmallFlow, sp, "sourceTransportPort",
+                   IEType::kUnsigned16);
+LIBFC_MAPPED_FIELD(SmallDp, SmallFlow, dp, "destinationTransportPort",
+                   IEType::kUnsigned16);
+LIBFC_MAPPED_FIELD(SmallProto, SmallFlow, proto, "protocolIdentifier",
+                   IEType::kUnsigned8);
+LIBFC_MAPPED_FIELD(SmallOctets, SmallFlow, octets, "octetDeltaCount",
+                   IEType::kUnsigned64);
+LIBFC_MAPPED_FIELD(SmallPackets, SmallFlow, packets, "packetDeltaCount",
+                   IEType::kUnsigned64);
+
+typedef RecordMapper<SmallFlow, SmallSip, SmallDip, SmallSp, SmallDp,
+                     SmallProto, SmallOctets, SmallPackets> SmallFlowMapper;
+
+/** Decodes or encodes small flow records with the generic plans or
+ * with the RecordMapper's codec, so that the two can be compared. */
+static bool bench_mapped(const std::string& name, bool decode,
+                         bool use_codec, Result* result) {
+  SmallFlow flow = { 0x0a000001, 0x0a000002, 1024, 80, 6, 1500, 3 };
+  SmallFlowMapper mapper(&flow);
+  PlacementTemplate* tmpl = mapper.get_template();
+  if (!use_codec)
+    tmpl->set_codec(0);
+
+  IETemplate wire_template;
+  for (auto i = tmpl->begin(); i != tmpl->end(); ++i)
+    wire_template.add(*i);
+
+  const size_t record_size = SmallFlowMapper::wire_size;
+  const uint64_t n_records = kPlanBufferSize / record_size;
+  std::vector<uint8_t> buf(n_records * record_size);
+
+  EncodePlan encode_plan(tmpl);
+  DecodePlan decode_plan(tmpl, &wire_template);
+  for (size_t offset = 0; offset < buf.size(); )
+    offset += encode_plan.execute(buf.data(), offset, buf.size());
+
+  result->name = name;
+  result->parameters["fields"] = std::to_string(wire_template.size());
+  result->iterations = 0;
+  result->records = 0;
+  result->ops = 0;
+  result->bytes = 0;
+  result->seconds = 0;
+
+  while (!measurement_done(*result)) {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+
+    for (unsigned int pass = 0; pass < 64; pass++) {
+      size_t offset = 0;
+      if (decode) {
+        while (offset < buf.size())
+          offset += decode_plan.execute(buf.data() + offset,
+                                        buf.size() - offset);
+      } else {
+        for (uint64_t i = 0; i < n_records; i++)
+          offset += encode_plan.execute(buf.data(), offset, buf.size());
+      }
+      if (offset != buf.size()) {
+        std::cerr << name << ": processed " << offset << " bytes, expected "
+                  << buf.size() << std::endl;
+        return false;
+      }
+    }
+
+    result->seconds += seconds_since(start);
+    result->iterations++;
+    result->records += 64*n_records;
+    result->ops += 64*n_records*wire_template.size();
+    result->bytes += 64*buf.size();
+  }
+
+  if (flow.octets != 1500 || flow.packets != 3) {
+    std::cerr << name << ": wrong values decoded" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/** The kinds of benchmark that fcprof runs. */
+enum Kind {
+  /** Parse and decode a generated message stream. */
+  kind_collect,
+  /** Like kind_collect, with a StaticPlacementCollector. */
+  kind_collect_static,
+  /** Export records to memory with PlacementExporter. */
+  kind_export,
+  /** Export to memory, collect again and compare values. */
+  kind_roundtrip,
+  /** Read uniflows from a file through libftrace. */
+  kind_ftrace,
+  /** Execute a DecodePlan with a single kind of decision. */
+  kind_decode_plan,
+  /** Execute an EncodePlan with a single kind of decision. */
+  kind_encode_plan,
+  /** Decode or encode records of a RecordMapper. */
+  kind_mapped,
+};
+
+struct Benchmark {
+  Kind kind;
+  Workload workload;
+  /** For plan benchmarks only. */
+  PlanCase plan;
+  /** For mapped benchmarks only: decode instead of encode, and use
+   * the mapper's codec instead of the plans. */
+  bool decode;
+  bool use_codec;
+};
+
+static std::vector<Benchmark> make_benchmarks() {
+  std::vector<Benchmark> ret;
+
+  FieldList small = {
+    field("sourceIPv4Address"), field("destinationIPv4Address"),
+    field("sourceTransportPort"), field("destinationTransportPort"),
+    field("protocolIdentifier"), field("octetDeltaCount"),
+    field("packetDeltaCount"),
+  };
+
+  FieldList wide = {
+    field("flowStartMilliseconds"), field("flowEndMilliseconds"),
+    field("sourceIPv6Address"), field("destinationIPv6Address"),
+    field("sourceIPv4Address"), field("destinationIPv4Address"),
+    field("ipNextHopIPv4Address"), field("sourceTransportPort"),
+    field("destinationTransportPort"), field("protocolIdentifier"),
+    field("ipClassOfService"), field("tcpControlBits"),
+    field("sourceIPv4PrefixLength"), field("destinationIPv4PrefixLength"),
+    field("ingressInterface"), field("egressInterface"),
+    field("bgpSourceAsNumber"), field("bgpDestinationAsNumber"),
+    field("sourceMacAddress"), field("vlanId"),
+    field("minimumTTL"), field("maximumTTL"),
+    field("flowEndReason"), field("octetDeltaCount"),
+    field("packetDeltaCount"), field("octetTotalCount"),
+    field("packetTotalCount"), field("fragmentIdentification"),
+    field("flowLabelIPv6"),
+  };
+
+  /* The wide template with a reduced-length field, as many routers
+   * send it.  This is only used for collection. */
+  FieldList wide_reduced = wide;
+  wide_reduced.push_back(field("postPacketDeltaCount", 4));
+
+  FieldList varlen = {
+    field("sourceIPv4Address"), field("destinationIPv4Address"),
+    field("octetDeltaCount"), field("interfaceName"),
+    field("interfaceDescription"), field("applicationName"),
+    field("applicationDescription"), field("wlanSSID"),
+    field("applicationId"),
+  };
+
+  FieldList enterprise = {
+    field("sourceIPv4Address"), field("destinationIPv4Address"),
+    field("sourceTransportPort"), field("destinationTransportPort"),
+    field("protocolIdentifier"), field("octetDeltaCount"),
+    field("packetDeltaCount"), field("reverseOctetDeltaCount"),
+    field("reversePacketDeltaCount"), field("reverseTcpControlBits"),
+    field("reverseIpClassOfService"), field("reverseFlowLabelIPv6"),
+  };
+
+  /* Many templates: distinct prefixes of the wide template. */
+  std::vector<FieldList> many;
+  for (unsigned int i = 0; i < 64; i++) {
+    FieldList f(wide.begin(), wide.begin() + 2 + i % (wide.size() - 2));
+    /* Make templates of equal length differ in their last field. */
+    f.push_back(field("postOctetDeltaCount", 1 + i / (wide.size() - 2)));
+    many.push_back(f);
+  }
+
+  Benchmark b;
+  Workload& w = b.workload;
+
+  static const PlacementCollector::Protocol protocols[]
+    = { PlacementCollector::ipfix, PlacementCollector::netflowv9 };
+
+  b.kind = kind_collect;
+  for (unsigned int p = 0; p < 2; p++) {
+    const PlacementCollector::Protocol protocol = protocols[p];
+    const std::string prefix
+      = protocol == PlacementCollector::ipfix ? "ipfix/" : "v9/";
+
+    w.protocol = protocol;
+    w.n_domains = 1;
+    w.records_per_set = 0;
+    w.max_varlen = 0;
+
+    w.name = prefix + "small-fixlen";
+    w.templates.assign(1, small);
+    ret.push_back(b);
+
+    w.name = prefix + "wide-fixlen";
+    w.templates.assign(1, wide_reduced);
+    ret.push_back(b);
+
+    w.name = prefix + "many-templates";
+    w.templates = many;
+    w.records_per_set = 2;
+    ret.push_back(b);
+
+    w.name = prefix + "many-domains";
+    w.templates.assign(1, small);
+    w.n_domains = 256;
+    w.records_per_set = 0;
+    ret.push_back(b);
+
+    /* NetFlow v9 has neither variable-length fields nor enterprise
+     * IEs. */
+    if (protocol == PlacementCollector::ipfix) {
+      w.n_domains = 1;
+
+      w.name = prefix + "varlen";
+      w.templates.assign(1, varlen);
+      w.max_varlen = 40;
+      ret.push_back(b);
+
+      w.name = prefix + "varlen-long";
+      w.templates.assign(1, varlen);
+      w.max_varlen = 300;
+      ret.push_back(b);
+
+      w.name = prefix + "enterprise";
+      w.templates.assign(1, enterprise);
+      w.max_varlen = 0;
+      ret.push_back(b);
+    }
+  }
+
+  b.kind = kind_collect_static;
+  w.protocol = PlacementCollector::ipfix;
+  w.n_domains = 1;
+  w.records_per_set = 0;
+  w.max_varlen = 0;
+
+  w.name = "ipfix/small-fixlen/static";
+  w.templates.assign(1, small);
+  ret.push_back(b);
+
+  w.name = "ipfix/wide-fixlen/static";
+  w.templates.assign(1, wide_reduced);
+  ret.push_back(b);
+
+  /* PlacementExporter only speaks IPFIX. */
+  static const Kind export_kinds[] = { kind_export, kind_roundtrip };
+  for (unsigned int k = 0; k < 2; k++) {
+    const std::string prefix
+      = export_kinds[k] == kind_export ? "export/" : "roundtrip/";
+
+    b.kind = export_kinds[k];
+    w.protocol = PlacementCollector::ipfix;
+    w.n_domains = 1;
+    w.records_per_set = 0;
+    w.max_varlen = 0;
+
+    w.name = prefix + "single-template";
+    w.templates.assign(1, small);
+    ret.push_back(b);
+
+    w.name = prefix + "wide";
+    w.templates.assign(1, wide);
+    ret.push_back(b);
+
+    w.name = prefix + "interleaved-templates";
+    w.templates.clear();
+    w.templates.push_back(small);
+    w.templates.push_back(enterprise);
+    w.templates.push_back(wide);
+    w.records_per_set = 1;
+    ret.push_back(b);
+
+    w.name = prefix + "varlen";
+    w.templates.assign(1, varlen);
+    w.records_per_set = 0;
+    w.max_varlen = 40;
+    ret.push_back(b);
+
+    w.name = prefix + "domain-switching";
+    w.templates.assign(1, small);
+    w.n_domains = 64;
+    w.max_varlen = 0;
+    ret.push_back(b);
+  }
+
+  /* The fields that libftrace collects for IPv4 uniflows. */
+  FieldList uniflow = {
+    field("flowStartMilliseconds"), field("flowEndMilliseconds"),
+    field("packetDeltaCount"), field("octetDeltaCount"),
+    field("sourceIPv4Address"), field("destinationIPv4Address"),
+    field("sourceTransportPort"), field("destinationTransportPort"),
+    field("protocolIdentifier"),
+  };
+
+  b.kind = kind_ftrace;
+  w.name = "ftrace/uniflows";
+  w.protocol = PlacementCollector::ipfix;
+  w.templates.assign(1, uniflow);
+  w.n_domains = 1;
+  w.records_per_set = 0;
+  w.max_varlen = 0;
+  ret.push_back(b);
+
+  /* Decision names are those for little-endian machines. */
+  static const struct {
+    const char* name;
+    PlanCase plan;
+  } decode_cases[] = {
+    { "skip_fixlen/4", { "unsigned32", 4, 4, false, 0 } },
+    { "skip_varlen/8", { "octetArray", kIpfixVarlen, kIpfixVarlen, false, 8 } },
+    { "skip_varlen/300",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, false, 300 } },
+    { "transfer_fixlen/1", { "unsigned8", 1, 1, true, 0 } },
+    { "transfer_fixlen/6", { "macAddress", 6, 6, true, 0 } },
+    { "transfer_fixlen/16", { "ipv6Address", 16, 16, true, 0 } },
+    { "transfer_fixlen_endianness/2", { "unsigned16", 2, 2, true, 0 } },
+    { "transfer_fixlen_endianness/4", { "unsigned32", 4, 4, true, 0 } },
+    { "transfer_fixlen_endianness/8", { "unsigned64", 8, 8, true, 0 } },
+    { "transfer_fixlen_endianness/4-of-8",
+      { "unsigned64", 8, 4, true, 0 } },
+    { "transfer_fixlen_endianness/8-float64",
+      { "float64", 8, 8, true, 0 } },
+    { "transfer_boolean", { "boolean", 1, 1, true, 0 } },
+    { "transfer_fixlen_octets/16", { "octetArray", 16, 16, true, 0 } },
+    { "transfer_float_into_double_endianness",
+      { "float64", 8, 4, true, 0 } },
+    { "transfer_varlen/0",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 0 } },
+    { "transfer_varlen/8",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 8 } },
+    { "transfer_varlen/64",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 64 } },
+    { "transfer_varlen/300",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 300 } },
+  };
+  b.kind = kind_decode_plan;
+  for (auto c : decode_cases) {
+    w.name = std::string("decode/") + c.name;
+    b.plan = c.plan;
+    ret.push_back(b);
+  }
+
+  static const struct {
+    const char* name;
+    PlanCase plan;
+  } encode_cases[] = {
+    { "encode_fixlen/1", { "unsigned8", 1, 1, true, 0 } },
+    { "encode_fixlen/6", { "macAddress", 6, 6, true, 0 } },
+    { "encode_fixlen/16", { "ipv6Address", 16, 16, true, 0 } },
+    { "encode_fixlen_endianness/2", { "unsigned16", 2, 2, true, 0 } },
+    { "encode_fixlen_endianness/4", { "unsigned32", 4, 4, true, 0 } },
+    { "encode_fixlen_endianness/8", { "unsigned64", 8, 8, true, 0 } },
+    { "encode_fixlen_endianness/4-of-8", { "unsigned64", 8, 4, true, 0 } },
+    { "encode_fixlen_endianness/8-float64", { "float64", 8, 8, true, 0 } },
+    { "encode_boolean", { "boolean", 1, 1, true, 0 } },
+    { "encode_fixlen_octets/16", { "octetArray", 16, 16, true, 0 } },
+    { "encode_double_as_float_endianness", { "float64", 8, 4, true, 0 } },
+    { "encode_varlen/0",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 0 } },
+    { "encode_varlen/8",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 8 } },
+    { "encode_varlen/64",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 64 } },
+    { "encode_varlen/300",
+      { "octetArray", kIpfixVarlen, kIpfixVarlen, true, 300 } },
+  };
+  b.kind = kind_encode_plan;
+  for (auto c : encode_cases) {
+    w.name = std::string("encode/") + c.name;
+    b.plan = c.plan;
+    ret.push_back(b);
+  }
+
+  b.kind = kind_mapped;
+  for (unsigned int i = 0; i < 4; i++) {
+    b.decode = i < 2;
+    b.use_codec = i % 2 == 1;
+    w.name = std::string("mapped/") + (b.decode ? "decode/" : "encode/")
+      + (b.use_codec ? "codec" : "plan");
+    ret.push_back(b);
+  }
+
+  return ret;
+}
+
+static void print_json(std::ostream& os, const std::vector<Result>& results) {
+  os << "{" << std::endl
+     << "  \"benchmark\": \"fcprof\"," << std::endl
+     << "  \"min_seconds\": " << min_seconds << "," << std::endl
+     << "  \"results\": [" << std::endl;
+
+  for (auto r = results.begin(); r != results.end(); ++r) {
+    os << "    { \"name\": \"" << r->name << "\"";
+    for (auto p = r->parameters.begin(); p != r->parameters.end(); ++p)
+      os << ", \"" << p->first << "\": " << p->second;
+    os << ", \"iterations\": " << r->iterations
+       << ", \"records\": " << r->records
+       << ", \"bytes\": " << r->bytes
+       << std::fixed << std::setprecision(6)
+       << ", \"seconds\": " << r->seconds
+       << std::setprecision(1)
+       << ", \"records_per_second\": " << r->records / r->seconds
+       << ", \"bytes_per_second\": " << r->bytes / r->seconds
+       << std::setprecision(2)
+       << ", \"ns_per_record\": " << 1e9 * r->seconds / r->records;
+    if (r->ops != 0)
+      os << ", \"ops\": " << r->ops
+         << ", \"ns_per_op\": " << 1e9 * r->seconds / r->ops;
+    os << " }" << (r + 1 == results.end() ? "" : ",") << std::endl;
+    os.unsetf(std::ios_base::floatfield);
+  }
+
+  os << "  ]" << std::endl
+     << "}" << std::endl;
+}
+
 int main(int argc, char* const* argv) {
-  return 0;
+  parse_options(argc, argv);
+
+  if (help_flag) {
+    help();
+    return EXIT_SUCCESS;
+  }
+
+  InfoModel::instance().default5103();
+
+  std::vector<Result> results;
+  bool ok = true;
+
+  std::vector<Benchmark> benchmarks = make_benchmarks();
+  for (auto b = benchmarks.begin(); b != benchmarks.end(); ++b) {
+    const Workload& w = b->workload;
+    if (w.name.find(filter) == std::string::npos)
+      continue;
+
+    std::cerr << w.name << "..." << std::endl;
+    Result r;
+    bool good = false;
+    try {
+      switch (b->kind) {
+      case kind_collect: good = bench_collect<BenchCollector>(w, &r); break;
+      case kind_collect_static:
+        good = bench_collect<StaticBenchCollector>(w, &r);
+        break;
+      case kind_export: good = bench_export(w, &r); break;
+      case kind_roundtrip: good = bench_roundtrip(w, &r); break;
+      case kind_ftrace: good = bench_ftrace(w, &r); break;
+      case kind_decode_plan:
+        good = bench_decode_plan(w.name, b->plan, &r);
+        break;
+      case kind_encode_plan:
+        good = bench_encode_plan(w.name, b->plan, &r);
+        break;
+      case kind_mapped:
+        good = bench_mapped(w.name, b->decode, b->use_codec, &r);
+        break;
+      }
+    } catch (FormatError& e) {
+      std::cerr << w.name << ": format error: " << e.what() << std::endl;
+    } catch (ExportError& e) {
+      std::cerr << w.name << ": export error: " << e.what() << std::endl;
+    }
+
+    if (good)
+      results.push_back(r);
+    else
+      ok = false;
+  }
+
+  if (output_file_name.empty())
+    print_json(std::cout, results);
+  else {
+    std::ofstream os(output_file_name.c_str());
+    print_json(os, results);
+    if (!os) {
+      std::cerr << "Can't write " << output_file_name << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -28,6 +28,7 @@
 
 #include "libftrace.h"
 #include "libfc.h"
+#include "uniflow_ring.h"
 
 #include <wandio.h>
 #include <pthread.h>
@@ -43,6 +44,13 @@
  *
  */
 
+/** Number of uniflows buffered between reader thread and caller */
+#define FTRACE_RING_CAPACITY 4096
+
+/** Number of uniflows (or free slots) to wait for before waking up
+    the caller (or the reader thread) */
+#define FTRACE_RING_BATCH 256
+
 struct libftrace_st {
     /** libwandio source */
     io_t                    *wio;
@@ -50,17 +58,15 @@ struct libftrace_st {
     const char              *filename;
     /** template set for callbacks */
     struct libfc_template_group_t    *tg;
-    /** rw cond mutex */
-    pthread_mutex_t         mux;
-    /** write ready */
-    pthread_cond_t          wok;
-    /** read ready */
-    pthread_cond_t          rok;
+    /** uniflows decoded by the reader thread, waiting to be read */
+    libftrace_ring_t        *ring;
     /** reader thread */
     pthread_t               rt;
-    /* storage for uniflow */
+    /* storage for uniflow, as returned to the caller */
     libftrace_uniflow_t     uf;
-    /** valid record flag */
+    /* storage for uniflow, as placed by the reader thread */
+    libftrace_uniflow_t     ruf;
+    /** valid record flag, set by the reader thread before closing the ring */
     int                     valid;
     /* abort flag */
     int                     terminate;
@@ -70,26 +76,16 @@ struct libftrace_st {
 libftrace_t *ftrace_create(const char *filename, int version, const char *lpfilename)
 {
     libftrace_t *ft = NULL;
-    int pterrno = 0;
     
     /* create structure */
     ft = malloc(sizeof(*ft));
     memset(ft, 0, sizeof(*ft));
     ft->filename = filename;
 
-    /* create condition variables and mutex */
-    if ((pterrno = pthread_mutex_init(&ft->mux, NULL)) != 0) {
-        fprintf(stderr, "couldn't init pthread mux: %s\n", strerror(pterrno));
-        goto err;
-    }
-
-    if ((pterrno = pthread_cond_init(&ft->wok, NULL)) != 0) {
-        fprintf(stderr, "couldn't init pthread wok: %s\n", strerror(pterrno));
-        goto err;
-    }
-
-    if ((pterrno = pthread_cond_init(&ft->rok, NULL)) != 0) {
-        fprintf(stderr, "couldn't init pthread rok: %s\n", strerror(pterrno));
+    /* create ring between reader thread and caller */
+    if (!(ft->ring = ftrace_ring_create(FTRACE_RING_CAPACITY,
+                                        FTRACE_RING_BATCH))) {
+        fprintf(stderr, "couldn't create uniflow ring\n");
         goto err;
     }
     
@@ -121,9 +117,7 @@ void ftrace_destroy(libftrace_t *ft)
 {
     /* FIXME need to destroy uniflow if currently reading */
     if (ft) {
-        pthread_cond_destroy(&ft->wok);
-        pthread_cond_destroy(&ft->rok);
-        pthread_mutex_destroy(&ft->mux);
+        if (ft->ring) ftrace_ring_destroy(ft->ring);
 
         if (ft->tg) libfc_template_group_delete(ft->tg);
         if (ft->wio) wandio_destroy(ft->wio);
@@ -133,22 +127,12 @@ void ftrace_destroy(libftrace_t *ft)
 
 static int _ftrace_semcb_inner(libftrace_t *ft)
 {
-    /* check terminate signal */
-    if (ft->terminate) {
+    /* copy the flow into the ring; this only blocks if the ring is full */
+    if (!ftrace_ring_push(ft->ring, &ft->ruf)) {
         fprintf(stderr,"_ftrace_semcb_inner() telling placement collector to stop.\n");
         return 0;
     }
 
-    /* signal read ready, outer thread will now return a record */
-    pthread_mutex_lock(&ft->mux);
-    pthread_cond_signal(&ft->rok);
-//    fprintf(stderr,"_ftrace_semcb_inner() signaled rok, waiting for wok.\n");
-
-    /* wait write ready, since next placement will happen after return */
-    pthread_cond_wait(&ft->wok, &ft->mux);
-    pthread_mutex_unlock(&ft->mux);
-//    fprintf(stderr,"_ftrace_semcb_inner() got wok.\n");
-    
     /* tell placement collector to keep going */
     return 1;
 }
@@ -157,7 +141,7 @@ static int _ftrace_semcb_v4(const struct libfc_template_t *t, void *vpft) {
     libftrace_t *ft = (libftrace_t *)vpft;
 
     /* set version */
-    ft->uf.ip_ver = 4;
+    ft->ruf.ip_ver = 4;
 
     /* signal flow ready */
     return _ftrace_semcb_inner(ft);
@@ -167,7 +151,7 @@ static int _ftrace_semcb_v6(const struct libfc_template_t *t, void *vpft) {
     libftrace_t *ft = (libftrace_t *)vpft;
 
     /* set version */
-    ft->uf.ip_ver = 6;
+    ft->ruf.ip_ver = 6;
 
     /* signal flow ready */
     return _ftrace_semcb_inner(ft);
@@ -194,11 +178,8 @@ void *_ftrace_rthread(void *vpft) {
     
     fprintf(stderr, "reader thread exiting, return value %d\n", rv);
 
-    /* signal read ready, outer thread will react to invalid record. */
-    pthread_mutex_lock(&ft->mux);
-    pthread_cond_signal(&ft->rok);
-    pthread_mutex_unlock(&ft->mux);
-    fprintf(stderr,"_ftrace_rthread() signaled rok on exit.\n");
+    /* close the ring; the caller will see the valid flag once it is empty */
+    ftrace_ring_close(ft->ring);
     
     /* we don't care about the return */
     return NULL;
@@ -216,51 +197,53 @@ libftrace_uniflow_t *ftrace_start_uniflow(libftrace_t *ft)
     /* register base template v4 */
     t = libfc_template_new(ft->tg);
     libfc_register_placement(t, "flowStartMilliseconds", 
-        &ft->uf.time_start, sizeof(ft->uf.time_start));
+        &ft->ruf.time_start, sizeof(ft->ruf.time_start));
     libfc_register_placement(t, "flowEndMilliseconds", 
-        &ft->uf.time_end, sizeof(ft->uf.time_end));
+        &ft->ruf.time_end, sizeof(ft->ruf.time_end));
     libfc_register_placement(t, "packetDeltaCount", 
-        &ft->uf.packets, sizeof(ft->uf.packets));
+        &ft->ruf.packets, sizeof(ft->ruf.packets));
     libfc_register_placement(t, "octetDeltaCount", 
-        &ft->uf.octets, sizeof(ft->uf.octets));
+        &ft->ruf.octets, sizeof(ft->ruf.octets));
     libfc_register_placement(t, "sourceIPv4Address", 
-        &ft->uf.ip.v4.src, sizeof(ft->uf.ip.v4.src));
+        &ft->ruf.ip.v4.src, sizeof(ft->ruf.ip.v4.src));
     libfc_register_placement(t, "destinationIPv4Address", 
-        &ft->uf.ip.v4.dst, sizeof(ft->uf.ip.v4.dst));
+        &ft->ruf.ip.v4.dst, sizeof(ft->ruf.ip.v4.dst));
     libfc_register_placement(t, "sourceTransportPort",
-        &ft->uf.port_src, sizeof(ft->uf.port_src));
+        &ft->ruf.port_src, sizeof(ft->ruf.port_src));
     libfc_register_placement(t, "destinationTransportPort",
-        &ft->uf.port_dst, sizeof(ft->uf.port_dst));
+        &ft->ruf.port_dst, sizeof(ft->ruf.port_dst));
     libfc_register_placement(t, "protocolIdentifier",
-        &ft->uf.ip_proto, sizeof(ft->uf.ip_proto));
+        &ft->ruf.ip_proto, sizeof(ft->ruf.ip_proto));
     libfc_register_callback(t, _ftrace_semcb_v4, ft);
 
     /* register base template v6 */
     t = libfc_template_new(ft->tg);
     libfc_register_placement(t, "flowStartMilliseconds", 
-        &ft->uf.time_start, sizeof(ft->uf.time_start));
+        &ft->ruf.time_start, sizeof(ft->ruf.time_start));
     libfc_register_placement(t, "flowEndMilliseconds", 
-        &ft->uf.time_end, sizeof(ft->uf.time_end));
+        &ft->ruf.time_end, sizeof(ft->ruf.time_end));
     libfc_register_placement(t, "packetDeltaCount", 
-        &ft->uf.packets, sizeof(ft->uf.packets));
+        &ft->ruf.packets, sizeof(ft->ruf.packets));
     libfc_register_placement(t, "octetDeltaCount", 
-        &ft->uf.octets, sizeof(ft->uf.octets));
+        &ft->ruf.octets, sizeof(ft->ruf.octets));
     libfc_register_placement(t, "sourceIPv6Address", 
-        &ft->uf.ip.v4.src, sizeof(ft->uf.ip.v4.src));
+        &ft->ruf.ip.v6.src, sizeof(ft->ruf.ip.v6.src));
     libfc_register_placement(t, "destinationIPv6Address", 
-        &ft->uf.ip.v4.dst, sizeof(ft->uf.ip.v4.dst));
+        &ft->ruf.ip.v6.dst, sizeof(ft->ruf.ip.v6.dst));
     libfc_register_placement(t, "sourceTransportPort",
-        &ft->uf.port_src, sizeof(ft->uf.port_src));
+        &ft->ruf.port_src, sizeof(ft->ruf.port_src));
     libfc_register_placement(t, "destinationTransportPort",
-        &ft->uf.port_dst, sizeof(ft->uf.port_dst));
+        &ft->ruf.port_dst, sizeof(ft->ruf.port_dst));
     libfc_register_placement(t, "protocolIdentifier",
-        &ft->uf.ip_proto, sizeof(ft->uf.ip_proto));
+        &ft->ruf.ip_proto, sizeof(ft->ruf.ip_proto));
     libfc_register_callback(t, _ftrace_semcb_v6, ft);
 
     /* FIXME more templates */
 
     /* make the reference circular so we know we started a uniflow */
     ft->uf._ft = ft;
+    ft->ruf._ft = ft;
+    ft->ruf._valid = 1;
     
     /* then start the reader thread */
     if ((pterrno = pthread_create(&ft->rt, NULL, _ftrace_rthread, ft)) != 0) {
@@ -275,10 +258,8 @@ libftrace_uniflow_t *ftrace_start_uniflow(libftrace_t *ft)
 void ftrace_destroy_uniflow(libftrace_uniflow_t *uf) {
     if (!uf->_ft->terminate) {
         /* signal inner uniflow to stop reading unless eof */
-        pthread_mutex_lock(&uf->_ft->mux);
         uf->_ft->terminate++;
-        pthread_cond_signal(&uf->_ft->wok);
-        pthread_mutex_unlock(&uf->_ft->mux);
+        ftrace_ring_cancel(uf->_ft->ring);
     }
 
     if (pthread_join(uf->_ft->rt, NULL) != 0) {
@@ -290,19 +271,16 @@ void ftrace_destroy_uniflow(libftrace_uniflow_t *uf) {
 /** Read the next uniflow from a libftrace reader. 
     Skips records in the stream which do not match uniflows. */
 int ftrace_next_uniflow(libftrace_uniflow_t *uf) {
-    
-    /* signal write ready */
-    pthread_mutex_lock(&uf->_ft->mux);
-    pthread_cond_signal(&uf->_ft->wok);
-//    fprintf(stderr,"next_uniflow() signaled wok, waiting for rok.\n");
-
-    /* wait read ready */
-    pthread_cond_wait(&uf->_ft->rok, &uf->_ft->mux);
-    pthread_mutex_unlock(&uf->_ft->mux);
-//    fprintf(stderr,"next_uniflow() got rok.\n");
-
-    /* check valid */
-    return uf->_ft->valid;
+    libftrace_t *ft = uf->_ft;
+
+    /* take the next flow from the ring; this only blocks if it is empty */
+    if (ftrace_ring_pop(ft->ring, uf)) {
+        return 1;
+    }
+
+    /* ring closed and drained, check valid */
+    uf->_valid = ft->valid;
+    return ft->valid;
 }
 
 int ftrace_add_specfile(libftrace_t *ft, const char *specfilename) {
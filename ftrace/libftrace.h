@@ -47,6 +47,10 @@
 
 #include "libfc.h"
 
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
 /** Opaque structure representing a libftrace source */
 struct libftrace_st;
 typedef struct libftrace_st libftrace_t;
@@ -126,5 +130,8 @@ void ftrace_destroy_uniflow(libftrace_uniflow_t *uf);
     Skips records in the stream which do not match uniflows. */
 int ftrace_next_uniflow(libftrace_uniflow_t *uf);
 
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
 
 #endif /* idem hack */
@@ -0,0 +1,195 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file uniflow_ring.cpp
+ * @brief Implementation of the uniflow ring
+ *
+ * The records themselves go through moodycamel's lock-free
+ * ReaderWriterQueue.  Each side additionally counts the records it has
+ * pushed or popped, so that the other side can tell how full the ring
+ * is without touching the queue.  A side that has to sleep sets its
+ * parked flag and then rechecks the counts under the mutex; the other
+ * side updates its count before looking at the flag.  Both use
+ * sequentially consistent atomics, so at least one of them sees the
+ * other's write, and no wakeup gets lost.
+ *
+ * A parked consumer waits for a whole batch for a short while only;
+ * after that, it asks to be woken by the next record, so that records
+ * of a slow source don't sit in the ring.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "moodycamel/ReaderWriterQueue.h"
+
+#include "uniflow_ring.h"
+
+/** Number of times a side retries before going to sleep. */
+static const unsigned int kSpins = 64;
+
+/** How long a parked consumer waits for a whole batch before it takes
+    any record that comes along. */
+static const std::chrono::milliseconds kFlushInterval(1);
+
+struct libftrace_ring_st {
+  libftrace_ring_st(size_t capacity, size_t batch)
+    : queue(capacity), capacity(capacity), batch(batch),
+      pushed(0), popped(0), closed(false), cancelled(false),
+      consumer_parked(false), producer_parked(false), consumer_wants(0) {
+  }
+
+  moodycamel::ReaderWriterQueue<libftrace_uniflow_t> queue;
+  const size_t capacity;
+  const size_t batch;
+
+  /** Number of records pushed; written by the producer only. */
+  std::atomic<size_t> pushed;
+  /** Number of records popped; written by the consumer only. */
+  std::atomic<size_t> popped;
+
+  std::atomic<bool> closed;
+  std::atomic<bool> cancelled;
+  std::atomic<bool> consumer_parked;
+  std::atomic<bool> producer_parked;
+  /** Number of records a parked consumer waits for. */
+  std::atomic<size_t> consumer_wants;
+
+  std::mutex mux;
+  /** Signalled when the records a parked consumer waits for are
+      available, or on close. */
+  std::condition_variable readable;
+  /** Signalled when a batch of slots is free or on cancel. */
+  std::condition_variable writable;
+};
+
+libftrace_ring_t *ftrace_ring_create(size_t capacity, size_t batch) {
+  if (capacity < 2)
+    capacity = 2;
+  if (batch < 1)
+    batch = 1;
+  if (batch > capacity / 2)
+    batch = capacity / 2;
+
+  return new (std::nothrow) libftrace_ring_st(capacity, batch);
+}
+
+void ftrace_ring_destroy(libftrace_ring_t *ring) {
+  delete ring;
+}
+
+int ftrace_ring_push(libftrace_ring_t *ring, const libftrace_uniflow_t *uf) {
+  for (unsigned int spins = 0; ; spins++) {
+    if (ring->cancelled.load())
+      return 0;
+    if (ring->queue.try_enqueue(*uf))
+      break;
+    if (spins < kSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    /* Full; sleep until the consumer has made room for a batch. */
+    std::unique_lock<std::mutex> lock(ring->mux);
+    ring->producer_parked.store(true);
+    ring->writable.wait(lock, [ring] {
+        return ring->cancelled.load()
+          || ring->pushed.load() - ring->popped.load() + ring->batch
+             <= ring->capacity;
+      });
+    ring->producer_parked.store(false);
+  }
+
+  size_t pushed = ring->pushed.load(std::memory_order_relaxed) + 1;
+  ring->pushed.store(pushed);
+
+  if (ring->consumer_parked.load()
+      && pushed - ring->popped.load() >= ring->consumer_wants.load()) {
+    std::lock_guard<std::mutex> lock(ring->mux);
+    ring->readable.notify_one();
+  }
+  return 1;
+}
+
+void ftrace_ring_close(libftrace_ring_t *ring) {
+  std::lock_guard<std::mutex> lock(ring->mux);
+  ring->closed.store(true);
+  ring->readable.notify_one();
+}
+
+int ftrace_ring_pop(libftrace_ring_t *ring, libftrace_uniflow_t *uf) {
+  for (unsigned int spins = 0; ; spins++) {
+    if (ring->queue.try_dequeue(*uf))
+      break;
+    if (ring->closed.load()) {
+      /* Everything was pushed before the ring was closed. */
+      if (ring->queue.try_dequeue(*uf))
+        break;
+      return 0;
+    }
+    if (spins < kSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    /* Empty; sleep until the producer has pushed a batch, or any
+     * record at all once the flush interval has passed. */
+    std::unique_lock<std::mutex> lock(ring->mux);
+    ring->consumer_wants.store(ring->batch);
+    ring->consumer_parked.store(true);
+    auto available = [ring] {
+      return ring->closed.load()
+        || ring->pushed.load() - ring->popped.load()
+           >= ring->consumer_wants.load();
+    };
+    if (!ring->readable.wait_for(lock, kFlushInterval, available)) {
+      ring->consumer_wants.store(1);
+      ring->readable.wait(lock, available);
+    }
+    ring->consumer_parked.store(false);
+  }
+
+  size_t popped = ring->popped.load(std::memory_order_relaxed) + 1;
+  ring->popped.store(popped);
+
+  if (ring->producer_parked.load()
+      && ring->pushed.load() - popped + ring->batch <= ring->capacity) {
+    std::lock_guard<std::mutex> lock(ring->mux);
+    ring->writable.notify_one();
+  }
+  return 1;
+}
+
+void ftrace_ring_cancel(libftrace_ring_t *ring) {
+  std::lock_guard<std::mutex> lock(ring->mux);
+  ring->cancelled.store(true);
+  ring->writable.notify_one();
+}
@@ -0,0 +1,91 @@
+/* Hi Emacs, please use -*- mode: C; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZÜRICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/**
+ * @file uniflow_ring.h
+ * @brief Single-producer, single-consumer ring of uniflow records
+ *
+ * libftrace decodes records on a reader thread and hands them to the
+ * thread calling ftrace_next_uniflow() through this ring.  Pushing and
+ * popping are lock-free.  A side only sleeps when the ring is empty
+ * (for the consumer) or full (for the producer), and it is only woken
+ * up again once a whole batch of records (or of free space) is
+ * available, so that a thread switch is amortized over many records.
+ * A consumer stops waiting for a whole batch after a millisecond, so
+ * that the records of a slow source still come through.
+ */
+
+#ifndef _LIBFTRACE_UNIFLOW_RING_H_ /* idem */
+#define _LIBFTRACE_UNIFLOW_RING_H_ /* hack */
+
+#include <stddef.h>
+
+#include "libftrace.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Opaque structure representing a uniflow ring */
+struct libftrace_ring_st;
+typedef struct libftrace_ring_st libftrace_ring_t;
+
+/** Create a uniflow ring.
+    Capacity is the number of records the ring holds; batch is the
+    number of records (or free slots) that must be available before a
+    sleeping consumer (or producer) is woken; a consumer that has
+    slept for a millisecond is woken by any record.  Batch is clamped
+    to half the capacity.  Returns NULL on allocation failure. */
+libftrace_ring_t *ftrace_ring_create(size_t capacity, size_t batch);
+
+/** Destroy a uniflow ring. No thread may use the ring anymore. */
+void ftrace_ring_destroy(libftrace_ring_t *ring);
+
+/** Append a record to the ring; producer side only.
+    Blocks while the ring is full.  Returns 1 if the record was
+    appended, 0 if the consumer has cancelled the ring. */
+int ftrace_ring_push(libftrace_ring_t *ring, const libftrace_uniflow_t *uf);
+
+/** Signal that no more records will be pushed; producer side only.
+    Records already in the ring can still be popped. */
+void ftrace_ring_close(libftrace_ring_t *ring);
+
+/** Remove the oldest record from the ring; consumer side only.
+    Blocks while the ring is empty and not closed.  Returns 1 if a
+    record was copied to uf, 0 if the ring is closed and empty. */
+int ftrace_ring_pop(libftrace_ring_t *ring, libftrace_uniflow_t *uf);
+
+/** Signal that no more records will be popped; consumer side only.
+    Wakes up the producer, whose pushes fail from now on. */
+void ftrace_ring_cancel(libftrace_ring_t *ring);
+
+#if defined(__cplusplus)
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* idem hack */
@@ -29,8 +29,10 @@
  *
  * From Brian's ipfix2csv Python utility.
  *
- * Syntax: ipfix2csv [--version={5|9|10}|-v {5|9|10} [-s iespec-file] \
- *     [ienames...] [message-stream]
+ * Syntax: ipfix2csv [--message-version={9|10}|-m {9|10}] [-s iespec-file] \
+ *     [-i input]... [-o output-dir] [-P n] [-j n] \
+ *     {ienames...|--all-fields [--split-templates]|
+ *      --group-by=ienames [--sum=ienames] [--top=n] [--bin=n [--time-ie=iename]]}
  *
  * E.g. ./ipfix2csv -s qof.iespec \
  *     sourceIPv4Address destinationIPv4Address 
@@ -44,6 +46,22 @@
  *     sourceIPv4Address destinationIPv4Address             \
  *     meanTcpRttMilliseconds reverseMeanTcpRttMilliseconds
  *
+ * Or, converting four compressed files at a time, each to a CSV file
+ * in out/:
+ *
+ * ./ipfix2csv -P 4 -o out -i '/data/ipfix/2014-05-*.ipfix.gz' \
+ *     sourceIPv4Address destinationIPv4Address
+ *
+ * Or, writing all IEs of every template, each template's IEs to a file
+ * of their own in out/:
+ *
+ * ./ipfix2csv -a -S -o out -i /data/ipfix/2014-05-01.ipfix
+ *
+ * Or, writing the ten sources with the most octets per minute:
+ *
+ * ./ipfix2csv -g sourceIPv4Address -c octetDeltaCount -n 10 -b 60 \
+ *     -i /data/ipfix/2014-05-01.ipfix
+ *
  * Or:
  *
  * ./ipfix2csv \
@@ -71,22 +89,38 @@
  *
  * @author Stephan Neuhaus <neuhaust@tik.ee.ethz.ch>
  */
-#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
 #include <cstddef>
-#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <list>
-
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
 #include <getopt.h>
+#include <glob.h>
+#include <unistd.h>
 
+#include "BasicOctetArray.h"
 #include "FileInputSource.h"
 #include "InfoElement.h"
 #include "InfoModel.h"
-#include "PlacementCollector.h"
+#include "OutputBuffer.h"
 #include "PlacementTemplate.h"
+#include "StaticPlacementCollector.h"
 #include "WandioInputSource.h"
+#include "text_format.h"
 
 #include "exceptions/FormatError.h"
 
@@ -102,8 +136,48 @@ static int verbose_flag = false;
 static int help_flag = false;
 static int message_version = 10;
 static int full_type_flag = 0;
+static int all_fields_flag = 0;
+static int split_templates_flag = 0;
 static std::list<const char*> ie_names;
-static std::string filename;
+static std::vector<std::string> inputs;
+static std::string output_dir;
+static unsigned int n_threads = std::thread::hardware_concurrency();
+static unsigned int n_parallel = 1;
+static std::vector<std::string> group_by_names;
+static std::vector<std::string> sum_names;
+static size_t top_n = 0;
+static uint64_t bin_seconds = 0;
+static const char* time_ie_name = "flowStartMilliseconds";
+
+/** Adds the files that match a glob(3) pattern to the inputs.
+ *
+ * A pattern that matches nothing is added as is, so that the error
+ * is reported when the file is opened.
+ */
+static void add_inputs(const char* pattern) {
+  glob_t g;
+
+  if (glob(pattern, 0, 0, &g) != 0)
+    inputs.push_back(pattern);
+  else
+    for (size_t i = 0; i < g.gl_pathc; i++)
+      inputs.push_back(g.gl_pathv[i]);
+  globfree(&g);
+}
+
+/** Adds the names in a comma-separated list to a vector. */
+static void add_names(std::vector<std::string>& names, const char* list) {
+  const char* end;
+
+  do {
+    end = strchr(list, ',');
+    if (end == 0)
+      end = list + strlen(list);
+    if (end > list)
+      names.push_back(std::string(list, end));
+    list = end + 1;
+  } while (*end != '\0');
+}
 
 /* Code patterned after http://www.gnu.org/software/libc/
  * manual/html_node/Getopt-Long-Option-Example.html
@@ -117,13 +191,23 @@ static void parse_options(int argc, char* const* argv) {
       { "verbose", no_argument, &verbose_flag, 1 },
       { "message-version", required_argument, 0, 'm' },
       { "specfile", required_argument, 0, 's' },
-      { "full-types", no_argument, &full_type_flag, 't' },
+      { "full-types", no_argument, &full_type_flag, 1 },
+      { "all-fields", no_argument, &all_fields_flag, 1 },
+      { "split-templates", no_argument, &split_templates_flag, 1 },
+      { "threads", required_argument, 0, 'j' },
+      { "output-dir", required_argument, 0, 'o' },
+      { "parallel", required_argument, 0, 'P' },
+      { "group-by", required_argument, 0, 'g' },
+      { "sum", required_argument, 0, 'c' },
+      { "top", required_argument, 0, 'n' },
+      { "bin", required_argument, 0, 'b' },
+      { "time-ie", required_argument, 0, 'T' },
       { 0, 0, 0, 0 },
     };
 
     int option_index = 0;
 
-    int c = getopt_long(argc, argv, "hi:m:s:tv", options, &option_index);
+    int c = getopt_long(argc, argv, "ab:c:g:hi:j:m:n:o:P:Ss:T:tv", options, &option_index);
 
     if (c == -1)
       break;
@@ -137,8 +221,26 @@ static void parse_options(int argc, char* const* argv) {
         std::cerr << " with arg \"" << optarg << "\"";
       std::cerr << std::endl;
       break;
+    case 'a':
+      all_fields_flag = 1;
+      break;
+    case 'b':
+      bin_seconds = strtoull(optarg, 0, 10);
+      break;
+    case 'c':
+      add_names(sum_names, optarg);
+      break;
+    case 'g':
+      add_names(group_by_names, optarg);
+      break;
+    case 'h':
+      help_flag = 1;
+      break;
     case 'i':
-      filename = optarg;
+      add_inputs(optarg);
+      break;
+    case 'j':
+      n_threads = atoi(optarg);
       break;
     case 'm':
       message_version = atoi(optarg);
@@ -149,9 +251,32 @@ static void parse_options(int argc, char* const* argv) {
         exit(EXIT_FAILURE);
       }
       break;
+    case 'n':
+      top_n = strtoul(optarg, 0, 10);
+      break;
+    case 'o':
+      output_dir = optarg;
+      break;
+    case 'P':
+      n_parallel = atoi(optarg);
+      if (n_parallel < 1)
+        n_parallel = 1;
+      break;
+    case 'S':
+      split_templates_flag = 1;
+      break;
     case 's':
       spec_file_name = optarg;
       break;
+    case 'T':
+      time_ie_name = optarg;
+      break;
+    case 't':
+      full_type_flag = 1;
+      break;
+    case 'v':
+      verbose_flag = 1;
+      break;
     default:
       std::cerr << "Unrecognised option character '" << c 
                 << "', aborting" << std::endl;
@@ -167,10 +292,51 @@ static void parse_options(int argc, char* const* argv) {
 
 static void help() {
   std::cerr << "usage: ./ipfix2csv [options] ie-names..." << std::endl
+            << "       ./ipfix2csv [options] --all-fields" << std::endl
+            << "       ./ipfix2csv [options] --group-by=ie-names"
+            << " [--sum=ie-names]" << std::endl
             << "Options:" << std::endl
+            << "  -a|--all-fields" << std::endl
+            << "\twrite all IEs of every template; the lines of each"
+            << " distinct list of" << std::endl
+            << "\tIEs start with its number, and so does its header,"
+            << " after a '#'" << std::endl
+            << "  -b n|--bin=n\twith -g, sum separately per N seconds,"
+            << " by the time in the" << std::endl
+            << "\tIE given with -T" << std::endl
+            << "  -c ies|--sum=ies" << std::endl
+            << "\twith -g, sum these comma-separated unsigned IEs per key"
+            << std::endl
+            << "  -g ies|--group-by=ies" << std::endl
+            << "\twrite one line per distinct value of these"
+            << " comma-separated IEs," << std::endl
+            << "\twith the sums and the number of records" << std::endl
+            << "  -i file|--input=file" << std::endl
+            << "\tread from FILE, which may be compressed and may be a"
+            << " glob pattern;" << std::endl
+            << "\tmay be given more than once (default: stdin)" << std::endl
+            << "  -n n|--top=n\twith -g, write only the N keys with the"
+            << " largest first sum" << std::endl
+            << "\t(or number of records) per bin" << std::endl
+            << "  -o dir|--output-dir=dir" << std::endl
+            << "\twrite each input to a CSV file of its own in DIR"
+            << " (default: all" << std::endl
+            << "\tto stdout, in the order given)" << std::endl
+            << "  -S|--split-templates" << std::endl
+            << "\twith -a and -o, write each list of IEs to a file of"
+            << " its own, named" << std::endl
+            << "\tafter the input and the list's number" << std::endl
+            << "  -P n|--parallel=n\tconvert N input files at a time"
+            << " (default 1)" << std::endl
             << "  -s file|--specfile=file" << std::endl
             << "\tuse FILE as IE spec filename" << std::endl
             << "  -h|--help\tprint this help text" << std::endl
+            << "  -j n|--threads=n\tformat records on N threads"
+            << " (default: number of CPUs); 1 formats them" << std::endl
+            << "\tin the decoding thread" << std::endl
+            << "  -T ie|--time-ie=ie" << std::endl
+            << "\twith -b, take the time of a record from IE"
+            << " (default: flowStartMilliseconds)" << std::endl
             << "  -t|--full-types print full type info in columns" << std::endl
             << "  -v|--verbose\tprint verbose output" << std::endl;
 }
@@ -194,34 +360,38 @@ add_ies_from_spec_file() {
 }
 
 
-static void
-print_unsigned(std::ostream& os, const IEType* type, void* v) {
+/* Renderers format a placed value into an OutputBuffer's space; see
+ * CSVCollector::end_record(). */
+
+static char*
+render_unsigned(char* p, const IEType* type, const void* v) {
   switch (type->number()) {
-  case IEType::kUnsigned8: os << static_cast<int>(*static_cast<uint8_t*>(v)); break;
-  case IEType::kUnsigned16: os << *static_cast<uint16_t*>(v); break;
-  case IEType::kUnsigned32: os << *static_cast<uint32_t*>(v); break;
-  case IEType::kUnsigned64: os << *static_cast<uint64_t*>(v); break;
+  case IEType::kUnsigned8: p = format_unsigned(p, *static_cast<const uint8_t*>(v)); break;
+  case IEType::kUnsigned16: p = format_unsigned(p, *static_cast<const uint16_t*>(v)); break;
+  case IEType::kUnsigned32: p = format_unsigned(p, *static_cast<const uint32_t*>(v)); break;
+  case IEType::kUnsigned64: p = format_unsigned(p, *static_cast<const uint64_t*>(v)); break;
   default: /* Can't happen, ignore silently */ break;
   }
-  
+
   if (full_type_flag) {
     switch (type->number()) {
-    case IEType::kUnsigned8: os << "U"; break;
-    case IEType::kUnsigned16: os << "U"; break;
-    case IEType::kUnsigned32: os << "UL"; break;
-    case IEType::kUnsigned64: os << "ULL"; break;
+    case IEType::kUnsigned8: *p++ = 'U'; break;
+    case IEType::kUnsigned16: *p++ = 'U'; break;
+    case IEType::kUnsigned32: memcpy(p, "UL", 2); p += 2; break;
+    case IEType::kUnsigned64: memcpy(p, "ULL", 3); p += 3; break;
     default: /* Can't happen, ignore silently */ break;
     }
   }
+  return p;
 }
 
-static void
-print_signed(std::ostream& os, const IEType* type, void* v) {
+static char*
+render_signed(char* p, const IEType* type, const void* v) {
   switch (type->number()) {
-  case IEType::kSigned8: os << static_cast<int>(*static_cast<int8_t*>(v)); break;
-  case IEType::kSigned16: os << *static_cast<int16_t*>(v); break;
-  case IEType::kSigned32: os << *static_cast<int32_t*>(v); break;
-  case IEType::kSigned64: os << *static_cast<int64_t*>(v); break;
+  case IEType::kSigned8: p = format_signed(p, *static_cast<const int8_t*>(v)); break;
+  case IEType::kSigned16: p = format_signed(p, *static_cast<const int16_t*>(v)); break;
+  case IEType::kSigned32: p = format_signed(p, *static_cast<const int32_t*>(v)); break;
+  case IEType::kSigned64: p = format_signed(p, *static_cast<const int64_t*>(v)); break;
   default: /* Can't happen, ignore silently */ break;
   }
 
@@ -229,394 +399,1638 @@ print_signed(std::ostream& os, const IEType* type, void* v) {
     switch (type->number()) {
     case IEType::kSigned8: break;
     case IEType::kSigned16: break;
-    case IEType::kSigned32: os << "L"; break;
-    case IEType::kSigned64: os << "LL"; break;
+    case IEType::kSigned32: *p++ = 'L'; break;
+    case IEType::kSigned64: memcpy(p, "LL", 2); p += 2; break;
     default: /* Can't happen, ignore silently */ break;
     }
   }
+  return p;
 }
 
-static void
-print_ipv4address(std::ostream& os, const IEType* type, void* v) {
-  uint32_t val = *static_cast<uint32_t*>(v);
-  os << ((val >> 24) & 0xff) 
-     << '.' << ((val >> 16) & 0xff) 
-     << '.' << ((val >>  8) & 0xff) 
-     << '.' << ((val >>  0) & 0xff);
+static char*
+render_ipv4address(char* p, const IEType* type, const void* v) {
+  return format_ipv4(p, *static_cast<const uint32_t*>(v));
 }
 
-static void
-print_ipv6address(std::ostream& os, const IEType* type, void* v) {
-  uint8_t* val = static_cast<uint8_t*>(v);
-  unsigned int i = 0;
-  std::ios_base::fmtflags f = os.flags();
+static char*
+render_ipv6address(char* p, const IEType* type, const void* v) {
+  return format_ipv6(p, static_cast<const uint8_t*>(v));
+}
 
-  os << std::hex;
+static char*
+render_macaddress(char* p, const IEType* type, const void* v) {
+  return format_mac(p, static_cast<const uint8_t*>(v));
+}
 
-  while (i < 16) {
-    if (val[i] == 0) {
-      os << ':';
-      ++i;
-      while (i < 16 && val[i] == 0)
-        ++i;
-    } else {
-      if (i > 0)
-        os << ':';
-      os << val[i];
-    }
-    ++i;
+static char*
+render_datetime(char* p, const IEType* type, const void* v) {
+  /* Convert to dateTimeNanoseconds. */
+  uint64_t nanos = 0;
+
+  switch (type->number()) {
+  case IEType::kDateTimeSeconds:
+    nanos = *static_cast<const uint32_t*>(v) * 1000000000ULL;
+    break;
+  case IEType::kDateTimeMilliseconds:
+    nanos = *static_cast<const uint64_t*>(v) * 1000000ULL;
+    break;
+  case IEType::kDateTimeMicroseconds:
+    nanos = *static_cast<const uint64_t*>(v) * 1000ULL;
+    break;
+  case IEType::kDateTimeNanoseconds:
+    nanos = *static_cast<const uint64_t*>(v) * 1ULL;
+    break;
+  default:
+    /* Can't happen, ignore silently */
+    break;
   }
 
-  os.flags(f);
+  return format_iso_datetime(p, nanos);
 }
 
-static void
-print_macaddress(std::ostream& os, const IEType* type, void* v) {
-  uint8_t* val = static_cast<uint8_t*>(v);
-  
-  for (unsigned int i = 0; i < 6; i++) {
-    unsigned char un = (val[i] >> 4) & 0x0f;
-    unsigned char ln = (val[i] >> 0) & 0x0f;
+static char*
+render_float(char* p, const IEType* type, const void* v) {
+  double d = 0.0;
 
-    if (i > 0)
-      os << ':';
-    os << un << ln;
+  switch(type->number()) {
+  case IEType::kFloat32: d = *static_cast<const float*>(v); break;
+  case IEType::kFloat64: d = *static_cast<const double*>(v); break;
+  default:
+    /* Can't happen, ignore silently */
+    break;
   }
+
+  return format_float(p, d);
 }
 
-static char
-to_digit(unsigned int d) {
-  assert(0 <= d && d < 10);
-  switch(d) {
-  case 0: return '0';
-  case 1: return '1';
-  case 2: return '2';
-  case 3: return '3';
-  case 4: return '4';
-  case 5: return '5';
-  case 6: return '6';
-  case 7: return '7';
-  case 8: return '8';
-  case 9: return '9';
-  }
-  assert(d == 0);               /* Will evaluate to false. */
-  return '\0';                  /* Shut up compiler. */
+static char*
+render_bool(char* p, const IEType* type, const void* v) {
+  if (*static_cast<const uint8_t*>(v) == 0) {
+    memcpy(p, "false", 5);
+    return p + 5;
+  }
+  memcpy(p, "true", 4);
+  return p + 4;
 }
 
-static void
-print_iso_datetime(std::ostream& os, struct tm* tm, uint64_t fraction) {
-  char buf[21];
-  char* p = buf;
+/** A view of the octets of an octetArray or string value.
+ *
+ * These values are placed into BasicOctetArrays outside a record;
+ * the record holds views of them instead, so that all its values can
+ * be formatted from the record alone. */
+struct Octets {
+  const uint8_t* buf;
+  size_t length;
+};
 
-  assert(p + 5 < buf + sizeof(buf));
-  tm->tm_year += 1900;
-  assert(tm->tm_year < 10000);
-  *(p + 3) = to_digit(tm->tm_year % 10); tm->tm_year /= 10;
-  *(p + 2) = to_digit(tm->tm_year % 10); tm->tm_year /= 10;
-  *(p + 1) = to_digit(tm->tm_year % 10); tm->tm_year /= 10;
-  *(p + 0) = to_digit(tm->tm_year % 10);
+static const char hex_digits[] = "0123456789abcdef";
 
-  p += 4; *p++ = '-';
+static char*
+render_octets(char* p, const IEType* type, const void* v) {
+  const Octets* o = static_cast<const Octets*>(v);
 
-  assert(p + 3 < buf + sizeof(buf));
-  tm->tm_mon++;
-  assert(1 <= tm->tm_mon && tm->tm_mon <= 12);
-  *(p + 1) = to_digit(tm->tm_mon % 10); tm->tm_mon /= 10;
-  *(p + 0) = to_digit(tm->tm_mon % 10);
+  for (size_t i = 0; i < o->length; i++) {
+    *p++ = hex_digits[o->buf[i] >> 4];
+    *p++ = hex_digits[o->buf[i] & 0xf];
+  }
+  return p;
+}
 
-  p += 2; *p++ = '-';
+static char*
+render_string(char* p, const IEType* type, const void* v) {
+  const Octets* o = static_cast<const Octets*>(v);
+  const char* s = reinterpret_cast<const char*>(o->buf);
+  bool quote = false;
 
-  assert(p + 3 < buf + sizeof(buf));
-  assert(1 <= tm->tm_mday && tm->tm_mday <= 31);
-  *(p + 1) = to_digit(tm->tm_mday % 10); tm->tm_mday /= 10;
-  *(p + 0) = to_digit(tm->tm_mday % 10);
+  for (size_t i = 0; i < o->length && !quote; i++)
+    quote = s[i] == ';' || s[i] == '"' || s[i] == '\r' || s[i] == '\n';
 
-  p += 2; *p++ = 'T';
+  if (!quote) {
+    memcpy(p, s, o->length);
+    return p + o->length;
+  }
 
-  assert(p + 3 < buf + sizeof(buf));
-  assert(0 <= tm->tm_hour && tm->tm_hour < 24);
-  *(p + 1) = to_digit(tm->tm_hour % 10); tm->tm_hour /= 10;
-  *(p + 0) = to_digit(tm->tm_hour % 10);
+  /* Quote as in RFC 4180. */
+  *p++ = '"';
+  for (size_t i = 0; i < o->length; i++) {
+    if (s[i] == '"')
+      *p++ = '"';
+    *p++ = s[i];
+  }
+  *p++ = '"';
+  return p;
+}
 
-  p += 2; *p++ = ':';
+/** Returns the name of an IE's column.
+ *
+ * IEs that were unknown when their template arrived all have the
+ * same name, so theirs is made unique with their PEN and number. */
+static std::string column_name(const InfoElement* ie) {
+  std::string ret = ie->name();
+
+  if (ret == "__ipfix_") {
+    char buf[2 * kMaxIntegerChars + 1];
+    char* p = format_unsigned(buf, ie->pen());
+    *p++ = '_';
+    p = format_unsigned(p, ie->number());
+    ret.append(buf, p - buf);
+  }
+  return ret;
+}
 
-  assert(p + 3 < buf + sizeof(buf));
-  assert(0 <= tm->tm_min && tm->tm_min < 60);
-  *(p + 1) = to_digit(tm->tm_min % 10); tm->tm_min /= 10;
-  *(p + 0) = to_digit(tm->tm_min % 10);
+/** The columns of a CSV file, and where their values are placed.
+ *
+ * The values of a record are placed next to each other in a single
+ * block of memory, so that a record can be saved for formatting
+ * later with a single memcpy().
+ */
+class CSVFormat {
+public:
+  /** Creates a format.
+   *
+   * @param ies the IEs of the columns, in order
+   * @param prefix text with which to start every line
+   * @param header_prefix text with which to start the header line
+   */
+  CSVFormat(const std::vector<const InfoElement*>& ies,
+            const std::string& prefix = "",
+            const std::string& header_prefix = "")
+    : prefix(prefix), header(header_prefix), record_size(0),
+      record_width(prefix.size() + 1) {
+    for (auto ie = ies.begin(); ie != ies.end(); ++ie) {
+      if (ie != ies.begin())
+        header += ';';
+      header += column_name(*ie);
+      add_column(*ie);
+    }
+    header += '\n';
+  }
 
-  p += 2; *p++ = ':';
+  /** Returns the header line, including the newline. */
+  const std::string& get_header() const { return header; }
+
+  /** Registers placements for all columns.
+   *
+   * @param tmpl the template in which to register the placements
+   * @param record where to place the values; this must be
+   *   get_record_size() bytes large and aligned like a uint64_t
+   * @param octets where to place octetArray and string values; there
+   *   must be get_n_octets() of them
+   */
+  void register_placements(PlacementTemplate* tmpl, uint8_t* record,
+                           BasicOctetArray* octets) const {
+    for (auto c = columns.begin(); c != columns.end(); ++c) {
+      if (c->renderer == render_octets || c->renderer == render_string)
+        tmpl->register_placement(c->ie, octets++, 0);
+      else
+        tmpl->register_placement(c->ie, record + c->offset, 0);
+    }
+  }
 
-  assert(p + 4 == buf + sizeof(buf));
-  assert(0 <= tm->tm_sec && tm->tm_sec <= 60); // Leap second
-  *(p + 1) = to_digit(tm->tm_sec % 10); tm->tm_sec /= 10;
-  *(p + 0) = to_digit(tm->tm_sec % 10);
+  /** Points the views in a record at the octetArray and string values
+   * that were placed for it.
+   *
+   * @param record the placed values of the record
+   * @param octets the octetArray and string values
+   */
+  void set_octets(uint8_t* record, const BasicOctetArray* octets) const {
+    for (auto o = octets_offsets.begin(); o != octets_offsets.end(); ++o) {
+      Octets* v = reinterpret_cast<Octets*>(record + *o);
+      v->buf = octets->get_buf();
+      v->length = octets->get_length();
+      octets++;
+    }
+  }
 
-  p += 2; *p++ = '.'; *p = '\0';
+  /** Calls a function on every view in a record, for example to copy
+   * the octets elsewhere and repoint the view.
+   *
+   * @param record the placed values of the record
+   * @param f the function, called with an Octets*
+   */
+  template<typename F>
+  void for_each_octets(uint8_t* record, F f) const {
+    for (auto o = octets_offsets.begin(); o != octets_offsets.end(); ++o)
+      f(reinterpret_cast<Octets*>(record + *o));
+  }
 
-  os << buf;
+  /** Formats a record as a CSV line.
+   *
+   * @param p where to write the line; there must be room for
+   *   get_record_width() characters
+   * @param record the placed values of the record
+   *
+   * @return pointer past the newline
+   */
+  char* format(char* p, const uint8_t* record) const {
+    p = format_fields(p, record);
+    *p++ = '\n';
+    return p;
+  }
 
-  p = buf + 9;
-  *p-- = '\0';
+  /** Formats a record as a CSV line without the newline.
+   *
+   * @param p where to write the line; there must be room for
+   *   get_record_width() characters
+   * @param record the placed values of the record
+   *
+   * @return pointer past the last field
+   */
+  char* format_fields(char* p, const uint8_t* record) const {
+    memcpy(p, prefix.data(), prefix.size());
+    p += prefix.size();
+    for (auto c = columns.begin(); c != columns.end(); ++c) {
+      if (c != columns.begin())
+        *p++ = ';';
+      p = c->renderer(p, c->type, record + c->offset);
+    }
+    return p;
+  }
 
-  while (fraction != 0 && fraction % 10 == 0)
-    fraction /= 10;
+  /** Returns the size of a record's placed values in bytes. */
+  size_t get_record_size() const { return record_size; }
+
+  /** Returns the number of octetArray and string columns. */
+  size_t get_n_octets() const { return octets_offsets.size(); }
+
+  /** Returns the maximum length of a record's CSV line, including the
+   * newline.
+   *
+   * @param record the placed values of the record
+   */
+  size_t get_record_width(const uint8_t* record) const {
+    size_t ret = record_width;
+    for (auto o = octets_offsets.begin(); o != octets_offsets.end(); ++o)
+      ret += 2 * reinterpret_cast<const Octets*>(record + *o)->length;
+    return ret;
+  }
 
-  do {
-    *p-- = to_digit(fraction % 10);
-    fraction /= 10;
-  } while (fraction != 0);
+private:
+  CSVFormat(const CSVFormat&);
+  CSVFormat& operator=(const CSVFormat&);
 
-  os << (p + 1);
-}
+  struct Column {
+    const InfoElement* ie;
+    const IEType* type;
+    char* (*renderer)(char* p, const IEType* type, const void* v);
+    /** Maximum number of characters written by renderer, not counting
+     * two per octet of octetArray and string values. */
+    size_t width;
+    /** Size of the placed value in bytes. */
+    size_t size;
+    /** Offset of the placed value within a record. */
+    size_t offset;
+  };
 
-static void
-print_datetime(std::ostream& os, const IEType* type, void* v) {
-  /* Convert to dateTimeNanoseconds. */
-  uint64_t nanos = 0;
+  void add_column(const InfoElement* ie) {
+    Column c;
 
-  switch (type->number()) {
-  case IEType::kDateTimeSeconds:
-    nanos = *static_cast<uint32_t*>(v) * 1000000000ULL;
-    break;
-  case IEType::kDateTimeMilliseconds:
-    nanos = *static_cast<uint64_t*>(v) * 1000000ULL;
-    break;
-  case IEType::kDateTimeMicroseconds:
-    nanos = *static_cast<uint64_t*>(v) * 1000ULL;
-    break;
-  case IEType::kDateTimeNanoseconds:
-    nanos = *static_cast<uint64_t*>(v) * 1ULL;
-    break;
-  default:
-    /* Can't happen, ignore silently */
-    break;
+    c.ie = ie;
+    c.type = ie->ietype();
+
+    switch (c.type->number()) {
+    case IEType::kOctetArray: 
+      c.size = sizeof(Octets);
+      c.renderer = render_octets;
+      c.width = 0;
+      break;
+
+    case IEType::kUnsigned8:
+      c.size = 1;
+      c.renderer = render_unsigned;
+      c.width = kMaxIntegerChars + 3;
+      break;
+
+    case IEType::kUnsigned16:
+      c.size = 2;
+      c.renderer = render_unsigned;
+      c.width = kMaxIntegerChars + 3;
+      break;
+
+    case IEType::kUnsigned32:
+      c.size = 4;
+      c.renderer = render_unsigned;
+      c.width = kMaxIntegerChars + 3;
+      break;
+
+    case IEType::kUnsigned64:
+      c.size = 8;
+      c.renderer = render_unsigned;
+      c.width = kMaxIntegerChars + 3;
+      break;
+
+    case IEType::kSigned8:
+      c.size = 1;
+      c.renderer = render_signed;
+      c.width = kMaxIntegerChars + 2;
+      break;
+
+    case IEType::kSigned16:
+      c.size = 2;
+      c.renderer = render_signed;
+      c.width = kMaxIntegerChars + 2;
+      break;
+
+    case IEType::kSigned32:
+      c.size = 4;
+      c.renderer = render_signed;
+      c.width = kMaxIntegerChars + 2;
+      break;
+
+    case IEType::kSigned64:
+      c.size = 8;
+      c.renderer = render_signed;
+      c.width = kMaxIntegerChars + 2;
+      break;
+
+    case IEType::kFloat32:
+      c.size = 4;
+      c.renderer = render_float;
+      c.width = kMaxFloatChars;
+      break;
+
+    case IEType::kFloat64:
+      c.size = 8;
+      c.renderer = render_float;
+      c.width = kMaxFloatChars;
+      break;
+
+    case IEType::kBoolean:
+      c.size = 1;
+      c.renderer = render_bool;
+      c.width = 5;
+      break;
+
+    case IEType::kMacAddress:
+      c.size = 6;
+      c.renderer = render_macaddress;
+      c.width = kMaxMacChars;
+      break;
+
+    case IEType::kString:
+      c.size = sizeof(Octets);
+      c.renderer = render_string;
+      /* Two quotes; doubled quotes are covered by two per octet. */
+      c.width = 2;
+      break;
+
+    case IEType::kDateTimeSeconds:
+      c.size = 4;
+      c.renderer = render_datetime;
+      c.width = kMaxDatetimeChars;
+      break;
+
+    case IEType::kDateTimeMilliseconds:
+      c.size = 8;
+      c.renderer = render_datetime;
+      c.width = kMaxDatetimeChars;
+      break;
+
+    case IEType::kDateTimeMicroseconds:
+      c.size = 8;
+      c.renderer = render_datetime;
+      c.width = kMaxDatetimeChars;
+      break;
+
+    case IEType::kDateTimeNanoseconds:
+      c.size = 8;
+      c.renderer = render_datetime;
+      c.width = kMaxDatetimeChars;
+      break;
+
+    case IEType::kIpv4Address:
+      c.size = 4;
+      c.renderer = render_ipv4address;
+      c.width = kMaxIpv4Chars;
+      break;
+
+    case IEType::kIpv6Address:
+      c.size = 16;
+      c.renderer = render_ipv6address;
+      c.width = kMaxIpv6Chars;
+      break;
+
+    default:
+      /* Can't happen */
+      std::cerr << "Unknown IE type number " << ie->ietype()->number() 
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    
+    /* Keep every value aligned for its type. */
+    c.offset = record_size;
+    record_size += (c.size + 7) & ~static_cast<size_t>(7);
+    record_width += c.width + 1;
+    if (c.renderer == render_octets || c.renderer == render_string)
+      octets_offsets.push_back(c.offset);
+    columns.push_back(c);
   }
 
-  time_t seconds = nanos / 1000000000ULL;
-  uint64_t fraction = nanos % 1000000000ULL;
+  std::string prefix;
+  std::string header;
+  std::vector<Column> columns;
+  /** Offsets of the views of octetArray and string values. */
+  std::vector<size_t> octets_offsets;
+  size_t record_size;
+  size_t record_width;
+};
 
-  struct tm tm;
-  gmtime_r(&seconds, &tm);
-  print_iso_datetime(os, &tm, fraction);
-}
+/** The formats of the wire templates seen so far, shared by all
+ * inputs.
+ *
+ * Wire templates with the same IEs in the same order share a format,
+ * no matter what their IDs or observation domains, and formats are
+ * numbered in the order in which they are first seen.
+ */
+class SchemaRegistry {
+public:
+  struct Schema {
+    unsigned int number;
+    std::unique_ptr<CSVFormat> format;
+  };
 
-static void
-print_float(std::ostream& os, const IEType* type, void* v) {
-  double d = 0.0;
+  SchemaRegistry() : n_schemas(0) {}
+
+  /** Returns the schema of a wire template, creating it if needed.
+   *
+   * An IE that appears more than once in the template gets only one
+   * column.
+   *
+   * @param wire_template the wire template
+   * @param numbered whether the schema's lines should start with its
+   *   number, and its header line with '#' and its number
+   */
+  const Schema& get(const IETemplate* wire_template, bool numbered) {
+    std::vector<uint64_t> key;
+    std::vector<const InfoElement*> ies;
+
+    for (auto ie = wire_template->begin(); ie != wire_template->end(); ++ie) {
+      uint64_t k = (static_cast<uint64_t>((*ie)->pen()) << 16)
+        | (*ie)->number();
+      if (std::find(key.begin(), key.end(), k) == key.end()) {
+        key.push_back(k);
+        ies.push_back(*ie);
+      }
+    }
 
-  switch(type->number()) {
-  case IEType::kFloat32: d = *static_cast<float*>(v); break;
-  case IEType::kFloat64: d = *static_cast<double*>(v); break;
-  default:
-    /* Can't happen, ignore silently */
-    break;
+    std::lock_guard<std::mutex> lock(mux);
+    Schema& s = schemas[key];
+    if (!s.format) {
+      s.number = n_schemas++;
+      std::string prefix;
+      if (numbered) {
+        char buf[kMaxIntegerChars + 1];
+        prefix.assign(buf, format_unsigned(buf, s.number));
+        prefix += ';';
+      }
+      s.format.reset(new CSVFormat(ies, prefix,
+                                   numbered ? "#" + prefix : std::string()));
+    }
+    return s;
   }
 
-  os << d;
-}
+private:
+  std::mutex mux;
+  std::map<std::vector<uint64_t>, Schema> schemas;
+  unsigned int n_schemas;
+};
 
-static void
-print_bool(std::ostream& os, const IEType* type, void* v) {
-  bool b = *static_cast<uint8_t*>(v) == 0 ? false : true;
+static SchemaRegistry schemas;
 
-  os << (b ? "true" : "false");
-}
+/** Turns records into CSV text on several threads.
+ *
+ * The decoding thread copies the placed values of each record into
+ * the current batch of its output with add().  Full batches are
+ * formatted by a number of formatter threads, in any order, and a
+ * writer thread appends their text to their outputs in the order in
+ * which the batches were filled.  Only a fixed number of batches may
+ * be on their way between the threads, so that a slow output slows
+ * down decoding instead of filling up memory.
+ */
+class FormatPipeline {
+public:
+  /** Number of records in a batch. */
+  static const size_t kBatchRecords = 4096;
+
+  /** Creates a pipeline and starts its threads.
+   *
+   * @param n_formatters the number of formatter threads
+   */
+  FormatPipeline(unsigned int n_formatters)
+    : last_out(0), last_batch(0), next_seq(0), next_output(0),
+      finished(false), max_in_flight(4 * n_formatters), in_flight(0),
+      done_submitting(false) {
+    for (unsigned int i = 0; i < n_formatters; i++)
+      formatters.push_back(std::thread(&FormatPipeline::run_formatter, this));
+    writer = std::thread(&FormatPipeline::run_writer, this);
+  }
 
-static void
-print_csv_header(std::ostream& os) {
-  bool rest = false;
-  for (const char* s : ie_names) {
-    if (rest)
-      os << ';';
-    os << s;
-    rest = true;
-  }
-  os << std::endl;
-}
+  ~FormatPipeline() {
+    finish();
+    for (auto b = free_batches.begin(); b != free_batches.end(); ++b)
+      delete *b;
+  }
+
+  /** Adds a record to the current batch of an output.
+   *
+   * @param format the format of the record
+   * @param out where to write the record's line
+   * @param record the placed values of the record
+   */
+  void add(const CSVFormat& format, OutputBuffer& out,
+           const uint8_t* record) {
+    Batch** b = current_batch(out);
+    if ((*b)->n_records == kBatchRecords) {
+      submit(*b);
+      *b = take_free_batch(out);
+    }
+
+    const size_t size = format.get_record_size();
+    uint8_t* values = (*b)->grow_values(sizeof(const CSVFormat*) + size);
+    const CSVFormat* f = &format;
+    memcpy(values, &f, sizeof f);
+    values += sizeof f;
+    memcpy(values, record, size);
+
+    /* Copy the octets into the batch; the views hold their offsets
+     * there until the batch is formatted. */
+    std::vector<uint8_t>& octets = (*b)->octets;
+    format.for_each_octets(values, [&octets](Octets* o) {
+        size_t offset = octets.size();
+        octets.insert(octets.end(), o->buf, o->buf + o->length);
+        o->buf = reinterpret_cast<const uint8_t*>(offset);
+      });
+    (*b)->n_records++;
+  }
+
+  /** Writes text to an output after all records added so far.
+   *
+   * @param out the output
+   * @param text the text to write
+   */
+  void write(OutputBuffer& out, const std::string& text) {
+    Batch** b = current_batch(out);
+    if ((*b)->n_records > 0) {
+      submit(*b);
+      *b = take_free_batch(out);
+    }
+    (*b)->preamble += text;
+  }
+
+  /** Formats and writes all remaining records and stops the
+   * threads. */
+  void finish() {
+    if (finished)
+      return;
+    finished = true;
+
+    for (auto c = current.begin(); c != current.end(); ++c) {
+      if (c->second->n_records > 0 || !c->second->preamble.empty())
+        submit(c->second);
+      else
+        free_batches.push_back(c->second);
+    }
+    current.clear();
 
-class CSVCollector : public PlacementCollector {
+    {
+      std::lock_guard<std::mutex> lock(mux);
+      done_submitting = true;
+    }
+    work_available.notify_all();
+    for (auto t = formatters.begin(); t != formatters.end(); ++t)
+      t->join();
+    output_available.notify_one();
+    writer.join();
+  }
+
+private:
+  struct Batch {
+    Batch() : out(0), seq(0), n_records(0), values_length(0),
+              text_length(0) {}
+
+    /** Returns room for n more bytes of values. */
+    uint8_t* grow_values(size_t n) {
+      if (values_length + n > values.size())
+        values.resize(std::max(2 * values.size(), values_length + n));
+      uint8_t* ret = values.data() + values_length;
+      values_length += n;
+      return ret;
+    }
+
+    OutputBuffer* out;
+    /** Position of the batch in the output. */
+    uint64_t seq;
+    /** Text to write before the records. */
+    std::string preamble;
+    size_t n_records;
+    /** For each record, its format followed by its placed values. */
+    std::vector<uint8_t> values;
+    size_t values_length;
+    /** The octets of the records' octetArray and string values. */
+    std::vector<uint8_t> octets;
+    std::vector<char> text;
+    size_t text_length;
+  };
+
+  Batch** current_batch(OutputBuffer& out) {
+    if (&out != last_out) {
+      Batch*& b = current[&out];
+      if (b == 0)
+        b = take_free_batch(out);
+      last_out = &out;
+      last_batch = &b;
+    }
+    return last_batch;
+  }
+
+  Batch* take_free_batch(OutputBuffer& out) {
+    Batch* b;
+    {
+      std::unique_lock<std::mutex> lock(mux);
+      batch_free.wait(lock, [this] { return in_flight < max_in_flight; });
+      if (free_batches.empty())
+        b = new Batch();
+      else {
+        b = free_batches.back();
+        free_batches.pop_back();
+      }
+    }
+    b->out = &out;
+    b->preamble.clear();
+    b->n_records = 0;
+    b->values_length = 0;
+    b->octets.clear();
+    return b;
+  }
+
+  void submit(Batch* b) {
+    b->seq = next_seq++;
+    {
+      std::lock_guard<std::mutex> lock(mux);
+      work.push_back(b);
+      in_flight++;
+    }
+    work_available.notify_one();
+  }
+
+  void run_formatter() {
+    while (true) {
+      Batch* b;
+      {
+        std::unique_lock<std::mutex> lock(mux);
+        work_available.wait(lock,
+                            [this] { return !work.empty() || done_submitting; });
+        if (work.empty())
+          return;
+        b = work.front();
+        work.pop_front();
+      }
+
+      const uint8_t* octets = b->octets.data();
+      uint8_t* values = b->values.data();
+      size_t text_length = 0;
+      for (size_t i = 0; i < b->n_records; i++) {
+        const CSVFormat* format;
+        memcpy(&format, values, sizeof format);
+        values += sizeof format;
+
+        format->for_each_octets(values, [octets](Octets* o) {
+            o->buf = octets + reinterpret_cast<size_t>(o->buf);
+          });
+
+        size_t width = format->get_record_width(values);
+        if (text_length + width > b->text.size())
+          b->text.resize(std::max(2 * b->text.size(), text_length + width));
+        char* text = b->text.data() + text_length;
+        text_length += format->format(text, values) - text;
+        values += format->get_record_size();
+      }
+      b->text_length = text_length;
+
+      {
+        std::lock_guard<std::mutex> lock(mux);
+        formatted[b->seq] = b;
+      }
+      output_available.notify_one();
+    }
+  }
+
+  void run_writer() {
+    while (true) {
+      Batch* b;
+      {
+        std::unique_lock<std::mutex> lock(mux);
+        output_available.wait(lock, [this] {
+            return formatted.count(next_output) != 0
+              || (done_submitting && next_output == next_seq);
+          });
+        auto i = formatted.find(next_output);
+        if (i == formatted.end())
+          return;
+        b = i->second;
+        formatted.erase(i);
+      }
+
+      b->out->append(b->preamble.data(), b->preamble.size());
+      b->out->append(b->text.data(), b->text_length);
+      next_output++;
+
+      {
+        std::lock_guard<std::mutex> lock(mux);
+        free_batches.push_back(b);
+        in_flight--;
+      }
+      batch_free.notify_one();
+    }
+  }
+
+  /** The batches being filled by the decoding thread, by output. */
+  std::map<OutputBuffer*, Batch*> current;
+  /** The output of the latest add(), and its entry in current. */
+  OutputBuffer* last_out;
+  Batch** last_batch;
+  /** Sequence number of the next batch to be submitted; written by
+   * the decoding thread only. */
+  uint64_t next_seq;
+  /** Sequence number of the next batch to be written; written by the
+   * writer thread only. */
+  uint64_t next_output;
+  bool finished;
+  const size_t max_in_flight;
+
+  std::vector<std::thread> formatters;
+  std::thread writer;
+
+  std::mutex mux;
+  std::vector<Batch*> free_batches;
+  /** Number of batches submitted and not yet written. */
+  size_t in_flight;
+  std::deque<Batch*> work;
+  std::map<uint64_t, Batch*> formatted;
+  bool done_submitting;
+  std::condition_variable batch_free;
+  std::condition_variable work_available;
+  std::condition_variable output_available;
+};
+
+/** Writes records as CSV lines.
+ *
+ * With a fixed format, only records with the format's IEs are
+ * written.  Without one, records of every wire template are written
+ * with all their IEs, in the schema of their template; the column
+ * table of a schema is built when the schema is first seen, so each
+ * record costs as much as with a fixed format.
+ */
+class CSVCollector : public StaticPlacementCollector<CSVCollector> {
 public:
-  CSVCollector(PlacementCollector::Protocol protocol) 
-    : PlacementCollector(protocol) {
-    InfoModel& model = libfc::InfoModel::instance();
-
-    csv_template = new PlacementTemplate();
-    n_ies = ie_names.size();
-    ie_values = new IEValue[n_ies];
-
-    unsigned int i = 0;
-    for (const char* s : ie_names) {
-      const InfoElement* ie = model.lookupIE(s);
-      if (ie == 0) {
-        std::cerr << "Unknown IE " << s << std::endl;
-        exit(EXIT_FAILURE);
+  /** Creates a collector.
+   *
+   * @param protocol the protocol to collect
+   * @param format the columns to write, or 0 to write all IEs of
+   *   every wire template
+   * @param out where to write the CSV lines; ignored if split_prefix
+   *   is not empty
+   * @param pipeline the pipeline that formats records, or 0 to
+   *   format them in the decoding thread
+   * @param split_prefix if not empty, where to write the lines of
+   *   each schema: to a file named like this, followed by a dot, the
+   *   number of the schema and ".csv"
+   */
+  CSVCollector(PlacementCollector::Protocol protocol,
+               const CSVFormat* format, OutputBuffer* out,
+               FormatPipeline* pipeline, const std::string& split_prefix)
+    : StaticPlacementCollector<CSVCollector>(protocol), out(out),
+      pipeline(pipeline), split_prefix(split_prefix), last_template(0),
+      last_layout(0), fixed(format != 0), output_error(false) {
+    if (fixed)
+      register_placement_template(&add_layout(*format, out)->tmpl);
+  }
+
+  /** Supplies the placement template of a wire template's schema if
+   * there is no fixed format. */
+  const PlacementTemplate* unmatched_template(uint32_t observation_domain,
+                                              uint16_t id,
+                                              const IETemplate* wire_template) {
+    if (fixed)
+      return 0;
+
+    const SchemaRegistry::Schema& s
+      = schemas.get(wire_template, split_prefix.empty());
+    for (auto l = layouts.begin(); l != layouts.end(); ++l)
+      if ((*l)->format == s.format.get())
+        return &(*l)->tmpl;
+
+    OutputBuffer* o = out;
+    std::unique_ptr<OutputBuffer> file;
+    int fd = -1;
+    std::string path;
+    if (!split_prefix.empty()) {
+      char buf[kMaxIntegerChars + 1];
+      path = split_prefix + "." 
+        + std::string(buf, format_unsigned(buf, s.number)) + ".csv";
+      fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0) {
+        std::cerr << "Can't open " << path << ": " << strerror(errno)
+                  << std::endl;
+        output_error = true;
+        return 0;
       }
+      file.reset(new OutputBuffer(fd));
+      o = file.get();
+    }
 
-      ie_values[i].type = ie->ietype();
-      ie_values[i].val = reinterpret_cast<void*>(0xdeadbeefdeadbeefULL);
+    Layout* l = add_layout(*s.format, o);
+    l->file = std::move(file);
+    l->fd = fd;
+    l->path = path;
+    if (pipeline != 0)
+      pipeline->write(*o, s.format->get_header());
+    else
+      o->append(s.format->get_header().data(), s.format->get_header().size());
+    return &l->tmpl;
+  }
 
-      switch (ie_values[i].type->number()) {
-      case IEType::kOctetArray: 
-        std::cerr << "OctetArray not yet supported" << std::endl;
-        exit(EXIT_FAILURE);
-        break;
+  bool end_record(const PlacementTemplate* tmpl) {
+    if (tmpl != last_template) {
+      for (auto l = layouts.begin(); l != layouts.end(); ++l)
+        if (&(*l)->tmpl == tmpl)
+          last_layout = l->get();
+      last_template = tmpl;
+    }
 
-      case IEType::kUnsigned8:
-        ie_values[i].val = new uint8_t[1];
-        ie_values[i].renderer = print_unsigned;
-        break;
+    Layout* l = last_layout;
+    uint8_t* values = reinterpret_cast<uint8_t*>(l->record.data());
+    l->format->set_octets(values, l->octets.get());
 
-      case IEType::kUnsigned16:
-        ie_values[i].val = new uint8_t[2];
-        ie_values[i].renderer = print_unsigned;
-        break;
+    if (pipeline != 0)
+      pipeline->add(*l->format, *l->out, values);
+    else
+      l->out->commit(l->format->format(
+          l->out->reserve(l->format->get_record_width(values)), values));
+    return true;
+  }
 
-      case IEType::kUnsigned32:
-        ie_values[i].val = new uint8_t[4];
-        ie_values[i].renderer = print_unsigned;
-        break;
+  /** Flushes and closes the files written to with a split prefix.
+   * If there is a pipeline, it must have been finished.
+   *
+   * @return true if all files could be opened, written and closed,
+   *   false otherwise
+   */
+  bool close_outputs() {
+    bool ok = !output_error;
+
+    for (auto l = layouts.begin(); l != layouts.end(); ++l) {
+      if ((*l)->fd < 0)
+        continue;
+      if ((*l)->file->flush() != 0) {
+        std::cerr << "Error writing " << (*l)->path << ": "
+                  << strerror(errno) << std::endl;
+        ok = false;
+      }
+      (*l)->file.reset();
+      if (close((*l)->fd) != 0) {
+        std::cerr << "Error closing " << (*l)->path << ": "
+                  << strerror(errno) << std::endl;
+        ok = false;
+      }
+      (*l)->fd = -1;
+    }
+    return ok;
+  }
 
-      case IEType::kUnsigned64:
-        ie_values[i].val = new uint8_t[8];
-        ie_values[i].renderer = print_unsigned;
-        break;
+private:
+  /** Where the records of one format are placed and written to. */
+  struct Layout {
+    const CSVFormat* format;
+    PlacementTemplate tmpl;
+    /** The placed values of the current record. */
+    std::vector<uint64_t> record;
+    /** The placed octetArray and string values of the current
+     * record. */
+    std::unique_ptr<BasicOctetArray[]> octets;
+    OutputBuffer* out;
+    /** The file that out writes to, if it is not shared. */
+    std::unique_ptr<OutputBuffer> file;
+    int fd;
+    std::string path;
+  };
 
-      case IEType::kSigned8:
-        ie_values[i].val = new int8_t[1];
-        ie_values[i].renderer = print_signed;
-        break;
+  Layout* add_layout(const CSVFormat& format, OutputBuffer* o) {
+    Layout* l = new Layout();
+    layouts.push_back(std::unique_ptr<Layout>(l));
+    l->format = &format;
+    l->record.resize((format.get_record_size() + 7) / 8);
+    l->octets.reset(new BasicOctetArray[format.get_n_octets()]);
+    l->out = o;
+    l->fd = -1;
+    format.register_placements(&l->tmpl,
+                               reinterpret_cast<uint8_t*>(l->record.data()),
+                               l->octets.get());
+    return l;
+  }
 
-      case IEType::kSigned16:
-        ie_values[i].val = new int8_t[2];
-        ie_values[i].renderer = print_signed;
-        break;
+  OutputBuffer* out;
+  FormatPipeline* pipeline;
+  std::string split_prefix;
+  std::vector<std::unique_ptr<Layout> > layouts;
+  /** The template of the latest record, and its layout. */
+  const PlacementTemplate* last_template;
+  Layout* last_layout;
+  bool fixed;
+  bool output_error;
+};
 
-      case IEType::kSigned32:
-        ie_values[i].val = new int8_t[4];
-        ie_values[i].renderer = print_signed;
-        break;
+/** Counters by key, in a flat hash table with open addressing.
+ *
+ * Keys are byte strings of a fixed size, here the placed values of
+ * the key IEs.  Every entry holds its key followed by its counters,
+ * so that looking up a key touches a single stretch of memory.  An
+ * entry whose last counter is 0 is empty.
+ */
+class AggregateTable {
+public:
+  /** Creates an empty table.
+   *
+   * @param key_size the size of a key in bytes, a multiple of 8
+   * @param n_counters the number of counters per key, at least 1
+   */
+  AggregateTable(size_t key_size, size_t n_counters)
+    : key_size(key_size), n_counters(n_counters),
+      stride(key_size + n_counters * sizeof(uint64_t)), n_entries(0),
+      mask(kInitialCapacity - 1),
+      slots(kInitialCapacity * stride / sizeof(uint64_t), 0) {
+  }
 
-      case IEType::kSigned64:
-        ie_values[i].val = new int8_t[8];
-        ie_values[i].renderer = print_signed;
-        break;
+  /** Returns the counters of a key, inserting the key with all
+   * counters 0 if it is not there yet.  The caller must then make
+   * the last counter non-zero.
+   *
+   * @param key the key, key_size bytes aligned like a uint64_t
+   */
+  uint64_t* find_or_insert(const uint8_t* key) {
+    if (4 * (n_entries + 1) > 3 * (mask + 1))
+      grow();
+
+    for (size_t i = hash(key) & mask; ; i = (i + 1) & mask) {
+      uint8_t* e = entry(i);
+      uint64_t* counters = reinterpret_cast<uint64_t*>(e + key_size);
+      if (counters[n_counters - 1] == 0) {
+        memcpy(e, key, key_size);
+        n_entries++;
+        return counters;
+      }
+      if (memcmp(e, key, key_size) == 0)
+        return counters;
+    }
+  }
 
-      case IEType::kFloat32:
-        ie_values[i].val = new float[1];
-        ie_values[i].renderer = print_float;
-        break;
+  /** Calls a function with the key and counters of every entry. */
+  template<typename F>
+  void for_each(F f) {
+    for (size_t i = 0; i <= mask; i++) {
+      uint8_t* e = entry(i);
+      uint64_t* counters = reinterpret_cast<uint64_t*>(e + key_size);
+      if (counters[n_counters - 1] != 0)
+        f(e, counters);
+    }
+  }
 
-      case IEType::kFloat64:
-        ie_values[i].val = new double[1];
-        ie_values[i].renderer = print_float;
-        break;
+  /** Returns the number of keys in the table. */
+  size_t size() const { return n_entries; }
 
-      case IEType::kBoolean:
-        ie_values[i].val = new uint8_t[1];
-        ie_values[i].renderer = print_bool;
-        break;
+private:
+  static const size_t kInitialCapacity = 1024;
 
-      case IEType::kMacAddress:
-        ie_values[i].val = new uint8_t[6];
-        ie_values[i].renderer = print_macaddress;
-        break;
+  uint8_t* entry(size_t i) {
+    return reinterpret_cast<uint8_t*>(slots.data()) + i * stride;
+  }
 
-      case IEType::kString:
-        std::cerr << "String not yet supported" << std::endl;
-        exit(EXIT_FAILURE);
-        break;
+  uint64_t hash(const uint8_t* key) const {
+    uint64_t h = 0;
+    for (size_t i = 0; i < key_size; i += sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, key + i, sizeof w);
+      h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    }
+    return h ^ (h >> 29);
+  }
+
+  void grow() {
+    std::vector<uint64_t> old(2 * (mask + 1) * stride / sizeof(uint64_t), 0);
+    old.swap(slots);
+    mask = 2 * mask + 1;
+    n_entries = 0;
+
+    const uint8_t* e = reinterpret_cast<const uint8_t*>(old.data());
+    const uint8_t* end = e + old.size() * sizeof(uint64_t);
+    for (; e < end; e += stride) {
+      const uint64_t* counters
+        = reinterpret_cast<const uint64_t*>(e + key_size);
+      if (counters[n_counters - 1] != 0)
+        memcpy(find_or_insert(e), counters, n_counters * sizeof(uint64_t));
+    }
+  }
+
+  const size_t key_size;
+  const size_t n_counters;
+  const size_t stride;
+  size_t n_entries;
+  size_t mask;
+  std::vector<uint64_t> slots;
+};
+
+/** Sums counters by key and time bin, and writes the sums, for the
+ * keys with the largest sums only if asked to.
+ *
+ * Records need not arrive in time order, but a bin is written and
+ * forgotten once a record for a bin two bins later arrives.  Records
+ * for bins that were written already are counted as late and
+ * otherwise ignored.
+ */
+class Aggregator {
+public:
+  /** Creates an aggregator and writes the header line.
+   *
+   * @param key_format the key columns
+   * @param sum_names the names of the summed columns
+   * @param top how many keys to write per bin, by decreasing first
+   *   sum (or record count, if there are no sums), or 0 for all
+   * @param bin_seconds the length of a time bin, or 0 for a single
+   *   bin spanning all time
+   * @param out where to write the lines
+   */
+  Aggregator(const CSVFormat& key_format,
+             const std::vector<std::string>& sum_names, size_t top,
+             uint64_t bin_seconds, OutputBuffer& out)
+    : key_format(key_format), n_sums(sum_names.size()), top(top),
+      bin_seconds(bin_seconds), out(out), last_bin(0), last_table(0),
+      newest_bin(0), n_written_bins(0), next_open_bin(0), n_late(0) {
+    std::string header = bin_seconds > 0 ? "bin;" : "";
+    const std::string& keys = key_format.get_header();
+    header.append(keys, 0, keys.size() - 1);
+    for (auto s = sum_names.begin(); s != sum_names.end(); ++s)
+      header += ";" + *s;
+    header += ";records\n";
+    out.append(header.data(), header.size());
+  }
+
+  /** Adds a record.
+   *
+   * @param seconds the time of the record, in seconds since the epoch
+   * @param key the placed values of the key IEs
+   * @param sums the values to add to the record's sums
+   */
+  void add(uint64_t seconds, const uint8_t* key, const uint64_t* sums) {
+    uint64_t bin = bin_seconds > 0 ? seconds / bin_seconds : 0;
+
+    if (last_table == 0 || bin != last_bin) {
+      if (n_written_bins > 0 && bin < next_open_bin) {
+        n_late++;
+        return;
+      }
+      std::unique_ptr<AggregateTable>& t = tables[bin];
+      if (!t)
+        t.reset(new AggregateTable(key_format.get_record_size(), n_sums + 1));
+      last_bin = bin;
+      last_table = t.get();
+      if (bin > newest_bin) {
+        newest_bin = bin;
+        /* t stays valid, as it is not written yet. */
+        while (!tables.empty() && tables.begin()->first + 2 <= newest_bin)
+          write_bin(tables.begin());
+      }
+    }
+
+    uint64_t* counters = last_table->find_or_insert(key);
+    for (size_t i = 0; i < n_sums; i++)
+      counters[i] += sums[i];
+    counters[n_sums]++;
+  }
+
+  /** Writes all remaining bins. */
+  void finish() {
+    while (!tables.empty())
+      write_bin(tables.begin());
+    last_table = 0;
+  }
+
+  /** Returns the number of records that arrived after their bin was
+   * written. */
+  uint64_t get_n_late() const { return n_late; }
+
+private:
+  typedef std::map<uint64_t, std::unique_ptr<AggregateTable> > TableMap;
+
+  void write_bin(TableMap::iterator t) {
+    struct Row {
+      const uint8_t* key;
+      const uint64_t* counters;
+    };
+    std::vector<Row> rows;
+    rows.reserve(t->second->size());
+    t->second->for_each([&rows](const uint8_t* key, const uint64_t* counters) {
+        Row r = { key, counters };
+        rows.push_back(r);
+      });
+
+    /* The first sum, or the record count if there are no sums. */
+    auto larger = [](const Row& a, const Row& b) {
+      return a.counters[0] > b.counters[0];
+    };
+    size_t n = rows.size();
+    if (top > 0 && top < n) {
+      std::partial_sort(rows.begin(), rows.begin() + top, rows.end(), larger);
+      n = top;
+    } else
+      std::sort(rows.begin(), rows.end(), larger);
+
+    for (size_t i = 0; i < n; i++) {
+      char* p = out.reserve(kMaxDatetimeChars + 1
+                            + key_format.get_record_width(rows[i].key)
+                            + (n_sums + 1) * (kMaxIntegerChars + 1));
+      if (bin_seconds > 0) {
+        p = format_iso_datetime(p, t->first * bin_seconds * 1000000000ULL);
+        *p++ = ';';
+      }
+      p = key_format.format_fields(p, rows[i].key);
+      for (size_t j = 0; j <= n_sums; j++) {
+        *p++ = ';';
+        p = format_unsigned(p, rows[i].counters[j]);
+      }
+      *p++ = '\n';
+      out.commit(p);
+    }
+
+    next_open_bin = t->first + 1;
+    n_written_bins++;
+    if (last_table == t->second.get())
+      last_table = 0;
+    tables.erase(t);
+  }
 
+  const CSVFormat& key_format;
+  const size_t n_sums;
+  const size_t top;
+  const uint64_t bin_seconds;
+  OutputBuffer& out;
+
+  TableMap tables;
+  /** The bin of the latest record, and its table. */
+  uint64_t last_bin;
+  AggregateTable* last_table;
+  uint64_t newest_bin;
+  uint64_t n_written_bins;
+  /** The earliest bin that has not been written yet. */
+  uint64_t next_open_bin;
+  uint64_t n_late;
+};
+
+/** Feeds records to an Aggregator.
+ *
+ * Only records whose templates have all of the key, sum and time IEs
+ * are counted. */
+class AggregateCollector : public StaticPlacementCollector<AggregateCollector> {
+public:
+  /** Creates a collector.
+   *
+   * @param protocol the protocol to collect
+   * @param key_format the key columns
+   * @param sum_ies the IEs to sum, all unsigned
+   * @param time_ie the IE that gives the time of a record, a
+   *   dateTime IE, or 0 if records are not binned
+   * @param aggregator where to add the records
+   */
+  AggregateCollector(PlacementCollector::Protocol protocol,
+                     const CSVFormat& key_format,
+                     const std::vector<const InfoElement*>& sum_ies,
+                     const InfoElement* time_ie, Aggregator& aggregator)
+    : StaticPlacementCollector<AggregateCollector>(protocol),
+      key_format(key_format), sum_ies(sum_ies), time_ie(time_ie),
+      aggregator(aggregator), key((key_format.get_record_size() + 7) / 8),
+      placed_sums(sum_ies.size()), sums(sum_ies.size()), time(0) {
+    key_format.register_placements(&tmpl,
+                                   reinterpret_cast<uint8_t*>(key.data()), 0);
+    for (size_t i = 0; i < sum_ies.size(); i++)
+      tmpl.register_placement(sum_ies[i], &placed_sums[i], 0);
+    if (time_ie != 0)
+      tmpl.register_placement(time_ie, &time, 0);
+    register_placement_template(&tmpl);
+  }
+
+  bool end_record(const PlacementTemplate* tmpl) {
+    /* Values are placed in their own size; widen them. */
+    for (size_t i = 0; i < sums.size(); i++) {
+      const void* v = &placed_sums[i];
+      switch (sum_ies[i]->ietype()->number()) {
+      case IEType::kUnsigned8: sums[i] = *static_cast<const uint8_t*>(v); break;
+      case IEType::kUnsigned16: sums[i] = *static_cast<const uint16_t*>(v); break;
+      case IEType::kUnsigned32: sums[i] = *static_cast<const uint32_t*>(v); break;
+      default: sums[i] = placed_sums[i]; break;
+      }
+    }
+
+    uint64_t seconds = 0;
+    if (time_ie != 0) {
+      const void* v = &time;
+      switch (time_ie->ietype()->number()) {
       case IEType::kDateTimeSeconds:
-        ie_values[i].val = new uint8_t[4];
-        ie_values[i].renderer = print_datetime;
+        seconds = *static_cast<const uint32_t*>(v);
         break;
+      case IEType::kDateTimeMilliseconds: seconds = time / 1000ULL; break;
+      case IEType::kDateTimeMicroseconds: seconds = time / 1000000ULL; break;
+      case IEType::kDateTimeNanoseconds: seconds = time / 1000000000ULL; break;
+      default: /* Can't happen, ignore silently */ break;
+      }
+    }
 
-      case IEType::kDateTimeMilliseconds:
-        ie_values[i].val = new uint8_t[8];
-        ie_values[i].renderer = print_datetime;
-        break;
+    aggregator.add(seconds, reinterpret_cast<const uint8_t*>(key.data()),
+                   sums.data());
+    return true;
+  }
 
-      case IEType::kDateTimeMicroseconds:
-        ie_values[i].val = new uint8_t[8];
-        ie_values[i].renderer = print_datetime;
-        break;
+private:
+  const CSVFormat& key_format;
+  const std::vector<const InfoElement*>& sum_ies;
+  const InfoElement* time_ie;
+  Aggregator& aggregator;
+  PlacementTemplate tmpl;
+  /** The placed values of the key IEs. */
+  std::vector<uint64_t> key;
+  /** The placed values of the sum IEs, each in its own size. */
+  std::vector<uint64_t> placed_sums;
+  /** The values of the sum IEs, widened. */
+  std::vector<uint64_t> sums;
+  /** The placed value of the time IE. */
+  uint64_t time;
+};
 
-      case IEType::kDateTimeNanoseconds:
-        ie_values[i].val = new uint8_t[8];
-        ie_values[i].renderer = print_datetime;
-        break;
+/** Converts a message stream to CSV.
+ *
+ * @param protocol the protocol of the stream
+ * @param format the columns to write, or 0 to write all IEs
+ * @param is the stream
+ * @param out where to write the CSV lines, without the header of a
+ *   fixed format
+ * @param n_formatters number of threads to format records on
+ * @param split_prefix if not empty, write the lines of each schema
+ *   to a file of its own whose name starts with this, instead of to
+ *   out
+ *
+ * @return true if the whole stream could be converted, false otherwise
+ */
+static bool convert(PlacementCollector::Protocol protocol,
+                    const CSVFormat* format, InputSource& is,
+                    OutputBuffer* out, unsigned int n_formatters,
+                    const std::string& split_prefix = "") {
+  std::unique_ptr<FormatPipeline> pipeline;
+  if (n_formatters > 1)
+    pipeline.reset(new FormatPipeline(n_formatters));
+  CSVCollector cc{protocol, format, out, pipeline.get(), split_prefix};
+
+  std::shared_ptr<ErrorContext> e = cc.collect(is);
+  if (pipeline)
+    pipeline->finish();
+  bool ok = cc.close_outputs();
+  if (e != 0) {
+    std::cerr << e->to_string() << std::endl;
+    return false;
+  }
+  return ok;
+}
 
-      case IEType::kIpv4Address:
-        ie_values[i].val = new uint8_t[4];
-        ie_values[i].renderer = print_ipv4address;
-        break;
+/** Opens and converts one input file.
+ *
+ * @param protocol the protocol of the file
+ * @param format the columns to write, or 0 to write all IEs
+ * @param path the file's name
+ * @param out where to write the CSV lines, without the header of a
+ *   fixed format
+ * @param n_formatters number of threads to format records on
+ * @param split_prefix see convert()
+ *
+ * @return true if the whole file could be converted, false otherwise
+ */
+static bool convert_file(PlacementCollector::Protocol protocol,
+                         const CSVFormat* format, const std::string& path,
+                         OutputBuffer* out, unsigned int n_formatters,
+                         const std::string& split_prefix = "") {
+  WandioInputSource is(path);
+  if (is.get_error() != 0) {
+    std::cerr << is.get_error()->to_string() << std::endl;
+    return false;
+  }
+  return convert(protocol, format, is, out, n_formatters, split_prefix);
+}
 
-      case IEType::kIpv6Address:
-        ie_values[i].val = new uint8_t[16];
-        ie_values[i].renderer = print_ipv6address;
-        break;
+/** Returns the name of the CSV file for an input file in
+ * output_dir, without the ".csv". */
+static std::string output_base(const std::string& input) {
+  std::string::size_type slash = input.rfind('/');
+  std::string base = slash == std::string::npos
+    ? input : input.substr(slash + 1);
+  return output_dir + "/" + base;
+}
 
-      default:
-        /* Can't happen */
-        std::cerr << "Unknown IE type number " << ie->ietype()->number() 
-                  << std::endl;
-        exit(EXIT_FAILURE);
-      }
-      
-      csv_template->register_placement(ie, ie_values[i].val, 0);
+/** Returns the name of the CSV file for an input file in
+ * output_dir. */
+static std::string output_path(const std::string& input) {
+  return output_base(input) + ".csv";
+}
 
-      ++i;
+/** Converts input files in parallel, each to a file of its own in
+ * output_dir, or with split_templates_flag, to one file per schema.
+ *
+ * @param format the columns to write, or 0 to write all IEs
+ *
+ * @return true if all files could be converted, false otherwise
+ */
+static bool convert_to_separate_files(PlacementCollector::Protocol protocol,
+                                      const CSVFormat* format,
+                                      unsigned int n_formatters) {
+  std::set<std::string> paths;
+  for (auto i = inputs.begin(); i != inputs.end(); ++i) {
+    if (!paths.insert(output_path(*i)).second) {
+      std::cerr << "More than one input would be written to "
+                << output_path(*i) << std::endl;
+      return false;
     }
-    register_placement_template(csv_template);
   }
-  
-  std::shared_ptr<ErrorContext>
-      start_placement(const PlacementTemplate* tmpl) {
-    LIBFC_RETURN_OK();
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+
+  for (unsigned int w = 0; w < n_parallel; w++) {
+    workers.push_back(std::thread([&] {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+          if (split_templates_flag) {
+            if (!convert_file(protocol, 0, inputs[i], 0, n_formatters,
+                              output_base(inputs[i])))
+              ok = false;
+            continue;
+          }
+
+          const std::string path = output_path(inputs[i]);
+          int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+          if (fd < 0) {
+            std::cerr << "Can't open " << path << ": " << strerror(errno)
+                      << std::endl;
+            ok = false;
+            continue;
+          }
+
+          bool good;
+          {
+            OutputBuffer out(fd);
+            if (format != 0)
+              out.append(format->get_header().data(),
+                         format->get_header().size());
+            good = convert_file(protocol, format, inputs[i], &out,
+                                n_formatters);
+            if (out.flush() != 0) {
+              std::cerr << "Error writing " << path << ": "
+                        << strerror(errno) << std::endl;
+              good = false;
+            }
+          }
+          if (close(fd) != 0) {
+            std::cerr << "Error closing " << path << ": " << strerror(errno)
+                      << std::endl;
+            good = false;
+          }
+          if (!good)
+            ok = false;
+        }
+      }));
+  }
+
+  for (auto w = workers.begin(); w != workers.end(); ++w)
+    w->join();
+  return ok;
+}
+
+/** Converts input files in parallel and writes their CSV lines to
+ * out, one file after the other, in the order of the inputs.
+ *
+ * Files that are converted while an earlier one is still being
+ * worked on are held in temporary files until it is their turn.
+ *
+ * @param format the columns to write, or 0 to write all IEs
+ *
+ * @return true if all files could be converted, false otherwise
+ */
+static bool convert_to_merged_output(PlacementCollector::Protocol protocol,
+                                     const CSVFormat* format,
+                                     OutputBuffer& out,
+                                     unsigned int n_formatters) {
+  if (n_parallel == 1) {
+    bool ok = true;
+    for (auto i = inputs.begin(); i != inputs.end(); ++i)
+      if (!convert_file(protocol, format, *i, &out, n_formatters))
+        ok = false;
+    return ok;
+  }
+
+  /* Per input: the temporary file, whether it is complete, and
+   * whether it converted without error. */
+  std::vector<FILE*> files(inputs.size(), static_cast<FILE*>(0));
+  std::vector<bool> done(inputs.size(), false);
+  std::vector<bool> good(inputs.size(), false);
+  std::mutex mux;
+  std::condition_variable file_done;
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+
+  for (unsigned int w = 0; w < n_parallel; w++) {
+    workers.push_back(std::thread([&] {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+          FILE* f = tmpfile();
+          bool ok = f != 0;
+          if (f == 0)
+            std::cerr << "Can't create temporary file: " << strerror(errno)
+                      << std::endl;
+          else {
+            OutputBuffer tmp(fileno(f));
+            ok = convert_file(protocol, format, inputs[i], &tmp,
+                              n_formatters);
+            if (tmp.flush() != 0) {
+              std::cerr << "Error writing temporary file: "
+                        << strerror(errno) << std::endl;
+              ok = false;
+            }
+          }
+
+          {
+            std::lock_guard<std::mutex> lock(mux);
+            files[i] = f;
+            done[i] = true;
+            good[i] = ok;
+          }
+          file_done.notify_all();
+        }
+      }));
   }
 
-  std::shared_ptr<ErrorContext>
-      end_placement(const PlacementTemplate* tmpl) {
-    for (unsigned int i = 0; i < n_ies; ++i) {
-      if (i > 0)
-        std::cout << ';';
-      ie_values[i].renderer(std::cout, ie_values[i].type, ie_values[i].val);
+  bool ok = true;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    {
+      std::unique_lock<std::mutex> lock(mux);
+      file_done.wait(lock, [&] { return done[i]; });
+      if (!good[i])
+        ok = false;
     }
-    std::cout << std::endl;
-    LIBFC_RETURN_OK();
+    if (files[i] == 0)
+      continue;
+
+    int fd = fileno(files[i]);
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n;
+    do {
+      static const size_t kChunk = 1 << 16;
+      char* p = out.reserve(kChunk);
+      n = read(fd, p, kChunk);
+      if (n > 0)
+        out.commit(p + n);
+    } while (n > 0 || (n < 0 && errno == EINTR));
+    if (n < 0) {
+      std::cerr << "Error reading temporary file: " << strerror(errno)
+                << std::endl;
+      ok = false;
+    }
+    fclose(files[i]);
   }
 
-  std::shared_ptr<ErrorContext> start_message(
-        uint16_t version,
-        uint16_t length,
-        uint32_t export_time,
-        uint32_t sequence_number,
-        uint32_t observation_domain,
-        uint64_t base_time) {
-    LIBFC_RETURN_OK();
+  for (auto w = workers.begin(); w != workers.end(); ++w)
+    w->join();
+  return ok;
+}
+
+/** Looks up IEs by name.
+ *
+ * @param names the names
+ * @param ies where to add the IEs
+ *
+ * @return true if all names are known, false otherwise
+ */
+static bool lookup_ies(const std::vector<std::string>& names,
+                       std::vector<const InfoElement*>& ies) {
+  InfoModel& model = libfc::InfoModel::instance();
+
+  for (auto s = names.begin(); s != names.end(); ++s) {
+    const InfoElement* ie = model.lookupIE(*s);
+    if (ie == 0) {
+      std::cerr << "Unknown IE " << *s << std::endl;
+      return false;
+    }
+    ies.push_back(ie);
   }
+  return true;
+}
 
-  ~CSVCollector() {
-    delete csv_template;
+/** Sums IEs by key over all inputs, in input order, and writes the
+ * sums to stdout.
+ *
+ * @param protocol the protocol of the inputs
+ *
+ * @return true if all inputs could be read and the sums written,
+ *   false otherwise
+ */
+static bool aggregate(PlacementCollector::Protocol protocol) {
+  std::vector<const InfoElement*> key_ies;
+  std::vector<const InfoElement*> sum_ies;
+  if (!lookup_ies(group_by_names, key_ies) || !lookup_ies(sum_names, sum_ies))
+    return false;
+
+  for (auto ie = key_ies.begin(); ie != key_ies.end(); ++ie) {
+    unsigned int type = (*ie)->ietype()->number();
+    if (type == IEType::kOctetArray || type == IEType::kString) {
+      std::cerr << "Can't group by " << (*ie)->name()
+                << ", which is of variable size" << std::endl;
+      return false;
+    }
+  }
+  for (auto ie = sum_ies.begin(); ie != sum_ies.end(); ++ie) {
+    unsigned int type = (*ie)->ietype()->number();
+    if (type != IEType::kUnsigned8 && type != IEType::kUnsigned16
+        && type != IEType::kUnsigned32 && type != IEType::kUnsigned64) {
+      std::cerr << "Can't sum " << (*ie)->name()
+                << ", which is not an unsigned integer" << std::endl;
+      return false;
+    }
+  }
 
-    for (unsigned int i = 0; i < n_ies; ++i)
-      delete[] static_cast<uint8_t*>(ie_values[i].val);
+  const InfoElement* time_ie = 0;
+  if (bin_seconds > 0) {
+    time_ie = InfoModel::instance().lookupIE(time_ie_name);
+    if (time_ie == 0) {
+      std::cerr << "Unknown IE " << time_ie_name << std::endl;
+      return false;
+    }
+    unsigned int type = time_ie->ietype()->number();
+    if (type != IEType::kDateTimeSeconds
+        && type != IEType::kDateTimeMilliseconds
+        && type != IEType::kDateTimeMicroseconds
+        && type != IEType::kDateTimeNanoseconds) {
+      std::cerr << "Can't take the time from " << time_ie->name()
+                << ", which is not a dateTime" << std::endl;
+      return false;
+    }
+  }
 
-    delete[] ie_values;
+  /* A placement template can place an IE only once. */
+  std::vector<const InfoElement*> all(key_ies);
+  all.insert(all.end(), sum_ies.begin(), sum_ies.end());
+  if (time_ie != 0)
+    all.push_back(time_ie);
+  for (size_t i = 0; i < all.size(); i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (all[i]->matches(*all[j])) {
+        std::cerr << "IE " << all[i]->name() << " is used more than once"
+                  << std::endl;
+        return false;
+      }
+    }
   }
 
-private:
-  struct IEValue {
-    void* val; /* Pointer to fixlen buffer or to varlen object */
-    const IEType* type;
-    void (*renderer)(std::ostream& os, const IEType* type, void* v);
+  CSVFormat key_format(key_ies);
+  OutputBuffer out(1); // 1 == stdout
+  Aggregator aggregator(key_format, sum_names, top_n, bin_seconds, out);
+  bool ok = true;
+
+  auto collect = [&](InputSource& is) {
+    AggregateCollector ac(protocol, key_format, sum_ies, time_ie, aggregator);
+    std::shared_ptr<ErrorContext> e = ac.collect(is);
+    if (e != 0) {
+      std::cerr << e->to_string() << std::endl;
+      ok = false;
+    }
   };
 
-  size_t n_ies;
-  IEValue* ie_values;
-  PlacementTemplate* csv_template;
-};
+  if (inputs.empty()) {
+    FileInputSource is(0, "<stdin>"); // 0 == stdin
+    collect(is);
+  } else {
+    for (auto i = inputs.begin(); i != inputs.end(); ++i) {
+      WandioInputSource is(*i);
+      if (is.get_error() != 0) {
+        std::cerr << is.get_error()->to_string() << std::endl;
+        ok = false;
+      } else
+        collect(is);
+    }
+  }
+
+  aggregator.finish();
+  if (aggregator.get_n_late() > 0)
+    std::cerr << aggregator.get_n_late() << " records arrived after their bin"
+              << " was written and were ignored" << std::endl;
+
+  if (out.flush() != 0) {
+    std::cerr << "Error writing output: " << strerror(errno) << std::endl;
+    return false;
+  }
+  return ok;
+}
 
 int main(int argc, char* const* argv) {
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
@@ -625,18 +2039,15 @@ int main(int argc, char* const* argv) {
 #endif /* _LIBFC_HAVE_LOG4CPLUS_ */
 
   libfc::PlacementCollector::Protocol protocol;
-  InputSource* is = 0;
 
   parse_options(argc, argv);
 
   if (message_version == 10) {
     InfoModel::instance().default5103();
     protocol = libfc::PlacementCollector::ipfix;
-    is = new FileInputSource(0, "<stdin>"); // 0 == stdin
   } else if (message_version == 9) {
     InfoModel::instance().default5103();
     protocol = libfc::PlacementCollector::netflowv9;
-    is = new WandioInputSource(filename);
   } else {
     std::cerr << "Unsupported message version " << message_version << std::endl;
     exit(EXIT_FAILURE);
@@ -649,18 +2060,68 @@ int main(int argc, char* const* argv) {
     return EXIT_SUCCESS;
   }
 
-  std::cout.fill('0');
+  if (all_fields_flag && !ie_names.empty()) {
+    std::cerr << "--all-fields takes no IE names" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (split_templates_flag && (!all_fields_flag || output_dir.empty())) {
+    std::cerr << "--split-templates needs --all-fields and --output-dir"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!group_by_names.empty()) {
+    if (all_fields_flag || !ie_names.empty() || !output_dir.empty()) {
+      std::cerr << "--group-by takes no IE names, --all-fields or"
+                << " --output-dir" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return aggregate(protocol) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (!sum_names.empty() || top_n > 0 || bin_seconds > 0) {
+    std::cerr << "--sum, --top and --bin need --group-by" << std::endl;
+    return EXIT_FAILURE;
+  }
 
-  CSVCollector cc{protocol};
+  std::unique_ptr<CSVFormat> fixed_format;
+  if (!all_fields_flag) {
+    std::vector<const InfoElement*> ies;
+    if (!lookup_ies(std::vector<std::string>(ie_names.begin(), ie_names.end()),
+                    ies))
+      return EXIT_FAILURE;
+    fixed_format.reset(new CSVFormat(ies));
+  }
+  const CSVFormat* format = fixed_format.get();
 
-  print_csv_header(std::cout);
+  /* Files converted in parallel share the formatting threads. */
+  if (n_parallel > inputs.size())
+    n_parallel = std::max<size_t>(1, inputs.size());
+  unsigned int n_formatters = n_threads / n_parallel;
 
-  std::shared_ptr<ErrorContext> e = cc.collect(*is);
-  if (e != 0) {
-    std::cerr << e->to_string() << std::endl;
+  if (!output_dir.empty()) {
+    if (inputs.empty()) {
+      std::cerr << "--output-dir needs input files" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return convert_to_separate_files(protocol, format, n_formatters)
+      ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  OutputBuffer out(1); // 1 == stdout
+  if (format != 0)
+    out.append(format->get_header().data(), format->get_header().size());
+
+  bool ok;
+  if (inputs.empty()) {
+    FileInputSource is(0, "<stdin>"); // 0 == stdin
+    ok = convert(protocol, format, is, &out, n_formatters);
+  } else
+    ok = convert_to_merged_output(protocol, format, out, n_formatters);
+
+  if (out.flush() != 0) {
+    std::cerr << "Error writing output: " << strerror(errno) << std::endl;
     return EXIT_FAILURE;
   }
 
-  delete is;
-  return EXIT_SUCCESS;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,1167 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * The name of ETH Zürich nor the names of other contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+/** Generate synthetic IPFIX or NetFlow v9 traffic.
+ *
+ * This program writes a reproducible stream of IPFIX messages to a
+ * file (or standard output) or sends it to a collector over UDP.  It
+ * uses PlacementExporter, so what it produces is also what libfc's
+ * exporter produces.  With --message-version=9, the messages are
+ * written as NetFlow v9 instead; since v9 has neither
+ * variable-length nor enterprise-specific fields, templates then
+ * consist of fixed-length IANA fields only.
+ *
+ * Templates are drawn at random from a pool of IANA and reverse
+ * (enterprise) information elements.  The number of templates, the
+ * number of fields per template, the fraction of variable-length and
+ * enterprise fields, the length distribution of variable-length
+ * values, the number of observation domains and the rates at which
+ * templates are refreshed and replaced are all configurable.
+ * Addresses, ports and the choice of template for each record can be
+ * drawn uniformly or from a Zipf distribution.  The same seed and
+ * options always give the same records.
+ *
+ * Syntax: ipfixgen [options]
+ *
+ * E.g. ./ipfixgen -n 10000000 -T 16 --varlen-fraction=0.1 \
+ *     --addresses=zipf:1.1 --domains=8 -o synthetic.ipfix
+ *
+ * Or:
+ *
+ * ./ipfixgen -u 127.0.0.1:4739 -r 50000 --template-refresh=100000
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "BasicOctetArray.h"
+#include "Constants.h"
+#include "decode_util.h"
+#include "FileExportDestination.h"
+#include "IEType.h"
+#include "InfoElement.h"
+#include "InfoModel.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "UDPExportDestination.h"
+
+#include "exceptions/ExportError.h"
+
+using namespace libfc;
+
+static uint64_t n_records = 1000000;
+static std::string output_file_name;
+static std::string udp_destination;
+static double rate = 0;
+static uint64_t seed = 1;
+static unsigned int n_templates = 4;
+static unsigned int min_fields = 5;
+static unsigned int max_fields = 20;
+static double varlen_fraction = 0;
+static double enterprise_fraction = 0;
+static std::string varlen_length_spec = "uniform:0:32";
+static unsigned int n_domains = 1;
+static unsigned int domain_run = 64;
+static uint64_t template_refresh = 0;
+static uint64_t template_churn = 0;
+static std::string template_mix_spec = "uniform";
+static unsigned int template_run = 1;
+static std::string address_spec = "uniform";
+static uint32_t n_addresses = 65536;
+static std::string port_spec = "uniform";
+static size_t message_size = 0;
+static int64_t start_time = -1;
+static int message_version = 10;
+static int help_flag = false;
+static int verbose_flag = false;
+
+enum {
+  opt_min_fields = 256,
+  opt_max_fields,
+  opt_varlen_fraction,
+  opt_varlen_length,
+  opt_enterprise_fraction,
+  opt_domains,
+  opt_domain_run,
+  opt_template_refresh,
+  opt_template_churn,
+  opt_template_mix,
+  opt_template_run,
+  opt_addresses,
+  opt_address_count,
+  opt_ports,
+  opt_start_time,
+  opt_message_version,
+};
+
+static uint64_t parse_count(const char* name, const char* arg) {
+  char* end;
+  unsigned long long ret = strtoull(arg, &end, 10);
+  if (*arg == '\0' || *end != '\0' || *arg == '-') {
+    std::cerr << "Bad value for " << name << ": \"" << arg << "\""
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return ret;
+}
+
+static double parse_fraction(const char* name, const char* arg) {
+  char* end;
+  double ret = strtod(arg, &end);
+  if (*arg == '\0' || *end != '\0' || ret < 0 || ret > 1) {
+    std::cerr << name << " must be between 0 and 1, got \"" << arg << "\""
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return ret;
+}
+
+/* Code patterned after http://www.gnu.org/software/libc/
+ * manual/html_node/Getopt-Long-Option-Example.html
+ * #Getopt-Long-Option-Example */
+static void parse_options(int argc, char* const* argv) {
+
+  while (1) {
+    static struct option options[] = {
+      { "help", no_argument, &help_flag, 1 },
+      { "verbose", no_argument, &verbose_flag, 1 },
+      { "records", required_argument, 0, 'n' },
+      { "output", required_argument, 0, 'o' },
+      { "udp", required_argument, 0, 'u' },
+      { "rate", required_argument, 0, 'r' },
+      { "seed", required_argument, 0, 'S' },
+      { "templates", required_argument, 0, 'T' },
+      { "message-size", required_argument, 0, 'm' },
+      { "min-fields", required_argument, 0, opt_min_fields },
+      { "max-fields", required_argument, 0, opt_max_fields },
+      { "varlen-fraction", required_argument, 0, opt_varlen_fraction },
+      { "varlen-length", required_argument, 0, opt_varlen_length },
+      { "enterprise-fraction", required_argument, 0,
+        opt_enterprise_fraction },
+      { "domains", required_argument, 0, opt_domains },
+      { "domain-run", required_argument, 0, opt_domain_run },
+      { "template-refresh", required_argument, 0, opt_template_refresh },
+      { "template-churn", required_argument, 0, opt_template_churn },
+      { "template-mix", required_argument, 0, opt_template_mix },
+      { "template-run", required_argument, 0, opt_template_run },
+      { "addresses", required_argument, 0, opt_addresses },
+      { "address-count", required_argument, 0, opt_address_count },
+      { "ports", required_argument, 0, opt_ports },
+      { "start-time", required_argument, 0, opt_start_time },
+      { "message-version", required_argument, 0, opt_message_version },
+      { 0, 0, 0, 0 },
+    };
+
+    int option_index = 0;
+
+    int c = getopt_long(argc, argv, "hvn:o:u:r:S:T:m:", options,
+                        &option_index);
+
+    if (c == -1)
+      break;
+
+    switch(c) {
+    case 0:
+      break;
+    case 'h':
+      help_flag = true;
+      break;
+    case 'v':
+      verbose_flag = true;
+      break;
+    case 'n':
+      n_records = parse_count("--records", optarg);
+      break;
+    case 'o':
+      output_file_name = optarg;
+      break;
+    case 'u':
+      udp_destination = optarg;
+      break;
+    case 'r':
+      rate = atof(optarg);
+      if (rate < 0) {
+        std::cerr << "Rate must not be negative, got " << optarg << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'S':
+      seed = parse_count("--seed", optarg);
+      break;
+    case 'T':
+      n_templates = parse_count("--templates", optarg);
+      break;
+    case 'm':
+      message_size = parse_count("--message-size", optarg);
+      break;
+    case opt_min_fields:
+      min_fields = parse_count("--min-fields", optarg);
+      break;
+    case opt_max_fields:
+      max_fields = parse_count("--max-fields", optarg);
+      break;
+    case opt_varlen_fraction:
+      varlen_fraction = parse_fraction("--varlen-fraction", optarg);
+      break;
+    case opt_varlen_length:
+      varlen_length_spec = optarg;
+      break;
+    case opt_enterprise_fraction:
+      enterprise_fraction = parse_fraction("--enterprise-fraction", optarg);
+      break;
+    case opt_domains:
+      n_domains = parse_count("--domains", optarg);
+      break;
+    case opt_domain_run:
+      domain_run = parse_count("--domain-run", optarg);
+      break;
+    case opt_template_refresh:
+      template_refresh = parse_count("--template-refresh", optarg);
+      break;
+    case opt_template_churn:
+      template_churn = parse_count("--template-churn", optarg);
+      break;
+    case opt_template_mix:
+      template_mix_spec = optarg;
+      break;
+    case opt_template_run:
+      template_run = parse_count("--template-run", optarg);
+      break;
+    case opt_addresses:
+      address_spec = optarg;
+      break;
+    case opt_address_count:
+      n_addresses = parse_count("--address-count", optarg);
+      break;
+    case opt_ports:
+      port_spec = optarg;
+      break;
+    case opt_start_time:
+      start_time = parse_count("--start-time", optarg);
+      break;
+    case opt_message_version:
+      message_version = parse_count("--message-version", optarg);
+      if (message_version != 9 && message_version != 10) {
+        std::cerr << "--message-version must be 9 or 10, got " << optarg
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      std::cerr << "Unrecognised option character '" << c 
+                << "', aborting" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (n_templates == 0 || n_domains == 0 || domain_run == 0
+      || template_run == 0 || n_addresses == 0) {
+    std::cerr << "--templates, --domains, --domain-run, --template-run and"
+              << " --address-count must be positive" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (min_fields == 0 || min_fields > max_fields) {
+    std::cerr << "Need 0 < --min-fields <= --max-fields" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (n_addresses > (1U << 24)) {
+    std::cerr << "--address-count must be at most " << (1U << 24)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (message_version == 9 && (varlen_fraction > 0
+                               || enterprise_fraction > 0)) {
+    std::cerr << "NetFlow v9 has neither variable-length nor"
+              << " enterprise-specific fields" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (!output_file_name.empty() && !udp_destination.empty()) {
+    std::cerr << "Use either --output or --udp, not both" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void help() {
+  std::cerr << "usage: ./ipfixgen [options]" << std::endl
+            << "Output:" << std::endl
+            << "  -o file|--output=file\twrite to FILE (default: stdout)"
+            << std::endl
+            << "  -u host:port|--udp=host:port\tsend to a collector via UDP"
+            << std::endl
+            << "  --message-version=n\t10 for IPFIX (default) or 9 for"
+            << " NetFlow v9" << std::endl
+            << "  -m n|--message-size=n\tmaximum message size (default"
+            << " 1400 for UDP, 65535 otherwise)" << std::endl
+            << "  -n n|--records=n\tgenerate N records (default 1000000)"
+            << std::endl
+            << "  -r n|--rate=n\tgenerate at most N records per second"
+            << " (default: unlimited)" << std::endl
+            << "  -S n|--seed=n\tseed for the random number generator"
+            << std::endl
+            << "  --start-time=n\ttimestamps start at N seconds since the"
+            << " epoch (default: now)" << std::endl
+            << "Templates:" << std::endl
+            << "  -T n|--templates=n\tnumber of templates in use (default 4)"
+            << std::endl
+            << "  --min-fields=n, --max-fields=n\tfields per template"
+            << " (default 5 to 20)" << std::endl
+            << "  --varlen-fraction=f\tfraction of variable-length fields"
+            << " (IPFIX only)" << std::endl
+            << "  --varlen-length=dist\tlength of variable-length values:"
+            << " fixed:N, uniform:MIN:MAX or exp:MEAN" << std::endl
+            << "  --enterprise-fraction=f\tfraction of enterprise-specific"
+            << " fields (IPFIX only)" << std::endl
+            << "  --template-mix=dist\ttemplate choice: uniform or zipf:S"
+            << std::endl
+            << "  --template-run=n\trecords in a row with the same template"
+            << std::endl
+            << "  --template-refresh=n\tsend all templates again every N"
+            << " records" << std::endl
+            << "  --template-churn=n\treplace a template by a new one every"
+            << " N records" << std::endl
+            << "Domains and values:" << std::endl
+            << "  --domains=n\tnumber of observation domains (default 1)"
+            << std::endl
+            << "  --domain-run=n\trecords in a row from the same domain"
+            << " (default 64)" << std::endl
+            << "  --addresses=dist\taddress choice: uniform or zipf:S"
+            << std::endl
+            << "  --address-count=n\tnumber of distinct addresses"
+            << " (default 65536)" << std::endl
+            << "  --ports=dist\tport choice: uniform or zipf:S" << std::endl
+            << "  -v|--verbose\tprint a summary when done" << std::endl
+            << "  -h|--help\tprint this help text" << std::endl;
+}
+
+/** Small and fast pseudo-random number generator (xorshift64*). */
+class Random {
+public:
+  Random(uint64_t seed)
+    : state(seed == 0 ? 0x9e3779b97f4a7c15ULL : seed) {}
+
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+  }
+
+  uint32_t below(uint32_t n) {
+    return static_cast<uint32_t>(next() % n);
+  }
+
+  /** Returns a number in [0, 1). */
+  double uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  bool chance(double p) {
+    return uniform() < p;
+  }
+
+private:
+  uint64_t state;
+};
+
+static void bad_distribution(const char* what, const std::string& spec) {
+  std::cerr << "Bad " << what << " distribution \"" << spec << "\""
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+/** Draws ranks 0 to n - 1, either uniformly or from a Zipf
+ * distribution.
+ *
+ * With a Zipf distribution of exponent s, rank k is drawn with a
+ * probability proportional to 1/(k + 1)^s, so rank 0 is the most
+ * popular one. */
+class RankDistribution {
+public:
+  /** Creates a distribution from a specification.
+   *
+   * @param what what is being distributed, for error messages
+   * @param spec "uniform" or "zipf:S"
+   * @param n number of ranks
+   */
+  RankDistribution(const char* what, const std::string& spec, uint32_t n)
+    : n(n) {
+    if (spec == "uniform")
+      return;
+    if (spec.compare(0, 5, "zipf:") != 0)
+      bad_distribution(what, spec);
+
+    char* end;
+    double s = strtod(spec.c_str() + 5, &end);
+    if (*end != '\0' || s <= 0)
+      bad_distribution(what, spec);
+
+    cdf.resize(n);
+    double sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+      sum += 1.0/pow(k + 1, s);
+      cdf[k] = sum;
+    }
+    for (uint32_t k = 0; k < n; k++)
+      cdf[k] /= sum;
+  }
+
+  uint32_t draw(Random& r) const {
+    if (cdf.empty())
+      return r.below(n);
+
+    auto i = std::upper_bound(cdf.begin(), cdf.end(), r.uniform());
+    return i == cdf.end() ? n - 1 : i - cdf.begin();
+  }
+
+private:
+  uint32_t n;
+  /** Cumulative probabilities, or empty for a uniform distribution. */
+  std::vector<double> cdf;
+};
+
+/** Distribution of the lengths of variable-length values. */
+class LengthDistribution {
+public:
+  /** Creates a distribution from a specification.
+   *
+   * @param spec "fixed:N", "uniform:MIN:MAX" or "exp:MEAN"
+   */
+  LengthDistribution(const std::string& spec) : a(0), b(0) {
+    char* end = 0;
+    const char* s = spec.c_str();
+
+    if (spec.compare(0, 6, "fixed:") == 0) {
+      kind = fixed;
+      a = strtod(s + 6, &end);
+    } else if (spec.compare(0, 8, "uniform:") == 0) {
+      kind = uniform;
+      a = strtod(s + 8, &end);
+      if (*end == ':')
+        b = strtod(end + 1, &end);
+      else
+        end = 0;
+    } else if (spec.compare(0, 4, "exp:") == 0) {
+      kind = exponential;
+      a = strtod(s + 4, &end);
+    }
+
+    if (end == 0 || *end != '\0' || a < 0 || b < 0 || a > kIpfixVarlen
+        || b > kIpfixVarlen || (kind == uniform && b < a))
+      bad_distribution("length", spec);
+  }
+
+  /** Draws a length, but at most max. */
+  uint16_t draw(Random& r, uint16_t max) const {
+    double l = 0;
+
+    switch (kind) {
+    case fixed: l = a; break;
+    case uniform: l = a + r.below(static_cast<uint32_t>(b - a) + 1); break;
+    case exponential: l = -a * log(1.0 - r.uniform()); break;
+    }
+    return l > max ? max : static_cast<uint16_t>(l);
+  }
+
+private:
+  enum { fixed, uniform, exponential } kind;
+  double a;
+  double b;
+};
+
+/** Information elements that templates are drawn from. */
+struct Pools {
+  std::vector<const InfoElement*> fixlen;
+  std::vector<const InfoElement*> varlen;
+  std::vector<const InfoElement*> enterprise_fixlen;
+  std::vector<const InfoElement*> enterprise_varlen;
+};
+
+static Pools make_pools() {
+  static const char* fixlen_names[] = {
+    "sourceIPv4Address", "destinationIPv4Address", "sourceIPv6Address",
+    "destinationIPv6Address", "sourceTransportPort",
+    "destinationTransportPort", "protocolIdentifier", "octetDeltaCount",
+    "packetDeltaCount", "octetTotalCount", "packetTotalCount",
+    "flowStartMilliseconds", "flowEndMilliseconds", "flowStartSeconds",
+    "flowEndSeconds", "ipClassOfService", "tcpControlBits",
+    "ingressInterface", "egressInterface", "ipNextHopIPv4Address",
+    "ipNextHopIPv6Address", "bgpSourceAsNumber", "bgpDestinationAsNumber",
+    "sourceIPv4PrefixLength", "destinationIPv4PrefixLength",
+    "sourceMacAddress", "destinationMacAddress", "vlanId", "minimumTTL",
+    "maximumTTL", "flowEndReason", "fragmentIdentification",
+    "flowLabelIPv6", "ipVersion", "icmpTypeCodeIPv4", "exporterIPv4Address",
+    "flowDurationMilliseconds", "postOctetDeltaCount",
+    "postPacketDeltaCount", "droppedOctetDeltaCount",
+    "droppedPacketDeltaCount", "samplingProbability", "flowId",
+  };
+  static const char* varlen_names[] = {
+    "interfaceName", "interfaceDescription", "applicationName",
+    "applicationDescription", "wlanSSID", "userName", "applicationId",
+    "mplsLabelStackSection", "ipHeaderPacketSection",
+  };
+
+  const InfoModel& m = InfoModel::instance();
+  Pools ret;
+
+  for (auto n : fixlen_names) {
+    const InfoElement* ie = m.lookupIE(n);
+    assert(ie != 0);
+    ret.fixlen.push_back(ie);
+  }
+  for (auto n : varlen_names) {
+    const InfoElement* ie = m.lookupIE(n);
+    assert(ie != 0);
+    ret.varlen.push_back(ie);
+  }
+
+  /* The enterprise-specific IEs are the reverse IEs of RFC 5103. */
+  for (auto i = ret.fixlen.begin(); i != ret.fixlen.end(); ++i) {
+    const InfoElement* ie = m.lookupIE("reverse" + (*i)->name());
+    if (ie != 0 && ie->pen() != 0)
+      ret.enterprise_fixlen.push_back(ie);
+  }
+  for (auto i = ret.varlen.begin(); i != ret.varlen.end(); ++i) {
+    const InfoElement* ie = m.lookupIE("reverse" + (*i)->name());
+    if (ie != 0 && ie->pen() != 0)
+      ret.enterprise_varlen.push_back(ie);
+  }
+
+  return ret;
+}
+
+/** Memory for one field of a generated template. */
+struct Slot {
+  const InfoElement* ie;
+  union {
+    uint64_t align;
+    bool flag;
+    uint8_t bytes[16];
+  };
+  BasicOctetArray octets;
+};
+
+/** A template together with the memory it places values from. */
+struct GeneratedTemplate {
+  ~GeneratedTemplate() {
+    for (auto i = slots.begin(); i != slots.end(); ++i)
+      delete *i;
+  }
+
+  PlacementTemplate placement;
+  std::vector<Slot*> slots;
+
+  /** Number of variable-length fields. */
+  unsigned int n_varlen;
+
+  /** Upper bound for the length of each variable-length value, so
+   * that a record always fits into a message. */
+  uint16_t max_varlen;
+};
+
+static bool is_varlen(const InfoElement* ie) {
+  return ie->len() == kIpfixVarlen;
+}
+
+/** Draws a new template. */
+static GeneratedTemplate* make_template(Random& r, const Pools& pools,
+                                        size_t max_message_size) {
+  GeneratedTemplate* ret = new GeneratedTemplate();
+  std::set<const InfoElement*> used;
+  unsigned int n_fields = min_fields + r.below(max_fields - min_fields + 1);
+  size_t fixlen_size = 0;
+  size_t template_size = 2*sizeof(uint16_t);
+
+  ret->n_varlen = 0;
+
+  for (unsigned int i = 0; i < n_fields; i++) {
+    bool varlen = r.chance(varlen_fraction);
+    bool enterprise = r.chance(enterprise_fraction);
+    const std::vector<const InfoElement*>* pool
+      = enterprise ? (varlen ? &pools.enterprise_varlen
+                             : &pools.enterprise_fixlen)
+                   : (varlen ? &pools.varlen : &pools.fixlen);
+
+    /* Fall back to other pools once a pool is used up, but give up
+     * when all of them are. */
+    const InfoElement* ie = 0;
+    const std::vector<const InfoElement*>* fallbacks[] = {
+      pool, &pools.fixlen, &pools.varlen, &pools.enterprise_fixlen,
+      &pools.enterprise_varlen,
+    };
+    for (auto p : fallbacks) {
+      std::vector<const InfoElement*> unused;
+      for (auto j = p->begin(); j != p->end(); ++j)
+        if (used.find(*j) == used.end())
+          unused.push_back(*j);
+      if (!unused.empty()) {
+        ie = unused[r.below(unused.size())];
+        break;
+      }
+    }
+    if (ie == 0)
+      break;
+
+    used.insert(ie);
+
+    Slot* slot = new Slot();
+    slot->ie = ie;
+    memset(slot->bytes, 0, sizeof(slot->bytes));
+    ret->slots.push_back(slot);
+
+    unsigned int type = ie->ietype()->number();
+    void* p = type == IEType::kOctetArray || type == IEType::kString
+      ? static_cast<void*>(&slot->octets)
+      : static_cast<void*>(slot->bytes);
+    ret->placement.register_placement(ie, p, ie->len());
+
+    template_size += 2*sizeof(uint16_t) + (ie->pen() == 0 ? 0 : sizeof(uint32_t));
+    if (is_varlen(ie))
+      ret->n_varlen++;
+    else
+      fixlen_size += ie->len();
+  }
+
+  /* The first record of a template in a message may have to share it
+   * with the template itself.  Variable-length values of up to 254
+   * octets have a 1-octet length prefix, longer ones a 3-octet
+   * prefix. */
+  ret->max_varlen = 0;
+  if (ret->n_varlen > 0) {
+    size_t overhead = kIpfixMessageHeaderLen + 2*kIpfixSetHeaderLen
+      + template_size + fixlen_size;
+    if (overhead < max_message_size) {
+      size_t room = (max_message_size - overhead) / ret->n_varlen;
+      if (room > 3)
+        ret->max_varlen = room - 3;
+    }
+  }
+
+  return ret;
+}
+
+static const uint32_t kSecondsFrom1900To1970 = 2208988800U;
+
+/** A flow, from which the values of a record are taken. */
+struct Flow {
+  uint32_t source_rank;
+  uint32_t destination_rank;
+  uint16_t source_port;
+  uint16_t destination_port;
+  uint8_t protocol;
+  uint64_t packets;
+  uint64_t octets;
+  /** Start and end, in microseconds since the epoch. */
+  uint64_t start;
+  uint64_t end;
+};
+
+/** Well-known ports, in order of popularity for the Zipf distribution
+ * of ports. */
+static const uint16_t kPopularPorts[] = {
+  443, 80, 53, 123, 22, 25, 993, 8080, 445, 3389, 587, 8443, 110, 143,
+  5222, 1935, 3478, 5060, 21, 23,
+};
+static const unsigned int kNPopularPorts
+  = sizeof(kPopularPorts)/sizeof(kPopularPorts[0]);
+
+static uint16_t port_for_rank(uint32_t rank) {
+  if (rank < kNPopularPorts)
+    return kPopularPorts[rank];
+  return static_cast<uint16_t>(1024 + (rank - kNPopularPorts) % 64512);
+}
+
+/** Maps an address rank to 24 bits, scattering neighbouring ranks.
+ * Multiplication by an odd number is a bijection modulo 2^24. */
+static uint32_t address_bits(uint32_t rank) {
+  return (rank * 0x9e3779b1U) & 0xffffff;
+}
+
+static void make_flow(Random& r, const RankDistribution& addresses,
+                      const RankDistribution& ports, uint64_t now,
+                      Flow* f) {
+  f->source_rank = addresses.draw(r);
+  f->destination_rank = addresses.draw(r);
+  f->source_port = 32768 + r.below(28232);
+  f->destination_port = port_for_rank(ports.draw(r));
+
+  uint32_t p = r.below(100);
+  f->protocol = p < 70 ? 6 : p < 95 ? 17 : 1;
+
+  /* Flow sizes are heavy-tailed; use a Pareto distribution with
+   * shape 1.2. */
+  f->packets = 1 + static_cast<uint64_t>(
+    pow(1.0 - r.uniform(), -1/1.2) - 1);
+  f->octets = f->packets * (40 + r.below(1461));
+
+  f->end = now - r.below(1000000);
+  f->start = f->end - std::min<uint64_t>(
+    f->packets * (1 + r.below(100000)), 3600000000ULL);
+}
+
+static bool contains(const std::string& s, const char* what) {
+  return s.find(what) != std::string::npos;
+}
+
+static void put_unsigned(Slot* slot, uint64_t value) {
+  switch (slot->ie->len()) {
+  case 1: { uint8_t v = value; memcpy(slot->bytes, &v, sizeof v); } break;
+  case 2: { uint16_t v = value; memcpy(slot->bytes, &v, sizeof v); } break;
+  case 4: { uint32_t v = value; memcpy(slot->bytes, &v, sizeof v); } break;
+  case 8: memcpy(slot->bytes, &value, sizeof value); break;
+  default: assert(0 == "unsupported integer length"); break;
+  }
+}
+
+/** Fills a slot with a value taken from a flow. */
+static void fill_slot(Slot* slot, const Flow& f, Random& r,
+                      const LengthDistribution& lengths, uint16_t max_varlen) {
+  const std::string& name = slot->ie->name();
+  const bool source = contains(name, "source") || contains(name, "Source")
+    || contains(name, "exporter");
+
+  switch (slot->ie->ietype()->number()) {
+  case IEType::kIpv4Address: {
+    uint32_t rank = source ? f.source_rank : f.destination_rank;
+    put_unsigned(slot, 0x0a000000 | address_bits(rank)); /* 10/8 */
+    break;
+  }
+
+  case IEType::kIpv6Address: {
+    uint32_t rank = source ? f.source_rank : f.destination_rank;
+    static const uint8_t prefix[] = { 0x20, 0x01, 0x0d, 0xb8 };
+    uint32_t bits = address_bits(rank);
+
+    memset(slot->bytes, 0, sizeof(slot->bytes));
+    memcpy(slot->bytes, prefix, sizeof(prefix));
+    slot->bytes[13] = bits >> 16;
+    slot->bytes[14] = bits >> 8;
+    slot->bytes[15] = bits;
+    break;
+  }
+
+  case IEType::kDateTimeSeconds: {
+    uint64_t t = contains(name, "Start") ? f.start : f.end;
+    put_unsigned(slot, t/1000000);
+    break;
+  }
+
+  case IEType::kDateTimeMilliseconds: {
+    uint64_t t = contains(name, "Start") ? f.start : f.end;
+    put_unsigned(slot, t/1000);
+    break;
+  }
+
+  case IEType::kDateTimeMicroseconds:
+  case IEType::kDateTimeNanoseconds: {
+    /* NTP timestamp; see RFC 7011, Section 6.1.9. */
+    uint64_t t = contains(name, "Start") ? f.start : f.end;
+    uint64_t ntp = ((t/1000000 + kSecondsFrom1900To1970) << 32)
+      | (((t % 1000000) << 32)/1000000);
+    put_unsigned(slot, ntp);
+    break;
+  }
+
+  case IEType::kUnsigned8:
+  case IEType::kUnsigned16:
+  case IEType::kUnsigned32:
+  case IEType::kUnsigned64:
+    if (contains(name, "Port"))
+      put_unsigned(slot, source ? f.source_port : f.destination_port);
+    else if (contains(name, "ctetDeltaCount")
+             || contains(name, "ctetTotalCount"))
+      put_unsigned(slot, f.octets);
+    else if (contains(name, "acketDeltaCount")
+             || contains(name, "acketTotalCount"))
+      put_unsigned(slot, f.packets);
+    else if (contains(name, "protocolIdentifier"))
+      put_unsigned(slot, f.protocol);
+    else if (contains(name, "ipVersion"))
+      put_unsigned(slot, 4);
+    else if (contains(name, "Duration"))
+      put_unsigned(slot, (f.end - f.start)/1000);
+    else if (contains(name, "PrefixLength"))
+      put_unsigned(slot, 8 + r.below(25));
+    else
+      put_unsigned(slot, r.next());
+    break;
+
+  case IEType::kSigned8:
+  case IEType::kSigned16:
+  case IEType::kSigned32:
+  case IEType::kSigned64:
+    put_unsigned(slot, r.next());
+    break;
+
+  case IEType::kFloat32: {
+    float v = r.uniform();
+    memcpy(slot->bytes, &v, sizeof v);
+    break;
+  }
+
+  case IEType::kFloat64: {
+    double v = r.uniform();
+    memcpy(slot->bytes, &v, sizeof v);
+    break;
+  }
+
+  case IEType::kBoolean:
+    slot->flag = r.chance(0.5);
+    break;
+
+  case IEType::kMacAddress: {
+    uint64_t v = r.next();
+    memcpy(slot->bytes, &v, 6);
+    slot->bytes[0] &= 0xfe; /* Unicast */
+    break;
+  }
+
+  case IEType::kString:
+  case IEType::kOctetArray: {
+    uint8_t buf[kMaxMessageLen];
+    uint16_t length = lengths.draw(r, max_varlen);
+    bool printable = slot->ie->ietype()->number() == IEType::kString;
+
+    for (uint16_t i = 0; i < length; i++) {
+      uint8_t c = r.next() >> 56;
+      buf[i] = printable ? 'a' + c % 26 : c;
+    }
+    slot->octets.copy_content(buf, length);
+    break;
+  }
+
+  default:
+    assert(0 == "unknown IE type");
+    break;
+  }
+}
+
+static void fill(GeneratedTemplate* t, const Flow& f, Random& r,
+                 const LengthDistribution& lengths) {
+  for (auto i = t->slots.begin(); i != t->slots.end(); ++i)
+    fill_slot(*i, f, r, lengths, t->max_varlen);
+}
+
+static int open_udp(const std::string& destination,
+                    struct sockaddr_storage* sa, socklen_t* sa_len) {
+  std::string::size_type colon = destination.rfind(':');
+  if (colon == std::string::npos) {
+    std::cerr << "UDP destination must be host:port, got \""
+              << destination << "\"" << std::endl;
+    return -1;
+  }
+
+  std::string host = destination.substr(0, colon);
+  std::string port = destination.substr(colon + 1);
+  if (host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+    host = host.substr(1, host.size() - 2);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  struct addrinfo* ai;
+  int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &ai);
+  if (error != 0) {
+    std::cerr << destination << ": " << gai_strerror(error) << std::endl;
+    return -1;
+  }
+
+  int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if (fd < 0)
+    perror("socket");
+  else {
+    memcpy(sa, ai->ai_addr, ai->ai_addrlen);
+    *sa_len = ai->ai_addrlen;
+  }
+  freeaddrinfo(ai);
+  return fd;
+}
+
+static void put16(std::vector<uint8_t>& buf, uint16_t v) {
+  buf.push_back(static_cast<uint8_t>(v >> 8));
+  buf.push_back(static_cast<uint8_t>(v));
+}
+
+static void put32(std::vector<uint8_t>& buf, uint32_t v) {
+  put16(buf, static_cast<uint16_t>(v >> 16));
+  put16(buf, static_cast<uint16_t>(v));
+}
+
+/** Writes the IPFIX messages of PlacementExporter as NetFlow v9.
+ *
+ * As long as there are no variable-length or enterprise-specific
+ * fields, IPFIX and v9 differ only in framing: the v9 message header
+ * is four octets longer and counts records instead of octets, and
+ * template sets have another set ID.  Template records and data
+ * records are copied unchanged. */
+class NetFlowV9Destination : public ExportDestination {
+public:
+  /** Creates a v9 destination that writes to, and takes over, d. */
+  NetFlowV9Destination(ExportDestination* d)
+    : d(d), boot(std::chrono::steady_clock::now()) {
+  }
+
+  ssize_t writev(const std::vector<::iovec>& iovecs) {
+    in.clear();
+    for (auto i = iovecs.begin(); i != iovecs.end(); ++i) {
+      const uint8_t* base = static_cast<const uint8_t*>(i->iov_base);
+      in.insert(in.end(), base, base + i->iov_len);
+    }
+    if (in.size() < kIpfixMessageHeaderLen)
+      return -1;
+
+    const uint8_t* p = in.data();
+    uint32_t domain = decode_uint32(p + 12);
+    uint32_t uptime = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - boot).count();
+
+    out.clear();
+    put16(out, kV9Version);
+    put16(out, 0); /* Count, patched below */
+    put32(out, uptime);
+    put32(out, decode_uint32(p + 4)); /* Export time */
+    put32(out, sequence_numbers[domain]++);
+    put32(out, domain);
+
+    uint16_t count = 0;
+    for (size_t off = kIpfixMessageHeaderLen;
+         off + kIpfixSetHeaderLen <= in.size(); ) {
+      uint16_t id = decode_uint16(p + off);
+      uint16_t len = decode_uint16(p + off + kIpfixSetLenOffset);
+      if (len < kIpfixSetHeaderLen || off + len > in.size())
+        return -1;
+
+      const uint8_t* body = p + off + kIpfixSetHeaderLen;
+      size_t body_len = len - kIpfixSetHeaderLen;
+
+      if (id == kIpfixTemplateSetID) {
+        id = kV9TemplateSetID;
+        for (size_t t = 0; t + 4 <= body_len; count++) {
+          uint16_t n_fields = decode_uint16(body + t + 2);
+          size_t record_len = 0;
+          for (uint16_t k = 0; k < n_fields; k++)
+            record_len += decode_uint16(body + t + 4 + 4*k + 2);
+          record_lengths[key(domain, decode_uint16(body + t))] = record_len;
+          t += 4 + 4*n_fields;
+        }
+      } else if (id >= kMinDataSetId) {
+        auto r = record_lengths.find(key(domain, id));
+        if (r != record_lengths.end() && r->second > 0)
+          count += body_len / r->second;
+      } else
+        return -1;
+
+      put16(out, id);
+      put16(out, len);
+      out.insert(out.end(), body, body + body_len);
+      off += len;
+    }
+
+    out[2] = static_cast<uint8_t>(count >> 8);
+    out[3] = static_cast<uint8_t>(count);
+
+    ::iovec v;
+    v.iov_base = out.data();
+    v.iov_len = out.size();
+    return d->writev(std::vector<::iovec>(1, v));
+  }
+
+  int flush() {
+    return d->flush();
+  }
+
+  bool is_connectionless() const {
+    return d->is_connectionless();
+  }
+
+  size_t preferred_maximum_message_size() const {
+    return d->preferred_maximum_message_size()
+      - (kV9MessageHeaderLen - kIpfixMessageHeaderLen);
+  }
+
+private:
+  static uint64_t key(uint32_t domain, uint16_t template_id) {
+    return (static_cast<uint64_t>(domain) << 16) | template_id;
+  }
+
+  std::unique_ptr<ExportDestination> d;
+  std::chrono::steady_clock::time_point boot;
+  /** Next v9 sequence number, which counts messages, per source ID. */
+  std::map<uint32_t, uint32_t> sequence_numbers;
+  /** Data record length per domain and template ID. */
+  std::map<uint64_t, size_t> record_lengths;
+  std::vector<uint8_t> in;
+  std::vector<uint8_t> out;
+};
+
+int main(int argc, char* const* argv) {
+  parse_options(argc, argv);
+
+  if (help_flag) {
+    help();
+    return EXIT_SUCCESS;
+  }
+
+  InfoModel::instance().default5103();
+
+  int fd;
+  std::unique_ptr<ExportDestination> d;
+
+  if (!udp_destination.empty()) {
+    struct sockaddr_storage sa;
+    socklen_t sa_len;
+
+    fd = open_udp(udp_destination, &sa, &sa_len);
+    if (fd < 0)
+      return EXIT_FAILURE;
+    if (message_size == 0)
+      message_size = 1400;
+    d.reset(new UDPExportDestination(reinterpret_cast<struct sockaddr*>(&sa),
+                                     sa_len, fd, message_size));
+  } else {
+    if (output_file_name.empty())
+      fd = 1;
+    else {
+      fd = open(output_file_name.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+      if (fd < 0) {
+        perror(output_file_name.c_str());
+        return EXIT_FAILURE;
+      }
+    }
+    d.reset(new FileExportDestination(fd, message_size));
+  }
+  if (message_version == 9)
+    d.reset(new NetFlowV9Destination(d.release()));
+
+  const size_t max_message_size = d->preferred_maximum_message_size();
+  if (max_message_size < 512) {
+    std::cerr << "Message size must be at least 512" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Random r(seed);
+  Pools pools = make_pools();
+  if (message_version == 9) {
+    /* Keep templates from falling back to fields that v9 lacks. */
+    pools.varlen.clear();
+    pools.enterprise_fixlen.clear();
+    pools.enterprise_varlen.clear();
+  }
+  LengthDistribution lengths(varlen_length_spec);
+  RankDistribution template_mix("template mix", template_mix_spec,
+                                n_templates);
+  RankDistribution addresses("address", address_spec, n_addresses);
+  RankDistribution ports("port", port_spec, 65536);
+
+  std::vector<GeneratedTemplate*> templates;
+  for (unsigned int i = 0; i < n_templates; i++)
+    templates.push_back(make_template(r, pools, max_message_size));
+
+  /* Replaced templates must live as long as the exporter, which
+   * remembers them by address. */
+  std::vector<GeneratedTemplate*> retired;
+
+  uint64_t now = 1000000ULL * (start_time >= 0 ? start_time : time(0));
+  const uint64_t tick = rate > 0 ? 1e6/rate : 10;
+
+  std::chrono::steady_clock::time_point wall_start
+    = std::chrono::steady_clock::now();
+  int ret = EXIT_SUCCESS;
+  uint64_t i = 0;
+
+  try {
+    PlacementExporter e(*d, 1);
+    size_t t = 0;
+
+    for (i = 0; i < n_records; i++) {
+      if (i % domain_run == 0 && n_domains > 1)
+        e.change_observation_domain(1 + r.below(n_domains));
+      if (template_refresh > 0 && i > 0 && i % template_refresh == 0)
+        e.refresh_templates();
+      if (template_churn > 0 && i > 0 && i % template_churn == 0) {
+        uint32_t k = r.below(templates.size());
+        retired.push_back(templates[k]);
+        templates[k] = make_template(r, pools, max_message_size);
+      }
+      if (i % template_run == 0)
+        t = template_mix.draw(r);
+
+      Flow f;
+      make_flow(r, addresses, ports, now, &f);
+      fill(templates[t], f, r, lengths);
+      e.place_values(&templates[t]->placement);
+
+      now += tick;
+
+      if (rate > 0 && i % 64 == 63)
+        std::this_thread::sleep_until(
+          wall_start + std::chrono::microseconds(
+            static_cast<uint64_t>((i + 1)*1e6/rate)));
+    }
+  } catch (ExportError& e) {
+    std::cerr << "After " << i << " records: " << e.what() << std::endl;
+    ret = EXIT_FAILURE;
+  }
+
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - wall_start).count();
+
+  if (verbose_flag)
+    std::cerr << i << " records, "
+              << templates.size() + retired.size() << " templates in "
+              << seconds << "s (" << i/seconds << " records/s)"
+              << std::endl;
+
+  for (auto j = templates.begin(); j != templates.end(); ++j)
+    delete *j;
+  for (auto j = retired.begin(); j != retired.end(); ++j)
+    delete *j;
+
+  if (fd != 1)
+    close(fd);
+
+  return ret;
+}
@@ -31,14 +31,23 @@
 
 namespace libfc {
 
-BufferInputSource::BufferInputSource(const uint8_t *buf, size_t len)
-    : buf(new uint8_t[len]), len(len), off(0), message_offset(0),
+BufferInputSource::BufferInputSource(const uint8_t *buf, size_t len,
+                                     bool copy, const char *name)
+    : buf(buf), owned_buf(0), len(len), off(0), message_offset(0),
       current_offset(0), name(0) {
-  memcpy(this->buf, buf, len);
+  if (copy) {
+    owned_buf = new uint8_t[len];
+    memcpy(owned_buf, buf, len);
+    this->buf = owned_buf;
+  }
+  if (name != 0) {
+    this->name = new char[strlen(name) + 1];
+    std::strcpy(const_cast<char *>(this->name), name);
+  }
 }
 
 BufferInputSource::~BufferInputSource() {
-  delete[] buf;
+  delete[] owned_buf;
   delete[] const_cast<char *>(name);
 }
 
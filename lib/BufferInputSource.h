@@ -43,8 +43,15 @@ public:
    *
    * @param buf the buffer containing one or more IPFIX messages
    * @param len the length of the buffer in bytes
+   * @param copy if true, the input source works on a copy of the
+   *   buffer; if false, it reads the caller's buffer directly, which
+   *   must then stay unchanged for the lifetime of the input source
+   * @param name the name by which this input source is known to
+   *   diagnostics and sequence tracking, or 0 for a name made up from
+   *   the buffer's address
    */
-  BufferInputSource(const uint8_t *buf, size_t len);
+  BufferInputSource(const uint8_t *buf, size_t len, bool copy = true,
+                    const char *name = 0);
   ~BufferInputSource();
 
   ssize_t read(uint8_t *buf, uint16_t len);
@@ -56,7 +63,9 @@ public:
   bool can_peek() const;
 
 private:
-  uint8_t *buf;
+  const uint8_t *buf;
+  /** Our copy of the buffer, or 0 if we don't own it. */
+  uint8_t *owned_buf;
   size_t len;
   size_t off;
   size_t message_offset;
@@ -83,7 +83,11 @@ std::string DecodePlan::Decision::to_string() const {
 
 DecodePlan::DecodePlan(const libfc::PlacementTemplate *placement_template,
                        const libfc::IETemplate *wire_template)
-    : plan(wire_template->size())
+    : codec(placement_template->get_codec() != 0 &&
+                    placement_template->get_codec()->can_decode(wire_template)
+                ? placement_template->get_codec()
+                : 0),
+      plan(wire_template->size())
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
       ,
       logger(log4cplus::Logger::getInstance(LOG4CPLUS_TEXT("DecodePlan")))
@@ -231,8 +235,8 @@ DecodePlan::DecodePlan(const libfc::PlacementTemplate *placement_template,
         break;
 
       case libfc::IEType::kFloat64:
-        assert((*ie)->len() == sizeof(float) || d.length == sizeof(double));
         d.length = (*ie)->len();
+        assert(d.length == sizeof(float) || d.length == sizeof(double));
         if (d.length == sizeof(float))
           d.type = transfer_float_into_double_maybe_endianness;
         else
@@ -448,6 +452,9 @@ static void hexdump(log4cplus::Logger &logger, const uint8_t *buf,
 uint16_t DecodePlan::execute(const uint8_t *buf, uint16_t length) {
   LOG4CPLUS_TRACE(logger, "ENTER DecodePlan::execute");
 
+  if (codec != 0)
+    return codec->decode(buf, length);
+
   const uint8_t *cur = buf;
   const uint8_t *buf_end = buf + length;
 
@@ -119,6 +119,10 @@ public:
   uint16_t execute(const uint8_t *buf, uint16_t length);
 
 private:
+  /** The placement template's codec, if it can decode records with
+   * this wire template; execute() then leaves the decoding to it. */
+  const RecordCodec *codec;
+
   struct Decision {
     /** The decision type. */
     enum decision_type_t {
@@ -187,6 +191,6 @@ private:
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
 };
 
-#endif /* _LIBFC_DECODEPLAN_H_ */
-
 } /* namespace libfc */
+
+#endif /* _LIBFC_DECODEPLAN_H_ */
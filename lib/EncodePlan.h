@@ -0,0 +1,165 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Plans for encoding data records
+ */
+
+#ifndef _LIBFC_ENCODEPLAN_H_
+#define _LIBFC_ENCODEPLAN_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+#include <log4cplus/logger.h>
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+
+#include "PlacementTemplate.h"
+
+namespace libfc {
+
+/** Encode plans describe how a data record is to be encoded.
+ *
+ * Decoding a data record means determining, for each data field,
+ *
+ *   - if the data's endianness must be converted;
+ *   - if the data needs to be transformed in any other way (for
+ *     example, boolean values are encoded with 1 meaning true and 2
+ *     meaning false(!!), or reduced-length encoding of floating-point
+ *     values means that doubles are really transferred as floats); and
+ *   - for variable-length data, what the length of the encoded value
+ *     is.
+ *
+ * See also the documentation for DecodePlan in DecodePlan.h.
+ */
+class EncodePlan {
+public:
+  /** Creates an encoding plan from a placement template.
+   *
+   * @param placement_template a placement template from which we
+   *   encode a data record.
+   */
+  EncodePlan(const libfc::PlacementTemplate *placementTemplate);
+
+  /** Executes this plan.
+   *
+   * @param buf the buffer where to store the encoded values
+   * @param offset the offset at which to store the values
+   * @param length the total length of the buffer
+   *
+   * @return the number of encoded octets
+   */
+  uint16_t execute(uint8_t *buf, uint16_t offset, uint16_t length);
+
+private:
+  /** The placement template's codec, which does the encoding if
+   * there is one. */
+  const RecordCodec *codec;
+
+  struct Decision {
+    /** The decision type. */
+    enum decision_type_t {
+      /** Value for an uninitialised decision type. */
+      encode_none,
+
+      /** Encode a boolean.  I'm repeating here the comment I made in
+       * the corresponding declaration for transfer_boolean in
+       * DataSetDecoder.cpp, because it still gets my blood up:
+       *
+       * Someone found it amusing in RFC 2579 to encode the boolean
+       * values true and false as 1 and 2, respectively [sic!].  And
+       * someone else found it amusing to standardise this behaviour
+       * in RFC 5101 too.  This is of course wrong, since it disallows
+       * entirely sensible operations like `plus' for "or", `times'
+       * for "and" and `less than' for implication (which is what you
+       * get when you make false less than true).
+       *
+       * This is why we can't subsume the encoding of booleans (which
+       * are fixlen-encoded values of length 1) under
+       * encode_basic_no_endianness below. */
+      encode_boolean,
+
+      /** Encode a basic type (fixlen) with no endianness conversion. */
+      encode_fixlen,
+
+      /** Encode a basic type (fixlen) with endianness conversion. */
+      encode_fixlen_endianness,
+
+      /** Encode a BasicOctetArray as fixlen. */
+      encode_fixlen_octets,
+
+      /** Encode a BasicOctetArray as varlen. Varlen encoding is
+       * supported only for BasicOctetArray and derived classes.  In
+       * all other instances, I'll do what Brian Trammell recommended
+       * I do and tell the user to eff off. */
+      encode_varlen,
+
+      /** Encode double as float with endianness conversion. */
+      encode_double_as_float_endianness,
+
+      /** Encode double as float, no endianness conversion. */
+      encode_double_as_float,
+    } type;
+
+    /** Address where original value is to be found. */
+    const void *address;
+
+    /** Size of original (unencoded) data.
+     *
+     * If type is encode_varlen or encode_double_as_float or
+     * encode_fixlen_octets, this field is implied and may not contain
+     * a valid value.
+     */
+    size_t unencoded_length;
+
+    /** Requested size of encoded data.
+     *
+     * If type is encode_varlen or encode_double_as_float, this field
+     * is implied and may not contain a valid value.
+     */
+    size_t encoded_length;
+
+    /** Creates a printable version of this encoding decision.
+     *
+     * @return a printable version of this encoding decision
+     */
+    std::string to_string() const;
+  };
+
+  std::vector<Decision> plan;
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+  log4cplus::Logger logger;
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_ENCODEPLAN_H_
@@ -0,0 +1,182 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <sstream>
+
+#ifdef _LIBFC_HAVE_LOG4CPLUS_
+#include <log4cplus/loggingmacros.h>
+#else
+#define LOG4CPLUS_WARN(logger, expr)
+#endif /* _LIBFC_HAVE_LOG4CPLUS_ */
+
+#include "ExportDelayTracker.h"
+
+namespace libfc {
+
+ExportDelayTracker::Stats::Stats()
+    : messages(0), min_delay(0), max_delay(0), sum_delay(0), last_delay(0) {
+  memset(behind, 0, sizeof(behind));
+  memset(ahead, 0, sizeof(ahead));
+}
+
+double ExportDelayTracker::Stats::mean_delay() const {
+  return messages == 0 ? 0.0 : static_cast<double>(sum_delay) / messages;
+}
+
+int64_t ExportDelayTracker::Stats::queueing_delay() const {
+  return last_delay - min_delay;
+}
+
+int64_t ExportDelayTracker::Stats::quantile(double q) const {
+  if (messages == 0)
+    return 0;
+
+  uint64_t rank = static_cast<uint64_t>(q * messages);
+  if (rank >= messages)
+    rank = messages - 1;
+
+  uint64_t seen = 0;
+
+  /* Negative delays first, from the largest magnitude down. */
+  for (unsigned int i = kBuckets; i > 0; i--) {
+    seen += ahead[i - 1];
+    if (seen > rank)
+      return i - 1 == 0 ? 0 : -(static_cast<int64_t>(1) << (i - 2));
+  }
+
+  for (unsigned int i = 0; i < kBuckets; i++) {
+    seen += behind[i];
+    if (seen > rank)
+      return i == kBuckets - 1 ? max_delay : (static_cast<int64_t>(1) << i) - 1;
+  }
+
+  return max_delay;
+}
+
+ExportDelayTracker::ExportDelayTracker(uint32_t skew_threshold)
+    : skew_threshold(skew_threshold), last(0), last_key(0)
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+      ,
+      logger(log4cplus::Logger::getInstance(
+          LOG4CPLUS_TEXT("ExportDelayTracker")))
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+{
+}
+
+unsigned int ExportDelayTracker::bucket(uint64_t magnitude) {
+  unsigned int ret = 0;
+  while (magnitude != 0 && ret < kBuckets - 1) {
+    magnitude >>= 1;
+    ret++;
+  }
+  return ret;
+}
+
+void ExportDelayTracker::record(const char *exporter,
+                                uint32_t observation_domain,
+                                uint32_t export_time, int64_t receive_time) {
+  if (last == 0 || last_key->second != observation_domain ||
+      last_key->first != exporter) {
+    std::map<key_type, Stats>::iterator i =
+        stats.insert(std::make_pair(key_type(exporter, observation_domain),
+                                    Stats())).first;
+    last_key = &i->first;
+    last = &i->second;
+  }
+
+  Stats &s = *last;
+  const int64_t delay = receive_time - static_cast<int64_t>(export_time);
+  const bool was_skewed = s.messages > 0 && is_skewed(s);
+
+  if (s.messages == 0 || delay < s.min_delay)
+    s.min_delay = delay;
+  if (s.messages == 0 || delay > s.max_delay)
+    s.max_delay = delay;
+  s.sum_delay += delay;
+  s.last_delay = delay;
+  s.messages++;
+
+  if (delay < 0)
+    s.ahead[bucket(-delay)]++;
+  else
+    s.behind[bucket(delay)]++;
+
+  if (!was_skewed && is_skewed(s))
+    LOG4CPLUS_WARN(logger, "Clock of exporter "
+                               << exporter << ", domain " << observation_domain
+                               << " appears to be off by " << s.min_delay
+                               << " seconds");
+}
+
+const ExportDelayTracker::Stats *
+ExportDelayTracker::get_stats(const std::string &exporter,
+                              uint32_t observation_domain) const {
+  std::map<key_type, Stats>::const_iterator i =
+      stats.find(key_type(exporter, observation_domain));
+  return i == stats.end() ? 0 : &i->second;
+}
+
+const std::map<ExportDelayTracker::key_type, ExportDelayTracker::Stats> &
+ExportDelayTracker::get_all_stats() const {
+  return stats;
+}
+
+bool ExportDelayTracker::is_skewed(const Stats &s) const {
+  return s.min_delay > static_cast<int64_t>(skew_threshold) ||
+         s.min_delay < -static_cast<int64_t>(skew_threshold);
+}
+
+std::map<ExportDelayTracker::key_type, int64_t>
+ExportDelayTracker::get_skewed_exporters() const {
+  std::map<key_type, int64_t> ret;
+  for (auto i = stats.begin(); i != stats.end(); ++i)
+    if (is_skewed(i->second))
+      ret[i->first] = i->second.min_delay;
+  return ret;
+}
+
+std::string ExportDelayTracker::to_string() const {
+  std::stringstream sstr;
+  for (auto i = stats.begin(); i != stats.end(); ++i) {
+    const Stats &s = i->second;
+    sstr << i->first.first << " domain=" << i->first.second
+         << " messages=" << s.messages << " min=" << s.min_delay
+         << " mean=" << s.mean_delay() << " p50<=" << s.quantile(0.5)
+         << " p99<=" << s.quantile(0.99) << " max=" << s.max_delay
+         << " queueing=" << s.queueing_delay()
+         << (is_skewed(s) ? " SKEWED" : "") << std::endl;
+  }
+  return sstr.str();
+}
+
+void ExportDelayTracker::clear() {
+  stats.clear();
+  last = 0;
+  last_key = 0;
+}
+
+} // namespace libfc
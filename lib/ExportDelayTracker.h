@@ -0,0 +1,219 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Per-exporter histograms of export-to-receive delays.
+ */
+
+#ifndef _LIBFC_EXPORTDELAYTRACKER_H_
+#define _LIBFC_EXPORTDELAYTRACKER_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+#include <log4cplus/logger.h>
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+
+namespace libfc {
+
+/** Records how long messages took from export to reception.
+ *
+ * Every IPFIX and v9 message header carries an export time, in
+ * seconds since the epoch.  The difference between the local receive
+ * time and the export time is the sum of three things: the offset
+ * between the exporter's clock and ours, the network delay, and the
+ * time the message spent queued in socket buffers and in the
+ * collector itself.  Network delays are usually well below the
+ * one-second resolution of the export time, so in practice the delay
+ * is clock offset plus queueing delay.
+ *
+ * Queueing can only make delays larger, so the smallest delay seen
+ * from an exporter is a good estimate of its clock offset.  If that
+ * estimate is larger in magnitude than a threshold, the exporter's
+ * clock is flagged as skewed; its export times should then not be
+ * trusted for time binning.  The delay above that minimum is the
+ * queueing delay; if it keeps growing, the collector is falling
+ * behind.
+ *
+ * Delays are kept in histograms with power-of-two bucket boundaries,
+ * one for non-negative delays and one for negative delays (export
+ * times in the future), per exporter and observation domain.
+ */
+class ExportDelayTracker {
+public:
+  /** Number of histogram buckets.
+   *
+   * Bucket 0 counts delays of 0 seconds, bucket i > 0 counts delays
+   * d with 2^(i-1) <= d < 2^i, and the last bucket counts all
+   * larger delays as well. */
+  static const unsigned int kBuckets = 18;
+
+  /** Delay histogram for one exporter and observation domain. */
+  struct Stats {
+    Stats();
+
+    /** Number of messages seen. */
+    uint64_t messages;
+
+    /** Counts of non-negative delays, see kBuckets. */
+    uint64_t behind[kBuckets];
+
+    /** Counts of negative delays (by magnitude), see kBuckets. */
+    uint64_t ahead[kBuckets];
+
+    /** Smallest delay seen, in seconds.  This is the estimated
+     * clock offset of the exporter. */
+    int64_t min_delay;
+
+    /** Largest delay seen, in seconds. */
+    int64_t max_delay;
+
+    /** Sum of all delays, for computing the mean. */
+    int64_t sum_delay;
+
+    /** Delay of the most recent message, in seconds. */
+    int64_t last_delay;
+
+    /** Returns the mean delay in seconds. */
+    double mean_delay() const;
+
+    /** Returns the current queueing delay in seconds, that is, the
+     * delay of the most recent message minus the estimated clock
+     * offset. */
+    int64_t queueing_delay() const;
+
+    /** Returns an upper bound for the given quantile of the delays.
+     *
+     * @param q the quantile, between 0 and 1
+     *
+     * @return the upper boundary of the histogram bucket containing
+     *   the quantile, in seconds
+     */
+    int64_t quantile(double q) const;
+  };
+
+  /** Identifies an exporter: exporter name and observation domain. */
+  typedef std::pair<std::string, uint32_t> key_type;
+
+  /** Creates an export delay tracker.
+   *
+   * @param skew_threshold the clock offset in seconds beyond which
+   *   an exporter's clock is considered skewed
+   */
+  ExportDelayTracker(uint32_t skew_threshold = kDefaultSkewThreshold);
+
+  /** Records the delay of one message.
+   *
+   * @param exporter the name of the exporter
+   * @param observation_domain observation domain (or v9 source ID)
+   * @param export_time export time from the message header, in
+   *   seconds since the epoch
+   * @param receive_time local receive time, in seconds since the
+   *   epoch
+   */
+  void record(const char *exporter, uint32_t observation_domain,
+              uint32_t export_time, int64_t receive_time);
+
+  /** Returns the delay statistics for an exporter and observation
+   * domain.
+   *
+   * @param exporter the name of the exporter
+   * @param observation_domain the observation domain
+   *
+   * @return a pointer to the statistics, or 0 if no message has been
+   *   seen from that exporter and observation domain
+   */
+  const Stats *get_stats(const std::string &exporter,
+                         uint32_t observation_domain) const;
+
+  /** Returns the statistics of all exporters.
+   *
+   * @return a map from (exporter, observation domain) to statistics
+   */
+  const std::map<key_type, Stats> &get_all_stats() const;
+
+  /** Tells whether an exporter's clock is skewed.
+   *
+   * @param stats the statistics of the exporter
+   *
+   * @return true if the estimated clock offset exceeds the skew
+   *   threshold
+   */
+  bool is_skewed(const Stats &stats) const;
+
+  /** Returns the exporters whose clocks are skewed.
+   *
+   * @return a map from the keys of all exporters for which
+   *   is_skewed() is true to their estimated clock offsets, in
+   *   seconds
+   */
+  std::map<key_type, int64_t> get_skewed_exporters() const;
+
+  /** Returns a printable report of the statistics, one line per
+   * exporter and observation domain.
+   *
+   * @return a printable report
+   */
+  std::string to_string() const;
+
+  /** Forgets all exporters. */
+  void clear();
+
+  /** Default for the skew threshold, in seconds. */
+  static const uint32_t kDefaultSkewThreshold = 5;
+
+  /** Returns the histogram bucket for a delay magnitude.
+   *
+   * @param magnitude the absolute value of a delay, in seconds
+   *
+   * @return the bucket index, less than kBuckets
+   */
+  static unsigned int bucket(uint64_t magnitude);
+
+private:
+  uint32_t skew_threshold;
+
+  std::map<key_type, Stats> stats;
+
+  /** Cache for the most recently used entry in stats. */
+  Stats *last;
+
+  /** The key belonging to last. */
+  const key_type *last_key;
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+  log4cplus::Logger logger;
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_EXPORTDELAYTRACKER_H_
@@ -37,8 +37,13 @@
 
 namespace libfc {
 
-FileExportDestination::FileExportDestination(int _fd)
-    : fd(_fd)
+FileExportDestination::FileExportDestination(
+    int _fd, size_t _preferred_maximum_message_size)
+    : fd(_fd),
+      max_message_size(_preferred_maximum_message_size == 0 ||
+                               _preferred_maximum_message_size > kMaxMessageLen
+                           ? kMaxMessageLen
+                           : _preferred_maximum_message_size)
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
       ,
       logger(log4cplus::Logger::getInstance(
@@ -70,7 +75,7 @@ int FileExportDestination::flush() { return 0; }
 bool FileExportDestination::is_connectionless() const { return false; }
 
 size_t FileExportDestination::preferred_maximum_message_size() const {
-  return kMaxMessageLen;
+  return max_message_size;
 }
 
 } // namespace libfc
@@ -48,8 +48,12 @@ public:
    * file descriptor.
    *
    * @param fd file descriptor pointing to an open file
+   * @param preferred_maximum_message_size largest message to write,
+   *   or 0 for the largest possible IPFIX message.  Files meant to
+   *   be replayed over UDP should use the path MTU minus IP and UDP
+   *   headers.
    */
-  FileExportDestination(int fd);
+  FileExportDestination(int fd, size_t preferred_maximum_message_size = 0);
 
   ssize_t writev(const std::vector<::iovec> &iovecs);
   int flush();
@@ -58,6 +62,7 @@ public:
 
 private:
   int fd;
+  size_t max_message_size;
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
   log4cplus::Logger logger;
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
@@ -0,0 +1,76 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "Constants.h"
+#include "MemoryExportDestination.h"
+
+namespace libfc {
+
+MemoryExportDestination::MemoryExportDestination(
+    bool connectionless, size_t preferred_maximum_message_size)
+    : n_messages(0), connectionless(connectionless),
+      max_message_size(preferred_maximum_message_size == 0
+                           ? kMaxMessageLen
+                           : preferred_maximum_message_size) {}
+
+ssize_t MemoryExportDestination::writev(const std::vector<::iovec> &iovecs) {
+  size_t total = 0;
+  for (auto i = iovecs.begin(); i != iovecs.end(); ++i)
+    total += i->iov_len;
+
+  buffer.reserve(buffer.size() + total);
+  for (auto i = iovecs.begin(); i != iovecs.end(); ++i) {
+    if (i->iov_len > 0) {
+      const uint8_t *p = static_cast<const uint8_t *>(i->iov_base);
+      buffer.insert(buffer.end(), p, p + i->iov_len);
+    }
+  }
+  n_messages++;
+
+  return total;
+}
+
+int MemoryExportDestination::flush() { return 0; }
+
+bool MemoryExportDestination::is_connectionless() const {
+  return connectionless;
+}
+
+size_t MemoryExportDestination::preferred_maximum_message_size() const {
+  return max_message_size;
+}
+
+const std::vector<uint8_t> &MemoryExportDestination::get_buffer() const {
+  return buffer;
+}
+
+size_t MemoryExportDestination::get_n_messages() const { return n_messages; }
+
+void MemoryExportDestination::clear() {
+  buffer.clear();
+  n_messages = 0;
+}
+
+} // namespace libfc
@@ -0,0 +1,89 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief IPFIX output to memory
+ */
+
+#ifndef _LIBFC_MEMORYEXPORTDESTINATION_H_
+#define _LIBFC_MEMORYEXPORTDESTINATION_H_
+
+#include "ExportDestination.h"
+
+namespace libfc {
+
+/** IPFIX outputs to memory.
+ *
+ * All messages are appended to a growing buffer, which can later be
+ * read back, for example with a BufferInputSource.  This is useful
+ * for testing and benchmarking, and for applications that want to
+ * do their own I/O.
+ */
+class MemoryExportDestination : public ExportDestination {
+public:
+  /** Creates a memory export destination.
+   *
+   * @param connectionless whether to behave like a connectionless
+   *   transport (this influences how the exporter sends templates)
+   * @param preferred_maximum_message_size the value to return from
+   *   preferred_maximum_message_size(), or 0 for kMaxMessageLen
+   */
+  MemoryExportDestination(bool connectionless = false,
+                          size_t preferred_maximum_message_size = 0);
+
+  ssize_t writev(const std::vector<::iovec> &iovecs);
+  int flush();
+  bool is_connectionless() const;
+  size_t preferred_maximum_message_size() const;
+
+  /** Returns the messages written so far.
+   *
+   * @return the concatenation of all messages written so far
+   */
+  const std::vector<uint8_t> &get_buffer() const;
+
+  /** Returns the number of messages written so far.
+   *
+   * @return the number of calls to writev() since the last clear()
+   */
+  size_t get_n_messages() const;
+
+  /** Discards all messages written so far, keeping the buffer's
+   * capacity. */
+  void clear();
+
+private:
+  std::vector<uint8_t> buffer;
+  size_t n_messages;
+  bool connectionless;
+  size_t max_message_size;
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_MEMORYEXPORTDESTINATION_H_
@@ -1,4 +1,3 @@
-/* Hi Emacs, please use -*- mode: C++; -*- */
 /* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
  *
  * Redistribution and use in source and binary forms, with or without
@@ -24,32 +23,51 @@
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <cerrno>
 
-/**
- * @file
- * @author Brian Trammell <trammell@tik.ee.ethz.ch>
- */
+#include <unistd.h>
+
+#include "OutputBuffer.h"
+
+namespace libfc {
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity)
+    : fd(fd), buf(new char[capacity]), cur(buf), end(buf + capacity),
+      error(0) {}
+
+OutputBuffer::~OutputBuffer() {
+  flush();
+  delete[] buf;
+}
+
+int OutputBuffer::flush() {
+  const char *p = buf;
+
+  while (error == 0 && p < cur) {
+    ssize_t n = ::write(fd, p, cur - p);
+    if (n < 0) {
+      if (errno != EINTR)
+        error = errno;
+    } else
+      p += n;
+  }
+  cur = buf;
+
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
 
-#ifndef _FCOLD_STATDATFRONTEND_H_
-#  define _FCOLD_STATDATFRONTEND_H_
-
-namespace fcold {
-    class StatdatFrontend: public WandFileFrontend {
-        
-    public:
-        StatdatFrontend(ImpFactory&        impfact,
-                        const std::string& filename);
-    public:
-        virtual std::shared_ptr<libfc::ErrorContext>
-                deframe_next(std::shared_ptr<MessageBuffer>& mb);
-        
-    private:
-        void next_statline();
-        
-        std::string         stat_filename;
-        libfc::InputSource* stat_is;
-
-    };
+void OutputBuffer::make_room(size_t n) {
+  flush();
+  if (static_cast<size_t>(end - buf) < n) {
+    delete[] buf;
+    buf = new char[n];
+    cur = buf;
+    end = buf + n;
+  }
 }
 
-#endif /* idem hack */
\ No newline at end of file
+} // namespace libfc
@@ -0,0 +1,140 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Buffered text output to a file descriptor
+ */
+
+#ifndef _LIBFC_OUTPUTBUFFER_H_
+#define _LIBFC_OUTPUTBUFFER_H_
+
+#include <cstddef>
+#include <cstring>
+
+namespace libfc {
+
+/** Buffered text output to a file descriptor.
+ *
+ * Text is formatted directly into a large buffer, which is handed to
+ * write(2) only when it is full, so that writing a record costs no
+ * system call and no stream machinery:
+ *
+ * @code
+ * OutputBuffer out(1);
+ *
+ * char *p = out.reserve(kMaxIpv4Chars + 1);
+ * p = format_ipv4(p, addr);
+ * *p++ = '\n';
+ * out.commit(p);
+ * @endcode
+ *
+ * Write errors are sticky: after the first one, all further output is
+ * discarded and flush() keeps failing.
+ */
+class OutputBuffer {
+public:
+  /** Default buffer size. */
+  static const size_t kDefaultCapacity = 1 << 20;
+
+  /** Creates an output buffer.
+   *
+   * @param fd the file descriptor to write to; this is not closed
+   * @param capacity the size of the buffer in bytes
+   */
+  OutputBuffer(int fd, size_t capacity = kDefaultCapacity);
+
+  /** Writes out pending output, ignoring errors, and destroys the
+   * buffer.  Call flush() first if you care about errors. */
+  ~OutputBuffer();
+
+  /** Makes room for output.
+   *
+   * If fewer than n bytes are free, the buffer is written out first.
+   * The space is used by writing to the returned pointer and passing
+   * the pointer past the last byte written to commit().
+   *
+   * @param n the number of bytes needed; if this exceeds the
+   *   capacity, the buffer grows
+   *
+   * @return where to write the output
+   */
+  char *reserve(size_t n) {
+    if (static_cast<size_t>(end - cur) < n)
+      make_room(n);
+    return cur;
+  }
+
+  /** Ends output started with reserve().
+   *
+   * @param p pointer past the last byte written
+   */
+  void commit(char *p) { cur = p; }
+
+  /** Appends a single character.
+   *
+   * @param c the character
+   */
+  void put(char c) {
+    *reserve(1) = c;
+    cur++;
+  }
+
+  /** Appends a sequence of bytes.
+   *
+   * @param s the bytes
+   * @param n the number of bytes
+   */
+  void append(const char *s, size_t n) {
+    memcpy(reserve(n), s, n);
+    cur += n;
+  }
+
+  /** Writes out pending output.
+   *
+   * @return 0 on success, or -1 with errno set if this or an earlier
+   *   write failed
+   */
+  int flush();
+
+private:
+  OutputBuffer(const OutputBuffer &);
+  OutputBuffer &operator=(const OutputBuffer &);
+
+  void make_room(size_t n);
+
+  int fd;
+  char *buf;
+  char *cur;
+  char *end;
+  /** The errno of the first failed write, or 0. */
+  int error;
+};
+
+} // namespace libfc
+
+#endif /* _LIBFC_OUTPUTBUFFER_H_ */
@@ -51,7 +51,136 @@ PlacementCollector::PlacementCollector(Protocol protocol) {
 PlacementCollector::~PlacementCollector() { delete ir; }
 
 std::shared_ptr<ErrorContext> PlacementCollector::collect(InputSource &is) {
-  return ir->parse(is);
+  d.set_input_source(&is);
+  std::shared_ptr<ErrorContext> ret = ir->parse(is);
+  d.set_input_source(0);
+  return ret;
+}
+
+namespace {
+
+/** An input source that ends after one message.
+ *
+ * Parsers tell their input source when a message has been read
+ * completely, by calling advance_message_offset().  After that,
+ * this input source reports the end of the stream, so that parsing
+ * stops after every message.
+ */
+class OneMessageInputSource : public InputSource {
+public:
+  OneMessageInputSource(InputSource &is) : is(is), message_read(false) {}
+
+  /** Lets the next message through. */
+  void next_message() { message_read = false; }
+
+  /** Tells whether a message has been read since next_message(). */
+  bool has_read_message() const { return message_read; }
+
+  ssize_t read(uint8_t *buf, uint16_t len) {
+    return message_read ? 0 : is.read(buf, len);
+  }
+
+  ssize_t peek(uint8_t *buf, uint16_t len) {
+    return message_read ? 0 : is.peek(buf, len);
+  }
+
+  bool resync() { return is.resync(); }
+
+  size_t get_message_offset() const { return is.get_message_offset(); }
+
+  void advance_message_offset() {
+    is.advance_message_offset();
+    message_read = true;
+  }
+
+  const char *get_name() const { return is.get_name(); }
+
+  bool can_peek() const { return is.can_peek(); }
+
+private:
+  InputSource &is;
+  bool message_read;
+};
+
+} // namespace
+
+class PlacementCollector::Records::State {
+public:
+  State(PlacementCollector *collector, InputSource &is)
+      : collector(collector), one_message(is), done(false) {
+    collector->d.set_input_source(&is);
+    collector->d.defer_data_records(true);
+  }
+
+  ~State() {
+    collector->d.defer_data_records(false);
+    collector->d.set_input_source(0);
+  }
+
+  PlacementCollector *collector;
+  OneMessageInputSource one_message;
+  /** Whether the input stream has ended or an error has occurred. */
+  bool done;
+  std::shared_ptr<ErrorContext> error;
+};
+
+PlacementCollector::Records::Records(PlacementCollector *collector,
+                                     InputSource &is)
+    : state(new State(collector, is)) {}
+
+PlacementCollector::Records::Records(Records &&other)
+    : state(std::move(other.state)) {}
+
+PlacementCollector::Records::~Records() {}
+
+const PlacementTemplate *PlacementCollector::Records::next() {
+  PlacementContentHandler &d = state->collector->d;
+
+  for (;;) {
+    const PlacementTemplate *tmpl = 0;
+    std::shared_ptr<ErrorContext> e = d.next_deferred_record(&tmpl);
+    if (e != 0 && e->get_error() != Error::no_error) {
+      state->error = e;
+      state->done = true;
+      d.defer_data_records(true);
+      return 0;
+    }
+    if (tmpl != 0)
+      return tmpl;
+    if (state->done || state->collector->ir == 0)
+      return 0;
+
+    /* No records left; parse the next message.  Records from a
+     * message that ends with an error are still delivered. */
+    state->one_message.next_message();
+    e = state->collector->ir->parse(state->one_message);
+    if (e != 0 && e->get_error() != Error::no_error) {
+      state->error = e;
+      state->done = true;
+    } else if (!state->one_message.has_read_message())
+      state->done = true;
+  }
+}
+
+std::shared_ptr<ErrorContext>
+PlacementCollector::Records::get_error() const {
+  return state->error;
+}
+
+PlacementCollector::Records PlacementCollector::records(InputSource &is) {
+  return Records(this, is);
+}
+
+const SequenceTracker &PlacementCollector::get_sequence_tracker() const {
+  return d.get_sequence_tracker();
+}
+
+void PlacementCollector::enable_export_delay_tracking(bool enable) {
+  d.enable_export_delay_tracking(enable);
+}
+
+const ExportDelayTracker &PlacementCollector::get_export_delay_tracker() const {
+  return d.get_export_delay_tracker();
 }
 
 void PlacementCollector::register_placement_template(
@@ -59,12 +188,41 @@ void PlacementCollector::register_placement_template(
   d.register_placement_template(placement, this);
 }
 
+std::shared_ptr<ErrorContext> PlacementCollector::decode_data_set(
+    const PlacementTemplate *tmpl, DecodePlan &plan, const uint8_t *buf,
+    uint16_t length, uint16_t min_length, uint32_t *n_records) {
+  const uint8_t *buf_end = buf + length;
+  const uint8_t *cur = buf;
+
+  *n_records = 0;
+  while (cur < buf_end && length >= min_length) {
+    std::shared_ptr<ErrorContext> e = start_placement(tmpl);
+    if (e != 0)
+      return e;
+    uint16_t consumed = plan.execute(cur, length);
+    e = end_placement(tmpl);
+    if (e != 0)
+      return e;
+    cur += consumed;
+    length -= consumed;
+    (*n_records)++;
+  }
+
+  LIBFC_RETURN_OK();
+}
+
 std::shared_ptr<ErrorContext>
 PlacementCollector::unhandled_data_set(uint32_t observation_domain, uint16_t id,
                                        uint16_t length, const uint8_t *buf) {
   LIBFC_RETURN_OK();
 }
 
+const PlacementTemplate *
+PlacementCollector::unmatched_template(uint32_t observation_domain, uint16_t id,
+                                       const IETemplate *wire_template) {
+  return 0;
+}
+
 std::shared_ptr<ErrorContext>
 PlacementCollector::unknown_data_set(uint32_t observation_domain, uint16_t id,
                                      uint16_t length, const uint8_t *buf) {
@@ -33,6 +33,10 @@
 #ifndef _LIBFC_PLACEMENTCALLBACK_H_
 #define _LIBFC_PLACEMENTCALLBACK_H_
 
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
 #include "MessageStreamParser.h"
 #include "PlacementContentHandler.h"
 #include "PlacementTemplate.h"
@@ -65,6 +69,68 @@ public:
    */
   std::shared_ptr<ErrorContext> collect(InputSource &is);
 
+  class Records;
+
+  /** Pulls records from an input stream, one at a time.
+   *
+   * Instead of having start_placement() and end_placement() called
+   * for all records in the stream, you iterate over the records and
+   * find the values of the current record at the placements of its
+   * template:
+   *
+   * @code
+   * PlacementCollector::Records r = collector.records(is);
+   * for (const PlacementTemplate *t : r) {
+   *   if (t == &flow_template)
+   *     process(source_address, destination_address, octets);
+   * }
+   * if (r.get_error() != 0)
+   *   ...
+   * @endcode
+   *
+   * Messages are parsed one at a time.  Their data sets are copied
+   * and their records decoded only when you ask for them, so there
+   * are no threads involved, and the values of a record stay at
+   * their placements until you ask for the next record.  The
+   * start_placement() and end_placement() callbacks are still
+   * called for every record, as it is decoded; all other callbacks
+   * are called as the messages are parsed.
+   *
+   * You must not call collect() or records() again while the result
+   * of this call is still in use.
+   *
+   * @param is the input stream to parse
+   *
+   * @return the records in the stream
+   */
+  Records records(InputSource &is);
+
+  /** Returns sequence number statistics for all messages collected
+   * so far.
+   *
+   * Exporters are identified by the name of the input source from
+   * which their messages were read, and by their observation domain.
+   *
+   * @return the sequence tracker
+   */
+  const SequenceTracker &get_sequence_tracker() const;
+
+  /** Switches recording of export-to-receive delays on or off.
+   *
+   * This is off by default, because it only makes sense when
+   * collecting live, for example from a UDPInputSource.
+   *
+   * @param enable whether to record delays
+   */
+  void enable_export_delay_tracking(bool enable = true);
+
+  /** Returns histograms of export-to-receive delays for all messages
+   * collected while delay tracking was enabled.
+   *
+   * @return the export delay tracker
+   */
+  const ExportDelayTracker &get_export_delay_tracker() const;
+
   /** Signals that a new message has just started.
    *
    * @param version the version number in the header
@@ -102,6 +168,30 @@ public:
   virtual std::shared_ptr<ErrorContext>
   end_placement(const PlacementTemplate *tmpl) = 0;
 
+  /** Decodes the data records of a data set.
+   *
+   * This is called once for every data set that matches a placement
+   * template.  The default implementation calls start_placement(),
+   * executes the plan and calls end_placement() for every record.
+   * Override it to avoid those two virtual calls per record; see
+   * StaticPlacementCollector.
+   *
+   * @param tmpl placement template that matches the data set
+   * @param plan the plan for decoding a record into the placements
+   * @param buf pointer to the beginning of the data records
+   * @param length length in bytes of the data records
+   * @param min_length minimum length of a data record; anything
+   *     shorter at the end of the data set is padding
+   * @param n_records where to store the number of records decoded
+   *
+   * @return a (shared) pointer to an error context, or null if no
+   * error occurred
+   */
+  virtual std::shared_ptr<ErrorContext>
+  decode_data_set(const PlacementTemplate *tmpl, DecodePlan &plan,
+                  const uint8_t *buf, uint16_t length, uint16_t min_length,
+                  uint32_t *n_records);
+
   /** Will be called on unhandled data sets.
    *
    * For the purposes of this discussion, an unhandled data set is a
@@ -130,6 +220,31 @@ public:
   unhandled_data_set(uint32_t observation_domain, uint16_t id, uint16_t length,
                      const uint8_t *buf);
 
+  /** Will be called for a wire template that matches none of the
+   * registered placement templates.
+   *
+   * This lets a collector decode records whose templates it cannot
+   * know in advance, for example to dump all of their fields.  The
+   * placement template returned is used for this wire template only:
+   * it is neither matched against other wire templates nor
+   * registered.  It must stay valid for as long as the collector is
+   * in use.  The question is asked again only if the exporter
+   * redefines the template.
+   *
+   * The default implementation returns 0, causing the data sets of
+   * this template to be skipped.
+   *
+   * @param observation_domain the observation domain of the template
+   * @param id template ID as per RFC 5101, > 255
+   * @param wire_template the wire template
+   *
+   * @return the placement template with which to decode data sets of
+   *   this template, or 0 to skip them
+   */
+  virtual const PlacementTemplate *
+  unmatched_template(uint32_t observation_domain, uint16_t id,
+                     const IETemplate *wire_template);
+
 protected:
   /** Will be called on unknown data sets.
    *
@@ -176,6 +291,77 @@ private:
   MessageStreamParser *ir;
 };
 
+/** The records in an input stream, as returned by
+ * PlacementCollector::records().
+ *
+ * This is a single-pass range: iterating over it consumes the input
+ * stream.
+ */
+class PlacementCollector::Records {
+public:
+  /** Iterates over records; dereferencing gives the placement
+   * template whose placements hold the current record's values. */
+  class iterator {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef const PlacementTemplate *value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const PlacementTemplate *const *pointer;
+    typedef const PlacementTemplate *const &reference;
+
+    const PlacementTemplate *operator*() const { return current; }
+    iterator &operator++() {
+      current = records->next();
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return current == other.current;
+    }
+    bool operator!=(const iterator &other) const {
+      return current != other.current;
+    }
+
+  private:
+    friend class Records;
+    iterator(Records *records, const PlacementTemplate *current)
+        : records(records), current(current) {}
+
+    Records *records;
+    const PlacementTemplate *current;
+  };
+
+  Records(Records &&other);
+  ~Records();
+
+  /** Decodes the first record and returns an iterator to it. */
+  iterator begin() { return iterator(this, next()); }
+
+  /** Returns the iterator that marks the end of the records. */
+  iterator end() { return iterator(this, 0); }
+
+  /** Decodes the next record.
+   *
+   * @return the placement template of the record, or 0 if there are
+   *     no more records, either because the input stream has ended
+   *     or because of an error
+   */
+  const PlacementTemplate *next();
+
+  /** Returns the error that ended the records, if any.
+   *
+   * @return an error context, or null if no error occurred
+   */
+  std::shared_ptr<ErrorContext> get_error() const;
+
+private:
+  friend class PlacementCollector;
+  class State;
+
+  Records(PlacementCollector *collector, InputSource &is);
+
+  std::unique_ptr<State> state;
+};
+
 } // namespace libfc
 
 #endif // _LIBFC_PLACEMENTCALLBACK_H_
@@ -66,9 +66,11 @@ namespace libfc {
   } while (0)
 
 PlacementContentHandler::PlacementContentHandler()
-    : info_model(InfoModel::instance()), start_message_handler(0),
+    : input_source(0), track_export_delay(false),
+      info_model(InfoModel::instance()),
+      start_message_handler(0),
       unhandled_data_set_handler(0), use_matched_template_cache(false),
-      current_wire_template(0), parse_is_good(true)
+      current_wire_template(0), parse_is_good(true), defer_records(false)
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
       ,
       logger(log4cplus::Logger::getInstance(
@@ -142,6 +144,14 @@ std::shared_ptr<ErrorContext> PlacementContentHandler::start_message(
 
   this->observation_domain = observation_domain;
 
+  const char *exporter =
+      input_source == 0 ? "<unknown>" : input_source->get_name();
+  sequence_tracker.start_message(exporter, version, observation_domain,
+                                 sequence_number);
+  if (track_export_delay)
+    export_delay_tracker.record(exporter, observation_domain, export_time,
+                                time(0));
+
   LOG4CPLUS_TRACE(logger, "LEAVE start_message");
 
   if (start_message_handler != 0)
@@ -155,6 +165,7 @@ std::shared_ptr<ErrorContext> PlacementContentHandler::start_message(
 std::shared_ptr<ErrorContext> PlacementContentHandler::end_message() {
   LOG4CPLUS_TRACE(logger, "ENTER end_message");
   assert(current_wire_template == 0);
+  sequence_tracker.end_message();
   LOG4CPLUS_TRACE(logger, "LEAVE end_message");
   LIBFC_RETURN_OK();
 }
@@ -279,6 +290,7 @@ std::shared_ptr<ErrorContext> PlacementContentHandler::end_template_record() {
           current_wire_template;
 
       matched_templates.erase(my_wire_template);
+      unmatched_placements.erase(my_wire_template);
     } else if (my_wire_template == 0) {
       LOG4CPLUS_INFO(logger, "  New template for domain "
                                  << observation_domain << ", ID "
@@ -477,6 +489,47 @@ const PlacementTemplate *PlacementContentHandler::match_placement_template(
     return m->second;
 }
 
+/** Counts the records in a data set without decoding them.
+ *
+ * @param t the wire template of the data set
+ * @param min_length the minimal length of a record
+ * @param buf the start of the data set's records
+ * @param length the length of the data set's records, in bytes
+ *
+ * @return the number of complete records in the data set
+ */
+static uint32_t count_records(const IETemplate *t, uint16_t min_length,
+                              const uint8_t *buf, uint16_t length) {
+  const uint8_t *buf_end = buf + length;
+  const uint8_t *cur = buf;
+  uint32_t n_records = 0;
+
+  while (cur < buf_end && buf_end - cur >= min_length) {
+    for (auto i = t->begin(); i != t->end(); ++i) {
+      size_t field_length = (*i)->len();
+
+      if (field_length == kIpfixVarlen) {
+        if (cur >= buf_end)
+          return n_records;
+        field_length = *cur++;
+        if (field_length == 0xff) {
+          if (cur + 2 > buf_end)
+            return n_records;
+          field_length = decode_uint16(cur);
+          cur += 2;
+        }
+      }
+      cur += field_length;
+    }
+
+    if (cur > buf_end)
+      return n_records;
+    n_records++;
+  }
+
+  return n_records;
+}
+
 std::shared_ptr<ErrorContext>
 PlacementContentHandler::start_data_set(uint16_t id, uint16_t length,
                                         const uint8_t *buf) {
@@ -489,6 +542,9 @@ PlacementContentHandler::start_data_set(uint16_t id, uint16_t length,
   LOG4CPLUS_TRACE(logger, "  wire_template=" << wire_template);
 
   if (wire_template == 0) {
+    /* We can't know how many records there are in this data set. */
+    sequence_tracker.records_uncountable();
+
     if (unhandled_data_set_handler == 0) {
       if (unmatched_template_ids.count(make_template_key(id)) == 0) {
         LOG4CPLUS_WARN(logger, "  No placement for data set with "
@@ -527,32 +583,54 @@ PlacementContentHandler::start_data_set(uint16_t id, uint16_t length,
   const PlacementTemplate *placement_template =
       match_placement_template(id, wire_template);
 
+  /* Give the collector that owns us a chance to supply one. */
+  if (placement_template == 0 && start_message_handler != 0) {
+    auto u = unmatched_placements.find(wire_template);
+    if (u == unmatched_placements.end()) {
+      const PlacementTemplate *p = start_message_handler->unmatched_template(
+          observation_domain, id, wire_template);
+      if (p != 0)
+        callbacks[p] = start_message_handler;
+      u = unmatched_placements.insert(std::make_pair(wire_template, p)).first;
+    }
+    placement_template = u->second;
+  }
+
   LOG4CPLUS_TRACE(logger, "  placement_template=" << placement_template);
 
   if (placement_template == 0) {
     LOG4CPLUS_TRACE(logger, "  no one interested in this data set; skipping");
+    /* The records still count towards the sequence number. */
+    sequence_tracker.add_records(count_records(
+        wire_template, wire_template_min_length(wire_template), buf, length));
     LIBFC_RETURN_OK();
   }
 
-  DecodePlan plan(placement_template, wire_template);
-
-  const uint8_t *buf_end = buf + length;
-  const uint8_t *cur = buf;
   const uint16_t min_length = wire_template_min_length(wire_template);
 
   auto callback = callbacks.find(placement_template);
   assert(callback != callbacks.end());
 
-  while (cur < buf_end && length >= min_length) {
-    CH_REPORT_CALLBACK_ERROR(
-        callback->second->start_placement(placement_template));
-    uint16_t consumed = plan.execute(cur, length);
-    CH_REPORT_CALLBACK_ERROR(
-        callback->second->end_placement(placement_template));
-    cur += consumed;
-    length -= consumed;
+  if (defer_records) {
+    /* Decode later, but count now, while the message is current. */
+    sequence_tracker.add_records(
+        count_records(wire_template, min_length, buf, length));
+    if (deferred_sets.empty())
+      deferred_data.clear();
+    deferred_sets.push_back(
+        DeferredDataSet(placement_template, wire_template, callback->second,
+                        deferred_data.size(), length, min_length));
+    deferred_data.insert(deferred_data.end(), buf, buf + length);
+    LIBFC_RETURN_OK();
   }
 
+  DecodePlan plan(placement_template, wire_template);
+
+  uint32_t n_records = 0;
+  CH_REPORT_CALLBACK_ERROR(callback->second->decode_data_set(
+      placement_template, plan, buf, length, min_length, &n_records));
+  sequence_tracker.add_records(n_records);
+
   LIBFC_RETURN_OK();
 }
 
@@ -573,6 +651,63 @@ void PlacementContentHandler::register_placement_template(
   callbacks[placement_template] = callback;
 }
 
+PlacementContentHandler::DeferredDataSet::DeferredDataSet(
+    const PlacementTemplate *placement_template,
+    const IETemplate *wire_template, PlacementCollector *callback,
+    size_t offset, uint16_t length, uint16_t min_length)
+    : plan(placement_template, wire_template),
+      placement_template(placement_template), callback(callback),
+      offset(offset), length(length), min_length(min_length) {}
+
+void PlacementContentHandler::defer_data_records(bool defer) {
+  defer_records = defer;
+  deferred_sets.clear();
+  deferred_data.clear();
+}
+
+std::shared_ptr<ErrorContext>
+PlacementContentHandler::next_deferred_record(const PlacementTemplate **tmpl) {
+  /* Same loop condition as in start_data_set(). */
+  while (!deferred_sets.empty()
+         && (deferred_sets.front().length == 0
+             || deferred_sets.front().length
+                    < deferred_sets.front().min_length))
+    deferred_sets.pop_front();
+
+  if (deferred_sets.empty()) {
+    *tmpl = 0;
+    LIBFC_RETURN_OK();
+  }
+
+  DeferredDataSet &s = deferred_sets.front();
+  *tmpl = s.placement_template;
+
+  CH_REPORT_CALLBACK_ERROR(s.callback->start_placement(s.placement_template));
+  uint16_t consumed = s.plan.execute(&deferred_data[s.offset], s.length);
+  CH_REPORT_CALLBACK_ERROR(s.callback->end_placement(s.placement_template));
+  s.offset += consumed;
+  s.length = consumed < s.length ? s.length - consumed : 0;
+
+  LIBFC_RETURN_OK();
+}
+
+void PlacementContentHandler::set_input_source(const InputSource *is) {
+  input_source = is;
+}
+
+const SequenceTracker &PlacementContentHandler::get_sequence_tracker() const {
+  return sequence_tracker;
+}
+
+void PlacementContentHandler::enable_export_delay_tracking(bool enable) {
+  track_export_delay = enable;
+}
+
+const ExportDelayTracker &
+PlacementContentHandler::get_export_delay_tracker() const {
+  return export_delay_tracker;
+}
+
 void PlacementContentHandler::register_unhandled_data_set_handler(
     PlacementCollector *callback) {
   unhandled_data_set_handler = callback;
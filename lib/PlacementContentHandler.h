@@ -33,6 +33,7 @@
 #ifndef _LIBFC_PLACEMENTCONTENTHANDLER_H_
 #define _LIBFC_PLACEMENTCONTENTHANDLER_H_
 
+#include <deque>
 #include <list>
 #include <map>
 #include <vector>
@@ -42,11 +43,14 @@
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
 
 #include "ContentHandler.h"
+#include "DecodePlan.h"
+#include "ExportDelayTracker.h"
 #include "IETemplate.h"
 #include "InfoElement.h"
 #include "InfoModel.h"
 #include "InputSource.h"
 #include "PlacementTemplate.h"
+#include "SequenceTracker.h"
 
 namespace libfc {
 
@@ -120,10 +124,82 @@ public:
    */
   void register_unhandled_data_set_handler(PlacementCollector *callback);
 
+  /** Sets the input source from which messages are being read.
+   *
+   * The name of the input source identifies the exporter for
+   * sequence number tracking.
+   *
+   * @param is the input source, or 0 if there is none
+   */
+  void set_input_source(const InputSource *is);
+
+  /** Returns the sequence number tracker.
+   *
+   * @return the sequence tracker for all messages seen so far
+   */
+  const SequenceTracker &get_sequence_tracker() const;
+
+  /** Switches recording of export-to-receive delays on or off.
+   *
+   * Delays are measured against the local clock at the time the
+   * message is processed, so this only makes sense for live input,
+   * not for reading files.  It is off by default.
+   *
+   * @param enable whether to record delays
+   */
+  void enable_export_delay_tracking(bool enable);
+
+  /** Returns the export delay tracker.
+   *
+   * @return the export delay tracker for all messages seen so far
+   */
+  const ExportDelayTracker &get_export_delay_tracker() const;
+
+  /** Switches deferred decoding of data records on or off.
+   *
+   * When decoding is deferred, start_data_set() copies the data set
+   * and remembers how to decode it, but places no values.  The
+   * records are then decoded, one at a time, by
+   * next_deferred_record().  This is how PlacementCollector::Records
+   * pulls single records out of a message.
+   *
+   * Switching deferral off drops all records that are still pending.
+   *
+   * @param defer whether to defer decoding
+   */
+  void defer_data_records(bool defer);
+
+  /** Decodes the next deferred data record.
+   *
+   * This calls the start_placement() and end_placement() callbacks
+   * for the record, just as start_data_set() does when decoding is
+   * not deferred.
+   *
+   * @param tmpl where to store the placement template of the record,
+   *     or 0 if no deferred records are left
+   *
+   * @return a (shared) pointer to an error context, or null if no
+   * error occurred
+   */
+  std::shared_ptr<ErrorContext>
+  next_deferred_record(const PlacementTemplate **tmpl);
+
 private:
   /** Observation domain for this message. */
   uint32_t observation_domain;
 
+  /** The input source that messages are read from, if known. */
+  const InputSource *input_source;
+
+  /** Tracks sequence numbers and losses per exporter. */
+  SequenceTracker sequence_tracker;
+
+  /** Whether to record export-to-receive delays. */
+  bool track_export_delay;
+
+  /** Records export-to-receive delays per exporter. */
+  ExportDelayTracker export_delay_tracker;
+
   /** The cached InfoModel instance. */
   InfoModel &info_model;
 
@@ -271,6 +347,15 @@ private:
   mutable std::map<const IETemplate *, const PlacementTemplate *>
       matched_templates;
 
+  /** Placement templates that the collector has supplied for wire
+   * templates that matched no registered placement template, or 0
+   * where it declined.
+   *
+   * See PlacementCollector::unmatched_template().
+   */
+  std::map<const IETemplate *, const PlacementTemplate *>
+      unmatched_placements;
+
   /** The current wire template that is being assembled.
    *
    * This pointer is set to null after every template record.
@@ -307,6 +392,33 @@ private:
   /** The template IDs about which we've warned already. */
   mutable std::set<uint64_t> unmatched_template_ids;
 
+  /** A data set whose records have not been decoded yet. */
+  struct DeferredDataSet {
+    DeferredDataSet(const PlacementTemplate *placement_template,
+                    const IETemplate *wire_template,
+                    PlacementCollector *callback, size_t offset,
+                    uint16_t length, uint16_t min_length);
+
+    DecodePlan plan;
+    const PlacementTemplate *placement_template;
+    PlacementCollector *callback;
+    /** Offset of the next record in deferred_data. */
+    size_t offset;
+    /** Remaining length of the data set. */
+    uint16_t length;
+    uint16_t min_length;
+  };
+
+  /** Whether decoding of data records is deferred. */
+  bool defer_records;
+
+  /** Copies of the deferred data sets.  The parser's message buffer
+   * can't be used, since it is overwritten when the parse ends. */
+  std::vector<uint8_t> deferred_data;
+
+  /** Deferred data sets, in message order. */
+  std::deque<DeferredDataSet> deferred_sets;
+
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
   log4cplus::Logger logger;
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
@@ -35,6 +35,7 @@
 
 #include <cstdint>
 #include <list>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -48,10 +49,10 @@
 #include "ExportDestination.h"
 #include "PlacementTemplate.h"
 
-class EncodePlan;
-
 namespace libfc {
 
+class EncodePlan;
+
 /** Interface for exporter with the placement interface.
  *
  * A simple example of how to use the placement interface for export
@@ -123,6 +124,17 @@ public:
    * domain, nothing happens. */
   void change_observation_domain(uint32_t new_observation_domain);
 
+  /** Sends all templates again before their next use.
+   *
+   * Collectors listening on connectionless transports may have
+   * missed a template or may have started listening after it was
+   * sent, so RFC 7011 asks exporters to send templates periodically
+   * over UDP.  This method flushes the current message and forgets
+   * which templates have been sent, in all observation domains, so
+   * that each template goes out again (with its old id) together
+   * with the next record that uses it. */
+  void refresh_templates();
+
 private:
   ExportDestination &os;
   /* The expression of const-ness for the PlacementTemplates pointed
@@ -154,15 +166,45 @@ private:
    * a new template is issued. */
   std::set<const PlacementTemplate *> used_templates;
 
+  /** Templates used in observation domains other than the current one.
+   *
+   * Templates are scoped by observation domain, so when the domain
+   * changes, the templates used so far are put aside here, and
+   * those of the new domain (if any) are restored into
+   * used_templates. */
+  std::map<uint32_t, std::set<const PlacementTemplate *>> domain_templates;
+
   /** Templates that need to go into this message's template record. */
   std::set<const PlacementTemplate *> new_templates;
 
   /** Most recently assigned template id. */
   uint16_t current_template_id;
 
-  /** Sequence number for messages; see RFC 5101. */
+  /** Template ids assigned by this exporter.
+   *
+   * A template keeps its id for the life of the exporter, when it is
+   * sent again after refresh_templates() or in another observation
+   * domain.  The id is kept here rather than in the template, since
+   * several exporters may share a template. */
+  std::map<const PlacementTemplate *, uint16_t> template_ids;
+
+  /** Returns the id of a template, assigning one if need be. */
+  uint16_t template_id_of(const PlacementTemplate *tmpl);
+
+  /** Sequence number for messages; see RFC 5101.
+   *
+   * This is the number of data records sent in the current
+   * observation domain before the current message (modulo 2^32),
+   * not the number of messages. */
   uint32_t sequence_number;
 
+  /** Sequence numbers of observation domains other than the current
+   * one. */
+  std::map<uint32_t, uint32_t> domain_sequence_numbers;
+
+  /** Number of data records in this message so far. */
+  uint32_t n_message_records;
+
   /** Observation domain for messages; see RFC 5101. */
   uint32_t observation_domain;
 
@@ -62,7 +62,7 @@ PlacementTemplate::PlacementInfo::PlacementInfo(const InfoElement *_ie,
     : ie(_ie), address(_address), size_on_wire(_size_on_wire) {}
 
 PlacementTemplate::PlacementTemplate()
-    : buf(0), size(0), fixlen_data_record_size(0), template_id(0)
+    : buf(0), size(0), fixlen_data_record_size(0), template_id(0), codec(0)
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
       ,
       logger(
@@ -184,7 +184,9 @@ void PlacementTemplate::wire_template(uint16_t _template_id,
 
       uint32_t ie_pen = htonl((*i)->pen());
       uint16_t ie_id = htons((*i)->number() | (ie_pen == 0 ? 0 : (1 << 15)));
-      uint16_t ie_len = htons((*i)->len());
+      /* Use the size given at registration, so that reduced-length
+       * encoding shows up in the template. */
+      uint16_t ie_len = htons(placements.find(*i)->second->size_on_wire);
       assert(p + sizeof(ie_id) <= buf + size);
       memcpy(p, &ie_id, sizeof ie_id);
       p += sizeof ie_id;
@@ -227,6 +229,12 @@ size_t PlacementTemplate::data_record_size() const {
 
 uint16_t PlacementTemplate::get_template_id() const { return template_id; }
 
+void PlacementTemplate::set_codec(const RecordCodec *_codec) {
+  codec = _codec;
+}
+
+const RecordCodec *PlacementTemplate::get_codec() const { return codec; }
+
 std::list<const InfoElement *>::const_iterator
 PlacementTemplate::begin() const {
   return ies.begin();
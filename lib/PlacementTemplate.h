@@ -43,6 +43,7 @@
 
 #include "IETemplate.h"
 #include "InfoElement.h"
+#include "RecordCodec.h"
 
 namespace libfc {
 
@@ -351,6 +352,24 @@ public:
    */
   uint16_t get_template_id() const;
 
+  /** Attaches a codec that decodes and encodes this template's data
+   * records without consulting a DecodePlan or EncodePlan.
+   *
+   * The codec must encode exactly the placements registered with
+   * this template, in registration order and with the registered
+   * sizes.  RecordMapper takes care of this.
+   *
+   * @param codec the codec, or 0 to use the generic plans; the codec
+   *     must live as long as this template
+   */
+  void set_codec(const RecordCodec *codec);
+
+  /** Returns the codec attached with set_codec().
+   *
+   * @return the codec, or 0 if there is none
+   */
+  const RecordCodec *get_codec() const;
+
   /** Returns an iterator over the InfoElements in this template.
    *
    * @return an iterator pointing to the first information element.
@@ -385,6 +404,9 @@ private:
   /** The template ID for the wire representation of this template. */
   mutable uint16_t template_id;
 
+  /** Codec for this template's data records, if any. */
+  const RecordCodec *codec;
+
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
   log4cplus::Logger logger;
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
@@ -0,0 +1,90 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Record coding specialized for a known layout
+ */
+
+#ifndef _LIBFC_RECORDCODEC_H_
+#define _LIBFC_RECORDCODEC_H_
+
+#include <cstdint>
+
+namespace libfc {
+
+class IETemplate;
+
+/** Decodes and encodes the data records of one placement template
+ * with code that knows the record layout in advance.
+ *
+ * DecodePlan and EncodePlan work for any placement template and any
+ * wire template, deciding for every field at run time how to
+ * transfer it.  A codec, attached to a placement template with
+ * PlacementTemplate::set_codec(), replaces them for the data records
+ * whose wire template it accepts.  Codecs are normally generated by
+ * RecordMapper.
+ */
+class RecordCodec {
+public:
+  virtual ~RecordCodec() {}
+
+  /** Tells whether decode() can decode data records of a given wire
+   * template.
+   *
+   * @param wire_template the wire template of a data set
+   *
+   * @return true if decode() can decode the data records, false if
+   *     the generic DecodePlan must be used
+   */
+  virtual bool can_decode(const IETemplate *wire_template) const = 0;
+
+  /** Decodes one data record into the placements of the placement
+   * template.
+   *
+   * @param buf the buffer containing the data record (and the
+   *     remaining data set)
+   * @param length length of the remaining data set
+   *
+   * @return number of bytes decoded
+   */
+  virtual uint16_t decode(const uint8_t *buf, uint16_t length) const = 0;
+
+  /** Encodes one data record from the placements of the placement
+   * template, in the order and with the sizes of its wire template.
+   *
+   * @param buf where to store the encoded record; there must be
+   *     space for PlacementTemplate::data_record_size() bytes
+   *
+   * @return number of bytes encoded
+   */
+  virtual uint16_t encode(uint8_t *buf) const = 0;
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_RECORDCODEC_H_
@@ -0,0 +1,374 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Compile-time mapping of records to wire layouts
+ */
+
+#ifndef _LIBFC_RECORDMAPPER_H_
+#define _LIBFC_RECORDMAPPER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "IETemplate.h"
+#include "IEType.h"
+#include "InfoElement.h"
+#include "InfoModel.h"
+#include "PlacementTemplate.h"
+#include "RecordCodec.h"
+
+#include "exceptions/FormatError.h"
+#include "exceptions/IESpecError.h"
+
+namespace libfc {
+
+/** Loads and stores integers in network byte order.
+ *
+ * Shifts instead of ntohl() and friends, since the buffer need not
+ * be aligned; compilers turn these loops into single byte-swapping
+ * loads and stores.
+ */
+template <typename T> struct BigEndianInteger {
+  typedef typename std::make_unsigned<T>::type unsigned_type;
+
+  static T load(const uint8_t *buf) {
+    unsigned_type v = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+      v = static_cast<unsigned_type>((v << 8) | buf[i]);
+    return static_cast<T>(v);
+  }
+
+  static void store(T value, uint8_t *buf) {
+    unsigned_type v = static_cast<unsigned_type>(value);
+    for (size_t i = sizeof(T); i > 0; i--) {
+      buf[i - 1] = static_cast<uint8_t>(v);
+      v = static_cast<unsigned_type>(v >> 8);
+    }
+  }
+};
+
+/** Codec for IE types whose values are integers in network byte
+ * order on the wire. */
+template <typename T> struct IntegerCodec {
+  typedef T native_type;
+  static const size_t wire_size = sizeof(T);
+
+  static void decode(const uint8_t *buf, T &v) {
+    v = BigEndianInteger<T>::load(buf);
+  }
+  static void encode(const T &v, uint8_t *buf) {
+    BigEndianInteger<T>::store(v, buf);
+  }
+};
+
+/** Codec for IE types whose values are floating-point numbers. */
+template <typename T, typename Bits> struct FloatCodec {
+  typedef T native_type;
+  static const size_t wire_size = sizeof(T);
+
+  static void decode(const uint8_t *buf, T &v) {
+    Bits bits = BigEndianInteger<Bits>::load(buf);
+    memcpy(&v, &bits, sizeof v);
+  }
+  static void encode(const T &v, uint8_t *buf) {
+    Bits bits;
+    memcpy(&bits, &v, sizeof bits);
+    BigEndianInteger<Bits>::store(bits, buf);
+  }
+};
+
+/** Codec for IE types whose values are copied unchanged, such as MAC
+ * and IPv6 addresses. */
+template <size_t n> struct OctetsCodec {
+  typedef uint8_t native_type[n];
+  static const size_t wire_size = n;
+
+  static void decode(const uint8_t *buf, native_type &v) {
+    memcpy(v, buf, n);
+  }
+  static void encode(const native_type &v, uint8_t *buf) {
+    memcpy(buf, v, n);
+  }
+};
+
+/** Codec for booleans, which RFC 2579 encodes as 1 for true and 2
+ * for false. */
+struct BooleanCodec {
+  typedef bool native_type;
+  static const size_t wire_size = 1;
+
+  static void decode(const uint8_t *buf, bool &v) {
+    if (*buf != 1 && *buf != 2)
+      throw FormatError("bool encoding wrong");
+    v = *buf == 1;
+  }
+  static void encode(const bool &v, uint8_t *buf) { *buf = v ? 1 : 2; }
+};
+
+/** The native type and wire encoding of an IE type.
+ *
+ * The native types are those that DecodePlan and EncodePlan expect
+ * at placements.  There is no codec for octet arrays and strings,
+ * since they have no fixed size; records containing them must be
+ * collected and exported with plain placement templates.
+ */
+template <unsigned int ie_type> struct IETypeCodec;
+
+template <>
+struct IETypeCodec<IEType::kUnsigned8> : public IntegerCodec<uint8_t> {};
+template <>
+struct IETypeCodec<IEType::kUnsigned16> : public IntegerCodec<uint16_t> {};
+template <>
+struct IETypeCodec<IEType::kUnsigned32> : public IntegerCodec<uint32_t> {};
+template <>
+struct IETypeCodec<IEType::kUnsigned64> : public IntegerCodec<uint64_t> {};
+template <>
+struct IETypeCodec<IEType::kSigned8> : public IntegerCodec<int8_t> {};
+template <>
+struct IETypeCodec<IEType::kSigned16> : public IntegerCodec<int16_t> {};
+template <>
+struct IETypeCodec<IEType::kSigned32> : public IntegerCodec<int32_t> {};
+template <>
+struct IETypeCodec<IEType::kSigned64> : public IntegerCodec<int64_t> {};
+template <>
+struct IETypeCodec<IEType::kFloat32> : public FloatCodec<float, uint32_t> {};
+template <>
+struct IETypeCodec<IEType::kFloat64> : public FloatCodec<double, uint64_t> {};
+template <> struct IETypeCodec<IEType::kBoolean> : public BooleanCodec {};
+template <> struct IETypeCodec<IEType::kMacAddress> : public OctetsCodec<6> {};
+template <>
+struct IETypeCodec<IEType::kDateTimeSeconds> : public IntegerCodec<uint32_t> {};
+template <>
+struct IETypeCodec<IEType::kDateTimeMilliseconds>
+    : public IntegerCodec<uint64_t> {};
+template <>
+struct IETypeCodec<IEType::kDateTimeMicroseconds>
+    : public IntegerCodec<uint64_t> {};
+template <>
+struct IETypeCodec<IEType::kDateTimeNanoseconds>
+    : public IntegerCodec<uint64_t> {};
+template <>
+struct IETypeCodec<IEType::kIpv4Address> : public IntegerCodec<uint32_t> {};
+template <>
+struct IETypeCodec<IEType::kIpv6Address> : public OctetsCodec<16> {};
+
+/** A member of a record that holds the value of an IE.
+ *
+ * Don't use this directly; declare fields with LIBFC_MAPPED_FIELD,
+ * which also supplies the IE name.
+ */
+template <typename Record, typename Member, Member Record::*member,
+          unsigned int ie_type>
+struct MappedField {
+  typedef IETypeCodec<ie_type> codec;
+
+  static_assert(std::is_same<Member, typename codec::native_type>::value,
+                "the type of the member is not the native type of the IE");
+
+  static const unsigned int type = ie_type;
+
+  static Member &get(Record &r) { return r.*member; }
+  static const Member &get(const Record &r) { return r.*member; }
+};
+
+/** Declares a field for RecordMapper.
+ *
+ * @param field name of the field type to declare
+ * @param record the record type
+ * @param member the member of the record that holds the value
+ * @param ie_name the name of the IE, as in the information model
+ * @param ie_type the IE type, such as IEType::kUnsigned64
+ */
+#define LIBFC_MAPPED_FIELD(field, record, member, ie_name, ie_type)            \
+  struct field                                                                 \
+      : public ::libfc::MappedField<record, decltype(record::member),          \
+                                    &record::member, ie_type> {                \
+    static const char *name() { return ie_name; }                              \
+  }
+
+/** The fields of a RecordMapper, laid out one after the other. */
+template <typename Record, typename... Fields> struct MappedFields;
+
+template <typename Record> struct MappedFields<Record> {
+  static const size_t wire_size = 0;
+
+  static void decode(const uint8_t *buf, Record &r) {}
+  static void encode(const Record &r, uint8_t *buf) {}
+  static void
+  register_placements(PlacementTemplate *t, Record *r,
+                      std::vector<std::pair<const InfoElement *, size_t> > *) {}
+};
+
+template <typename Record, typename Field, typename... Rest>
+struct MappedFields<Record, Field, Rest...> {
+  typedef typename Field::codec codec;
+  typedef MappedFields<Record, Rest...> rest;
+
+  static const size_t wire_size = codec::wire_size + rest::wire_size;
+
+  static void decode(const uint8_t *buf, Record &r) {
+    codec::decode(buf, Field::get(r));
+    rest::decode(buf + codec::wire_size, r);
+  }
+
+  static void encode(const Record &r, uint8_t *buf) {
+    codec::encode(Field::get(r), buf);
+    rest::encode(r, buf + codec::wire_size);
+  }
+
+  static void register_placements(
+      PlacementTemplate *t, Record *r,
+      std::vector<std::pair<const InfoElement *, size_t> > *ies) {
+    const InfoElement *ie = InfoModel::instance().lookupIE(Field::name());
+    if (ie == 0)
+      throw IESpecError(std::string("unknown IE ") + Field::name());
+    if (ie->ietype() == 0 || ie->ietype()->number() != Field::type)
+      throw IESpecError(std::string("IE ") + Field::name() +
+                        " does not have the declared type");
+
+    const size_t size = codec::wire_size;
+    t->register_placement(ie, &Field::get(*r), size);
+    ies->push_back(std::make_pair(ie, size));
+    rest::register_placements(t, r, ies);
+  }
+};
+
+/** Maps the members of a record type to IEs at compile time.
+ *
+ * Instead of registering a void pointer and a size for each IE with
+ * a PlacementTemplate, declare the fields once:
+ *
+ * @code
+ * struct Flow {
+ *   uint32_t sip;
+ *   uint16_t sp;
+ *   uint64_t octets;
+ * };
+ *
+ * LIBFC_MAPPED_FIELD(FlowSip, Flow, sip, "sourceIPv4Address",
+ *                    IEType::kIpv4Address);
+ * LIBFC_MAPPED_FIELD(FlowSp, Flow, sp, "sourceTransportPort",
+ *                    IEType::kUnsigned16);
+ * LIBFC_MAPPED_FIELD(FlowOctets, Flow, octets, "octetDeltaCount",
+ *                    IEType::kUnsigned64);
+ *
+ * typedef RecordMapper<Flow, FlowSip, FlowSp, FlowOctets> FlowMapper;
+ * @endcode
+ *
+ * A member whose type isn't the native type of the IE type (say, a
+ * uint32_t for an unsigned64 IE) is a compile-time error.  The IE
+ * names are looked up, and their types checked, when the mapper is
+ * constructed.
+ *
+ * A mapper is bound to a record and provides a placement template
+ * for it, which can be used with PlacementCollector and
+ * PlacementExporter like any other.  The difference is in the
+ * decoding and encoding: the mapper is the template's RecordCodec.
+ * It exports the fields in declaration order with their native
+ * sizes, and it decodes data records that have exactly this layout
+ * with a straight-line sequence of loads and stores generated at
+ * compile time, instead of a DecodePlan that dispatches on IE types
+ * for every field.  Data records with other layouts (other exporters,
+ * reduced-length encoding, additional IEs) are still decoded by the
+ * DecodePlan.
+ */
+template <typename Record, typename... Fields>
+class RecordMapper : public RecordCodec {
+public:
+  typedef MappedFields<Record, Fields...> fields;
+
+  /** Size of a data record as exported. */
+  static const size_t wire_size = fields::wire_size;
+
+  /** Creates a mapper and its placement template.
+   *
+   * @param record the record whose members are the placements
+   *
+   * @throw IESpecError if an IE is unknown or has another type than
+   *     the one declared
+   */
+  explicit RecordMapper(Record *record) : record(record) {
+    fields::register_placements(&tmpl, record, &ies);
+    tmpl.set_codec(this);
+  }
+
+  /** Returns the placement template for the record.
+   *
+   * @return the placement template
+   */
+  PlacementTemplate *get_template() { return &tmpl; }
+
+  /** Returns the record that the mapper is bound to.
+   *
+   * @return the record
+   */
+  Record *get_record() const { return record; }
+
+  bool can_decode(const IETemplate *wire_template) const {
+    if (wire_template->size() != ies.size())
+      return false;
+
+    auto w = wire_template->begin();
+    for (auto i = ies.begin(); i != ies.end(); ++i, ++w)
+      if (!(*w)->matches(*i->first) || (*w)->len() != i->second)
+        return false;
+    return true;
+  }
+
+  uint16_t decode(const uint8_t *buf, uint16_t length) const {
+    if (length < wire_size)
+      throw FormatError("data record shorter than its template");
+    fields::decode(buf, *record);
+    return wire_size;
+  }
+
+  uint16_t encode(uint8_t *buf) const {
+    fields::encode(*record, buf);
+    return wire_size;
+  }
+
+private:
+  /* Not copyable, since the template points to this mapper. */
+  RecordMapper(const RecordMapper &);
+  RecordMapper &operator=(const RecordMapper &);
+
+  Record *record;
+  PlacementTemplate tmpl;
+  /** The IEs and their sizes on the wire, in declaration order. */
+  std::vector<std::pair<const InfoElement *, size_t> > ies;
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_RECORDMAPPER_H_
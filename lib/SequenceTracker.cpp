@@ -0,0 +1,225 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sstream>
+
+#ifdef _LIBFC_HAVE_LOG4CPLUS_
+#include <log4cplus/loggingmacros.h>
+#else
+#define LOG4CPLUS_TRACE(logger, expr)
+#define LOG4CPLUS_WARN(logger, expr)
+#endif /* _LIBFC_HAVE_LOG4CPLUS_ */
+
+#include "SequenceTracker.h"
+
+namespace libfc {
+
+SequenceTracker::Stats::Stats()
+    : version(0), messages(0), records(0), lost(0), reordered(0),
+      duplicates(0), resets(0), unsynchronized(0), next_sequence_number(0) {}
+
+SequenceTracker::State::State()
+    : synchronized(false), current_sequence_number(0), current_records(0),
+      current_countable(true), n_recent(0), next_recent(0) {}
+
+SequenceTracker::SequenceTracker(uint32_t max_reorder_distance)
+    : max_reorder_distance(max_reorder_distance), current(0), last(0),
+      last_key(0)
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+      ,
+      logger(log4cplus::Logger::getInstance(
+          LOG4CPLUS_TEXT("SequenceTracker")))
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+{
+}
+
+void SequenceTracker::start_message(const char *exporter, uint16_t version,
+                                    uint32_t observation_domain,
+                                    uint32_t sequence_number) {
+  if (current != 0) {
+    current->current_countable = false;
+    finish_message(current);
+  }
+
+  if (last == 0 || last_key->second != observation_domain ||
+      last_key->first != exporter) {
+    std::map<key_type, State>::iterator i =
+        states.insert(std::make_pair(key_type(exporter, observation_domain),
+                                     State())).first;
+    last_key = &i->first;
+    last = &i->second;
+  }
+
+  current = last;
+  current->stats.version = version;
+  current->current_sequence_number = sequence_number;
+  current->current_records = 0;
+  current->current_countable = true;
+}
+
+void SequenceTracker::add_records(uint32_t n_records) {
+  if (current != 0)
+    current->current_records += n_records;
+}
+
+void SequenceTracker::records_uncountable() {
+  if (current != 0)
+    current->current_countable = false;
+}
+
+void SequenceTracker::end_message() {
+  if (current != 0) {
+    finish_message(current);
+    current = 0;
+  }
+}
+
+void SequenceTracker::finish_message(State *s) {
+  Stats &stats = s->stats;
+  const bool is_v9 = stats.version == 9;
+  const uint32_t seq = s->current_sequence_number;
+
+  /* Sequence units covered by this message. */
+  const uint32_t units = is_v9 ? 1 : s->current_records;
+
+  /* Message boundaries are unaffected by uncountable records in v9,
+   * since v9 counts packets, not records. */
+  const bool countable = is_v9 || s->current_countable;
+
+  stats.messages++;
+  stats.records += s->current_records;
+
+  bool advance = true;
+
+  if (s->synchronized) {
+    /* Serial number arithmetic, RFC 1982. */
+    const int32_t diff = static_cast<int32_t>(seq - stats.next_sequence_number);
+    const uint32_t distance =
+        diff < 0 ? static_cast<uint32_t>(-static_cast<int64_t>(diff))
+                 : static_cast<uint32_t>(diff);
+
+    if (distance > max_reorder_distance) {
+      LOG4CPLUS_WARN(logger, "Sequence number jumped from "
+                                 << stats.next_sequence_number << " to " << seq
+                                 << ", assuming exporter restart");
+      stats.resets++;
+    } else if (diff > 0) {
+      LOG4CPLUS_TRACE(logger, "Sequence gap of " << diff << " (expected "
+                                                 << stats.next_sequence_number
+                                                 << ", got " << seq << ")");
+      stats.lost += diff;
+    } else if (diff < 0) {
+      advance = false;
+
+      bool is_duplicate = false;
+      for (unsigned int i = 0; i < s->n_recent; i++) {
+        if (s->recent[i].first == seq &&
+            (is_v9 || s->recent[i].second == s->current_records)) {
+          is_duplicate = true;
+          break;
+        }
+      }
+
+      if (is_duplicate)
+        stats.duplicates++;
+      else {
+        stats.reordered++;
+        /* This message fills (part of) an earlier gap. */
+        stats.lost -= stats.lost < units ? stats.lost : units;
+      }
+    }
+  }
+
+  if (advance) {
+    if (countable) {
+      stats.next_sequence_number = seq + units;
+      s->synchronized = true;
+    } else {
+      stats.unsynchronized++;
+      s->synchronized = false;
+    }
+  }
+
+  s->recent[s->next_recent] = std::make_pair(seq, s->current_records);
+  s->next_recent = (s->next_recent + 1) % kRecentMessages;
+  if (s->n_recent < kRecentMessages)
+    s->n_recent++;
+}
+
+const SequenceTracker::Stats *
+SequenceTracker::get_stats(const std::string &exporter,
+                           uint32_t observation_domain) const {
+  std::map<key_type, State>::const_iterator i =
+      states.find(key_type(exporter, observation_domain));
+  return i == states.end() ? 0 : &i->second.stats;
+}
+
+SequenceTracker::Stats SequenceTracker::get_totals() const {
+  Stats ret;
+  for (auto i = states.begin(); i != states.end(); ++i) {
+    const Stats &s = i->second.stats;
+    ret.messages += s.messages;
+    ret.records += s.records;
+    ret.lost += s.lost;
+    ret.reordered += s.reordered;
+    ret.duplicates += s.duplicates;
+    ret.resets += s.resets;
+    ret.unsynchronized += s.unsynchronized;
+  }
+  return ret;
+}
+
+std::map<SequenceTracker::key_type, SequenceTracker::Stats>
+SequenceTracker::get_all_stats() const {
+  std::map<key_type, Stats> ret;
+  for (auto i = states.begin(); i != states.end(); ++i)
+    ret[i->first] = i->second.stats;
+  return ret;
+}
+
+std::string SequenceTracker::to_string() const {
+  std::stringstream sstr;
+  for (auto i = states.begin(); i != states.end(); ++i) {
+    const Stats &s = i->second.stats;
+    sstr << i->first.first << " domain=" << i->first.second
+         << " version=" << s.version << " messages=" << s.messages
+         << " records=" << s.records << " lost=" << s.lost
+         << (s.version == 9 ? " packets" : " records")
+         << " reordered=" << s.reordered << " duplicates=" << s.duplicates
+         << " resets=" << s.resets << " unsynchronized=" << s.unsynchronized
+         << std::endl;
+  }
+  return sstr.str();
+}
+
+void SequenceTracker::clear() {
+  states.clear();
+  current = 0;
+  last = 0;
+  last_key = 0;
+}
+
+} // namespace libfc
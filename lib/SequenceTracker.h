@@ -0,0 +1,253 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Per-exporter sequence number tracking and loss accounting.
+ */
+
+#ifndef _LIBFC_SEQUENCETRACKER_H_
+#define _LIBFC_SEQUENCETRACKER_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+#include <log4cplus/logger.h>
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+
+namespace libfc {
+
+/** Tracks message sequence numbers per exporter and observation domain.
+ *
+ * IPFIX and NetFlow v9 both carry a sequence number in the message
+ * header, but they count different things.  In IPFIX (RFC 7011,
+ * Chapter 3, Verse 1), the sequence number is the number of data
+ * records sent from the observation domain @em{before} this message,
+ * so the next expected sequence number is the current one plus the
+ * number of data records in the current message.  In NetFlow v9 (RFC
+ * 3954, Chapter 5, Verse 1), the sequence number counts export
+ * packets, so the next expected sequence number is simply the current
+ * one plus one.
+ *
+ * This class keeps, for every (exporter, observation domain) pair, the
+ * next expected sequence number and compares it with what actually
+ * arrives.  Gaps are counted as losses (in records for IPFIX and in
+ * packets for v9); messages that arrive with a sequence number lower
+ * than expected are counted as reordered or duplicated, and reordered
+ * messages that fill an earlier gap are subtracted from the losses
+ * again.
+ *
+ * The exporter is identified by a name, which is usually the name of
+ * the InputSource from which the message was read.  For UDP input
+ * sources, this is the address of the peer that sent the datagram.
+ *
+ * Together with the socket drop counter of UDPInputSource, this
+ * allows you to tell apart losses in the network (sequence gaps
+ * without socket drops), in the socket buffer (socket drops), and in
+ * libfc itself (data sets that could not be decoded, see
+ * Stats::unsynchronized).
+ */
+class SequenceTracker {
+public:
+  /** Loss accounting for one exporter and observation domain. */
+  struct Stats {
+    Stats();
+
+    /** Message version number of the last message (9 or 10). */
+    uint16_t version;
+
+    /** Number of messages seen. */
+    uint64_t messages;
+
+    /** Number of data records seen. */
+    uint64_t records;
+
+    /** Number of sequence units that were skipped and that have not
+     * arrived late.  Sequence units are data records for IPFIX and
+     * export packets for v9. */
+    uint64_t lost;
+
+    /** Number of messages that arrived later than a message with a
+     * higher sequence number. */
+    uint64_t reordered;
+
+    /** Number of messages that had already been seen. */
+    uint64_t duplicates;
+
+    /** Number of times the sequence number jumped back so far that
+     * we assumed that the exporter restarted. */
+    uint64_t resets;
+
+    /** Number of messages after which the next sequence number
+     * could not be predicted, usually because the message contained
+     * a data set for an unknown template, whose records could not be
+     * counted.  Losses across such messages are not counted. */
+    uint64_t unsynchronized;
+
+    /** The next expected sequence number. */
+    uint32_t next_sequence_number;
+  };
+
+  /** Identifies an exporter: exporter name and observation domain. */
+  typedef std::pair<std::string, uint32_t> key_type;
+
+  /** Creates a sequence tracker.
+   *
+   * @param max_reorder_distance the largest backward jump in
+   *   sequence units that is still counted as reordering; anything
+   *   larger is counted as an exporter restart.
+   */
+  SequenceTracker(uint32_t max_reorder_distance = kDefaultMaxReorderDistance);
+
+  /** Signals that a new message has started.
+   *
+   * If the previous message has not been finished with
+   * end_message() (for example because an error aborted its
+   * parse), it is finished now, but its records are considered
+   * uncountable.
+   *
+   * @param exporter the name of the exporter
+   * @param version the message version number (9 or 10)
+   * @param observation_domain observation domain (or v9 source ID)
+   * @param sequence_number sequence number from the message header
+   */
+  void start_message(const char *exporter, uint16_t version,
+                     uint32_t observation_domain, uint32_t sequence_number);
+
+  /** Adds data records to the current message.
+   *
+   * @param n_records number of data records in a data set
+   */
+  void add_records(uint32_t n_records);
+
+  /** Signals that the current message contains data records that
+   * could not be counted. */
+  void records_uncountable();
+
+  /** Signals that the current message has ended. */
+  void end_message();
+
+  /** Returns the statistics for an exporter and observation domain.
+   *
+   * @param exporter the name of the exporter
+   * @param observation_domain the observation domain
+   *
+   * @return a pointer to the statistics, or 0 if no message has been
+   *   seen from that exporter and observation domain
+   */
+  const Stats *get_stats(const std::string &exporter,
+                         uint32_t observation_domain) const;
+
+  /** Returns the sum of the statistics over all exporters.
+   *
+   * The fields version and next_sequence_number are meaningless in
+   * the result.
+   *
+   * @return the accumulated statistics
+   */
+  Stats get_totals() const;
+
+  /** Returns the statistics of all exporters.
+   *
+   * @return a map from (exporter, observation domain) to statistics
+   */
+  std::map<key_type, Stats> get_all_stats() const;
+
+  /** Returns a printable report of the statistics, one line per
+   * exporter and observation domain.
+   *
+   * @return a printable report
+   */
+  std::string to_string() const;
+
+  /** Forgets all exporters. */
+  void clear();
+
+  /** Default for the maximum reordering distance. */
+  static const uint32_t kDefaultMaxReorderDistance = 65536;
+
+private:
+  /** Number of recent messages remembered for duplicate detection. */
+  static const unsigned int kRecentMessages = 16;
+
+  struct State {
+    State();
+
+    Stats stats;
+
+    /** True if next_sequence_number in stats is meaningful. */
+    bool synchronized;
+
+    /** Sequence number of the current message. */
+    uint32_t current_sequence_number;
+
+    /** Number of data records in the current message so far. */
+    uint32_t current_records;
+
+    /** False if the current message contains uncountable records. */
+    bool current_countable;
+
+    /** Sequence numbers and record counts of recent messages. */
+    std::pair<uint32_t, uint32_t> recent[kRecentMessages];
+
+    /** Number of valid entries in recent. */
+    unsigned int n_recent;
+
+    /** Where to put the next entry in recent. */
+    unsigned int next_recent;
+  };
+
+  /** Classifies the current message once its length is known. */
+  void finish_message(State *s);
+
+  uint32_t max_reorder_distance;
+
+  std::map<key_type, State> states;
+
+  /** The state belonging to the current message, or 0 if there is
+   * no current message. */
+  State *current;
+
+  /** The state belonging to the most recent message, or 0.  This
+   * is a cache that saves a map lookup for consecutive messages
+   * from the same exporter. */
+  State *last;
+
+  /** The key belonging to last. */
+  const key_type *last_key;
+
+#if defined(_LIBFC_HAVE_LOG4CPLUS_)
+  log4cplus::Logger logger;
+#endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_SEQUENCETRACKER_H_
@@ -0,0 +1,180 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "PlacementCollector.h"
+#include "StatDatInputSource.h"
+
+namespace libfc {
+
+StatDatInputSource::StatDatInputSource(const std::string &dat_name,
+                                       const std::string &stat_name)
+    : dat_name(dat_name),
+      stat(stat_name.empty() ? stat_name_for(dat_name) : stat_name), io(0),
+      lines(kLineBatch), next_line_index(0), n_lines(0), data(kBlockSize),
+      begin(0), end(0), datagram(0), datagram_length(0), datagram_read(0),
+      one_datagram(false), offset(0) {
+  snprintf(name, sizeof(name), "%s", "<stat+dat>");
+
+  if (!stat.good()) {
+    set_error(Error::system_error, 0, stat.get_message());
+    return;
+  }
+
+  io = wandio_create(dat_name.c_str());
+  if (io == 0)
+    set_error(Error::system_error, errno, "wandio cannot open " + dat_name);
+}
+
+StatDatInputSource::~StatDatInputSource() {
+  if (io != 0)
+    wandio_destroy(io);
+}
+
+std::string StatDatInputSource::stat_name_for(const std::string &dat_name) {
+  std::string::size_type dat = dat_name.rfind(".dat");
+  if (dat == std::string::npos)
+    return dat_name + ".stat";
+  return dat_name.substr(0, dat) + ".stat" + dat_name.substr(dat + 4);
+}
+
+void StatDatInputSource::set_error(Error::error_t e, int system_errno,
+                                   const std::string &explanation) {
+  error = std::make_shared<ErrorContext>(ErrorContext::fatal, Error(e),
+                                         system_errno, explanation.c_str(),
+                                         this, nullptr, 0, 0);
+}
+
+bool StatDatInputSource::next_line() {
+  if (next_line_index < n_lines)
+    return true;
+
+  n_lines = stat.next_ps(lines.data(), kLineBatch);
+  next_line_index = 0;
+  if (n_lines == 0 && !stat.eof())
+    set_error(Error::format_error, 0, stat.get_message());
+  return n_lines > 0;
+}
+
+bool StatDatInputSource::fill(size_t length) {
+  if (end - begin >= length)
+    return true;
+
+  memmove(data.data(), data.data() + begin, end - begin);
+  end -= begin;
+  begin = 0;
+
+  while (end < length) {
+    off_t n = wandio_read(io, data.data() + end, data.size() - end);
+    if (n < 0) {
+      set_error(Error::system_error, errno, "Error reading " + dat_name);
+      return false;
+    }
+    if (n == 0) {
+      set_error(Error::short_body, 0,
+                dat_name + " ends before the datagrams in its stat file");
+      return false;
+    }
+    end += n;
+  }
+  return true;
+}
+
+bool StatDatInputSource::next_datagram() {
+  if (error != 0 || !next_line())
+    return false;
+
+  const StatParser::PLine &line = lines[next_line_index++];
+  if (!fill(line.length))
+    return false;
+
+  offset += datagram_length;
+  datagram = data.data() + begin;
+  datagram_length = line.length;
+  datagram_read = 0;
+  begin += line.length;
+
+  snprintf(name, sizeof(name), "%u.%u.%u.%u:%u", line.source_address[0],
+           line.source_address[1], line.source_address[2],
+           line.source_address[3], line.port);
+  return true;
+}
+
+std::shared_ptr<ErrorContext> StatDatInputSource::demultiplex(
+    std::function<PlacementCollector *(const char *exporter)> collector_for) {
+  one_datagram = true;
+  while (next_datagram()) {
+    PlacementCollector *c = collector_for(name);
+    if (c == 0)
+      continue;
+
+    std::shared_ptr<ErrorContext> e = c->collect(*this);
+    if (e != 0 && e->get_error() != Error::no_error) {
+      one_datagram = false;
+      return e;
+    }
+  }
+  one_datagram = false;
+  return error;
+}
+
+ssize_t StatDatInputSource::read(uint8_t *buf, uint16_t len) {
+  while (datagram_read == datagram_length) {
+    if (one_datagram || !next_datagram())
+      return error != 0 ? -1 : 0;
+  }
+
+  size_t n = std::min<size_t>(len, datagram_length - datagram_read);
+  memcpy(buf, datagram + datagram_read, n);
+  datagram_read += n;
+  return n;
+}
+
+ssize_t StatDatInputSource::peek(uint8_t *buf, uint16_t len) {
+  /* The end of a datagram is the end of a message. */
+  size_t n = std::min<size_t>(len, datagram_length - datagram_read);
+  memcpy(buf, datagram + datagram_read, n);
+  return n;
+}
+
+bool StatDatInputSource::resync() {
+  datagram_read = datagram_length;
+  return true;
+}
+
+size_t StatDatInputSource::get_message_offset() const { return offset; }
+
+void StatDatInputSource::advance_message_offset() {}
+
+const char *StatDatInputSource::get_name() const { return name; }
+
+bool StatDatInputSource::can_peek() const { return true; }
+
+} // namespace libfc
@@ -0,0 +1,179 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Input from stat+dat capture files
+ */
+
+#ifndef _LIBFC_STATDATINPUTSOURCE_H_
+#define _LIBFC_STATDATINPUTSOURCE_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <wandio.h>
+}
+
+#include "ErrorContext.h"
+#include "InputSource.h"
+#include "StatParser.h"
+
+namespace libfc {
+
+class PlacementCollector;
+
+/** Reads the datagrams of a dat file, as described by its stat file.
+ *
+ * A dat file holds captured datagrams back to back, and its stat
+ * file has a P-line for each of them, giving its length and the
+ * exporter that sent it.  This input source walks both in lock-step,
+ * so that it can give each datagram its bounds and its exporter.
+ *
+ * Read as a whole, this is a message-based input source like a UDP
+ * socket: a message never extends beyond its datagram, and
+ * get_name() returns the exporter of the current datagram, so that
+ * sequence numbers are tracked per exporter.  Since different
+ * exporters may use the same template IDs, their datagrams should
+ * rather go to a collector each, which demultiplex() does.
+ *
+ * The dat file is read through wandio, and so may be compressed; it
+ * is read in large blocks.  The stat file is mapped into memory.
+ */
+class StatDatInputSource : public InputSource {
+public:
+  /** Creates a stat+dat input source.
+   *
+   * @param dat_name the name of the dat file
+   * @param stat_name the name of the stat file, or empty to take the
+   *   name of the dat file with ".dat" replaced by ".stat"
+   */
+  StatDatInputSource(const std::string &dat_name,
+                     const std::string &stat_name = "");
+
+  ~StatDatInputSource();
+
+  ssize_t read(uint8_t *buf, uint16_t len);
+  ssize_t peek(uint8_t *buf, uint16_t len);
+  bool resync();
+  size_t get_message_offset() const;
+  void advance_message_offset();
+  /** Returns the name of this input source.
+   *
+   * This is the exporter of the current datagram, as address:port.
+   *
+   * @return the exporter of the current datagram, or "<stat+dat>" if
+   *   there is none yet
+   */
+  const char *get_name() const;
+  bool can_peek() const;
+
+  /** Moves to the next datagram, skipping the rest of the current
+   * one.
+   *
+   * @return true if there is a next datagram, false at the end of
+   *   the files or on error; check get_error() to tell them apart
+   */
+  bool next_datagram();
+
+  /** Collects every datagram with the collector of its exporter.
+   *
+   * This keeps the template spaces of the exporters apart in a
+   * single pass over the files.
+   *
+   * @param collector_for returns the collector for the datagrams of
+   *   an exporter, given as address:port.  It is called for every
+   *   datagram, so it should be fast for exporters seen before.
+   *
+   * @return the first error reported by a collector or while
+   *   reading, or 0
+   */
+  std::shared_ptr<ErrorContext>
+  demultiplex(std::function<PlacementCollector *(const char *exporter)>
+                  collector_for);
+
+  /** Returns the error that occurred while opening or reading the
+   * files.
+   *
+   * @return a shared pointer to an error context, NULL if there was
+   *   no error
+   */
+  std::shared_ptr<ErrorContext> get_error() { return error; }
+
+  /** Returns the stat file name for a dat file name.
+   *
+   * @param dat_name the name of a dat file
+   *
+   * @return dat_name with the last ".dat" replaced by ".stat", or
+   *   with ".stat" appended if there is no ".dat"
+   */
+  static std::string stat_name_for(const std::string &dat_name);
+
+private:
+  /** Size of the block in which the dat file is read. */
+  static const size_t kBlockSize = 1 << 20;
+  /** Number of P-lines parsed at a time. */
+  static const size_t kLineBatch = 256;
+
+  void set_error(Error::error_t e, int system_errno,
+                 const std::string &explanation);
+  bool next_line();
+  bool fill(size_t length);
+
+  std::string dat_name;
+  StatParser stat;
+  io_t *io;
+
+  /** P-lines parsed but not used yet. */
+  std::vector<StatParser::PLine> lines;
+  size_t next_line_index;
+  size_t n_lines;
+
+  /** Data read from the dat file; data[begin, end) is not used yet. */
+  std::vector<uint8_t> data;
+  size_t begin;
+  size_t end;
+
+  /** The current datagram, and how much of it has been read. */
+  const uint8_t *datagram;
+  size_t datagram_length;
+  size_t datagram_read;
+  /** Whether read() stops at the end of the current datagram. */
+  bool one_datagram;
+
+  /** Offset of the current datagram in the dat file. */
+  size_t offset;
+  char name[sizeof "255.255.255.255:65535"];
+  std::shared_ptr<ErrorContext> error;
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_STATDATINPUTSOURCE_H_
@@ -24,8 +24,15 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <sstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
 #include <log4cplus/loggingmacros.h>
 #else
@@ -38,365 +45,258 @@
 
 namespace libfc {
 
+#define MAKE_MESSAGE(m, expr)                                                  \
+  do {                                                                         \
+    std::stringstream is;                                                      \
+    is << expr;                                                                \
+    m = is.str();                                                              \
+  } while (0)
+
 StatParser::StatParser(const std::string filename)
-    : filename(filename), is(filename), line_no(0), state(init)
+    : filename(filename), map(0), map_length(0), pos(0), end(0), line_no(0),
+      state(init)
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
       ,
       logger(log4cplus::Logger::getInstance(LOG4CPLUS_TEXT("StatParser")))
 #endif /* _LIBFC_HAVE_LOG4CPLUS_ */
 {
-  if (is.good())
-    state = good_state;
-  else if (is.fail() || is.bad()) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
     state = io_error;
     message = "File \"" + filename + "\" couldn't be opened";
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    map_length = st.st_size;
+    map = mmap(0, map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+      map = 0;
+  }
+
+  if (map != 0) {
+    madvise(map, map_length, MADV_SEQUENTIAL);
+    pos = static_cast<const char *>(map);
+    end = pos + map_length;
+    state = good_state;
+  } else if (read_file(fd)) {
+    /* Not a regular file, or empty, or not mappable. */
+    pos = contents.data();
+    end = pos + contents.size();
+    state = good_state;
   } else {
-    state = other_error;
-    message = "Input file \"" + filename + "\"'s state isn't good() but "
-                                           "neither is it fail() or bad()";
+    state = io_error;
+    MAKE_MESSAGE(message, "File \"" << filename << "\" couldn't be read: "
+                                    << strerror(errno));
   }
+
+  close(fd);
 }
 
-static int char_to_int(char c) {
-  switch (c) {
-  case '0':
-    return 0;
-  case '1':
-    return 1;
-  case '2':
-    return 2;
-  case '3':
-    return 3;
-  case '4':
-    return 4;
-  case '5':
-    return 5;
-  case '6':
-    return 6;
-  case '7':
-    return 7;
-  case '8':
-    return 8;
-  case '9':
-    return 9;
-  default:
-    return -1;
-  }
+StatParser::~StatParser() {
+  if (map != 0)
+    munmap(map, map_length);
 }
 
-#define MAKE_MESSAGE(m, expr)                                                  \
-  do {                                                                         \
-    std::stringstream is;                                                      \
-    is << expr;                                                                \
-    m = is.str();                                                              \
-  } while (0)
+bool StatParser::read_file(int fd) {
+  static const size_t kChunk = 1 << 16;
+  size_t length = 0;
 
-bool StatParser::parse_uint16(std::string line, unsigned int *i, uint16_t *val,
-                              const std::string what) {
-  *val = 0;
+  while (true) {
+    contents.resize(length + kChunk);
+    ssize_t n = read(fd, contents.data() + length, kChunk);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    length += n;
+  }
+  contents.resize(length);
+  return true;
+}
 
-  while (*i < line.length() && isdigit(line[*i])) {
-    int next_digit = char_to_int(line[*i]);
+static inline bool is_digit(char c) {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
 
-    if (next_digit == -1) {
-      state = parse_error;
-      MAKE_MESSAGE(message, filename
-                                << ":" << line_no << ": while parsing " << what
-                                << ", supposed digit " << line[*i]
-                                << " neither 0, 1, 2, 3, 4, 5, 6, 7, "
-                                   "8, or 9. Have we switched from decimal "
-                                   "to something else while I wasn't looking?");
-      return false;
-    }
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    assert(next_digit >= 0 && next_digit <= 9);
+bool StatParser::parse_error_at(const char *p, const char *eol,
+                                const char *after, const char *expected) {
+  state = parse_error;
+  if (p >= eol)
+    MAKE_MESSAGE(message, filename << ":" << line_no << ": Line ends after "
+                                   << after);
+  else
+    MAKE_MESSAGE(message, filename << ":" << line_no << ": Expected "
+                                   << expected << " after " << after
+                                   << ", but got '" << *p << "'");
+  return false;
+}
+
+bool StatParser::parse_uint16(const char **p, const char *eol, uint16_t *val,
+                              const char *what) {
+  const char *q = *p;
+  uint32_t v = 0;
 
-    if (*val > (UINT16_MAX - next_digit) / 10) {
+  while (q < eol && is_digit(*q)) {
+    v = 10 * v + (*q++ - '0');
+    if (v > UINT16_MAX) {
       state = parse_error;
       MAKE_MESSAGE(message, filename << ":" << line_no << ": " << what
                                      << " would overflow a uint16_t");
       return false;
     }
-
-    *val = 10 * (*val) + next_digit;
-    (*i)++;
   }
+
+  *val = v;
+  *p = q;
   return true;
 }
 
-bool StatParser::parse_uint8(std::string line, unsigned int *i, uint8_t *val,
-                             char delim, const std::string what) {
-  *val = 0;
+bool StatParser::parse_uint8(const char **p, const char *eol, uint8_t *val,
+                             char delim, const char *what) {
+  const char *q = *p;
+  uint32_t v = 0;
 
-  while (*i < line.length() && isdigit(line[*i])) {
-    int next_digit = char_to_int(line[*i]);
-
-    if (next_digit == -1) {
-      state = parse_error;
-      MAKE_MESSAGE(message, filename
-                                << ":" << line_no << ": wile parsing " << what
-                                << ", supposed digit " << line[*i]
-                                << " neither 0, 1, 2, 3, 4, 5, 6, "
-                                   "7, 8, or 9. Have we switched from decimal "
-                                   "to something else while I wasn't looking?");
-      return false;
-    }
-
-    assert(next_digit >= 0 && next_digit <= 9);
-
-    if (*val > (UINT8_MAX - next_digit) / 10) {
+  while (q < eol && is_digit(*q)) {
+    v = 10 * v + (*q++ - '0');
+    if (v > UINT8_MAX) {
       state = parse_error;
       MAKE_MESSAGE(message, filename << ":" << line_no << ": " << what
                                      << " would overflow a uint8_t");
       return false;
     }
+  }
 
-    *val = 10 * (*val) + next_digit;
-    (*i)++;
+  if (q >= eol || *q != delim) {
+    char expected[] = {'\'', delim, '\'', '\0'};
+    return parse_error_at(q, eol, what, expected);
   }
 
-  if (*i >= line.length()) {
-    state = parse_error;
-    MAKE_MESSAGE(message, filename << ":" << line_no << ": Line ends after "
-                                   << what);
+  *val = v;
+  *p = q + 1;
+  return true;
+}
+
+/** Parses a P-line.
+ *
+ * @param p the start of the line, just after the 'P'
+ * @param eol the end of the line, without the newline
+ */
+bool StatParser::parse_p(const char *p, const char *eol, uint16_t *length,
+                         uint8_t *source_address, uint16_t *port) {
+  while (p < eol && is_space(*p))
+    p++;
+  if (p >= eol || !is_digit(*p))
+    return parse_error_at(p, eol, "P", "digits");
+
+  /* Packet number */
+  while (p < eol && is_digit(*p))
+    p++;
+  if (p >= eol || !is_space(*p))
+    return parse_error_at(p, eol, "packet number", "spaces");
+  while (p < eol && is_space(*p))
+    p++;
+  if (p >= eol || !is_digit(*p))
+    return parse_error_at(p, eol, "packet number and spaces", "digits");
+
+  /* Relative time */
+  while (p < eol && is_digit(*p))
+    p++;
+  if (p >= eol || *p != '.')
+    return parse_error_at(p, eol, "integer part of relative time",
+                          "decimal point");
+  p++;
+  while (p < eol && is_digit(*p))
+    p++;
+  if (p >= eol || !is_space(*p))
+    return parse_error_at(p, eol, "relative time", "spaces");
+  while (p < eol && is_space(*p))
+    p++;
+  if (p >= eol || !is_digit(*p))
+    return parse_error_at(p, eol, "relative time and spaces", "digits");
+
+  if (!parse_uint16(&p, eol, length, "length"))
+    return false;
+  if (p >= eol || !is_space(*p))
+    return parse_error_at(p, eol, "length", "spaces");
+  while (p < eol && is_space(*p))
+    p++;
+  if (p >= eol || !is_digit(*p))
+    return parse_error_at(p, eol, "length and spaces", "digits");
+
+  if (!parse_uint8(&p, eol, &source_address[0], '.', "first IP address octet")
+      || !parse_uint8(&p, eol, &source_address[1], '.',
+                      "second IP address octet")
+      || !parse_uint8(&p, eol, &source_address[2], '.',
+                      "third IP address octet")
+      || !parse_uint8(&p, eol, &source_address[3], ':',
+                      "fourth IP address octet")
+      || !parse_uint16(&p, eol, port, "port"))
     return false;
-  }
 
-  if (line[*i] != delim) {
+  while (p < eol && is_space(*p))
+    p++;
+  if (p < eol) {
     state = parse_error;
-    MAKE_MESSAGE(message, filename << ":" << line_no << ": Expected '" << delim
-                                   << "' "
-                                      "after "
-                                   << what << ", but got '" << line[*i] << "'");
+    MAKE_MESSAGE(message,
+                 filename << ":" << line_no
+                          << ": There is non-blank junk at the end of the line");
     return false;
   }
-  (*i)++;
+
   return true;
 }
 
 bool StatParser::next_p(uint16_t *length, uint8_t *source_address,
                         uint16_t *port) {
-  if (state != good_state)
+  PLine line;
+
+  if (next_ps(&line, 1) == 0)
     return false;
 
-  bool found = false;
-
-  while (!found) {
-    std::string line;
-    if (!std::getline(is, line)) {
-      if (is.eof()) {
-        state = eof_state;
-        MAKE_MESSAGE(message, "Parse of \""
-                                  << filename
-                                  << "\" terminated normally due to EOF");
-      } else if (is.fail() || is.bad()) {
-        state = io_error;
-        MAKE_MESSAGE(message, "Parse of \"" << filename
-                                            << "\" terminated abnormally "
-                                               "due to an I/O error");
-      } else {
-        state = other_error;
-        MAKE_MESSAGE(message, "Parse of \"" << filename
-                                            << "\" terminated abnormally "
-                                               "due to an unknown error");
-      }
-      return false;
+  *length = line.length;
+  memcpy(source_address, line.source_address, sizeof line.source_address);
+  *port = line.port;
+  return true;
+}
+
+size_t StatParser::next_ps(PLine *lines, size_t n) {
+  if (state != good_state)
+    return 0;
+
+  size_t i = 0;
+  while (i < n) {
+    if (pos >= end) {
+      state = eof_state;
+      MAKE_MESSAGE(message, "Parse of \"" << filename
+                                          << "\" terminated normally due to EOF");
+      break;
     }
 
-    line_no++;
-    if (line.length() > 0 && line[0] == 'P') {
-      found = true;
-      unsigned int i = 1;
-      while (i < line.length() && isspace(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after P");
-        return false;
-      }
-
-      if (!isdigit(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Expected digits after P "
-                                          "and spaces, but got '"
-                                       << line[i] << "'");
-        return false;
-      }
-
-      while (i < line.length() && isdigit(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after packet number");
-        return false;
-      }
-
-      if (!isspace(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Expected spaces after "
-                                          "packet number, but got '"
-                                       << line[i] << "'");
-        return false;
-      }
-
-      while (i < line.length() && isspace(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after packet "
-                                          "number and spaces");
-        return false;
-      }
-
-      if (!isdigit(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Expected digits after "
-                                          "packet number, but got '"
-                                       << line[i] << "'");
-        return false;
-      }
-
-      while (i < line.length() && isdigit(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after integer "
-                                          "part of relative time");
-        return false;
-      }
-
-      if (line[i] != '.') {
-        state = parse_error;
-        MAKE_MESSAGE(message,
-                     filename << ":" << line_no
-                              << ": Relative time seems not to be a "
-                                 "floating-point number (no decimal point)");
-        return false;
-      }
+    const char *eol =
+        static_cast<const char *>(memchr(pos, '\n', end - pos));
+    const char *next = eol == 0 ? end : eol + 1;
+    if (eol == 0)
+      eol = end;
 
+    line_no++;
+    if (*pos == 'P') {
+      if (!parse_p(pos + 1, eol, &lines[i].length, lines[i].source_address,
+                   &lines[i].port))
+        break;
       i++;
-      while (i < line.length() && isdigit(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after relative time");
-        return false;
-      }
-
-      if (!isspace(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Expected spaces after "
-                                          "relative time, but got '"
-                                       << line[i] << "'");
-        return false;
-      }
-
-      while (i < line.length() && isspace(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message,
-                     filename << ":" << line_no
-                              << ": Line ends after relative time and spaces");
-        return false;
-      }
-
-      if (!isdigit(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Expected digits after "
-                                          "relative time, but got '"
-                                       << line[i] << "'");
-        return false;
-      }
-
-      if (!parse_uint16(line, &i, length, "length"))
-        return false;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename << ":" << line_no
-                                       << ": Line ends after length");
-        return false;
-      }
-
-      if (!isspace(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename
-                                  << ":" << line_no
-                                  << ": Expected spaces after length, but got '"
-                                  << line[i] << "'");
-        return false;
-      }
-
-      while (i < line.length() && isspace(line[i]))
-        i++;
-
-      if (i >= line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename
-                                  << ":" << line_no
-                                  << ": Line ends after length and spaces");
-        return false;
-      }
-
-      if (!isdigit(line[i])) {
-        state = parse_error;
-        MAKE_MESSAGE(message, filename
-                                  << ":" << line_no
-                                  << ": Expected digits after length, but got '"
-                                  << line[i] << "'");
-        return false;
-      }
-
-      if (!parse_uint8(line, &i, &source_address[0], '.',
-                       "first IP address octet"))
-        return false;
-      if (!parse_uint8(line, &i, &source_address[1], '.',
-                       "second IP address octet"))
-        return false;
-      if (!parse_uint8(line, &i, &source_address[2], '.',
-                       "third IP address octet"))
-        return false;
-      if (!parse_uint8(line, &i, &source_address[3], ':',
-                       "fourth IP address octet"))
-        return false;
-      if (!parse_uint16(line, &i, port, "port"))
-        return false;
-
-      while (i < line.length() && isspace(line[i]))
-        i++;
-
-      if (i < line.length()) {
-        state = parse_error;
-        MAKE_MESSAGE(message,
-                     filename
-                         << ":" << line_no
-                         << ": There is non-blank junk at the end of the line");
-        return false;
-      }
-
-      return true;
     }
+    pos = next;
   }
 
-  assert("You should never reach this" == 0);
-  return true;
+  return i;
 }
 
 bool StatParser::good() const { return state == good_state; }
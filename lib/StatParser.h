@@ -28,9 +28,10 @@
 #ifndef _LIBFC_STATPARSER_H_
 #define _LIBFC_STATPARSER_H_
 
+#include <cstddef>
 #include <cstdint>
-#include <fstream>
 #include <string>
+#include <vector>
 
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
 #include <log4cplus/logger.h>
@@ -44,6 +45,9 @@ namespace libfc {
  * dat files (containing the flow records).  Knowing what comes next
  * can make processing dat files much easier.  This class parses
  * such stat files.
+ *
+ * The file is mapped into memory and its lines are parsed where they
+ * are, without copying them.
  */
 class StatParser {
 public:
@@ -81,6 +85,19 @@ public:
    */
   StatParser(const std::string filename);
 
+  /** Destroys a StatParser, unmapping its file. */
+  ~StatParser();
+
+  /** A P-line, as returned by next_ps(). */
+  struct PLine {
+    /** The message length. */
+    uint16_t length;
+    /** The router's IP address in network byte order. */
+    uint8_t source_address[4];
+    /** The router's port. */
+    uint16_t port;
+  };
+
   /** Gets the next P-line from the stat file.
    *
    * @param length pointer to the message length
@@ -100,6 +117,19 @@ public:
    */
   bool next_p(uint16_t *length, uint8_t *source_address, uint16_t *port);
 
+  /** Gets the next P-lines from the stat file.
+   *
+   * This is the same as calling next_p() up to n times, but faster.
+   *
+   * @param lines where to put the P-lines
+   * @param n the maximum number of P-lines to get
+   *
+   * @return the number of P-lines got.  If this is less than n,
+   *   there was an error or the file ended; check with get_state()
+   *   and get_message().
+   */
+  size_t next_ps(PLine *lines, size_t n);
+
   /** Checks if the state of this parser is still good.
    *
    * This is a convenience function, equivalent to get_state() ==
@@ -131,8 +161,19 @@ public:
   const std::string get_message() const;
 
 private:
+  StatParser(const StatParser &);
+  StatParser &operator=(const StatParser &);
+
   std::string filename;
-  std::ifstream is;
+
+  /** The mapped file, or 0 if it is not mapped. */
+  void *map;
+  size_t map_length;
+  /** The contents of the file if it could not be mapped. */
+  std::vector<char> contents;
+  /** The next line to parse, and the end of the file. */
+  const char *pos;
+  const char *end;
 
   unsigned int line_no;
   state_t state;
@@ -142,11 +183,19 @@ private:
   log4cplus::Logger logger;
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
 
-  bool parse_uint8(std::string line, unsigned int *i, uint8_t *val, char delim,
-                   const std::string what);
+  bool read_file(int fd);
+
+  bool parse_p(const char *p, const char *eol, uint16_t *length,
+               uint8_t *source_address, uint16_t *port);
+
+  bool parse_uint8(const char **p, const char *eol, uint8_t *val, char delim,
+                   const char *what);
+
+  bool parse_uint16(const char **p, const char *eol, uint16_t *val,
+                    const char *what);
 
-  bool parse_uint16(std::string line, unsigned int *i, uint16_t *val,
-                    const std::string what);
+  bool parse_error_at(const char *p, const char *eol, const char *after,
+                      const char *expected);
 };
 
 } // namespace libfc
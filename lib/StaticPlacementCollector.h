@@ -0,0 +1,152 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief Placement collector with compile-time callbacks
+ */
+
+#ifndef _LIBFC_STATICPLACEMENTCOLLECTOR_H_
+#define _LIBFC_STATICPLACEMENTCOLLECTOR_H_
+
+#include "DecodePlan.h"
+#include "PlacementCollector.h"
+
+namespace libfc {
+
+/** Placement collector whose per-record callbacks are bound at
+ * compile time.
+ *
+ * A PlacementCollector gets two virtual calls for every record, each
+ * returning a shared pointer.  A StaticPlacementCollector is told its
+ * subclass as template argument (the "curiously recurring template
+ * pattern") and decodes whole data sets itself, calling the
+ * subclass's begin_record() and end_record() directly, so that the
+ * compiler can inline them into the decoding loop:
+ *
+ * @code
+ * class FlowCounter : public StaticPlacementCollector<FlowCounter> {
+ * public:
+ *   FlowCounter() : StaticPlacementCollector<FlowCounter>(ipfix) { ... }
+ *
+ *   bool end_record(const PlacementTemplate *tmpl) {
+ *     octets_total += octets;
+ *     return true;
+ *   }
+ * };
+ * @endcode
+ *
+ * Both member functions return true to continue and false to stop
+ * collecting, in which case collect() returns an error context with
+ * Error::aborted_by_user.  Both default to doing nothing, so a
+ * subclass need only hide the one it needs.  All other callbacks of
+ * PlacementCollector remain virtual, since they are called at most
+ * once per data set.
+ *
+ * @tparam Derived the subclass
+ */
+template <typename Derived>
+class StaticPlacementCollector : public PlacementCollector {
+public:
+  /** Creates a collector.
+   *
+   * @param protocol the protocol which we want to collect for
+   */
+  StaticPlacementCollector(Protocol protocol) : PlacementCollector(protocol) {}
+
+  /** Signals that placement of values will now begin.
+   *
+   * @param tmpl placement template for current placements
+   *
+   * @return true if collection should go on, false otherwise
+   */
+  bool begin_record(const PlacementTemplate *tmpl) { return true; }
+
+  /** Signals that placement of values has ended.
+   *
+   * @param tmpl placement template for current placements
+   *
+   * @return true if collection should go on, false otherwise
+   */
+  bool end_record(const PlacementTemplate *tmpl) { return true; }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  /* Used only by records(), which decodes one record at a time. */
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *tmpl) {
+    if (!static_cast<Derived *>(this)->begin_record(tmpl))
+      LIBFC_RETURN_ERROR(fatal, aborted_by_user, "begin_record() aborted", 0,
+                         0, 0, 0, 0);
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *tmpl) {
+    if (!static_cast<Derived *>(this)->end_record(tmpl))
+      LIBFC_RETURN_ERROR(fatal, aborted_by_user, "end_record() aborted", 0, 0,
+                         0, 0, 0);
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext>
+  decode_data_set(const PlacementTemplate *tmpl, DecodePlan &plan,
+                  const uint8_t *buf, uint16_t length, uint16_t min_length,
+                  uint32_t *n_records) {
+    Derived *self = static_cast<Derived *>(this);
+    const uint8_t *buf_end = buf + length;
+    const uint8_t *cur = buf;
+    uint32_t n = 0;
+
+    while (cur < buf_end && length >= min_length) {
+      if (!self->begin_record(tmpl)) {
+        *n_records = n;
+        LIBFC_RETURN_ERROR(fatal, aborted_by_user, "begin_record() aborted",
+                           0, 0, 0, 0, 0);
+      }
+      uint16_t consumed = plan.execute(cur, length);
+      if (!self->end_record(tmpl)) {
+        *n_records = n;
+        LIBFC_RETURN_ERROR(fatal, aborted_by_user, "end_record() aborted", 0,
+                           0, 0, 0, 0);
+      }
+      cur += consumed;
+      length -= consumed;
+      n++;
+    }
+
+    *n_records = n;
+    LIBFC_RETURN_OK();
+  }
+};
+
+} // namespace libfc
+
+#endif // _LIBFC_STATICPLACEMENTCOLLECTOR_H_
@@ -24,6 +24,8 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cerrno>
+
 #include <unistd.h>
 
 #include "TCPInputSource.h"
@@ -38,9 +40,20 @@ TCPInputSource::~TCPInputSource() {
 }
 
 ssize_t TCPInputSource::read(uint8_t *buf, uint16_t len) {
-  ssize_t ret = ::read(fd, buf, len);
-  if (ret > 0)
-    current_offset += message_offset;
+  /* The stream parsers expect to get all they ask for unless the
+   * stream ends, but a read from a socket may return less. */
+  ssize_t ret = 0;
+  while (ret < len) {
+    ssize_t n = ::read(fd, buf + ret, len - ret);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return -1;
+    if (n == 0)
+      break;
+    ret += n;
+  }
+  current_offset += ret;
   return ret;
 }
 
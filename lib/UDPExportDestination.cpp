@@ -19,15 +19,20 @@
 
 namespace libfc {
 
-    UDPExportDestination::UDPExportDestination( const struct  sockaddr * _sa, size_t _sa_len, int _fd)
-            : sa_len(_sa_len), fd(_fd)
+    UDPExportDestination::UDPExportDestination( const struct  sockaddr * _sa, size_t _sa_len, int _fd,
+                                                size_t _max_message_size)
+            : sa_len(_sa_len), fd(_fd),
+              max_message_size(_max_message_size == 0 || _max_message_size > kMaxMessageLen
+                               ? kMaxMessageLen : _max_message_size)
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
     , logger(log4cplus::Logger::getInstance(LOG4CPLUS_TEXT("FileExportDestination")))
 #endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
     {
+        if (sa_len > sizeof(sa))
+            sa_len = sizeof(sa);
         memcpy(&sa, _sa, sa_len);
         msg.msg_name = &sa;
-        msg.msg_namelen = sizeof(sa);
+        msg.msg_namelen = sa_len;
         msg.msg_control=nullptr;
         msg.msg_controllen=0;
     }
@@ -51,9 +56,7 @@ namespace libfc {
         msg.msg_iov = (iovec *) iovecs.data();
         msg.msg_iovlen = static_cast<int>(iovecs.size());
 
-        sendmsg(fd, &mg, 0);
-        return NULL;
-        //return ::writev(fd, iovecs.data(), static_cast<int>(iovecs.size()));
+        return sendmsg(fd, &msg, 0);
     }
 
     int UDPExportDestination::flush() {
@@ -64,7 +67,7 @@ namespace libfc {
     }
 
     size_t UDPExportDestination::preferred_maximum_message_size() const {
-        return kMaxMessageLen;
+        return max_message_size;
     }
 
 }
\ No newline at end of file
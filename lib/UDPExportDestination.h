@@ -7,7 +7,9 @@
 
 #endif //EXTRACTFEATURES_NOSLIDING_WINDOW_OSNT_UDPOUTPUTSOURCE_H
 
-#  include "OutputSource.h"
+
+#include <sys/socket.h>
+
 #include "ExportDestination.h"
 
 namespace libfc {
@@ -15,12 +17,19 @@ namespace libfc {
 
     class UDPExportDestination : public ExportDestination {
     public:
-        /** Creates a file export destination from an already existing
-         * file descriptor.
+        /** Creates a UDP export destination from an already existing
+         * socket.
          *
-         * @param fd file descriptor pointing to an open file
+         * @param sa address of the collector
+         * @param sa_len length of sa
+         * @param fd UDP socket to send from
+         * @param preferred_maximum_message_size largest message to
+         *   send, or 0 for the largest possible IPFIX message.  Use
+         *   the path MTU minus IP and UDP headers to avoid
+         *   fragmentation.
          */
-        UDPExportDestination(const struct  sockaddr * sa, size_t sa_len, int _fd);
+        UDPExportDestination(const struct  sockaddr * sa, size_t sa_len, int _fd,
+                             size_t preferred_maximum_message_size = 0);
 
         ssize_t writev(const std::vector<::iovec> &iovecs);
 
@@ -31,11 +40,12 @@ namespace libfc {
         size_t preferred_maximum_message_size() const;
 
     private:
-        struct sockaddr sa;
+        struct sockaddr_storage sa;
     struct msghdr msg;
 
     size_t sa_len;
         int fd;
+        size_t max_message_size;
 #  if defined(_LIBFC_HAVE_LOG4CPLUS_)
         log4cplus::Logger logger;
 #  endif /* defined(_LIBFC_HAVE_LOG4CPLUS_) */
@@ -23,33 +23,149 @@
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <cstdio>
+#include <cerrno>
 #include <cstring>
 
+#include <netdb.h>
 #include <sys/socket.h>
 
 #include "UDPInputSource.h"
-#include <stdio.h>
+
 namespace libfc {
 
+/** Room for the control messages that we ask for. */
+static const size_t kControlSpace = CMSG_SPACE(sizeof(uint32_t));
+
 UDPInputSource::UDPInputSource(const struct sockaddr *_remote,
-                               size_t _remote_len, int _fd)
-    : remote_len(_remote_len), fd(_fd) {
-  memcpy(&remote, _remote, _remote_len);
+                               size_t _remote_len, int _fd,
+                               unsigned int _batch_size)
+    : batch_size(_batch_size), batch_received(0), batch_next(0),
+      remote_len(_remote_len), fd(_fd), received_sa_len(0), socket_drops(0) {
+  if (remote_len > sizeof(remote))
+    remote_len = sizeof(remote);
+  memcpy(&remote, _remote, remote_len);
+  memset(&received_sa, 0, sizeof(received_sa));
+  strcpy(name, "<UDP socket>");
+
+#if !defined(MSG_WAITFORONE)
+  batch_size = 1;
+#endif /* !defined(MSG_WAITFORONE) */
+  if (batch_size == 0)
+    batch_size = 1;
+
+  if (batch_size > 1) {
+    batch_buffers.resize(batch_size * sizeof(packet_buffer));
+    batch_msgs.resize(batch_size);
+    batch_iovecs.resize(batch_size);
+    batch_addrs.resize(batch_size);
+    /* Aligned for struct cmsghdr, since kControlSpace is a multiple of
+     * the alignment and vector storage is aligned for any type. */
+    batch_controls.resize(batch_size * kControlSpace);
+  }
+
+#if defined(SO_RXQ_OVFL)
+  /* Ask the kernel to tell us how many datagrams it had to drop. */
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif /* defined(SO_RXQ_OVFL) */
 }
 
-ssize_t UDPInputSource::read(uint8_t *buf, uint16_t len) {
-  struct sockaddr received_sa;
-  socklen_t received_sa_len;
+ssize_t UDPInputSource::receive() {
+#if defined(MSG_WAITFORONE)
+  if (batch_size > 1) {
+    if (batch_next == batch_received) {
+      for (unsigned int i = 0; i < batch_size; i++) {
+        struct msghdr &msg = batch_msgs[i].msg_hdr;
+        batch_iovecs[i].iov_base = &batch_buffers[i * sizeof(packet_buffer)];
+        batch_iovecs[i].iov_len = sizeof(packet_buffer);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &batch_addrs[i];
+        msg.msg_namelen = sizeof(batch_addrs[i]);
+        msg.msg_iov = &batch_iovecs[i];
+        msg.msg_iovlen = 1;
+        msg.msg_control = &batch_controls[i * kControlSpace];
+        msg.msg_controllen = kControlSpace;
+      }
+
+      /* Block for the first datagram only, then take what's there. */
+      int n = recvmmsg(fd, batch_msgs.data(), batch_size, MSG_WAITFORONE, 0);
+      if (n < 0)
+        return -1;
+      batch_received = n;
+      batch_next = 0;
+    }
+
+    unsigned int i = batch_next++;
+    packet = &batch_buffers[i * sizeof(packet_buffer)];
+    received(&batch_msgs[i].msg_hdr);
+    return batch_msgs[i].msg_len;
+  }
+#endif /* defined(MSG_WAITFORONE) */
+
+  struct iovec iov;
+  iov.iov_base = packet_buffer;
+  iov.iov_len = sizeof(packet_buffer);
+
+  union {
+    struct cmsghdr align;
+    uint8_t buf[kControlSpace];
+  } control;
+
+  struct sockaddr_storage sa;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &sa;
+  msg.msg_namelen = sizeof(sa);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  ssize_t ret = recvmsg(fd, &msg, 0);
+  if (ret >= 0) {
+    packet = packet_buffer;
+    received(&msg);
+  }
+  return ret;
+}
+
+void UDPInputSource::received(const struct msghdr *msg) {
+  /* Looking up the name is expensive, and most datagrams come from
+   * the same peer as the one before. */
+  if (msg->msg_namelen != received_sa_len
+      || memcmp(msg->msg_name, &received_sa, received_sa_len) != 0) {
+    received_sa_len = msg->msg_namelen;
+    memcpy(&received_sa, msg->msg_name, received_sa_len);
+    update_name();
+  }
+
+#if defined(SO_RXQ_OVFL)
+  for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c != 0;
+       c = CMSG_NXTHDR(const_cast<struct msghdr *>(msg), c)) {
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL)
+      memcpy(&socket_drops, CMSG_DATA(c), sizeof(socket_drops));
+  }
+#endif /* defined(SO_RXQ_OVFL) */
+}
 
+ssize_t UDPInputSource::read(uint8_t *buf, uint16_t len) {
   // Wait for a packet if needed
   if (packet_read == packet_lenght) {
-    packet_lenght = recvfrom(fd, packet_buffer, sizeof(packet_buffer), 0,
-                             &received_sa, &received_sa_len);
+    packet_lenght = receive();
     packet_read = 0;
+
+    if (packet_lenght < 0) {
+      packet_lenght = 0;
+      /* A receive timeout ends the input like end of file. */
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      return -1;
+    }
   }
 
   if (packet_read + len <= packet_lenght) {
-    memcpy(buf, packet_buffer + packet_read, len);
+    memcpy(buf, packet + packet_read, len);
     packet_read += len;
   } else {
     return -1;
@@ -58,6 +174,20 @@ ssize_t UDPInputSource::read(uint8_t *buf, uint16_t len) {
   return len;
 }
 
+void UDPInputSource::update_name() {
+  char host[NI_MAXHOST];
+  char port[NI_MAXSERV];
+
+  if (getnameinfo(reinterpret_cast<const struct sockaddr *>(&received_sa),
+                  received_sa_len, host, sizeof(host), port, sizeof(port),
+                  NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+    if (received_sa.ss_family == AF_INET6)
+      snprintf(name, sizeof(name), "[%s]:%s", host, port);
+    else
+      snprintf(name, sizeof(name), "%s:%s", host, port);
+  }
+}
+
 bool UDPInputSource::resync() {
   packet_read = 0;
   packet_lenght = 0;
@@ -68,8 +198,10 @@ size_t UDPInputSource::get_message_offset() const { return 0; }
 
 void UDPInputSource::advance_message_offset() {}
 
-const char *UDPInputSource::get_name() const { return "<UDP socket>"; }
+const char *UDPInputSource::get_name() const { return name; }
 
 bool UDPInputSource::can_peek() const { return false; }
 
+uint32_t UDPInputSource::get_socket_drops() const { return socket_drops; }
+
 } // namespace libfc
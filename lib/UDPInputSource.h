@@ -33,6 +33,11 @@
 #ifndef _LIBFC_UDPINPUTSOURCE_H_
 #define _LIBFC_UDPINPUTSOURCE_H_
 
+#include <vector>
+
+#include <netdb.h>
+#include <sys/socket.h>
+
 #include "InputSource.h"
 
 namespace libfc {
@@ -40,28 +45,87 @@ namespace libfc {
 class UDPInputSource : public InputSource {
 public:
   /** Creates a UDP input source from a file descriptor.
+   *
+   * UDP has no end of file, so collecting from a UDP input source
+   * normally never ends.  If the socket has a receive timeout
+   * (SO_RCVTIMEO), running into that timeout ends the input as if
+   * it were the end of a file.
    *
    * @param remote the socket address of the peer from whom we accept messages
    * @param remote_len the length of the socket address, in bytes
    * @param fd the file descriptor belonging to a UDP socket
+   * @param batch_size maximum number of datagrams to receive with
+   *   one system call.  Values greater than 1 use recvmmsg(2) where
+   *   available, at the cost of a 64 KiB buffer per datagram.
    */
-  UDPInputSource(const struct sockaddr *remote, size_t remote_len, int fd);
+  UDPInputSource(const struct sockaddr *remote, size_t remote_len, int fd,
+                 unsigned int batch_size = 1);
 
   ssize_t read(uint8_t *buf, uint16_t len);
   bool resync();
   size_t get_message_offset() const;
   void advance_message_offset();
+  /** Returns the name of this input source.
+   *
+   * This is the numeric address and port of the peer that sent the
+   * most recent datagram, so that collectors can tell exporters
+   * apart, for example when tracking sequence numbers.
+   *
+   * @return the address of the most recent peer, or "<UDP socket>"
+   *   if nothing has been received yet
+   */
   const char *get_name() const;
   bool can_peek() const;
 
+  /** Returns the number of datagrams dropped by the kernel because
+   * the socket receive buffer was full.
+   *
+   * This needs support for SO_RXQ_OVFL (Linux 2.6.33 and later).
+   * Where that isn't available, this function always returns 0.
+   *
+   * @return number of datagrams dropped since the socket was opened
+   */
+  uint32_t get_socket_drops() const;
+
 private:
-  uint8_t packet_buffer[4096];
+  /** Receives the next datagram into packet.
+   *
+   * @return the length of the datagram, or -1 on error */
+  ssize_t receive();
+  void received(const struct msghdr *msg);
+  void update_name();
+
+  uint8_t packet_buffer[65536];
+  /** The current datagram. */
+  const uint8_t *packet = packet_buffer;
   ssize_t packet_lenght = 0;
   ssize_t packet_read = 0;
 
-  struct sockaddr remote;
+  /* For batched reception. */
+  unsigned int batch_size;
+  std::vector<uint8_t> batch_buffers;
+  std::vector<struct mmsghdr> batch_msgs;
+  std::vector<struct iovec> batch_iovecs;
+  std::vector<struct sockaddr_storage> batch_addrs;
+  std::vector<uint8_t> batch_controls;
+  /** Number of datagrams in the current batch. */
+  unsigned int batch_received;
+  /** Next datagram to take from the current batch. */
+  unsigned int batch_next;
+
+  struct sockaddr_storage remote;
   size_t remote_len;
   int fd;
+
+  /** Address of the most recent peer, for which name is valid. */
+  struct sockaddr_storage received_sa;
+  socklen_t received_sa_len;
+
+  /** Socket drop counter as reported with the most recent datagram. */
+  uint32_t socket_drops;
+
+  /** Printable address of the most recent peer. */
+  char name[NI_MAXHOST + NI_MAXSERV + 4];
 };
 
 } // namespace libfc
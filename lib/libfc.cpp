@@ -24,20 +24,41 @@
  * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
  * DAMAGE.
  */
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "libfc.h"
 
+#include "BufferInputSource.h"
+#include "FileExportDestination.h"
 #include "FileInputSource.h"
+#include "IEType.h"
 #include "InfoModel.h"
+#include "MemoryExportDestination.h"
 #include "PlacementCollector.h"
+#include "PlacementExporter.h"
 #include "PlacementTemplate.h"
+#include "StaticPlacementCollector.h"
+#include "TCPInputSource.h"
+#include "UDPExportDestination.h"
+#include "UDPInputSource.h"
 #include "WandioInputSource.h"
+#include "decode_util.h"
+#include "exceptions/ExportError.h"
 #include "exceptions/FormatError.h"
 #include "exceptions/IESpecError.h"
 
@@ -53,24 +74,49 @@
 
 using namespace libfc;
 
-static bool infomodel_initialized = false;
+static std::once_flag infomodel_initialized;
+
+/** Loads the default IPFIX information model, exactly once, even if
+ * several threads create template groups at the same time. */
+static void initialize_infomodel() {
+  std::call_once(infomodel_initialized,
+                 []() { InfoModel::instance().defaultIPFIX(); });
+}
 
 struct libfc_template_t {
   PlacementTemplate tmpl;
   int (*callback)(const libfc_template_t *t, void *vp);
   void *vparg;
+
+  /* Batch collection; see libfc_register_batch_callback().  Fields
+   * are placed into the staging record and copied into the next free
+   * slot of records when the record is complete. */
+  int (*batch_callback)(const libfc_template_t *t, void *records, size_t n,
+                        void *vp);
+  void *batch_vparg;
+  size_t stride;
+  size_t n_records;
+  std::vector<uint8_t> staging;
+  std::vector<uint8_t> records;
 };
 
-class CBinding : public PlacementCollector {
+class CBinding : public StaticPlacementCollector<CBinding> {
 private:
-  std::set<PlacementTemplate *> templates;
+  std::set<libfc_template_t *> templates;
+
+  /** The template whose batch currently holds records, or 0.
+   *
+   * Only one batch is ever pending, so that callbacks see records in
+   * the order in which they appear in the stream. */
+  libfc_template_t *pending;
+
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
   log4cplus::Logger logger;
 #endif /* _LIBFC_HAVE_LOG4CPLUS_ */
 
 public:
   CBinding(PlacementCollector::Protocol protocol)
-      : PlacementCollector(protocol)
+      : StaticPlacementCollector<CBinding>(protocol), pending(0)
 #ifdef _LIBFC_HAVE_LOG4CPLUS_
         ,
         logger(log4cplus::Logger::getInstance(LOG4CPLUS_TEXT("CBinding")))
@@ -86,15 +132,33 @@ public:
   }
 
   void add_template(libfc_template_t *t) {
-    templates.insert(&(t->tmpl));
+    templates.insert(t);
     register_placement_template(&(t->tmpl));
   }
 
-  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *tmpl) {
-    LIBFC_RETURN_OK();
+  /** Hands the pending batch, if any, to its callback.
+   *
+   * @return the callback's return value, or 1 if nothing was pending
+   */
+  int flush_batch() {
+    if (pending == 0)
+      return 1;
+
+    libfc_template_t *t = pending;
+    size_t n = t->n_records;
+    pending = 0;
+    t->n_records = 0;
+    return t->batch_callback(t, t->records.data(), n, t->batch_vparg);
   }
 
-  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *t) {
+  /** Forgets the pending batch, e.g., after the user aborted. */
+  void drop_batch() {
+    if (pending != 0)
+      pending->n_records = 0;
+    pending = 0;
+  }
+
+  bool end_record(const PlacementTemplate *t) {
 
     /* INSANE HACK which probably works -- get template from object.
      *
@@ -111,20 +175,22 @@ public:
             reinterpret_cast<const unsigned char *>(t) -
             offsetof(struct libfc_template_t, tmpl));
 
-    if (this_template != 0)
-      if (this_template->callback(this_template, this_template->vparg) <= 0) {
-        LIBFC_RETURN_ERROR(fatal, aborted_by_user, "C callback abort", 0, 0, 0,
-                           0, 0);
-      }
-    LIBFC_RETURN_OK();
-  }
-
-  std::shared_ptr<ErrorContext> start_message(uint16_t version, uint16_t length,
-                                              uint32_t export_time,
-                                              uint32_t sequence_number,
-                                              uint32_t observation_domain,
-                                              uint64_t base_time) {
-    LIBFC_RETURN_OK();
+    libfc_template_t *bt = const_cast<libfc_template_t *>(this_template);
+
+    if (bt->batch_callback != 0) {
+      if (pending != bt && flush_batch() <= 0)
+        return false;
+      memcpy(bt->records.data() + bt->n_records * bt->stride,
+             bt->staging.data(), bt->stride);
+      pending = bt;
+      if (++bt->n_records * bt->stride == bt->records.size()
+          && flush_batch() <= 0)
+        return false;
+    } else if (bt->callback != 0) {
+      if (flush_batch() <= 0 || bt->callback(bt, bt->vparg) <= 0)
+        return false;
+    }
+    return true;
   }
 
   std::shared_ptr<ErrorContext> unhandled_data_set(uint32_t observation_domain,
@@ -138,14 +204,20 @@ public:
 
 struct libfc_template_group_t {
   CBinding *binding;
+  int version;
+};
+
+struct libfc_feeder_t {
+  struct libfc_template_group_t *group;
+  std::string name;
+  /** Start of an IPFIX message whose end hasn't been fed yet. */
+  std::vector<uint8_t> partial;
 };
 
 extern struct libfc_template_group_t *libfc_template_group_new(int version) {
   PlacementCollector::Protocol protocol;
 
-  if (!infomodel_initialized)
-    InfoModel::instance().defaultIPFIX();
-  infomodel_initialized = true;
+  initialize_infomodel();
 
   switch (version) {
   case 9:
@@ -160,23 +232,28 @@ extern struct libfc_template_group_t *libfc_template_group_new(int version) {
 
   struct libfc_template_group_t *ret = new libfc_template_group_t;
   ret->binding = new CBinding(protocol);
+  ret->version = version;
   return ret;
 }
 
 extern struct libfc_template_t *
 libfc_template_new(struct libfc_template_group_t *s) {
-  if (!infomodel_initialized)
-    InfoModel::instance().defaultIPFIX();
-  infomodel_initialized = true;
+  initialize_infomodel();
 
   struct libfc_template_t *ret = new libfc_template_t;
   ret->callback = 0;
+  ret->vparg = 0;
+  ret->batch_callback = 0;
+  ret->batch_vparg = 0;
+  ret->stride = 0;
+  ret->n_records = 0;
   s->binding->add_template(ret);
   return ret;
 }
 
 extern void libfc_template_group_delete(struct libfc_template_group_t *s) {
   delete s->binding;
+  delete s;
 }
 
 extern int libfc_register_placement(struct libfc_template_t *t,
@@ -193,36 +270,421 @@ extern void libfc_register_callback(struct libfc_template_t *t,
   t->vparg = vparg;
 }
 
-extern int libfc_collect_from_file(int fd, const char *name,
-                                   struct libfc_template_group_t *t) {
+extern int libfc_register_batch_callback(
+    struct libfc_template_t *t, size_t stride, size_t batch_size,
+    int (*c)(const struct libfc_template_t *, void *, size_t, void *),
+    void *vparg) {
+  if (stride == 0 || batch_size == 0 || t->stride != 0)
+    return 0;
+
+  t->batch_callback = c;
+  t->batch_vparg = vparg;
+  t->stride = stride;
+  t->n_records = 0;
+  t->staging.assign(stride, 0);
+  t->records.assign(stride * batch_size, 0);
+  return 1;
+}
+
+/** Checks whether values of an IE can live in C memory.
+ *
+ * Octet arrays and strings need a BasicOctetArray, which C can't
+ * provide.
+ */
+static bool is_c_placeable(const InfoElement *ie) {
+  unsigned int type = ie->ietype()->number();
+  return ie->len() != kIpfixVarlen && type != IEType::kOctetArray
+         && type != IEType::kString;
+}
+
+/** Checks whether an IE's value fits into a record at an offset.
+ *
+ * Values are stored with their native size, i.e., the IE's length.
+ */
+static bool fits(const InfoElement *ie, size_t offset, size_t record_size) {
+  return offset <= record_size && ie->len() <= record_size - offset;
+}
+
+extern int libfc_register_field(struct libfc_template_t *t,
+                                const char *ie_name, size_t offset,
+                                size_t size) {
+  const InfoElement *ie = InfoModel::instance().lookupIE(ie_name);
+  if (ie == 0 || t->stride == 0)
+    return 0;
+
+  if (!is_c_placeable(ie) || !fits(ie, offset, t->stride))
+    return 0;
+
+  return t->tmpl.register_placement(ie, t->staging.data() + offset, size);
+}
+
+/** Collects from an input source and flushes batches afterwards.
+ *
+ * A user abort stops collection without flushing.
+ */
+static int collect(struct libfc_template_group_t *t, InputSource &is) {
   int ret = 1;
 
-  FileInputSource is(fd, name);
   try {
-    t->binding->collect(is);
-  } catch (FormatError e) {
+    std::shared_ptr<ErrorContext> e = t->binding->collect(is);
+    if (e != 0 && e->get_error() == Error::aborted_by_user) {
+      t->binding->drop_batch();
+      return ret;
+    }
+    if (e != 0 && e->get_error() != Error::no_error) {
+      std::cerr << "Error: " << e->to_string() << std::endl;
+      ret = 0;
+    }
+  } catch (FormatError& e) {
     std::cerr << "Format error: " << e.what() << std::endl;
     ret = 0;
   }
 
+  t->binding->flush_batch();
   return ret;
 }
 
+extern int libfc_collect_from_file(int fd, const char *name,
+                                   struct libfc_template_group_t *t) {
+  FileInputSource is(fd, name);
+  return collect(t, is);
+}
+
 extern int libfc_collect_from_wandio(io_t *wio, const char *name,
                                      struct libfc_template_group_t *t) {
+  WandioInputSource is(wio, name);
+  return collect(t, is);
+}
+
+/** Collects files from a shared work queue with a template group of
+ * its own, and deletes the group when the queue is empty. */
+static void collect_files_worker(const char *const *paths, size_t n,
+                                 std::atomic<size_t> *next, int *results,
+                                 unsigned worker,
+                                 libfc_group_factory_t group_factory,
+                                 void *vparg) {
+  struct libfc_template_group_t *g = group_factory(worker, vparg);
+  if (g == nullptr)
+    return;
+
+  for (size_t i = (*next)++; i < n; i = (*next)++) {
+    WandioInputSource is(paths[i]);
+    if (is.get_error() != nullptr) {
+      std::cerr << "Error: " << is.get_error()->to_string() << std::endl;
+      results[i] = 0;
+    } else
+      results[i] = collect(g, is);
+  }
+
+  libfc_template_group_delete(g);
+}
+
+extern int libfc_collect_files_parallel(const char *const *paths, size_t n,
+                                        unsigned threads,
+                                        libfc_group_factory_t group_factory,
+                                        void *vparg, int *results) {
+  initialize_infomodel();
+
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  if (threads > n)
+    threads = static_cast<unsigned>(n);
+
+  std::vector<int> own_results;
+  if (results == nullptr) {
+    own_results.resize(n);
+    results = own_results.data();
+  }
+  std::fill(results, results + n, 0);
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; i++)
+    workers.push_back(std::thread(collect_files_worker, paths, n, &next,
+                                  results, i, group_factory, vparg));
+  for (auto &w : workers)
+    w.join();
+
+  return std::find(results, results + n, 0) == results + n;
+}
+
+extern int libfc_collect_from_buffer(const void *buf, size_t len,
+                                     const char *name,
+                                     struct libfc_template_group_t *t) {
+  BufferInputSource is(static_cast<const uint8_t *>(buf), len, false, name);
+  return collect(t, is);
+}
+
+extern int libfc_collect_from_udp(int fd, unsigned int batch_size,
+                                  struct libfc_template_group_t *t) {
+  struct sockaddr_storage any;
+  memset(&any, 0, sizeof(any));
+
+  UDPInputSource is(reinterpret_cast<const struct sockaddr *>(&any),
+                    sizeof(any), fd, batch_size);
+  return collect(t, is);
+}
+
+extern int libfc_collect_from_tcp(int fd, struct libfc_template_group_t *t) {
+  /* TCPInputSource closes its descriptor, but the socket is the
+   * caller's. */
+  int our_fd = dup(fd);
+  if (our_fd < 0)
+    return 0;
+
+  TCPInputSource is(our_fd);
+  return collect(t, is);
+}
+
+extern struct libfc_feeder_t *
+libfc_feeder_new(struct libfc_template_group_t *t, const char *name) {
+  struct libfc_feeder_t *ret = new libfc_feeder_t;
+  ret->group = t;
+  ret->name = name == 0 ? "<fed>" : name;
+  return ret;
+}
+
+extern void libfc_feeder_delete(struct libfc_feeder_t *f) { delete f; }
+
+extern size_t libfc_feeder_pending(const struct libfc_feeder_t *f) {
+  return f->partial.size();
+}
+
+extern void libfc_feeder_reset(struct libfc_feeder_t *f) {
+  f->partial.clear();
+}
+
+/** Returns the length of the IPFIX message at buf, or 0 if that is
+ * not a valid message length. */
+static size_t ipfix_message_length(const uint8_t *buf) {
+  uint16_t length = decode_uint16(buf + 2);
+  return length < kIpfixMessageHeaderLen ? 0 : length;
+}
+
+extern int libfc_feed(struct libfc_feeder_t *f, const void *buf, size_t len) {
+  const uint8_t *cur = static_cast<const uint8_t *>(buf);
+  const uint8_t *end = cur + len;
+  const char *name = f->name.c_str();
+
+  /* NetFlow v9 messages don't say how long they are, so every call
+   * must contain whole messages. */
+  if (f->group->version != kIpfixVersion) {
+    BufferInputSource is(cur, len, false, name);
+    return collect(f->group, is);
+  }
+
+  /* First complete the message left over from last time. */
+  if (!f->partial.empty()) {
+    size_t want = kIpfixMessageHeaderLen;
+    if (f->partial.size() >= kIpfixMessageHeaderLen) {
+      want = ipfix_message_length(f->partial.data());
+    } else {
+      size_t n = std::min<size_t>(want - f->partial.size(), end - cur);
+      f->partial.insert(f->partial.end(), cur, cur + n);
+      cur += n;
+      if (f->partial.size() < want)
+        return 1;
+      want = ipfix_message_length(f->partial.data());
+    }
+
+    if (want == 0) {
+      f->partial.clear();
+      return 0;
+    }
+
+    size_t n = std::min<size_t>(want - f->partial.size(), end - cur);
+    f->partial.insert(f->partial.end(), cur, cur + n);
+    cur += n;
+    if (f->partial.size() < want)
+      return 1;
+
+    BufferInputSource is(f->partial.data(), f->partial.size(), false, name);
+    int ret = collect(f->group, is);
+    f->partial.clear();
+    if (!ret)
+      return ret;
+  }
+
+  /* Then collect all complete messages straight from the caller's
+   * buffer, and keep the rest for next time. */
+  const uint8_t *messages_end = cur;
+  bool bad_length = false;
+  while (end - messages_end >= static_cast<ptrdiff_t>(kIpfixMessageHeaderLen)) {
+    size_t length = ipfix_message_length(messages_end);
+    if (length == 0) {
+      bad_length = true;
+      break;
+    }
+    if (length > static_cast<size_t>(end - messages_end))
+      break;
+    messages_end += length;
+  }
+
   int ret = 1;
+  if (messages_end > cur) {
+    BufferInputSource is(cur, messages_end - cur, false, name);
+    ret = collect(f->group, is);
+  }
+  if (bad_length)
+    return 0;
+  f->partial.assign(messages_end, end);
+  return ret;
+}
 
-  WandioInputSource is(wio, name);
+struct libfc_export_template_t {
+  PlacementTemplate tmpl;
+  /** Values of fields registered with libfc_exporter_register_field(). */
+  std::vector<uint8_t> staging;
+};
+
+struct libfc_exporter_t {
+  /* Declared in this order so that the exporter, which flushes on
+   * destruction, goes first. */
+  std::unique_ptr<ExportDestination> destination;
+  /** The destination, if it is a memory destination, or 0. */
+  MemoryExportDestination *memory;
+  std::vector<std::unique_ptr<libfc_export_template_t> > templates;
+  std::unique_ptr<PlacementExporter> exporter;
+};
+
+static struct libfc_exporter_t *new_exporter(ExportDestination *d,
+                                             uint32_t observation_domain) {
+  initialize_infomodel();
+
+  struct libfc_exporter_t *ret = new libfc_exporter_t;
+  ret->destination.reset(d);
+  ret->memory = 0;
+  ret->exporter.reset(new PlacementExporter(*d, observation_domain));
+  return ret;
+}
+
+extern struct libfc_exporter_t *
+libfc_exporter_new_file(int fd, uint32_t observation_domain,
+                        size_t max_message_size) {
+  return new_exporter(new FileExportDestination(fd, max_message_size),
+                      observation_domain);
+}
+
+extern struct libfc_exporter_t *
+libfc_exporter_new_udp(int fd, const struct sockaddr *sa, size_t sa_len,
+                       uint32_t observation_domain, size_t max_message_size) {
+  return new_exporter(
+      new UDPExportDestination(sa, sa_len, fd, max_message_size),
+      observation_domain);
+}
+
+extern struct libfc_exporter_t *
+libfc_exporter_new_memory(uint32_t observation_domain,
+                          size_t max_message_size) {
+  MemoryExportDestination *d
+    = new MemoryExportDestination(false, max_message_size);
+  struct libfc_exporter_t *ret = new_exporter(d, observation_domain);
+  ret->memory = d;
+  return ret;
+}
+
+extern void libfc_exporter_delete(struct libfc_exporter_t *e) {
   try {
-    t->binding->collect(is);
-  } catch (FormatError e) {
-    std::cerr << "Format error: " << e.what() << std::endl;
-    ret = 0;
+    e->exporter.reset();
+  } catch (ExportError &x) {
+    std::cerr << "Export error: " << x.what() << std::endl;
+  }
+  delete e;
+}
+
+extern const void *libfc_exporter_get_buffer(const struct libfc_exporter_t *e,
+                                             size_t *len) {
+  if (e->memory == 0) {
+    *len = 0;
+    return nullptr;
   }
+  *len = e->memory->get_buffer().size();
+  return e->memory->get_buffer().data();
+}
+
+extern void libfc_exporter_clear_buffer(struct libfc_exporter_t *e) {
+  if (e->memory != 0)
+    e->memory->clear();
+}
 
+extern struct libfc_export_template_t *
+libfc_exporter_template_new(struct libfc_exporter_t *e, size_t record_size) {
+  struct libfc_export_template_t *ret = new libfc_export_template_t;
+  ret->staging.assign(record_size, 0);
+  e->templates.push_back(std::unique_ptr<libfc_export_template_t>(ret));
   return ret;
 }
 
+/** Registers an IE for export, if it can be exported from C. */
+static int register_export(struct libfc_export_template_t *t,
+                           const InfoElement *ie, void *p, size_t size) {
+  void *q;
+  if (ie == 0 || !is_c_placeable(ie) || size > ie->len()
+      || t->tmpl.lookup_placement(ie, &q, 0))
+    return 0;
+  return t->tmpl.register_placement(ie, p, size);
+}
+
+extern int libfc_exporter_register_placement(struct libfc_export_template_t *t,
+                                             const char *ie_name, void *p,
+                                             size_t size) {
+  return register_export(t, InfoModel::instance().lookupIE(ie_name), p, size);
+}
+
+extern int libfc_exporter_register_field(struct libfc_export_template_t *t,
+                                         const char *ie_name, size_t offset,
+                                         size_t size) {
+  const InfoElement *ie = InfoModel::instance().lookupIE(ie_name);
+  if (ie == 0 || !fits(ie, offset, t->staging.size()))
+    return 0;
+  return register_export(t, ie, t->staging.data() + offset, size);
+}
+
+extern int libfc_exporter_place(struct libfc_exporter_t *e,
+                                struct libfc_export_template_t *t) {
+  try {
+    e->exporter->place_values(&t->tmpl);
+  } catch (ExportError &x) {
+    std::cerr << "Export error: " << x.what() << std::endl;
+    return 0;
+  }
+  return 1;
+}
+
+extern int libfc_exporter_place_records(struct libfc_exporter_t *e,
+                                        struct libfc_export_template_t *t,
+                                        const void *base, size_t stride,
+                                        size_t count) {
+  const uint8_t *record = static_cast<const uint8_t *>(base);
+  const size_t record_size = t->staging.size();
+
+  try {
+    for (size_t i = 0; i < count; i++, record += stride) {
+      memcpy(t->staging.data(), record, record_size);
+      e->exporter->place_values(&t->tmpl);
+    }
+  } catch (ExportError &x) {
+    std::cerr << "Export error: " << x.what() << std::endl;
+    return 0;
+  }
+  return 1;
+}
+
+extern int libfc_exporter_flush(struct libfc_exporter_t *e) {
+  try {
+    return e->exporter->flush();
+  } catch (ExportError &x) {
+    std::cerr << "Export error: " << x.what() << std::endl;
+    return 0;
+  }
+}
+
+extern void
+libfc_exporter_set_observation_domain(struct libfc_exporter_t *e,
+                                      uint32_t observation_domain) {
+  e->exporter->change_observation_domain(observation_domain);
+}
+
 extern void libfc_initialize_logging(const char *lpfilename) {
 #if defined(_LIBFC_HAVE_LOG4CPLUS_)
   log4cplus::PropertyConfigurator config(lpfilename);
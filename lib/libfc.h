@@ -177,7 +177,9 @@
 extern "C" {
 #endif /* defined(__cplusplus) */
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <wandio.h>
 
 /** An libfc template set.
@@ -194,6 +196,27 @@ struct libfc_template_group_t;
  */
 struct libfc_template_t;
 
+/** An incremental collector, to which data is fed piecemeal.
+ *
+ * This is an opaque struct, and you should only ever handle a
+ * pointer to it.
+ */
+struct libfc_feeder_t;
+
+/** An exporter, writing to a file, a UDP socket or memory.
+ *
+ * This is an opaque struct, and you should only ever handle a
+ * pointer to it.
+ */
+struct libfc_exporter_t;
+
+/** A template for export.
+ *
+ * This is an opaque struct, and you should only ever handle a
+ * pointer to it.
+ */
+struct libfc_export_template_t;
+
 /** Creates a new libfc template group.
  *
  * @param version the only legitimate values are 9 (to read NetFlow
@@ -254,6 +277,85 @@ extern void libfc_register_callback(struct libfc_template_t *t,
                                     int (*c)(const struct libfc_template_t *,
                                              void *),
                                     void *vparg);
+
+/** Registers a callback for batches of records.
+ *
+ * Instead of scattering values over fixed addresses and calling a
+ * callback for every record, libfc can fill an array of records and
+ * call a callback once for every batch_size records.  The records are
+ * laid out as an array of a struct of your choosing, whose fields
+ * you register with libfc_register_field(); stride is the distance
+ * between two records, usually the sizeof the struct.  For example:
+ *
+ * @code
+ * struct flow { uint32_t sip; uint32_t dip; uint64_t octets; };
+ *
+ * static int batch(const struct libfc_template_t *t, void *records,
+ *                  size_t n, void *arg) {
+ *   const struct flow *f = records;
+ *   for (size_t i = 0; i < n; i++)
+ *     total += f[i].octets;
+ *   return 1;
+ * }
+ *
+ * struct libfc_template_t *t = libfc_template_new(s);
+ * libfc_register_batch_callback(t, sizeof(struct flow), 256, batch, NULL);
+ * libfc_register_field(t, "sourceIPv4Address",
+ *                      offsetof(struct flow, sip), 0);
+ * libfc_register_field(t, "destinationIPv4Address",
+ *                      offsetof(struct flow, dip), 0);
+ * libfc_register_field(t, "octetDeltaCount",
+ *                      offsetof(struct flow, octets), 0);
+ * @endcode
+ *
+ * A batch is handed over when it is full, when a record for another
+ * template arrives, and at the end of collection, so callbacks see
+ * all records in stream order.  The array belongs to libfc and is
+ * reused after the callback returns.  A template can have either a
+ * batch callback or the callback registered with
+ * libfc_register_callback(), not both; the batch callback wins.
+ *
+ * This must be called before libfc_register_field() and only once per
+ * template.
+ *
+ * @param t the template
+ * @param stride distance in bytes between consecutive records
+ * @param batch_size maximum number of records per batch
+ * @param c the callback to call; it is given the template, the
+ *   records, the number of records and vparg, and returns a value
+ *   less than or equal to zero to stop collection
+ * @param vparg an optional argument to pass to the callback
+ *
+ * @return non-zero if the operation was successful, 0 if stride or
+ *   batch_size are 0 or if a batch callback was already registered
+ */
+extern int libfc_register_batch_callback(
+    struct libfc_template_t *t, size_t stride, size_t batch_size,
+    int (*c)(const struct libfc_template_t *, void *, size_t, void *),
+    void *vparg);
+
+/** Registers an IE as a field of the records in a batch.
+ *
+ * The value is stored at the given offset from the start of each
+ * record, with the native size of the IE's type (e.g., 8 bytes for
+ * an unsigned64, even if it appears with reduced length on the
+ * wire).  Variable-length IEs, octet arrays and strings can't be used
+ * in batches.
+ *
+ * @param t the template, which must have a batch callback
+ * @param ie_name name of the information element
+ * @param offset offset of the field within a record
+ * @param size the size of the information element on the wire, or
+ *   0 for the default size
+ *
+ * @return non-zero if the operation was successful, 0 if the IE is
+ *   unknown or unsuitable, if the field does not fit into the
+ *   record, or if no batch callback has been registered.
+ */
+extern int libfc_register_field(struct libfc_template_t *t,
+                                const char *ie_name, size_t offset,
+                                size_t size);
+
 /** Collect IPFIX data from a file.
  *
  * @param fd a valid file descriptor, such as you'd get back from a
@@ -278,6 +380,370 @@ extern int libfc_collect_from_file(int fd, const char *name,
 extern int libfc_collect_from_wandio(io_t *wio, const char *name,
                                      struct libfc_template_group_t *s);
 
+/** Creates the template group for one worker of
+ * libfc_collect_files_parallel().
+ *
+ * @param worker the number of the worker, from 0 to the number of
+ *     threads minus one
+ * @param vparg the argument given to libfc_collect_files_parallel()
+ *
+ * @return a new template group, or NULL if the worker should not
+ *     collect anything
+ */
+typedef struct libfc_template_group_t *(*libfc_group_factory_t)(
+    unsigned worker, void *vparg);
+
+/** Collect data from a number of files in parallel.
+ *
+ * Every worker thread gets its own template group from group_factory
+ * and collects one file at a time from a shared queue until all
+ * files are done; it then deletes its template group.  Callbacks are
+ * therefore called from several threads, but those of a single
+ * template group always from the same thread.  Use the worker number
+ * to give each group its own state, for example:
+ *
+ * @code
+ * struct state { uint64_t octets; uint64_t total; };
+ * static struct state states[N_THREADS];
+ *
+ * static struct libfc_template_group_t *
+ * make_group(unsigned worker, void *vparg) {
+ *   struct libfc_template_group_t *g = libfc_template_group_new(10);
+ *   struct libfc_template_t *t = libfc_template_new(g);
+ *   libfc_register_placement(t, "octetDeltaCount",
+ *                            &states[worker].octets, 0);
+ *   libfc_register_callback(t, add_octets, &states[worker]);
+ *   return g;
+ * }
+ *
+ * libfc_collect_files_parallel(paths, n_paths, N_THREADS, make_group,
+ *                              NULL, NULL);
+ * @endcode
+ *
+ * Files are opened with wandio, so they may be compressed.  A
+ * callback that returns 0 stops the collection of the current file
+ * only.
+ *
+ * Template groups and templates must not be shared between workers,
+ * but the information model may be: libfc_add_specfile() should be
+ * called before, not during, the collection.
+ *
+ * @param paths names of the files
+ * @param n number of files
+ * @param threads number of worker threads, or 0 for one per core; no
+ *     more than n threads are started
+ * @param group_factory creates a worker's template group
+ * @param vparg passed to group_factory
+ * @param results if not NULL, an array of n ints that receives the
+ *     result of collecting each file: non-zero on success and 0 on
+ *     error
+ *
+ * @return non-zero if all files were collected successfully and 0
+ *     otherwise
+ */
+extern int libfc_collect_files_parallel(const char *const *paths, size_t n,
+                                        unsigned threads,
+                                        libfc_group_factory_t group_factory,
+                                        void *vparg, int *results);
+
+/** Collect data from a buffer in memory.
+ *
+ * The buffer must contain whole messages.  It is read in place, not
+ * copied.
+ *
+ * @param buf the buffer
+ * @param len the length of the buffer in bytes
+ * @param name the name by which the sender of these messages is known
+ *     to diagnostics and sequence number tracking, or NULL
+ * @param s template set containing the templates of interest
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_collect_from_buffer(const void *buf, size_t len,
+                                     const char *name,
+                                     struct libfc_template_group_t *s);
+
+/** Collect data from a bound UDP socket.
+ *
+ * Every datagram must contain one message.  UDP has no end of file,
+ * so this function only returns on error, when a callback stops
+ * collection, or when the socket's receive timeout (SO_RCVTIMEO)
+ * expires.
+ *
+ * @param fd a bound UDP socket
+ * @param batch_size the maximum number of datagrams to receive with
+ *     one system call; 1 receives them one at a time.  Larger values
+ *     save system calls under load but need 64 KiB of memory per
+ *     datagram.
+ * @param s template set containing the templates of interest
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_collect_from_udp(int fd, unsigned int batch_size,
+                                  struct libfc_template_group_t *s);
+
+/** Collect data from a connected TCP socket until the peer closes
+ * the connection.
+ *
+ * The socket is not closed.
+ *
+ * @param fd a connected TCP socket
+ * @param s template set containing the templates of interest
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_collect_from_tcp(int fd, struct libfc_template_group_t *s);
+
+/** Creates an incremental collector.
+ *
+ * This is for programs that receive data in their own event loop
+ * and hand it to libfc with libfc_feed() as it arrives.
+ *
+ * @param s template set containing the templates of interest; it
+ *     must outlive the feeder
+ * @param name the name by which the sender of the data is known to
+ *     diagnostics and sequence number tracking, or NULL.  Use one
+ *     feeder per sender.
+ *
+ * @return a new feeder
+ */
+extern struct libfc_feeder_t *
+libfc_feeder_new(struct libfc_template_group_t *s, const char *name);
+
+/** Destroys an incremental collector.
+ *
+ * Data from an incomplete message is discarded.
+ *
+ * @param f the feeder
+ */
+extern void libfc_feeder_delete(struct libfc_feeder_t *f);
+
+/** Feeds data to an incremental collector.
+ *
+ * For IPFIX, the data is a byte stream, as read from a TCP
+ * connection: it can be fed in pieces of any size, and callbacks are
+ * called for each message as soon as it is complete.  Complete
+ * messages are read in place; only the start of an incomplete message
+ * at the end of the data is copied until the rest arrives.
+ *
+ * NetFlow v9 messages do not contain their length, so for NetFlow v9,
+ * every call must contain whole messages, such as a UDP datagram.
+ *
+ * @param f the feeder
+ * @param buf the data
+ * @param len the length of the data in bytes
+ *
+ * @return non-zero on success and 0 on error.  After an error, the
+ *     stream is out of step; call libfc_feeder_reset() before feeding
+ *     data from the start of a message.
+ */
+extern int libfc_feed(struct libfc_feeder_t *f, const void *buf, size_t len);
+
+/** Returns the number of bytes held back from an incomplete message.
+ *
+ * @param f the feeder
+ * @return the number of bytes waiting for the rest of their message
+ */
+extern size_t libfc_feeder_pending(const struct libfc_feeder_t *f);
+
+/** Discards data from an incomplete message.
+ *
+ * @param f the feeder
+ */
+extern void libfc_feeder_reset(struct libfc_feeder_t *f);
+
+/** Creates an exporter that writes to a file.
+ *
+ * For example, to export flows from an array of structs:
+ *
+ * @code
+ * struct flow { uint32_t sip; uint32_t dip; uint64_t octets; };
+ * struct flow flows[N];
+ *
+ * struct libfc_exporter_t *e = libfc_exporter_new_file(fd, 1, 0);
+ * struct libfc_export_template_t *t
+ *   = libfc_exporter_template_new(e, sizeof(struct flow));
+ * libfc_exporter_register_field(t, "sourceIPv4Address",
+ *                               offsetof(struct flow, sip), 0);
+ * libfc_exporter_register_field(t, "destinationIPv4Address",
+ *                               offsetof(struct flow, dip), 0);
+ * libfc_exporter_register_field(t, "octetDeltaCount",
+ *                               offsetof(struct flow, octets), 4);
+ * libfc_exporter_place_records(e, t, flows, sizeof(struct flow), N);
+ * libfc_exporter_delete(e);
+ * @endcode
+ *
+ * @param fd a file descriptor open for writing; it is not closed
+ * @param observation_domain the initial observation domain
+ * @param max_message_size the largest message to write, or 0 for
+ *     the largest possible IPFIX message
+ *
+ * @return a new exporter
+ */
+extern struct libfc_exporter_t *
+libfc_exporter_new_file(int fd, uint32_t observation_domain,
+                        size_t max_message_size);
+
+/** Creates an exporter that sends to a UDP collector.
+ *
+ * Every message is sent as one datagram.  Templates are sent again
+ * periodically, as required for unreliable transports.
+ *
+ * @param fd a UDP socket; it is not closed
+ * @param sa the address of the collector
+ * @param sa_len the length of sa
+ * @param observation_domain the initial observation domain
+ * @param max_message_size the largest message to send, or 0 for the
+ *     largest possible IPFIX message.  Use the path MTU minus IP and
+ *     UDP headers to avoid fragmentation.
+ *
+ * @return a new exporter
+ */
+extern struct libfc_exporter_t *
+libfc_exporter_new_udp(int fd, const struct sockaddr *sa, size_t sa_len,
+                       uint32_t observation_domain, size_t max_message_size);
+
+/** Creates an exporter that appends messages to a buffer in memory.
+ *
+ * Use libfc_exporter_get_buffer() to get at the messages, for
+ * example to send them with your own I/O.
+ *
+ * @param observation_domain the initial observation domain
+ * @param max_message_size the largest message to write, or 0 for
+ *     the largest possible IPFIX message
+ *
+ * @return a new exporter
+ */
+extern struct libfc_exporter_t *
+libfc_exporter_new_memory(uint32_t observation_domain,
+                          size_t max_message_size);
+
+/** Flushes and destroys an exporter and all of its templates.
+ *
+ * @param e the exporter
+ */
+extern void libfc_exporter_delete(struct libfc_exporter_t *e);
+
+/** Returns the messages written by a memory exporter.
+ *
+ * Only complete messages are in the buffer; call
+ * libfc_exporter_flush() first to complete the current message.  The
+ * buffer is valid until the next call to another exporter function.
+ *
+ * @param e the exporter
+ * @param len where to store the length of the buffer in bytes
+ *
+ * @return the messages written since the exporter was created or
+ *     since libfc_exporter_clear_buffer(), or NULL if this is not a
+ *     memory exporter
+ */
+extern const void *libfc_exporter_get_buffer(const struct libfc_exporter_t *e,
+                                             size_t *len);
+
+/** Discards the messages written by a memory exporter.
+ *
+ * @param e the exporter
+ */
+extern void libfc_exporter_clear_buffer(struct libfc_exporter_t *e);
+
+/** Creates a new template for export.
+ *
+ * @param e the exporter that uses the template
+ * @param record_size the size of the records that are exported with
+ *     libfc_exporter_place_records(), or 0 if there are none
+ *
+ * @return a new template, which is destroyed with the exporter
+ */
+extern struct libfc_export_template_t *
+libfc_exporter_template_new(struct libfc_exporter_t *e, size_t record_size);
+
+/** Registers an IE whose value is to be exported from a fixed address.
+ *
+ * The value must be stored with the native size of the IE's type
+ * (e.g., 8 bytes for an unsigned64).  Variable-length IEs, octet
+ * arrays and strings can't be exported from C.
+ *
+ * @param t the template
+ * @param ie_name name of the information element
+ * @param p where the value is
+ * @param size the size of the value on the wire, or 0 for the default
+ *     size; less than the default size gives reduced-length encoding
+ *
+ * @return non-zero on success, 0 if the IE is unknown, unsuitable or
+ *     already registered, or if the size is too large
+ */
+extern int libfc_exporter_register_placement(struct libfc_export_template_t *t,
+                                             const char *ie_name, void *p,
+                                             size_t size);
+
+/** Registers an IE whose value is to be exported from records.
+ *
+ * This is like libfc_exporter_register_placement(), except that the
+ * value is at an offset within the records given to
+ * libfc_exporter_place_records().
+ *
+ * @param t the template
+ * @param ie_name name of the information element
+ * @param offset offset of the value within a record
+ * @param size the size of the value on the wire, or 0 for the default
+ *     size
+ *
+ * @return non-zero on success, 0 if the IE is unknown, unsuitable or
+ *     already registered, if the size is too large, or if the value
+ *     does not fit into the record size given to
+ *     libfc_exporter_template_new()
+ */
+extern int libfc_exporter_register_field(struct libfc_export_template_t *t,
+                                         const char *ie_name, size_t offset,
+                                         size_t size);
+
+/** Exports one record with the values at the template's fixed
+ * addresses.
+ *
+ * @param e the exporter
+ * @param t the template
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_exporter_place(struct libfc_exporter_t *e,
+                                struct libfc_export_template_t *t);
+
+/** Exports a number of records.
+ *
+ * Fields registered with libfc_exporter_register_field() are taken
+ * from the records; values at fixed addresses are the same for all
+ * records.
+ *
+ * @param e the exporter
+ * @param t the template
+ * @param base the first record
+ * @param stride distance in bytes between consecutive records
+ * @param count number of records
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_exporter_place_records(struct libfc_exporter_t *e,
+                                        struct libfc_export_template_t *t,
+                                        const void *base, size_t stride,
+                                        size_t count);
+
+/** Completes the current message and writes it.
+ *
+ * @param e the exporter
+ *
+ * @return non-zero on success and 0 on error
+ */
+extern int libfc_exporter_flush(struct libfc_exporter_t *e);
+
+/** Changes the observation domain of subsequent records.
+ *
+ * @param e the exporter
+ * @param observation_domain the new observation domain
+ */
+extern void
+libfc_exporter_set_observation_domain(struct libfc_exporter_t *e,
+                                      uint32_t observation_domain);
+
 /** Add IESpecs from a file to the information model
  *
  * @param specfilename path to specfile
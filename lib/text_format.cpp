@@ -0,0 +1,203 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "text_format.h"
+
+namespace libfc {
+
+/* Two ASCII digits for every number from 0 to 99, so that integers
+ * can be converted two digits at a time. */
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline char *format_two_digits(char *p, unsigned int v) {
+  memcpy(p, digit_pairs + 2 * v, 2);
+  return p + 2;
+}
+
+char *format_unsigned(char *p, uint64_t v) {
+  char buf[kMaxIntegerChars];
+  char *q = buf + sizeof(buf);
+
+  while (v >= 100) {
+    q -= 2;
+    memcpy(q, digit_pairs + 2 * (v % 100), 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    q -= 2;
+    memcpy(q, digit_pairs + 2 * v, 2);
+  } else
+    *--q = static_cast<char>('0' + v);
+
+  size_t n = buf + sizeof(buf) - q;
+  memcpy(p, q, n);
+  return p + n;
+}
+
+char *format_signed(char *p, int64_t v) {
+  if (v < 0) {
+    *p++ = '-';
+    /* Negate as unsigned, so that INT64_MIN works, too. */
+    return format_unsigned(p, ~static_cast<uint64_t>(v) + 1);
+  }
+  return format_unsigned(p, static_cast<uint64_t>(v));
+}
+
+char *format_float(char *p, double v) {
+  int n = snprintf(p, kMaxFloatChars, "%g", v);
+  return p + (n < 0 ? 0 : n);
+}
+
+char *format_ipv4(char *p, uint32_t addr) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    unsigned int octet = (addr >> shift) & 0xff;
+    if (octet >= 100) {
+      *p++ = static_cast<char>('0' + octet / 100);
+      p = format_two_digits(p, octet % 100);
+    } else if (octet >= 10)
+      p = format_two_digits(p, octet);
+    else
+      *p++ = static_cast<char>('0' + octet);
+    if (shift > 0)
+      *p++ = '.';
+  }
+  return p;
+}
+
+char *format_ipv6(char *p, const uint8_t *addr) {
+  unsigned int groups[8];
+  for (unsigned int i = 0; i < 8; i++)
+    groups[i] = (addr[2 * i] << 8) | addr[2 * i + 1];
+
+  /* Find the first longest run of at least two zero groups. */
+  int best_start = -1;
+  int best_length = 1;
+  for (int i = 0; i < 8;) {
+    if (groups[i] != 0) {
+      i++;
+      continue;
+    }
+    int j = i;
+    while (j < 8 && groups[j] == 0)
+      j++;
+    if (j - i > best_length) {
+      best_start = i;
+      best_length = j - i;
+    }
+    i = j;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    if (i == best_start) {
+      *p++ = ':';
+      *p++ = ':';
+      i += best_length - 1;
+      continue;
+    }
+    if (i > 0 && i != best_start + best_length)
+      *p++ = ':';
+
+    unsigned int g = groups[i];
+    int shift = 12;
+    while (shift > 0 && ((g >> shift) & 0xf) == 0)
+      shift -= 4;
+    for (; shift >= 0; shift -= 4)
+      *p++ = hex_digits[(g >> shift) & 0xf];
+  }
+  return p;
+}
+
+char *format_mac(char *p, const uint8_t *addr) {
+  for (unsigned int i = 0; i < 6; i++) {
+    if (i > 0)
+      *p++ = ':';
+    *p++ = hex_digits[addr[i] >> 4];
+    *p++ = hex_digits[addr[i] & 0xf];
+  }
+  return p;
+}
+
+char *format_iso_datetime(char *p, uint64_t nanos) {
+  uint64_t seconds = nanos / 1000000000ULL;
+  uint32_t fraction = static_cast<uint32_t>(nanos % 1000000000ULL);
+  uint64_t days = seconds / 86400;
+  uint32_t secs_of_day = static_cast<uint32_t>(seconds % 86400);
+
+  /* Convert days since the epoch to a date in the proleptic
+   * Gregorian calendar, using eras of 400 years, as described by
+   * Howard Hinnant in "chrono-Compatible Low-Level Date Algorithms".
+   * This is what gmtime() does, but without time zones and locks. */
+  uint64_t z = days + 719468;
+  uint64_t era = z / 146097;
+  uint64_t doe = z - era * 146097;
+  uint64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint64_t mp = (5 * doy + 2) / 153;
+  unsigned int day = static_cast<unsigned int>(doy - (153 * mp + 2) / 5 + 1);
+  unsigned int month = static_cast<unsigned int>(mp < 10 ? mp + 3 : mp - 9);
+  uint64_t year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+  if (year < 10000) {
+    p = format_two_digits(p, static_cast<unsigned int>(year / 100));
+    p = format_two_digits(p, static_cast<unsigned int>(year % 100));
+  } else
+    p = format_unsigned(p, year);
+  *p++ = '-';
+  p = format_two_digits(p, month);
+  *p++ = '-';
+  p = format_two_digits(p, day);
+  *p++ = 'T';
+  p = format_two_digits(p, secs_of_day / 3600);
+  *p++ = ':';
+  p = format_two_digits(p, (secs_of_day / 60) % 60);
+  *p++ = ':';
+  p = format_two_digits(p, secs_of_day % 60);
+  *p++ = '.';
+
+  /* Nine digits, of which trailing zeroes are dropped. */
+  char *q = p + 9;
+  for (char *d = q; d > p; fraction /= 10)
+    *--d = static_cast<char>('0' + fraction % 10);
+  while (q > p + 1 && q[-1] == '0')
+    q--;
+  return q;
+}
+
+} // namespace libfc
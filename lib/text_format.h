@@ -0,0 +1,138 @@
+/* Hi Emacs, please use -*- mode: C++; -*- */
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the names of ETH Zürich nor the names of other contributors
+ *      may be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * Formatting of values as text, for tools that write out millions of
+ * records.
+ *
+ * All functions write into a caller-supplied character buffer and
+ * return a pointer just past the last character written.  They do not
+ * terminate the result with a NUL.  The buffer must have room for at
+ * least as many characters as given by the corresponding kMax...
+ * constant.
+ */
+
+#ifndef _LIBFC_TEXT_FORMAT_H_
+#define _LIBFC_TEXT_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libfc {
+
+/** Maximum length of a formatted 64-bit integer, signed or not. */
+const size_t kMaxIntegerChars = 20;
+
+/** Maximum length of a formatted floating-point number. */
+const size_t kMaxFloatChars = 32;
+
+/** Maximum length of a formatted IPv4 address. */
+const size_t kMaxIpv4Chars = 15;
+
+/** Maximum length of a formatted IPv6 address. */
+const size_t kMaxIpv6Chars = 39;
+
+/** Maximum length of a formatted MAC address. */
+const size_t kMaxMacChars = 17;
+
+/** Maximum length of a formatted date and time. */
+const size_t kMaxDatetimeChars = 30;
+
+/** Formats an unsigned integer in decimal.
+ *
+ * @param p where to write the digits
+ * @param v the value
+ *
+ * @return pointer past the last digit
+ */
+extern char *format_unsigned(char *p, uint64_t v);
+
+/** Formats a signed integer in decimal.
+ *
+ * @param p where to write the digits
+ * @param v the value
+ *
+ * @return pointer past the last digit
+ */
+extern char *format_signed(char *p, int64_t v);
+
+/** Formats a floating-point number like printf's "%g".
+ *
+ * @param p where to write the number
+ * @param v the value
+ *
+ * @return pointer past the last character
+ */
+extern char *format_float(char *p, double v);
+
+/** Formats an IPv4 address in dotted-quad notation.
+ *
+ * @param p where to write the address
+ * @param addr the address, in host byte order, as it is placed by a
+ *   PlacementTemplate
+ *
+ * @return pointer past the last character
+ */
+extern char *format_ipv4(char *p, uint32_t addr);
+
+/** Formats an IPv6 address as recommended by RFC 5952: lower-case
+ * hex, no leading zeroes, and the longest run of two or more zero
+ * groups replaced by "::".
+ *
+ * @param p where to write the address
+ * @param addr the 16 octets of the address, in network byte order
+ *
+ * @return pointer past the last character
+ */
+extern char *format_ipv6(char *p, const uint8_t *addr);
+
+/** Formats a MAC address as six colon-separated pairs of hex digits.
+ *
+ * @param p where to write the address
+ * @param addr the 6 octets of the address
+ *
+ * @return pointer past the last character
+ */
+extern char *format_mac(char *p, const uint8_t *addr);
+
+/** Formats a point in time in ISO 8601 format, UTC.
+ *
+ * The result looks like "2014-05-03T12:00:00.25", with the fraction
+ * of a second written without trailing zeroes, but with at least one
+ * digit.
+ *
+ * @param p where to write the date and time
+ * @param nanos nanoseconds since Jan 1, 1970
+ *
+ * @return pointer past the last character
+ */
+extern char *format_iso_datetime(char *p, uint64_t nanos);
+
+} // namespace libfc
+
+#endif /* _LIBFC_TEXT_FORMAT_H_ */
@@ -0,0 +1,523 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "FileExportDestination.h"
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+
+#include "libfc.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(CBinding)
+
+struct flow {
+  uint32_t sip;
+  uint32_t dip;
+  uint64_t octets;
+};
+
+/** What the callbacks saw, in order: 'F' plus octets for each flow
+ * from a batch, 'P' plus the port for each per-record callback. */
+struct Events {
+  std::vector<std::pair<char, uint64_t> > seen;
+  size_t max_batch;
+  size_t n_batches;
+  size_t stop_after;
+  uint16_t port;
+};
+
+static int flow_batch(const struct libfc_template_t *t, void *records,
+                      size_t n, void *arg) {
+  Events *e = static_cast<Events *>(arg);
+  const flow *f = static_cast<const flow *>(records);
+
+  for (size_t i = 0; i < n; i++) {
+    if (f[i].sip != 0x0a000001 || f[i].dip != 0x0a000002)
+      e->seen.push_back(std::make_pair('?', f[i].octets));
+    else
+      e->seen.push_back(std::make_pair('F', f[i].octets));
+  }
+  e->max_batch = std::max(e->max_batch, n);
+  e->n_batches++;
+  return e->n_batches < e->stop_after;
+}
+
+static int port_record(const struct libfc_template_t *t, void *arg) {
+  Events *e = static_cast<Events *>(arg);
+  e->seen.push_back(std::make_pair('P', e->port));
+  return 1;
+}
+
+/** Exports 1000 flows, one port record, 500 flows and another port
+ * record.  Flow i has i octets. */
+static void export_records(ExportDestination &d) {
+  InfoModel &model = InfoModel::instance();
+  uint32_t sip = 0x0a000001;
+  uint32_t dip = 0x0a000002;
+  uint64_t octets = 0;
+  uint16_t sp = 1;
+  uint16_t dp = 2;
+
+  PlacementTemplate flows;
+  flows.register_placement(model.lookupIE("sourceIPv4Address"), &sip, 0);
+  flows.register_placement(model.lookupIE("destinationIPv4Address"), &dip, 0);
+  /* Reduced length on the wire, native size in the struct. */
+  flows.register_placement(model.lookupIE("octetDeltaCount"), &octets, 4);
+
+  PlacementTemplate ports;
+  ports.register_placement(model.lookupIE("sourceTransportPort"), &sp, 0);
+  ports.register_placement(model.lookupIE("destinationTransportPort"), &dp, 0);
+
+  PlacementExporter e(d, 1);
+  for (; octets < 1000; octets++)
+    e.place_values(&flows);
+  e.place_values(&ports);
+  for (; octets < 1500; octets++)
+    e.place_values(&flows);
+  sp = 3;
+  e.place_values(&ports);
+  e.flush();
+}
+
+static std::string write_records() {
+  char file_name[] = "/tmp/fctest-cbinding-XXXXXX";
+  int fd = mkstemp(file_name);
+  BOOST_REQUIRE(fd >= 0);
+  {
+    FileExportDestination d(fd);
+    export_records(d);
+  }
+  close(fd);
+
+  return file_name;
+}
+
+/** Returns export_records()'s messages in memory; messages are no
+ * larger than an Ethernet frame, so that there are many of them. */
+static std::vector<uint8_t> records_in_memory() {
+  MemoryExportDestination d(true, 1400);
+  export_records(d);
+  return d.get_buffer();
+}
+
+static void init_events(Events *e, size_t stop_after = 1000) {
+  e->seen.clear();
+  e->max_batch = 0;
+  e->n_batches = 0;
+  e->stop_after = stop_after;
+}
+
+static void check_events(const Events &e) {
+  BOOST_REQUIRE_EQUAL(e.seen.size(), 1502U);
+
+  uint64_t octets = 0;
+  for (size_t i = 0; i < e.seen.size(); i++) {
+    if (i == 1000) {
+      BOOST_CHECK_EQUAL(e.seen[i].first, 'P');
+      BOOST_CHECK_EQUAL(e.seen[i].second, 1U);
+    } else if (i == 1501) {
+      BOOST_CHECK_EQUAL(e.seen[i].first, 'P');
+      BOOST_CHECK_EQUAL(e.seen[i].second, 3U);
+    } else {
+      BOOST_CHECK_EQUAL(e.seen[i].first, 'F');
+      BOOST_CHECK_EQUAL(e.seen[i].second, octets);
+      octets++;
+    }
+  }
+}
+
+/** Creates a template group with a batch template for flows and a
+ * per-record template for ports. */
+static struct libfc_template_group_t *make_group(Events *e) {
+  struct libfc_template_group_t *g = libfc_template_group_new(10);
+
+  struct libfc_template_t *t = libfc_template_new(g);
+  BOOST_CHECK(libfc_register_batch_callback(t, sizeof(flow), 64, flow_batch,
+                                            e));
+  BOOST_CHECK(libfc_register_field(t, "sourceIPv4Address",
+                                   offsetof(flow, sip), 0));
+  BOOST_CHECK(libfc_register_field(t, "destinationIPv4Address",
+                                   offsetof(flow, dip), 0));
+  BOOST_CHECK(libfc_register_field(t, "octetDeltaCount",
+                                   offsetof(flow, octets), 0));
+
+  t = libfc_template_new(g);
+  libfc_register_placement(t, "sourceTransportPort", &e->port, 0);
+  libfc_register_callback(t, port_record, e);
+
+  return g;
+}
+
+static int collect(const std::string &file_name, Events *e) {
+  struct libfc_template_group_t *g = make_group(e);
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  BOOST_REQUIRE(fd >= 0);
+  int ret = libfc_collect_from_file(fd, file_name.c_str(), g);
+  close(fd);
+
+  libfc_template_group_delete(g);
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(BatchesInStreamOrder) {
+  std::string file_name = write_records();
+
+  Events e;
+  init_events(&e);
+  BOOST_CHECK(collect(file_name, &e));
+  unlink(file_name.c_str());
+
+  check_events(e);
+  BOOST_CHECK_EQUAL(e.max_batch, 64U);
+}
+
+BOOST_AUTO_TEST_CASE(BatchAbort) {
+  std::string file_name = write_records();
+
+  Events e;
+  init_events(&e, 2);
+  BOOST_CHECK(collect(file_name, &e));
+  unlink(file_name.c_str());
+
+  /* Stopped after the second batch, without flushing what was left. */
+  BOOST_CHECK_EQUAL(e.n_batches, 2U);
+  BOOST_CHECK_EQUAL(e.seen.size(), 128U);
+}
+
+BOOST_AUTO_TEST_CASE(BadFields) {
+  struct libfc_template_group_t *g = libfc_template_group_new(10);
+  struct libfc_template_t *t = libfc_template_new(g);
+  Events e;
+
+  /* No batch callback yet. */
+  BOOST_CHECK(!libfc_register_field(t, "octetDeltaCount", 0, 0));
+
+  BOOST_CHECK(!libfc_register_batch_callback(t, 0, 64, flow_batch, &e));
+  BOOST_CHECK(libfc_register_batch_callback(t, sizeof(flow), 64, flow_batch,
+                                            &e));
+  BOOST_CHECK(!libfc_register_batch_callback(t, sizeof(flow), 64,
+                                             flow_batch, &e));
+
+  BOOST_CHECK(!libfc_register_field(t, "octetDeltaCount",
+                                    offsetof(flow, octets) + 4, 0));
+  BOOST_CHECK(!libfc_register_field(t, "octetDeltaCount", sizeof(flow), 0));
+  BOOST_CHECK(!libfc_register_field(t, "interfaceName", 0, 0));
+  BOOST_CHECK(!libfc_register_field(t, "noSuchInformationElement", 0, 0));
+  BOOST_CHECK(libfc_register_field(t, "octetDeltaCount",
+                                   offsetof(flow, octets), 0));
+
+  libfc_template_group_delete(g);
+}
+
+BOOST_AUTO_TEST_CASE(FromBuffer) {
+  std::vector<uint8_t> buf = records_in_memory();
+  Events e;
+  init_events(&e);
+
+  struct libfc_template_group_t *g = make_group(&e);
+  BOOST_CHECK(libfc_collect_from_buffer(buf.data(), buf.size(), "buffer", g));
+  libfc_template_group_delete(g);
+
+  check_events(e);
+}
+
+BOOST_AUTO_TEST_CASE(Feed) {
+  std::vector<uint8_t> buf = records_in_memory();
+  Events e;
+  init_events(&e);
+
+  struct libfc_template_group_t *g = make_group(&e);
+  struct libfc_feeder_t *f = libfc_feeder_new(g, "feed");
+
+  /* Pieces of all sizes, from single bytes to several messages. */
+  uint32_t r = 12345;
+  size_t off = 0;
+  while (off < buf.size()) {
+    r = r * 1103515245 + 12345;
+    size_t n = std::min<size_t>(1 + (r >> 8) % (r % 4 == 0 ? 5000 : 20),
+                                buf.size() - off);
+    BOOST_REQUIRE(libfc_feed(f, &buf[off], n));
+    off += n;
+  }
+  BOOST_CHECK_EQUAL(libfc_feeder_pending(f), 0U);
+
+  libfc_feeder_delete(f);
+  libfc_template_group_delete(g);
+
+  check_events(e);
+}
+
+BOOST_AUTO_TEST_CASE(FeedGarbage) {
+  Events e;
+  init_events(&e);
+
+  struct libfc_template_group_t *g = make_group(&e);
+  struct libfc_feeder_t *f = libfc_feeder_new(g, 0);
+
+  /* An IPFIX header claiming to be shorter than a header. */
+  static const uint8_t garbage[16] = { 0x00, 0x0a, 0x00, 0x04 };
+  BOOST_CHECK(libfc_feed(f, garbage, 3));
+  BOOST_CHECK_EQUAL(libfc_feeder_pending(f), 3U);
+  BOOST_CHECK(!libfc_feed(f, garbage + 3, sizeof(garbage) - 3));
+  BOOST_CHECK_EQUAL(libfc_feeder_pending(f), 0U);
+
+  libfc_feeder_delete(f);
+  libfc_template_group_delete(g);
+}
+
+BOOST_AUTO_TEST_CASE(FromUDP) {
+  std::vector<uint8_t> buf = records_in_memory();
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  BOOST_REQUIRE(fd >= 0);
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t sa_len = sizeof(sa);
+  BOOST_REQUIRE(bind(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                     sizeof(sa)) == 0);
+  BOOST_REQUIRE(getsockname(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                            &sa_len) == 0);
+  struct timeval tv = { 0, 200000 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  /* Send one message per datagram; they all fit into the socket's
+   * receive buffer. */
+  int out = socket(AF_INET, SOCK_DGRAM, 0);
+  BOOST_REQUIRE(out >= 0);
+  for (size_t off = 0; off < buf.size(); ) {
+    size_t length = (buf[off + 2] << 8) | buf[off + 3];
+    BOOST_REQUIRE(sendto(out, &buf[off], length, 0,
+                         reinterpret_cast<struct sockaddr *>(&sa),
+                         sizeof(sa)) == static_cast<ssize_t>(length));
+    off += length;
+  }
+  close(out);
+
+  Events e;
+  init_events(&e);
+  struct libfc_template_group_t *g = make_group(&e);
+  BOOST_CHECK(libfc_collect_from_udp(fd, 8, g));
+  libfc_template_group_delete(g);
+  close(fd);
+
+  check_events(e);
+}
+
+BOOST_AUTO_TEST_CASE(FromTCP) {
+  std::vector<uint8_t> buf = records_in_memory();
+
+  int fds[2];
+  BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  BOOST_REQUIRE(write(fds[0], buf.data(), buf.size())
+                == static_cast<ssize_t>(buf.size()));
+  close(fds[0]);
+
+  Events e;
+  init_events(&e);
+  struct libfc_template_group_t *g = make_group(&e);
+  BOOST_CHECK(libfc_collect_from_tcp(fds[1], g));
+  libfc_template_group_delete(g);
+
+  /* Still open. */
+  BOOST_CHECK(close(fds[1]) == 0);
+
+  check_events(e);
+}
+
+/** Exports the same records as export_records(), but through the C
+ * API: flows from an array in batches, ports one at a time. */
+static void c_export_records(struct libfc_exporter_t *x) {
+  std::vector<flow> flows(1500);
+  for (size_t i = 0; i < flows.size(); i++) {
+    flows[i].sip = 0x0a000001;
+    flows[i].dip = 0x0a000002;
+    flows[i].octets = i;
+  }
+  uint16_t sp = 1;
+  uint16_t dp = 2;
+
+  struct libfc_export_template_t *f
+    = libfc_exporter_template_new(x, sizeof(flow));
+  BOOST_CHECK(libfc_exporter_register_field(f, "sourceIPv4Address",
+                                            offsetof(flow, sip), 0));
+  BOOST_CHECK(libfc_exporter_register_field(f, "destinationIPv4Address",
+                                            offsetof(flow, dip), 0));
+  BOOST_CHECK(libfc_exporter_register_field(f, "octetDeltaCount",
+                                            offsetof(flow, octets), 4));
+
+  struct libfc_export_template_t *p = libfc_exporter_template_new(x, 0);
+  BOOST_CHECK(libfc_exporter_register_placement(p, "sourceTransportPort",
+                                                &sp, 0));
+  BOOST_CHECK(libfc_exporter_register_placement(p, "destinationTransportPort",
+                                                &dp, 0));
+
+  BOOST_CHECK(libfc_exporter_place_records(x, f, flows.data(), sizeof(flow),
+                                           1000));
+  BOOST_CHECK(libfc_exporter_place(x, p));
+  BOOST_CHECK(libfc_exporter_place_records(x, f, flows.data() + 1000,
+                                           sizeof(flow), 500));
+  sp = 3;
+  BOOST_CHECK(libfc_exporter_place(x, p));
+  BOOST_CHECK(libfc_exporter_flush(x));
+}
+
+BOOST_AUTO_TEST_CASE(ExportToMemory) {
+  struct libfc_exporter_t *x = libfc_exporter_new_memory(1, 1400);
+  c_export_records(x);
+
+  size_t len = 0;
+  const void *buf = libfc_exporter_get_buffer(x, &len);
+  BOOST_REQUIRE(buf != 0);
+  BOOST_CHECK(len > 1400);
+
+  Events e;
+  init_events(&e);
+  struct libfc_template_group_t *g = make_group(&e);
+  BOOST_CHECK(libfc_collect_from_buffer(buf, len, "buffer", g));
+  libfc_template_group_delete(g);
+  check_events(e);
+
+  libfc_exporter_clear_buffer(x);
+  libfc_exporter_get_buffer(x, &len);
+  BOOST_CHECK_EQUAL(len, 0U);
+  libfc_exporter_delete(x);
+}
+
+BOOST_AUTO_TEST_CASE(ExportToFile) {
+  char file_name[] = "/tmp/fctest-cbinding-XXXXXX";
+  int fd = mkstemp(file_name);
+  BOOST_REQUIRE(fd >= 0);
+
+  struct libfc_exporter_t *x = libfc_exporter_new_file(fd, 1, 0);
+  size_t len = 0;
+  BOOST_CHECK(libfc_exporter_get_buffer(x, &len) == 0);
+  c_export_records(x);
+  libfc_exporter_delete(x);
+  close(fd);
+
+  Events e;
+  init_events(&e);
+  BOOST_CHECK(collect(file_name, &e));
+  check_events(e);
+  unlink(file_name);
+}
+
+BOOST_AUTO_TEST_CASE(ExportBadFields) {
+  struct libfc_exporter_t *x = libfc_exporter_new_memory(1, 0);
+  uint64_t v = 0;
+
+  struct libfc_export_template_t *t
+    = libfc_exporter_template_new(x, sizeof(flow));
+  BOOST_CHECK(!libfc_exporter_register_field(t, "noSuchElement", 0, 0));
+  /* Doesn't fit into the record. */
+  BOOST_CHECK(!libfc_exporter_register_field(t, "octetDeltaCount",
+                                             offsetof(flow, octets) + 4, 0));
+  /* Longer than the native size. */
+  BOOST_CHECK(!libfc_exporter_register_placement(t, "octetDeltaCount", &v,
+                                                 16));
+  /* Octet arrays and strings need more than a pointer. */
+  BOOST_CHECK(!libfc_exporter_register_placement(t, "interfaceName", &v, 0));
+  BOOST_CHECK(libfc_exporter_register_placement(t, "octetDeltaCount", &v, 0));
+  BOOST_CHECK(!libfc_exporter_register_field(t, "octetDeltaCount",
+                                             offsetof(flow, octets), 0));
+
+  libfc_exporter_delete(x);
+}
+
+static struct libfc_template_group_t *make_worker_group(unsigned worker,
+                                                        void *vparg) {
+  Events *e = static_cast<Events *>(vparg) + worker;
+  return make_group(e);
+}
+
+BOOST_AUTO_TEST_CASE(FilesInParallel) {
+  const size_t n_files = 7;
+  const unsigned n_threads = 3;
+
+  std::vector<std::string> names;
+  for (size_t i = 0; i < n_files; i++)
+    names.push_back(write_records());
+  names.push_back("/nonexistent/fctest-cbinding");
+
+  std::vector<const char *> paths;
+  for (size_t i = 0; i < names.size(); i++)
+    paths.push_back(names[i].c_str());
+
+  Events e[n_threads];
+  for (unsigned i = 0; i < n_threads; i++)
+    init_events(&e[i]);
+
+  int results[n_files + 1];
+  BOOST_CHECK(!libfc_collect_files_parallel(paths.data(), paths.size(),
+                                            n_threads, make_worker_group, e,
+                                            results));
+  for (size_t i = 0; i < n_files; i++)
+    BOOST_CHECK(results[i]);
+  BOOST_CHECK(!results[n_files]);
+
+  /* Each worker sees whole files, one after the other. */
+  size_t n_seen = 0;
+  for (unsigned i = 0; i < n_threads; i++) {
+    BOOST_CHECK_EQUAL(e[i].seen.size() % 1502, 0U);
+    for (size_t j = 0; j + 1502 <= e[i].seen.size(); j += 1502) {
+      Events file;
+      init_events(&file);
+      file.seen.assign(e[i].seen.begin() + j, e[i].seen.begin() + j + 1502);
+      check_events(file);
+    }
+    n_seen += e[i].seen.size();
+  }
+  BOOST_CHECK_EQUAL(n_seen, n_files * 1502);
+
+  for (size_t i = 0; i < n_files; i++)
+    unlink(names[i].c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,93 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "ExportDelayTracker.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(ExportDelay)
+
+BOOST_AUTO_TEST_CASE(Buckets) {
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(0), 0);
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(1), 1);
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(2), 2);
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(3), 2);
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(4), 3);
+  BOOST_CHECK_EQUAL(ExportDelayTracker::bucket(1ULL << 40),
+                    ExportDelayTracker::kBuckets - 1);
+}
+
+BOOST_AUTO_TEST_CASE(Histogram) {
+  ExportDelayTracker t;
+  const int64_t now = 1400000000;
+
+  for (int i = 0; i < 98; i++)
+    t.record("exporter", 1, now, now);
+  t.record("exporter", 1, now - 3, now);
+  t.record("exporter", 1, now - 100, now);
+
+  const ExportDelayTracker::Stats *s = t.get_stats("exporter", 1);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->messages, 100);
+  BOOST_CHECK_EQUAL(s->behind[0], 98);
+  BOOST_CHECK_EQUAL(s->behind[2], 1);
+  BOOST_CHECK_EQUAL(s->behind[7], 1);
+  BOOST_CHECK_EQUAL(s->min_delay, 0);
+  BOOST_CHECK_EQUAL(s->max_delay, 100);
+  BOOST_CHECK_EQUAL(s->queueing_delay(), 100);
+  BOOST_CHECK_EQUAL(s->quantile(0.5), 0);
+  BOOST_CHECK_EQUAL(s->quantile(0.985), 3);
+  BOOST_CHECK_EQUAL(s->quantile(1.0), 127);
+  BOOST_CHECK(!t.is_skewed(*s));
+  BOOST_CHECK(t.get_skewed_exporters().empty());
+}
+
+BOOST_AUTO_TEST_CASE(ClockSkew) {
+  ExportDelayTracker t;
+  const int64_t now = 1400000000;
+
+  /* Exporter 'fast' is an hour ahead, 'slow' ten minutes behind. */
+  t.record("fast", 1, now + 3600, now);
+  t.record("fast", 1, now + 3599, now);
+  t.record("slow", 1, now - 600, now);
+  t.record("good", 1, now - 1, now);
+
+  BOOST_CHECK_EQUAL(t.get_stats("fast", 1)->ahead[12], 2);
+  BOOST_CHECK_EQUAL(t.get_stats("fast", 1)->min_delay, -3600);
+
+  std::map<ExportDelayTracker::key_type, int64_t> skewed =
+      t.get_skewed_exporters();
+  BOOST_CHECK_EQUAL(skewed.size(), 2);
+  BOOST_CHECK_EQUAL(skewed[ExportDelayTracker::key_type("fast", 1)], -3600);
+  BOOST_CHECK_EQUAL(skewed[ExportDelayTracker::key_type("slow", 1)], 600);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,666 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__linux__)
+#  include <linux/mempolicy.h>
+#  include <sys/syscall.h>
+#endif
+
+#include "BufferInputSource.h"
+#include "FileExportDestination.h"
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "StatDatInputSource.h"
+#include "StaticPlacementCollector.h"
+#include "UDPExportDestination.h"
+#include "WandioInputSource.h"
+
+#include "Configuration.h"
+#include "DirectoryListener.h"
+#include "Frontend.h"
+#include "IPFIXBackend.h"
+#include "ImpFactory.h"
+#include "MessageBufferPool.h"
+#include "Numa.h"
+#include "TCPListener.h"
+#include "UDPListener.h"
+#include "WorkerPool.h"
+
+using namespace libfc;
+using namespace fcold;
+
+BOOST_AUTO_TEST_SUITE(Fcold)
+
+/* Keeps the octetDeltaCount values of every session. */
+class TestBackends : public BackendFactory {
+public:
+  class TestBackend : public Backend {
+  public:
+    TestBackend(TestBackends &backends, const std::string &name)
+        : backends(backends), name(name) {}
+
+    std::shared_ptr<ErrorContext> record(const PlacementTemplate *tmpl,
+                                         const FlowRecord &rec) {
+      std::unique_lock<std::mutex> lock(backends.mtx);
+      backends.values[name].push_back(rec.octetDeltaCount);
+      LIBFC_RETURN_OK();
+    }
+
+  private:
+    TestBackends &backends;
+    std::string name;
+  };
+
+  Backend *create_backend(const std::string &session_name) {
+    return new TestBackend(*this, session_name);
+  }
+
+  std::map<std::string, std::vector<uint64_t> > get_values() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return values;
+  }
+
+  size_t get_n_records() {
+    std::unique_lock<std::mutex> lock(mtx);
+    size_t n = 0;
+    for (auto v = values.begin(); v != values.end(); ++v)
+      n += v->second.size();
+    return n;
+  }
+
+private:
+  std::mutex mtx;
+  std::map<std::string, std::vector<uint64_t> > values;
+};
+
+/* Counts the sessions that have ended. */
+class TestImpFactory : public ImpFactory {
+public:
+  TestImpFactory(BackendFactory &backends, WorkerPool &pool)
+      : ImpFactory(backends, pool), n_closed(0), n_errors(0) {}
+
+  void session_closed(const Imp &imp) {
+    std::unique_lock<std::mutex> lock(mtx);
+    n_closed++;
+    n_errors += imp.get_n_errors();
+  }
+
+  unsigned int get_n_closed() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return n_closed;
+  }
+
+  unsigned int get_n_errors() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return n_errors;
+  }
+
+private:
+  std::mutex mtx;
+  unsigned int n_closed;
+  unsigned int n_errors;
+};
+
+/* Waits up to ten seconds for a condition to become true. */
+static bool wait_until(std::function<bool()> condition) {
+  for (int i = 0; i < 1000; i++) {
+    if (condition())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+/* Exports n flows with octetDeltaCount first, first + 1, ..., with a
+ * field that fcold doesn't know about thrown in. */
+static void export_flows(ExportDestination &d, uint32_t observation_domain,
+                         uint64_t first, unsigned int n) {
+  uint64_t octets;
+  uint32_t source = 0x0a000001;
+  uint32_t label = 17;
+
+  PlacementTemplate tmpl;
+  InfoModel &model = InfoModel::instance();
+  tmpl.register_placement(model.lookupIE("sourceIPv4Address"), &source, 0);
+  tmpl.register_placement(model.lookupIE("octetDeltaCount"), &octets, 0);
+  tmpl.register_placement(model.lookupIE("flowLabelIPv6"), &label, 0);
+
+  PlacementExporter e(d, observation_domain);
+  for (unsigned int i = 0; i < n; i++) {
+    octets = first + i;
+    e.place_values(&tmpl);
+  }
+}
+
+static void check_values(const std::vector<uint64_t> &values, uint64_t first,
+                         unsigned int n) {
+  BOOST_REQUIRE_EQUAL(values.size(), n);
+  for (unsigned int i = 0; i < n; i++)
+    BOOST_CHECK_EQUAL(values[i], first + i);
+}
+
+static std::string local_name(int fd) {
+  struct sockaddr_in sa;
+  socklen_t sa_len = sizeof sa;
+  BOOST_REQUIRE(getsockname(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                            &sa_len) == 0);
+  return "127.0.0.1:" + std::to_string(ntohs(sa.sin_port));
+}
+
+static struct sockaddr_in loopback(uint16_t port) {
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof sa);
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return sa;
+}
+
+static std::string make_temp_dir() {
+  char name[] = "/tmp/TestFcoldXXXXXX";
+  BOOST_REQUIRE(mkdtemp(name) != 0);
+  return name;
+}
+
+BOOST_AUTO_TEST_CASE(AddressSpecs) {
+  std::string address;
+  std::string port;
+
+  Configuration::split_address("4739", address, port);
+  BOOST_CHECK_EQUAL(address, "");
+  BOOST_CHECK_EQUAL(port, "4739");
+  Configuration::split_address("127.0.0.1:4740", address, port);
+  BOOST_CHECK_EQUAL(address, "127.0.0.1");
+  BOOST_CHECK_EQUAL(port, "4740");
+  Configuration::split_address("[::1]:4741", address, port);
+  BOOST_CHECK_EQUAL(address, "::1");
+  BOOST_CHECK_EQUAL(port, "4741");
+}
+
+BOOST_AUTO_TEST_CASE(BufferPool) {
+  for (int hugepages = 0; hugepages < 2; hugepages++) {
+    MessageBufferPool pool(4, kMBufSz, hugepages != 0);
+
+    std::vector<MessageBuffer *> mbs;
+    for (int i = 0; i < 4; i++) {
+      MessageBuffer *mb = pool.get();
+      BOOST_REQUIRE(mb != 0);
+      BOOST_CHECK_EQUAL(mb->bufsz(), kMBufSz);
+      BOOST_CHECK_EQUAL(mb->buflen(), 0);
+      memset(mb->bufptr(), i, mb->bufsz());
+      mbs.push_back(mb);
+    }
+    BOOST_CHECK(pool.get() == 0);
+
+    /* Names are kept in the buffer, cut to length. */
+    std::string long_name(2 * kSrcNameLen, 'x');
+    mbs[0]->setbuflen(16);
+    mbs[0]->set_metadata(0, 0, 0, long_name.c_str());
+    BOOST_CHECK_EQUAL(mbs[0]->get_name(), long_name.substr(0, kSrcNameLen));
+    mbs[0]->set_metadata(0, 0, 0, "192.0.2.1:4739");
+    BOOST_CHECK_EQUAL(mbs[0]->get_name(), std::string("192.0.2.1:4739"));
+
+    /* Returned buffers come back empty, most recent first. */
+    pool.put(mbs[0]);
+    MessageBuffer *mb = pool.get();
+    BOOST_CHECK(mb == mbs[0]);
+    BOOST_CHECK_EQUAL(mb->buflen(), 0);
+    BOOST_CHECK(std::string(mb->get_name()) != "192.0.2.1:4739");
+
+    pool.put(mbs.data(), mbs.size());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(FrontendWithFewBuffers) {
+  /* Many small messages through two buffers, so that the Frontend
+   * keeps waiting for its Imp to hand buffers back. */
+  MemoryExportDestination d(false, 256);
+  export_flows(d, 1, 1, 5000);
+
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+  MessageBufferPool mbufs(2);
+  {
+    Frontend frontend(impfact, mbufs,
+                      new BufferInputSource(d.get_buffer().data(),
+                                            d.get_buffer().size()),
+                      "few-buffers", 10);
+    BOOST_CHECK(frontend.run() == 0);
+  }
+
+  BOOST_CHECK_EQUAL(impfact.get_n_closed(), 1);
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+  check_values(backends.get_values()["few-buffers"], 1, 5000);
+}
+
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+BOOST_AUTO_TEST_CASE(BuffersOnNumaNode) {
+  std::vector<int> nodes = numa_nodes();
+  if (nodes.empty())
+    return;
+
+  /* The last node, so that placing the buffers there isn't just the
+   * kernel's default on machines with several nodes. */
+  int node = nodes.back();
+  MessageBufferPool mbufs(4, kMBufSz, false, node);
+  BOOST_REQUIRE_EQUAL(mbufs.get_numa_node(), node);
+
+  MessageBuffer *mb = mbufs.get();
+  BOOST_REQUIRE(mb != 0);
+  memset(mb->bufptr(), 0, mb->bufsz());
+
+  int placed = -1;
+  BOOST_REQUIRE(syscall(SYS_get_mempolicy, &placed, 0, 0, mb->bufptr(),
+                        MPOL_F_NODE | MPOL_F_ADDR) == 0);
+  BOOST_CHECK_EQUAL(placed, node);
+  mbufs.put(mb);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(UDPLoopback) {
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  UDPListener listener(impfact, "127.0.0.1", "0", 16);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  /* Two exporters, told apart by their source ports. */
+  struct sockaddr_in sa = loopback(listener.get_port());
+  int fd1 = socket(AF_INET, SOCK_DGRAM, 0);
+  int fd2 = socket(AF_INET, SOCK_DGRAM, 0);
+  BOOST_REQUIRE(fd1 >= 0 && fd2 >= 0);
+  {
+    UDPExportDestination d1(reinterpret_cast<struct sockaddr *>(&sa),
+                            sizeof sa, fd1, 1400);
+    UDPExportDestination d2(reinterpret_cast<struct sockaddr *>(&sa),
+                            sizeof sa, fd2, 1400);
+    export_flows(d1, 1, 0, 500);
+    export_flows(d2, 2, 1000, 300);
+  }
+
+  BOOST_CHECK(wait_until([&backends]() {
+    return backends.get_n_records() >= 800;
+  }));
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_closed(), 2);
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+
+  std::map<std::string, std::vector<uint64_t> > values = backends.get_values();
+  BOOST_CHECK_EQUAL(values.size(), 2);
+  check_values(values[local_name(fd1)], 0, 500);
+  check_values(values[local_name(fd2)], 1000, 300);
+
+  close(fd1);
+  close(fd2);
+}
+
+BOOST_AUTO_TEST_CASE(UDPIdleSessionsExpire) {
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  /* Sessions close after a second without messages. */
+  UDPListener listener(impfact, "127.0.0.1", "0", 16, false, -1, 1);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  struct sockaddr_in sa = loopback(listener.get_port());
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  BOOST_REQUIRE(fd >= 0);
+  {
+    UDPExportDestination d(reinterpret_cast<struct sockaddr *>(&sa),
+                           sizeof sa, fd, 1400);
+    export_flows(d, 1, 0, 100);
+  }
+
+  /* Closed while the listener still runs. */
+  BOOST_CHECK(wait_until([&impfact]() {
+    return impfact.get_n_closed() == 1;
+  }));
+  check_values(backends.get_values()[local_name(fd)], 0, 100);
+
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_closed(), 1);
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+  close(fd);
+}
+
+BOOST_AUTO_TEST_CASE(UDPSessionLimit) {
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  UDPListener listener(impfact, "127.0.0.1", "0", 16, false, -1, 600, 2);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  struct sockaddr_in sa = loopback(listener.get_port());
+  int fds[3];
+  for (int i = 0; i < 3; i++) {
+    fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+    BOOST_REQUIRE(fds[i] >= 0);
+    UDPExportDestination d(reinterpret_cast<struct sockaddr *>(&sa),
+                           sizeof sa, fds[i], 1400);
+    export_flows(d, 1, i * 1000, 10);
+  }
+
+  /* The third exporter's messages came before these. */
+  {
+    UDPExportDestination d(reinterpret_cast<struct sockaddr *>(&sa),
+                           sizeof sa, fds[0], 1400);
+    export_flows(d, 1, 10, 10);
+  }
+  BOOST_CHECK(wait_until([&backends]() {
+    return backends.get_n_records() >= 30;
+  }));
+  listener.stop();
+
+  BOOST_CHECK_EQUAL(impfact.get_n_closed(), 2);
+  std::map<std::string, std::vector<uint64_t> > values = backends.get_values();
+  check_values(values[local_name(fds[0])], 0, 20);
+  check_values(values[local_name(fds[1])], 1000, 10);
+  BOOST_CHECK(values[local_name(fds[2])].empty());
+
+  for (int i = 0; i < 3; i++)
+    close(fds[i]);
+}
+
+/* Collects octetDeltaCount and the observation domain of every
+ * record. */
+class OctetCollector : public StaticPlacementCollector<OctetCollector> {
+public:
+  OctetCollector()
+      : StaticPlacementCollector<OctetCollector>(PlacementCollector::ipfix),
+        octets(0), domain(0) {
+    tmpl.register_placement(InfoModel::instance().lookupIE("octetDeltaCount"),
+                            &octets, 0);
+    register_placement_template(&tmpl);
+  }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    domain = observation_domain;
+    LIBFC_RETURN_OK();
+  }
+
+  bool end_record(const PlacementTemplate *t) {
+    values.push_back(octets);
+    domains.push_back(domain);
+    return true;
+  }
+
+  std::vector<uint64_t> values;
+  std::vector<uint32_t> domains;
+
+private:
+  PlacementTemplate tmpl;
+  uint64_t octets;
+  uint32_t domain;
+};
+
+BOOST_AUTO_TEST_CASE(TCPLoopbackToIPFIXFiles) {
+  std::string dir = make_temp_dir();
+  IPFIXBackendFactory backends(dir);
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  TCPListener listener(impfact, "127.0.0.1", "0", 16);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  struct sockaddr_in sa = loopback(listener.get_port());
+  int fd1 = socket(AF_INET, SOCK_STREAM, 0);
+  int fd2 = socket(AF_INET, SOCK_STREAM, 0);
+  BOOST_REQUIRE(fd1 >= 0 && fd2 >= 0);
+  BOOST_REQUIRE(connect(fd1, reinterpret_cast<struct sockaddr *>(&sa),
+                        sizeof sa) == 0);
+  BOOST_REQUIRE(connect(fd2, reinterpret_cast<struct sockaddr *>(&sa),
+                        sizeof sa) == 0);
+  std::string name1 = local_name(fd1);
+  std::string name2 = local_name(fd2);
+  {
+    /* Interleave the two connections. */
+    FileExportDestination d1(fd1);
+    FileExportDestination d2(fd2);
+    export_flows(d1, 7, 0, 2000);
+    export_flows(d2, 8, 5000, 3000);
+    export_flows(d1, 9, 100, 10);
+  }
+  close(fd1);
+  close(fd2);
+
+  BOOST_CHECK(wait_until([&impfact]() { return impfact.get_n_closed() == 2; }));
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+
+  OctetCollector c1;
+  WandioInputSource is1(backends.file_name(name1));
+  BOOST_REQUIRE(is1.get_error() == 0);
+  BOOST_CHECK(c1.collect(is1) == 0);
+  BOOST_REQUIRE_EQUAL(c1.values.size(), 2010);
+  for (unsigned int i = 0; i < 2000; i++) {
+    BOOST_CHECK_EQUAL(c1.values[i], i);
+    BOOST_CHECK_EQUAL(c1.domains[i], 7);
+  }
+  for (unsigned int i = 0; i < 10; i++) {
+    BOOST_CHECK_EQUAL(c1.values[2000 + i], 100 + i);
+    BOOST_CHECK_EQUAL(c1.domains[2000 + i], 9);
+  }
+
+  OctetCollector c2;
+  WandioInputSource is2(backends.file_name(name2));
+  BOOST_REQUIRE(is2.get_error() == 0);
+  BOOST_CHECK(c2.collect(is2) == 0);
+  check_values(c2.values, 5000, 3000);
+
+  unlink(backends.file_name(name1).c_str());
+  unlink(backends.file_name(name2).c_str());
+  rmdir(dir.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(ManyShortTCPConnections) {
+  /* Every connection ends while its Imp's last batch may still be
+   * finishing on a worker. */
+  TestBackends backends;
+  WorkerPool pool(4);
+  TestImpFactory impfact(backends, pool);
+
+  TCPListener listener(impfact, "127.0.0.1", "0", 16);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  const unsigned int n_connections = 200;
+  struct sockaddr_in sa = loopback(listener.get_port());
+  std::vector<std::string> names;
+  for (unsigned int i = 0; i < n_connections; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE(connect(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                          sizeof sa) == 0);
+    names.push_back(local_name(fd));
+    {
+      FileExportDestination d(fd);
+      export_flows(d, 1, i, 1 + i % 5);
+    }
+    close(fd);
+  }
+
+  BOOST_CHECK(wait_until([&impfact]() {
+    return impfact.get_n_closed() == n_connections;
+  }));
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+
+  std::map<std::string, std::vector<uint64_t> > values = backends.get_values();
+  BOOST_CHECK_EQUAL(values.size(), n_connections);
+  for (unsigned int i = 0; i < n_connections; i++)
+    check_values(values[names[i]], i, 1 + i % 5);
+}
+
+BOOST_AUTO_TEST_CASE(IdleTCPConnections) {
+  /* Connections that have sent their messages and stay open must not
+   * keep the buffers that a new connection needs. */
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  TCPListener listener(impfact, "127.0.0.1", "0", 16);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  const unsigned int n_idle = 4;
+  const unsigned int n_messages = 200;
+  struct sockaddr_in sa = loopback(listener.get_port());
+  std::vector<int> idle_fds;
+  std::vector<std::string> names;
+  for (unsigned int i = 0; i < n_idle; i++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_REQUIRE(connect(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                          sizeof sa) == 0);
+    idle_fds.push_back(fd);
+    names.push_back(local_name(fd));
+    FileExportDestination d(fd);
+    for (unsigned int m = 0; m < n_messages; m++)
+      export_flows(d, 1, m * 2, 2);
+  }
+  BOOST_CHECK(wait_until([&backends]() {
+    return backends.get_n_records() == n_idle * n_messages * 2;
+  }));
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  BOOST_REQUIRE(fd >= 0);
+  BOOST_REQUIRE(connect(fd, reinterpret_cast<struct sockaddr *>(&sa),
+                        sizeof sa) == 0);
+  std::string active_name = local_name(fd);
+  {
+    FileExportDestination d(fd);
+    export_flows(d, 1, 5000, 5);
+  }
+  close(fd);
+  BOOST_CHECK(wait_until([&impfact]() {
+    return impfact.get_n_closed() == 1;
+  }));
+  BOOST_CHECK_EQUAL(backends.get_values()[active_name].size(), 5);
+
+  for (unsigned int i = 0; i < n_idle; i++)
+    close(idle_fds[i]);
+  BOOST_CHECK(wait_until([&impfact]() {
+    return impfact.get_n_closed() == n_idle + 1;
+  }));
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+
+  std::map<std::string, std::vector<uint64_t> > values = backends.get_values();
+  check_values(values[active_name], 5000, 5);
+  for (unsigned int i = 0; i < n_idle; i++)
+    check_values(values[names[i]], 0, n_messages * 2);
+}
+
+BOOST_AUTO_TEST_CASE(DirectoryFilesAndStatDat) {
+  std::string dir = make_temp_dir();
+  TestBackends backends;
+  WorkerPool pool(2);
+  TestImpFactory impfact(backends, pool);
+
+  DirectoryListener listener(impfact, dir, 16);
+  BOOST_REQUIRE(listener.is_good());
+  listener.start();
+
+  /* An IPFIX file, moved into place. */
+  MemoryExportDestination file;
+  export_flows(file, 1, 0, 1000);
+  std::string tmp_name = dir + "/.flows.ipfix";
+  FILE *f = fopen(tmp_name.c_str(), "wb");
+  BOOST_REQUIRE(f != 0);
+  fwrite(file.get_buffer().data(), 1, file.get_buffer().size(), f);
+  fclose(f);
+  BOOST_REQUIRE(rename(tmp_name.c_str(), (dir + "/flows.ipfix").c_str()) == 0);
+
+  /* A stat+dat capture of two exporters, one message each. */
+  MemoryExportDestination a;
+  MemoryExportDestination b;
+  export_flows(a, 1, 10, 20);
+  export_flows(b, 1, 50, 30);
+  FILE *dat = fopen((dir + "/capture.dat").c_str(), "wb");
+  BOOST_REQUIRE(dat != 0);
+  fwrite(a.get_buffer().data(), 1, a.get_buffer().size(), dat);
+  fwrite(b.get_buffer().data(), 1, b.get_buffer().size(), dat);
+  fclose(dat);
+  FILE *stat = fopen((dir + "/capture.stat").c_str(), "w");
+  BOOST_REQUIRE(stat != 0);
+  fprintf(stat, " Format:\n P <p.-number> <relative time> <p.-lenght> "
+                "<src IP:port>\n\n");
+  fprintf(stat, "P  0      0.000000   %zu  10.0.0.1:4739\n",
+          a.get_buffer().size());
+  fprintf(stat, "P  1      0.000000   %zu  10.0.0.2:4740\n",
+          b.get_buffer().size());
+  fclose(stat);
+
+  BOOST_CHECK(wait_until([&impfact]() { return impfact.get_n_closed() == 3; }));
+  listener.stop();
+  BOOST_CHECK_EQUAL(impfact.get_n_errors(), 0);
+
+  std::map<std::string, std::vector<uint64_t> > values = backends.get_values();
+  BOOST_CHECK_EQUAL(values.size(), 3);
+  check_values(values["flows.ipfix"], 0, 1000);
+  check_values(values["10.0.0.1:4739"], 10, 20);
+  check_values(values["10.0.0.2:4740"], 50, 30);
+
+  unlink((dir + "/flows.ipfix").c_str());
+  unlink((dir + "/capture.dat").c_str());
+  unlink((dir + "/capture.stat").c_str());
+  rmdir(dir.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,245 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "FileExportDestination.h"
+#include "InfoModel.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+
+#include "libftrace.h"
+#include "uniflow_ring.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(Ftrace)
+
+BOOST_AUTO_TEST_CASE(RingKeepsOrder) {
+  /* A small ring, so that both sides have to sleep now and then. */
+  libftrace_ring_t *ring = ftrace_ring_create(16, 4);
+  BOOST_REQUIRE(ring != 0);
+
+  const uint64_t n = 100000;
+  std::thread producer([ring, n] {
+      libftrace_uniflow_t uf;
+      memset(&uf, 0, sizeof(uf));
+      for (uint64_t i = 0; i < n; i++) {
+        uf.packets = i;
+        ftrace_ring_push(ring, &uf);
+      }
+      ftrace_ring_close(ring);
+    });
+
+  libftrace_uniflow_t uf;
+  uint64_t expected = 0;
+  bool in_order = true;
+  while (ftrace_ring_pop(ring, &uf)) {
+    in_order = in_order && uf.packets == expected;
+    expected++;
+  }
+  producer.join();
+
+  BOOST_CHECK(in_order);
+  BOOST_CHECK_EQUAL(expected, n);
+  BOOST_CHECK_EQUAL(ftrace_ring_pop(ring, &uf), 0);
+
+  ftrace_ring_destroy(ring);
+}
+
+BOOST_AUTO_TEST_CASE(RingDeliversPartialBatch) {
+  /* A single record from a source that then goes quiet must reach a
+   * consumer that sleeps waiting for a whole batch. */
+  libftrace_ring_t *ring = ftrace_ring_create(1024, 256);
+  BOOST_REQUIRE(ring != 0);
+
+  std::atomic<bool> popped(false);
+  std::thread consumer([ring, &popped] {
+      libftrace_uniflow_t uf;
+      if (ftrace_ring_pop(ring, &uf))
+        popped = true;
+    });
+
+  /* Let the consumer park first. */
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  libftrace_uniflow_t uf;
+  memset(&uf, 0, sizeof(uf));
+  BOOST_CHECK_EQUAL(ftrace_ring_push(ring, &uf), 1);
+
+  for (int i = 0; i < 500 && !popped; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  BOOST_CHECK(popped);
+
+  ftrace_ring_close(ring);
+  consumer.join();
+  ftrace_ring_destroy(ring);
+}
+
+BOOST_AUTO_TEST_CASE(RingCancelWakesProducer) {
+  libftrace_ring_t *ring = ftrace_ring_create(4, 2);
+  BOOST_REQUIRE(ring != 0);
+
+  uint64_t n_pushed = 0;
+  std::thread producer([ring, &n_pushed] {
+      libftrace_uniflow_t uf;
+      memset(&uf, 0, sizeof(uf));
+      while (ftrace_ring_push(ring, &uf))
+        n_pushed++;
+    });
+
+  libftrace_uniflow_t uf;
+  BOOST_CHECK_EQUAL(ftrace_ring_pop(ring, &uf), 1);
+  ftrace_ring_cancel(ring);
+  producer.join();
+
+  /* The producer stopped although nobody made room for it. */
+  BOOST_CHECK(n_pushed >= 1);
+
+  ftrace_ring_destroy(ring);
+}
+
+/** Writes count IPv4 uniflows and one IPv6 uniflow to a temporary
+ * file; uniflow i has i packets.  Returns the file name. */
+static std::string write_uniflows(unsigned int count) {
+  InfoModel &model = InfoModel::instance();
+  uint64_t start = 1400000000000ULL;
+  uint64_t end = start + 1000;
+  uint64_t packets;
+  uint64_t octets = 1500;
+  uint32_t sip = 0x0a000001;
+  uint32_t dip = 0x0a000002;
+  uint8_t sip6[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                       0, 0, 0, 0, 0, 0, 0, 1 };
+  uint8_t dip6[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                       0, 0, 0, 0, 0, 0, 0, 2 };
+  uint16_t sp = 12345;
+  uint16_t dp = 80;
+  uint8_t proto = 6;
+
+  PlacementTemplate v4;
+  PlacementTemplate v6;
+  PlacementTemplate *ts[] = { &v4, &v6 };
+  for (unsigned int i = 0; i < 2; i++) {
+    ts[i]->register_placement(model.lookupIE("flowStartMilliseconds"),
+                              &start, 0);
+    ts[i]->register_placement(model.lookupIE("flowEndMilliseconds"), &end, 0);
+    ts[i]->register_placement(model.lookupIE("packetDeltaCount"),
+                              &packets, 0);
+    ts[i]->register_placement(model.lookupIE("octetDeltaCount"), &octets, 0);
+    ts[i]->register_placement(model.lookupIE("sourceTransportPort"), &sp, 0);
+    ts[i]->register_placement(model.lookupIE("destinationTransportPort"),
+                              &dp, 0);
+    ts[i]->register_placement(model.lookupIE("protocolIdentifier"),
+                              &proto, 0);
+  }
+  v4.register_placement(model.lookupIE("sourceIPv4Address"), &sip, 0);
+  v4.register_placement(model.lookupIE("destinationIPv4Address"), &dip, 0);
+  v6.register_placement(model.lookupIE("sourceIPv6Address"), sip6, 0);
+  v6.register_placement(model.lookupIE("destinationIPv6Address"), dip6, 0);
+
+  char file_name[] = "/tmp/fctest-ftrace-XXXXXX";
+  int fd = mkstemp(file_name);
+  BOOST_REQUIRE(fd >= 0);
+  {
+    FileExportDestination d(fd);
+    PlacementExporter e(d, 1);
+    for (packets = 0; packets < count; packets++)
+      e.place_values(&v4);
+    e.place_values(&v6);
+    e.flush();
+  }
+  close(fd);
+
+  return file_name;
+}
+
+BOOST_AUTO_TEST_CASE(ReadsAllUniflows) {
+  const unsigned int count = 10000;
+  std::string file_name = write_uniflows(count);
+
+  libftrace_t *ft = ftrace_create(file_name.c_str(), 10, 0);
+  BOOST_REQUIRE(ft != 0);
+  libftrace_uniflow_t *uf = ftrace_start_uniflow(ft);
+  BOOST_REQUIRE(uf != 0);
+
+  unsigned int n_v4 = 0;
+  bool values_ok = true;
+  while (n_v4 < count && ftrace_next_uniflow(uf) == 1) {
+    values_ok = values_ok && uf->ip_ver == 4 && uf->packets == n_v4
+      && uf->time_start == 1400000000000ULL
+      && uf->time_end == 1400000001000ULL && uf->octets == 1500
+      && uf->ip.v4.src == 0x0a000001 && uf->ip.v4.dst == 0x0a000002
+      && uf->port_src == 12345 && uf->port_dst == 80 && uf->ip_proto == 6;
+    n_v4++;
+  }
+  BOOST_CHECK(values_ok);
+  BOOST_CHECK_EQUAL(n_v4, count);
+
+  BOOST_REQUIRE_EQUAL(ftrace_next_uniflow(uf), 1);
+  BOOST_CHECK_EQUAL(uf->ip_ver, 6);
+  BOOST_CHECK_EQUAL(uf->packets, count);
+  BOOST_CHECK_EQUAL(uf->ip.v6.src[15], 1);
+  BOOST_CHECK_EQUAL(uf->ip.v6.dst[15], 2);
+
+  /* End of file, and it stays that way. */
+  BOOST_CHECK_EQUAL(ftrace_next_uniflow(uf), 0);
+  BOOST_CHECK_EQUAL(ftrace_next_uniflow(uf), 0);
+
+  ftrace_destroy_uniflow(uf);
+  ftrace_destroy(ft);
+  unlink(file_name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(StopsEarly) {
+  std::string file_name = write_uniflows(100000);
+
+  libftrace_t *ft = ftrace_create(file_name.c_str(), 10, 0);
+  BOOST_REQUIRE(ft != 0);
+  libftrace_uniflow_t *uf = ftrace_start_uniflow(ft);
+  BOOST_REQUIRE(uf != 0);
+
+  for (unsigned int i = 0; i < 10; i++)
+    BOOST_CHECK_EQUAL(ftrace_next_uniflow(uf), 1);
+
+  /* Must not hang although the reader thread has lots left to read. */
+  ftrace_destroy_uniflow(uf);
+  ftrace_destroy(ft);
+  unlink(file_name.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
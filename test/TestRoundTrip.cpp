@@ -0,0 +1,905 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "BasicOctetArray.h"
+#include "BufferInputSource.h"
+#include "FileExportDestination.h"
+#include "FileInputSource.h"
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementCollector.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "RecordMapper.h"
+#include "StaticPlacementCollector.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(RoundTrip)
+
+struct Flow {
+  uint32_t domain;
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  std::string name;
+};
+
+static PlacementTemplate *make_template(uint32_t *sip, uint16_t *sp,
+                                        uint64_t *octets, uint8_t *sip6,
+                                        BasicOctetArray *name) {
+  InfoModel &model = InfoModel::instance();
+  PlacementTemplate *t = new PlacementTemplate();
+  t->register_placement(model.lookupIE("sourceIPv4Address"), sip, 0);
+  t->register_placement(model.lookupIE("sourceTransportPort"), sp, 0);
+  t->register_placement(model.lookupIE("octetDeltaCount"), octets, 0);
+  t->register_placement(model.lookupIE("sourceIPv6Address"), sip6, 0);
+  t->register_placement(model.lookupIE("interfaceName"), name, 0);
+  return t;
+}
+
+class FlowCollector : public PlacementCollector {
+public:
+  FlowCollector() : PlacementCollector(PlacementCollector::ipfix) {
+    tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+    register_placement_template(tmpl);
+  }
+
+  ~FlowCollector() { delete tmpl; }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    domain = observation_domain;
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *t) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *t) {
+    Flow f;
+    f.domain = domain;
+    f.sip = sip;
+    f.sp = sp;
+    f.octets = octets;
+    memcpy(f.sip6, sip6, sizeof(sip6));
+    f.name.assign(reinterpret_cast<const char *>(name.get_buf()),
+                  name.get_length());
+    flows.push_back(f);
+    LIBFC_RETURN_OK();
+  }
+
+  std::vector<Flow> flows;
+
+private:
+  PlacementTemplate *tmpl;
+  uint32_t domain;
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+};
+
+BOOST_AUTO_TEST_CASE(DomainsAndFlushes) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+
+  std::vector<Flow> exported;
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+
+    for (unsigned int i = 0; i < 300; i++) {
+      Flow f;
+      f.domain = 1 + (i / 50) % 2;
+      f.sip = 0x0a000000 + i;
+      f.sp = static_cast<uint16_t>(1024 + i);
+      f.octets = 0x0102030405060708ULL * i;
+      for (unsigned int j = 0; j < sizeof(f.sip6); j++)
+        f.sip6[j] = static_cast<uint8_t>(0x20 + j + i);
+      f.name = std::string(i % 7, 'a' + i % 26);
+
+      e.change_observation_domain(f.domain);
+      sip = f.sip;
+      sp = f.sp;
+      octets = f.octets;
+      memcpy(sip6, f.sip6, sizeof(sip6));
+      name.copy_content(reinterpret_cast<const uint8_t *>(f.name.data()),
+                        f.name.size());
+      e.place_values(tmpl);
+      exported.push_back(f);
+
+      if (i % 17 == 0)
+        e.flush();
+    }
+  }
+
+  FlowCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  std::shared_ptr<ErrorContext> err = c.collect(is);
+  BOOST_CHECK(err == 0);
+
+  BOOST_REQUIRE_EQUAL(c.flows.size(), exported.size());
+  for (unsigned int i = 0; i < exported.size(); i++) {
+    BOOST_CHECK_EQUAL(c.flows[i].domain, exported[i].domain);
+    BOOST_CHECK_EQUAL(c.flows[i].sip, exported[i].sip);
+    BOOST_CHECK_EQUAL(c.flows[i].sp, exported[i].sp);
+    BOOST_CHECK_EQUAL(c.flows[i].octets, exported[i].octets);
+    BOOST_CHECK(memcmp(c.flows[i].sip6, exported[i].sip6, 16) == 0);
+    BOOST_CHECK_EQUAL(c.flows[i].name, exported[i].name);
+  }
+
+  /* Sequence numbers must count records in each domain. */
+  const SequenceTracker &t = c.get_sequence_tracker();
+  for (uint32_t domain = 1; domain <= 2; domain++) {
+    const SequenceTracker::Stats *s = t.get_stats(is.get_name(), domain);
+    BOOST_REQUIRE(s != 0);
+    BOOST_CHECK_EQUAL(s->records, 150);
+    BOOST_CHECK_EQUAL(s->lost, 0);
+    BOOST_CHECK_EQUAL(s->unsynchronized, 0);
+  }
+
+  delete tmpl;
+}
+
+BOOST_AUTO_TEST_CASE(TemplatesAtMessageBoundaries) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+
+  /* Small messages, so that many new templates arrive just when the
+   * current message is full. */
+  MemoryExportDestination d(true, 1200);
+  std::vector<PlacementTemplate *> others;
+  unsigned int n_exported = 0;
+  {
+    PlacementExporter e(d, 1);
+
+    for (unsigned int i = 0; i < 300; i++) {
+      sip = 0x0a000000 + i;
+      sp = static_cast<uint16_t>(i);
+      octets = i;
+      memset(sip6, 0, sizeof(sip6));
+      std::string s(80 + i % 23, 'x');
+      name.copy_content(reinterpret_cast<const uint8_t *>(s.data()),
+                        s.size());
+
+      e.place_values(tmpl);
+      n_exported++;
+
+      if (i % 3 == 0) {
+        PlacementTemplate *other = new PlacementTemplate();
+        other->register_placement(
+            InfoModel::instance().lookupIE("sourceIPv4Address"), &sip, 0);
+        other->register_placement(
+            InfoModel::instance().lookupIE("interfaceName"), &name, 0);
+        others.push_back(other);
+        e.place_values(other);
+      }
+
+      if (i == 150)
+        e.refresh_templates();
+    }
+  }
+
+  FlowCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  std::shared_ptr<ErrorContext> err = c.collect(is);
+  BOOST_CHECK(err == 0);
+  BOOST_CHECK_EQUAL(c.flows.size(), n_exported);
+
+  SequenceTracker::Stats s = c.get_sequence_tracker().get_totals();
+  BOOST_CHECK_EQUAL(s.records, n_exported + others.size());
+  BOOST_CHECK_EQUAL(s.lost, 0);
+
+  for (auto i = others.begin(); i != others.end(); ++i)
+    delete *i;
+  delete tmpl;
+}
+
+BOOST_AUTO_TEST_CASE(ExportersSharingTemplates) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+  PlacementTemplate *other = new PlacementTemplate();
+  other->register_placement(InfoModel::instance().lookupIE("sourceIPv4Address"),
+                            &sip, 0);
+
+  memset(sip6, 0, sizeof(sip6));
+  sp = 80;
+
+  /* The first exporter gives tmpl its first id... */
+  MemoryExportDestination d1;
+  {
+    PlacementExporter e(d1, 1);
+    sip = 0x0a000001;
+    octets = 1;
+    e.place_values(tmpl);
+  }
+
+  /* ...which the second exporter must not hand out again, to
+   * other, in the same stream as tmpl. */
+  MemoryExportDestination d2;
+  {
+    PlacementExporter e(d2, 1);
+    for (unsigned int i = 0; i < 10; i++) {
+      sip = 0x0a000000 + i;
+      octets = i;
+      e.place_values(i % 2 == 0 ? other : tmpl);
+      if (i == 5)
+        e.refresh_templates();
+    }
+  }
+
+  for (int d = 1; d <= 2; d++) {
+    const std::vector<uint8_t> &buf =
+        d == 1 ? d1.get_buffer() : d2.get_buffer();
+    FlowCollector c;
+    BufferInputSource is(buf.data(), buf.size());
+    std::shared_ptr<ErrorContext> err = c.collect(is);
+    BOOST_CHECK(err == 0);
+
+    if (d == 1) {
+      BOOST_REQUIRE_EQUAL(c.flows.size(), 1);
+      BOOST_CHECK_EQUAL(c.flows[0].octets, 1);
+    } else {
+      BOOST_REQUIRE_EQUAL(c.flows.size(), 5);
+      for (unsigned int i = 0; i < 5; i++) {
+        BOOST_CHECK_EQUAL(c.flows[i].sip, 0x0a000000 + 2 * i + 1);
+        BOOST_CHECK_EQUAL(c.flows[i].octets, 2 * i + 1);
+      }
+    }
+  }
+
+  delete other;
+  delete tmpl;
+}
+
+BOOST_AUTO_TEST_CASE(ManyDataSets) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+  PlacementTemplate *other = new PlacementTemplate();
+  other->register_placement(InfoModel::instance().lookupIE("sourceIPv4Address"),
+                            &sip, 0);
+
+  /* Alternating templates open a new data set for every record, so
+   * a full-sized message has far more data sets than writev() takes
+   * at once. */
+  FILE *f = tmpfile();
+  BOOST_REQUIRE(f != 0);
+  int fd = dup(fileno(f));
+  fclose(f);
+
+  const unsigned int n_records = 10000;
+  {
+    FileExportDestination d(fd);
+    PlacementExporter e(d, 1);
+
+    memset(sip6, 0, sizeof(sip6));
+    for (unsigned int i = 0; i < n_records; i++) {
+      sip = 0x0a000000 + i;
+      sp = static_cast<uint16_t>(i);
+      octets = i;
+      e.place_values(i % 2 == 0 ? tmpl : other);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(lseek(fd, 0, SEEK_SET), 0);
+
+  FlowCollector c;
+  FileInputSource is(fd, "many-data-sets");
+  std::shared_ptr<ErrorContext> err = c.collect(is);
+  BOOST_CHECK(err == 0);
+  BOOST_CHECK_EQUAL(c.flows.size(), n_records / 2);
+
+  SequenceTracker::Stats s = c.get_sequence_tracker().get_totals();
+  BOOST_CHECK_EQUAL(s.records, n_records);
+  BOOST_CHECK_EQUAL(s.lost, 0);
+
+  delete other;
+  delete tmpl;
+}
+
+BOOST_AUTO_TEST_CASE(PullRecords) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+
+    for (unsigned int i = 0; i < 300; i++) {
+      e.change_observation_domain(1 + (i / 50) % 2);
+      sip = 0x0a000000 + i;
+      sp = static_cast<uint16_t>(i);
+      octets = i;
+      memset(sip6, 0, sizeof(sip6));
+      name.copy_content(reinterpret_cast<const uint8_t *>("eth0"), 4);
+      e.place_values(tmpl);
+
+      if (i % 17 == 0)
+        e.flush();
+    }
+  }
+
+  FlowCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  PlacementCollector::Records r = c.records(is);
+
+  /* Records are decoded only when asked for. */
+  BOOST_REQUIRE(r.next() != 0);
+  BOOST_CHECK_EQUAL(c.flows.size(), 1U);
+  BOOST_REQUIRE(r.next() != 0);
+  BOOST_CHECK_EQUAL(c.flows.size(), 2U);
+
+  unsigned int n = 2;
+  for (const PlacementTemplate *t : r) {
+    BOOST_CHECK(t != 0);
+    n++;
+    BOOST_CHECK_EQUAL(c.flows.size(), n);
+  }
+  BOOST_CHECK(r.get_error() == 0);
+  BOOST_CHECK(r.next() == 0);
+
+  BOOST_REQUIRE_EQUAL(c.flows.size(), 300U);
+  for (unsigned int i = 0; i < c.flows.size(); i++) {
+    BOOST_CHECK_EQUAL(c.flows[i].domain, 1 + (i / 50) % 2);
+    BOOST_CHECK_EQUAL(c.flows[i].sip, 0x0a000000 + i);
+    BOOST_CHECK_EQUAL(c.flows[i].octets, i);
+    BOOST_CHECK_EQUAL(c.flows[i].name, "eth0");
+  }
+
+  SequenceTracker::Stats s = c.get_sequence_tracker().get_totals();
+  BOOST_CHECK_EQUAL(s.records, 300);
+  BOOST_CHECK_EQUAL(s.lost, 0);
+
+  delete tmpl;
+}
+
+struct MappedFlow {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  uint8_t mac[6];
+  uint64_t start;
+  bool reliable;
+  double probability;
+};
+
+LIBFC_MAPPED_FIELD(MappedSip, MappedFlow, sip, "sourceIPv4Address",
+                   IEType::kIpv4Address);
+LIBFC_MAPPED_FIELD(MappedSp, MappedFlow, sp, "sourceTransportPort",
+                   IEType::kUnsigned16);
+LIBFC_MAPPED_FIELD(MappedOctets, MappedFlow, octets, "octetDeltaCount",
+                   IEType::kUnsigned64);
+LIBFC_MAPPED_FIELD(MappedSip6, MappedFlow, sip6, "sourceIPv6Address",
+                   IEType::kIpv6Address);
+LIBFC_MAPPED_FIELD(MappedMac, MappedFlow, mac, "sourceMacAddress",
+                   IEType::kMacAddress);
+LIBFC_MAPPED_FIELD(MappedStart, MappedFlow, start, "flowStartMilliseconds",
+                   IEType::kDateTimeMilliseconds);
+
+LIBFC_MAPPED_FIELD(MappedReliable, MappedFlow, reliable,
+                   "dataRecordsReliability", IEType::kBoolean);
+LIBFC_MAPPED_FIELD(MappedProbability, MappedFlow, probability,
+                   "samplingProbability", IEType::kFloat64);
+
+typedef RecordMapper<MappedFlow, MappedSip, MappedSp, MappedOctets,
+                     MappedSip6, MappedMac, MappedStart, MappedReliable,
+                     MappedProbability>
+    FlowMapper;
+
+/** Counts the records that the mapper decodes itself. */
+class CountingFlowMapper : public FlowMapper {
+public:
+  CountingFlowMapper(MappedFlow *flow) : FlowMapper(flow), n_decoded(0) {}
+
+  uint16_t decode(const uint8_t *buf, uint16_t length) const {
+    n_decoded++;
+    return FlowMapper::decode(buf, length);
+  }
+
+  mutable unsigned int n_decoded;
+};
+
+class MappedCollector : public PlacementCollector {
+public:
+  MappedCollector() : PlacementCollector(PlacementCollector::ipfix),
+                      mapper(&flow) {
+    register_placement_template(mapper.get_template());
+  }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *t) {
+    memset(&flow, 0, sizeof flow);
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *t) {
+    flows.push_back(flow);
+    LIBFC_RETURN_OK();
+  }
+
+  MappedFlow flow;
+  CountingFlowMapper mapper;
+  std::vector<MappedFlow> flows;
+};
+
+static MappedFlow make_mapped_flow(unsigned int i) {
+  MappedFlow f;
+  memset(&f, 0, sizeof f);
+  f.sip = 0x0a000000 + i;
+  f.sp = static_cast<uint16_t>(i);
+  f.octets = 0x0102030405060708ULL * i;
+  for (unsigned int j = 0; j < sizeof(f.sip6); j++)
+    f.sip6[j] = static_cast<uint8_t>(i + j);
+  for (unsigned int j = 0; j < sizeof(f.mac); j++)
+    f.mac[j] = static_cast<uint8_t>(0xa0 + i + j);
+  f.start = 1400000000000ULL + i;
+  f.reliable = i % 3 == 0;
+  f.probability = 1.0 / (i + 1);
+  return f;
+}
+
+static void check_mapped_flows(const std::vector<MappedFlow> &flows,
+                               unsigned int n) {
+  BOOST_REQUIRE_EQUAL(flows.size(), n);
+  for (unsigned int i = 0; i < n; i++) {
+    MappedFlow f = make_mapped_flow(i);
+    BOOST_CHECK_EQUAL(flows[i].sip, f.sip);
+    BOOST_CHECK_EQUAL(flows[i].sp, f.sp);
+    BOOST_CHECK_EQUAL(flows[i].octets, f.octets);
+    BOOST_CHECK(memcmp(flows[i].sip6, f.sip6, sizeof f.sip6) == 0);
+    BOOST_CHECK(memcmp(flows[i].mac, f.mac, sizeof f.mac) == 0);
+    BOOST_CHECK_EQUAL(flows[i].start, f.start);
+    BOOST_CHECK_EQUAL(flows[i].reliable, f.reliable);
+    BOOST_CHECK_EQUAL(flows[i].probability, f.probability);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MappedRecords) {
+  MappedFlow flow;
+  FlowMapper mapper(&flow);
+  BOOST_CHECK_EQUAL(static_cast<size_t>(FlowMapper::wire_size),
+                    4U + 2 + 8 + 16 + 6 + 8 + 1 + 8);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+    for (unsigned int i = 0; i < 500; i++) {
+      flow = make_mapped_flow(i);
+      e.place_values(mapper.get_template());
+    }
+  }
+
+  MappedCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  BOOST_CHECK(c.collect(is) == 0);
+  check_mapped_flows(c.flows, 500);
+  BOOST_CHECK_EQUAL(c.mapper.n_decoded, 500U);
+}
+
+BOOST_AUTO_TEST_CASE(MappedRecordsFromOtherLayouts) {
+  /* Same IEs in another order, with reduced-length fields and an
+   * additional one, so that the mapper can't decode the records. */
+  MappedFlow flow;
+  uint8_t tos = 0;
+  InfoModel &model = InfoModel::instance();
+  PlacementTemplate tmpl;
+  tmpl.register_placement(model.lookupIE("flowStartMilliseconds"),
+                          &flow.start, 0);
+  tmpl.register_placement(model.lookupIE("ipClassOfService"), &tos, 0);
+  tmpl.register_placement(model.lookupIE("sourceMacAddress"), flow.mac, 0);
+  tmpl.register_placement(model.lookupIE("sourceIPv6Address"), flow.sip6, 0);
+  tmpl.register_placement(model.lookupIE("octetDeltaCount"), &flow.octets, 4);
+  tmpl.register_placement(model.lookupIE("sourceTransportPort"), &flow.sp, 0);
+  tmpl.register_placement(model.lookupIE("sourceIPv4Address"), &flow.sip, 0);
+  tmpl.register_placement(model.lookupIE("samplingProbability"),
+                          &flow.probability, 4);
+  tmpl.register_placement(model.lookupIE("dataRecordsReliability"),
+                          &flow.reliable, 0);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+    for (unsigned int i = 0; i < 100; i++) {
+      flow = make_mapped_flow(i);
+      flow.octets &= 0xffffffff;
+      e.place_values(&tmpl);
+    }
+  }
+
+  MappedCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  BOOST_CHECK(c.collect(is) == 0);
+  BOOST_REQUIRE_EQUAL(c.flows.size(), 100U);
+  BOOST_CHECK_EQUAL(c.mapper.n_decoded, 0U);
+  for (unsigned int i = 0; i < 100; i++) {
+    BOOST_CHECK_EQUAL(c.flows[i].sip, 0x0a000000 + i);
+    BOOST_CHECK_EQUAL(c.flows[i].octets, (0x0102030405060708ULL * i)
+                                             & 0xffffffff);
+    BOOST_CHECK_EQUAL(c.flows[i].start, 1400000000000ULL + i);
+    BOOST_CHECK_EQUAL(c.flows[i].reliable, i % 3 == 0);
+    BOOST_CHECK_EQUAL(c.flows[i].probability,
+                      static_cast<float>(1.0 / (i + 1)));
+  }
+}
+
+struct BadlyMapped {
+  uint8_t octets;
+};
+
+LIBFC_MAPPED_FIELD(BadOctets, BadlyMapped, octets, "octetDeltaCount",
+                   IEType::kUnsigned8);
+
+typedef RecordMapper<BadlyMapped, BadOctets> BadMapper;
+
+BOOST_AUTO_TEST_CASE(MappedTypeMismatch) {
+  BadlyMapped r;
+  BOOST_CHECK_THROW(BadMapper m(&r), IESpecError);
+}
+
+class StaticFlowCollector
+    : public StaticPlacementCollector<StaticFlowCollector> {
+public:
+  StaticFlowCollector(size_t limit)
+      : StaticPlacementCollector<StaticFlowCollector>(
+            PlacementCollector::ipfix),
+        started(0), limit(limit) {
+    tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+    register_placement_template(tmpl);
+  }
+
+  ~StaticFlowCollector() { delete tmpl; }
+
+  bool begin_record(const PlacementTemplate *t) {
+    started++;
+    return true;
+  }
+
+  bool end_record(const PlacementTemplate *t) {
+    sips.push_back(sip);
+    return sips.size() < limit;
+  }
+
+  std::vector<uint32_t> sips;
+  size_t started;
+
+private:
+  size_t limit;
+  PlacementTemplate *tmpl;
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+};
+
+BOOST_AUTO_TEST_CASE(StaticCollector) {
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *tmpl = make_template(&sip, &sp, &octets, sip6, &name);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+
+    for (unsigned int i = 0; i < 200; i++) {
+      sip = 0x0a000000 + i;
+      sp = static_cast<uint16_t>(i);
+      octets = i;
+      memset(sip6, 0, sizeof(sip6));
+      name.copy_content(reinterpret_cast<const uint8_t *>("eth0"), 4);
+      e.place_values(tmpl);
+
+      if (i % 30 == 0)
+        e.flush();
+    }
+  }
+
+  {
+    StaticFlowCollector c(1000);
+    BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+    BOOST_CHECK(c.collect(is) == 0);
+    BOOST_CHECK_EQUAL(c.started, 200U);
+    BOOST_REQUIRE_EQUAL(c.sips.size(), 200U);
+    for (unsigned int i = 0; i < c.sips.size(); i++)
+      BOOST_CHECK_EQUAL(c.sips[i], 0x0a000000 + i);
+    BOOST_CHECK_EQUAL(c.get_sequence_tracker().get_totals().records, 200);
+  }
+
+  /* Returning false from end_record() stops collection. */
+  {
+    StaticFlowCollector c(45);
+    BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+    std::shared_ptr<ErrorContext> e = c.collect(is);
+    BOOST_REQUIRE(e != 0);
+    BOOST_CHECK_EQUAL(e->get_error(), Error::aborted_by_user);
+    BOOST_CHECK_EQUAL(c.sips.size(), 45U);
+  }
+
+  /* The pull API goes through the same callbacks. */
+  {
+    StaticFlowCollector c(1000);
+    BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+    PlacementCollector::Records r = c.records(is);
+    unsigned int n = 0;
+    for (const PlacementTemplate *t : r) {
+      BOOST_CHECK(t != 0);
+      n++;
+    }
+    BOOST_CHECK(r.get_error() == 0);
+    BOOST_CHECK_EQUAL(n, 200U);
+    BOOST_CHECK_EQUAL(c.sips.size(), 200U);
+  }
+
+  delete tmpl;
+}
+
+/* Decodes the records of any template that contains
+ * sourceIPv4Address, without registering placement templates. */
+class AnyTemplateCollector : public PlacementCollector {
+public:
+  AnyTemplateCollector(size_t skip_size)
+      : PlacementCollector(PlacementCollector::ipfix), skip_size(skip_size),
+        n_asked(0) {}
+
+  ~AnyTemplateCollector() {
+    for (auto i = templates.begin(); i != templates.end(); ++i)
+      delete *i;
+  }
+
+  const PlacementTemplate *unmatched_template(uint32_t observation_domain,
+                                              uint16_t id,
+                                              const IETemplate *wire_template) {
+    n_asked++;
+    if (wire_template->size() == skip_size)
+      return 0;
+
+    PlacementTemplate *t = new PlacementTemplate();
+    for (auto ie = wire_template->begin(); ie != wire_template->end(); ++ie) {
+      if ((*ie)->name() == "sourceIPv4Address")
+        t->register_placement(*ie, &sip, 0);
+      else if ((*ie)->name() == "octetDeltaCount")
+        t->register_placement(*ie, &octets, 0);
+    }
+    templates.push_back(t);
+    sizes[t] = wire_template->size();
+    return t;
+  }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *t) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *t) {
+    records.push_back(std::make_pair(sizes[t], sip + octets));
+    LIBFC_RETURN_OK();
+  }
+
+  size_t skip_size;
+  unsigned int n_asked;
+  /** Wire template size and sip + octets of every record. */
+  std::vector<std::pair<size_t, uint64_t>> records;
+
+private:
+  std::vector<PlacementTemplate *> templates;
+  std::map<const PlacementTemplate *, size_t> sizes;
+  uint32_t sip;
+  uint64_t octets;
+};
+
+BOOST_AUTO_TEST_CASE(UnmatchedTemplates) {
+  InfoModel &model = InfoModel::instance();
+  uint32_t sip;
+  uint16_t sp;
+  uint64_t octets;
+  uint8_t sip6[16];
+  BasicOctetArray name;
+  PlacementTemplate *wide = make_template(&sip, &sp, &octets, sip6, &name);
+  PlacementTemplate *narrow = new PlacementTemplate();
+  narrow->register_placement(model.lookupIE("sourceIPv4Address"), &sip, 0);
+  narrow->register_placement(model.lookupIE("octetDeltaCount"), &octets, 0);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+
+    for (unsigned int i = 0; i < 100; i++) {
+      sip = 0x0a000000 + i;
+      sp = 80;
+      octets = 1000 * i;
+      memset(sip6, 0, sizeof(sip6));
+      name.copy_content(reinterpret_cast<const uint8_t *>("eth0"), 4);
+      e.place_values(i % 3 == 0 ? narrow : wide);
+      if (i % 10 == 0)
+        e.flush();
+    }
+  }
+
+  {
+    AnyTemplateCollector c(0);
+    BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+    BOOST_CHECK(c.collect(is) == 0);
+
+    /* Once per template, not once per data set. */
+    BOOST_CHECK_EQUAL(c.n_asked, 2U);
+    BOOST_REQUIRE_EQUAL(c.records.size(), 100U);
+    for (unsigned int i = 0; i < c.records.size(); i++) {
+      BOOST_CHECK_EQUAL(c.records[i].first, i % 3 == 0 ? 2U : 5U);
+      BOOST_CHECK_EQUAL(c.records[i].second, 0x0a000000 + 1001 * i);
+    }
+  }
+
+  /* Declined templates are skipped. */
+  {
+    AnyTemplateCollector c(2);
+    BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+    BOOST_CHECK(c.collect(is) == 0);
+    BOOST_CHECK_EQUAL(c.n_asked, 2U);
+    BOOST_CHECK_EQUAL(c.records.size(), 66U);
+    BOOST_CHECK_EQUAL(c.get_sequence_tracker().get_totals().records, 100);
+  }
+
+  delete narrow;
+  delete wide;
+}
+
+class ReducedLengthCollector : public PlacementCollector {
+public:
+  ReducedLengthCollector() : PlacementCollector(PlacementCollector::ipfix) {
+    InfoModel &model = InfoModel::instance();
+    tmpl = new PlacementTemplate();
+    tmpl->register_placement(model.lookupIE("octetDeltaCount"), &octets, 0);
+    tmpl->register_placement(model.lookupIE("packetDeltaCount"), &packets,
+                             0);
+    tmpl->register_placement(model.lookupIE("samplingProbability"),
+                             &probability, 0);
+    register_placement_template(tmpl);
+  }
+
+  ~ReducedLengthCollector() { delete tmpl; }
+
+  std::shared_ptr<ErrorContext>
+  start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                uint32_t sequence_number, uint32_t observation_domain,
+                uint64_t base_time) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> start_placement(const PlacementTemplate *t) {
+    LIBFC_RETURN_OK();
+  }
+
+  std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *t) {
+    values.push_back(std::make_pair(octets, packets));
+    probabilities.push_back(probability);
+    LIBFC_RETURN_OK();
+  }
+
+  std::vector<std::pair<uint64_t, uint64_t>> values;
+  std::vector<double> probabilities;
+
+private:
+  PlacementTemplate *tmpl;
+  uint64_t octets;
+  uint64_t packets;
+  double probability;
+};
+
+BOOST_AUTO_TEST_CASE(ReducedLength) {
+  InfoModel &model = InfoModel::instance();
+  uint64_t octets;
+  uint64_t packets;
+  double probability;
+
+  PlacementTemplate *tmpl = new PlacementTemplate();
+  tmpl->register_placement(model.lookupIE("octetDeltaCount"), &octets, 4);
+  tmpl->register_placement(model.lookupIE("packetDeltaCount"), &packets, 2);
+  tmpl->register_placement(model.lookupIE("samplingProbability"),
+                           &probability, 4);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, 1);
+    for (unsigned int i = 0; i < 10; i++) {
+      octets = 0x01020304 * i;
+      packets = 0x0102 * i;
+      probability = 1.0 / (1 << i);
+      e.place_values(tmpl);
+    }
+  }
+
+  /* Message header, template set with one template of three fields,
+   * data set with ten records of ten bytes each. */
+  BOOST_CHECK_EQUAL(d.get_buffer().size(), 16 + (4 + 4 + 3 * 4) + 4 + 100);
+
+  ReducedLengthCollector c;
+  BufferInputSource is(d.get_buffer().data(), d.get_buffer().size());
+  BOOST_CHECK(c.collect(is) == 0);
+
+  BOOST_REQUIRE_EQUAL(c.values.size(), 10);
+  for (unsigned int i = 0; i < 10; i++) {
+    BOOST_CHECK_EQUAL(c.values[i].first, 0x01020304 * i);
+    BOOST_CHECK_EQUAL(c.values[i].second, 0x0102 * i);
+    BOOST_CHECK_EQUAL(c.probabilities[i], 1.0 / (1 << i));
+  }
+
+  delete tmpl;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,211 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "BufferInputSource.h"
+#include "Constants.h"
+#include "PlacementCollector.h"
+#include "SequenceTracker.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(SequenceTracking)
+
+static void feed(SequenceTracker &t, uint16_t version, uint32_t seq,
+                 uint32_t n_records) {
+  t.start_message("exporter", version, 1, seq);
+  t.add_records(n_records);
+  t.end_message();
+}
+
+BOOST_AUTO_TEST_CASE(IPFIXInOrder) {
+  SequenceTracker t;
+
+  feed(t, kIpfixVersion, 100, 5);
+  feed(t, kIpfixVersion, 105, 0);
+  feed(t, kIpfixVersion, 105, 3);
+
+  const SequenceTracker::Stats *s = t.get_stats("exporter", 1);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->messages, 3);
+  BOOST_CHECK_EQUAL(s->records, 8);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+  BOOST_CHECK_EQUAL(s->reordered, 0);
+  BOOST_CHECK_EQUAL(s->duplicates, 0);
+  BOOST_CHECK_EQUAL(s->next_sequence_number, 108);
+  BOOST_CHECK(t.get_stats("exporter", 2) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(IPFIXGapReorderDuplicate) {
+  SequenceTracker t;
+
+  feed(t, kIpfixVersion, 0, 10);
+  feed(t, kIpfixVersion, 20, 10); /* 10..19 missing */
+  BOOST_CHECK_EQUAL(t.get_stats("exporter", 1)->lost, 10);
+
+  feed(t, kIpfixVersion, 10, 10); /* ...and here they are */
+  feed(t, kIpfixVersion, 20, 10); /* duplicate */
+  feed(t, kIpfixVersion, 30, 10);
+
+  const SequenceTracker::Stats *s = t.get_stats("exporter", 1);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+  BOOST_CHECK_EQUAL(s->reordered, 1);
+  BOOST_CHECK_EQUAL(s->duplicates, 1);
+  BOOST_CHECK_EQUAL(s->next_sequence_number, 40);
+}
+
+BOOST_AUTO_TEST_CASE(IPFIXWraparoundAndReset) {
+  SequenceTracker t;
+
+  feed(t, kIpfixVersion, 0xfffffffe, 4);
+  feed(t, kIpfixVersion, 2, 1);
+  BOOST_CHECK_EQUAL(t.get_stats("exporter", 1)->lost, 0);
+
+  feed(t, kIpfixVersion, 0x80000000, 1);
+  BOOST_CHECK_EQUAL(t.get_stats("exporter", 1)->resets, 1);
+  BOOST_CHECK_EQUAL(t.get_stats("exporter", 1)->lost, 0);
+}
+
+BOOST_AUTO_TEST_CASE(IPFIXUncountable) {
+  SequenceTracker t;
+
+  t.start_message("exporter", kIpfixVersion, 1, 0);
+  t.add_records(2);
+  t.records_uncountable();
+  t.end_message();
+
+  /* Would be a gap if the message above had been countable. */
+  feed(t, kIpfixVersion, 7, 1);
+  feed(t, kIpfixVersion, 9, 1);
+
+  const SequenceTracker::Stats *s = t.get_stats("exporter", 1);
+  BOOST_CHECK_EQUAL(s->unsynchronized, 1);
+  BOOST_CHECK_EQUAL(s->lost, 1);
+}
+
+BOOST_AUTO_TEST_CASE(V9Packets) {
+  SequenceTracker t;
+
+  feed(t, kV9Version, 1, 30);
+  feed(t, kV9Version, 2, 30);
+  feed(t, kV9Version, 5, 30); /* Packets 3 and 4 missing */
+  feed(t, kV9Version, 4, 30);
+
+  const SequenceTracker::Stats *s = t.get_stats("exporter", 1);
+  BOOST_CHECK_EQUAL(s->lost, 1);
+  BOOST_CHECK_EQUAL(s->reordered, 1);
+  BOOST_CHECK_EQUAL(s->next_sequence_number, 6);
+  BOOST_CHECK_EQUAL(t.get_totals().records, 120);
+}
+
+/* Appends an IPFIX message with n_records four-byte records using
+ * template 256, optionally preceded by the template. */
+static void append_message(std::vector<uint8_t> &buf, uint32_t seq,
+                           uint32_t domain, uint16_t n_records,
+                           bool with_template) {
+  const uint16_t template_set_len = with_template ? 12 : 0;
+  const uint16_t data_set_len = 4 + 4 * n_records;
+  const uint16_t len = 16 + template_set_len + data_set_len;
+
+  const uint8_t header[] = {
+    0x00, 0x0a, static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len),
+    0x50, 0x6a, 0xce, 0xbc,
+    static_cast<uint8_t>(seq >> 24), static_cast<uint8_t>(seq >> 16),
+    static_cast<uint8_t>(seq >> 8), static_cast<uint8_t>(seq),
+    static_cast<uint8_t>(domain >> 24), static_cast<uint8_t>(domain >> 16),
+    static_cast<uint8_t>(domain >> 8), static_cast<uint8_t>(domain) };
+  buf.insert(buf.end(), header, header + sizeof(header));
+
+  if (with_template) {
+    /* Template 256: sourceIPv4Address */
+    const uint8_t tmpl[] = { 0x00, 0x02, 0x00, 0x0c, 0x01, 0x00, 0x00, 0x01,
+                             0x00, 0x08, 0x00, 0x04 };
+    buf.insert(buf.end(), tmpl, tmpl + sizeof(tmpl));
+  }
+
+  const uint8_t set_header[] = { 0x01, 0x00,
+                                 static_cast<uint8_t>(data_set_len >> 8),
+                                 static_cast<uint8_t>(data_set_len) };
+  buf.insert(buf.end(), set_header, set_header + sizeof(set_header));
+  for (uint16_t i = 0; i < n_records; i++) {
+    const uint8_t record[] = { 10, 0, 0, static_cast<uint8_t>(i) };
+    buf.insert(buf.end(), record, record + sizeof(record));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CollectorPerDomain) {
+  class MyCollector : public PlacementCollector {
+  public:
+    MyCollector() : PlacementCollector(PlacementCollector::ipfix) {}
+
+    std::shared_ptr<ErrorContext>
+    start_message(uint16_t version, uint16_t length, uint32_t export_time,
+                  uint32_t sequence_number, uint32_t observation_domain,
+                  uint64_t base_time) {
+      LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<ErrorContext>
+    start_placement(const PlacementTemplate *tmpl) {
+      LIBFC_RETURN_OK();
+    }
+
+    std::shared_ptr<ErrorContext> end_placement(const PlacementTemplate *tmpl) {
+      LIBFC_RETURN_OK();
+    }
+  };
+
+  std::vector<uint8_t> buf;
+  append_message(buf, 0, 1, 3, true);
+  append_message(buf, 0, 2, 2, true);
+  append_message(buf, 3, 1, 4, false);
+  append_message(buf, 9, 1, 1, false); /* Records 7 and 8 lost */
+  append_message(buf, 2, 2, 1, false);
+
+  MyCollector m;
+  BufferInputSource is(buf.data(), buf.size());
+  std::shared_ptr<ErrorContext> e = m.collect(is);
+  BOOST_CHECK(e == 0 || e->get_error() == Error::no_error);
+
+  const SequenceTracker &t = m.get_sequence_tracker();
+  const SequenceTracker::Stats *s1 = t.get_stats(is.get_name(), 1);
+  const SequenceTracker::Stats *s2 = t.get_stats(is.get_name(), 2);
+  BOOST_REQUIRE(s1 != 0);
+  BOOST_REQUIRE(s2 != 0);
+  BOOST_CHECK_EQUAL(s1->records, 8);
+  BOOST_CHECK_EQUAL(s1->lost, 2);
+  BOOST_CHECK_EQUAL(s2->records, 3);
+  BOOST_CHECK_EQUAL(s2->lost, 0);
+  BOOST_CHECK_EQUAL(t.get_totals().messages, 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
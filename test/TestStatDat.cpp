@@ -0,0 +1,354 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "InfoModel.h"
+#include "MemoryExportDestination.h"
+#include "PlacementExporter.h"
+#include "PlacementTemplate.h"
+#include "StatDatInputSource.h"
+#include "StaticPlacementCollector.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(StatDat)
+
+/* Collects the values of one IE; all exporters use template ID 256
+ * for templates with different IEs. */
+class ValueCollector : public StaticPlacementCollector<ValueCollector> {
+public:
+  ValueCollector(const char *ie_name, PlacementCollector::Protocol protocol =
+                                          PlacementCollector::ipfix)
+      : StaticPlacementCollector<ValueCollector>(protocol), value(0) {
+    tmpl.register_placement(InfoModel::instance().lookupIE(ie_name), &value,
+                            0);
+    register_placement_template(&tmpl);
+  }
+
+  bool end_record(const PlacementTemplate *t) {
+    values.push_back(value);
+    return true;
+  }
+
+  std::vector<uint64_t> values;
+
+private:
+  PlacementTemplate tmpl;
+  uint64_t value;
+};
+
+/* Collects octetDeltaCount and packetDeltaCount, from whichever
+ * template has them. */
+class CountsCollector : public StaticPlacementCollector<CountsCollector> {
+public:
+  CountsCollector()
+      : StaticPlacementCollector<CountsCollector>(PlacementCollector::ipfix),
+        octets(0), packets(0) {
+    InfoModel &model = InfoModel::instance();
+    octets_tmpl.register_placement(model.lookupIE("octetDeltaCount"), &octets,
+                                   0);
+    packets_tmpl.register_placement(model.lookupIE("packetDeltaCount"),
+                                    &packets, 0);
+    register_placement_template(&octets_tmpl);
+    register_placement_template(&packets_tmpl);
+  }
+
+  bool end_record(const PlacementTemplate *t) {
+    if (t == &octets_tmpl)
+      octet_values.push_back(octets);
+    else
+      packet_values.push_back(packets);
+    return true;
+  }
+
+  std::vector<uint64_t> octet_values;
+  std::vector<uint64_t> packet_values;
+
+private:
+  PlacementTemplate octets_tmpl;
+  PlacementTemplate packets_tmpl;
+  uint64_t octets;
+  uint64_t packets;
+};
+
+/* Exports n records with the values 0, factor, 2 * factor..., of an
+ * unsigned64 IE, a few records per message. */
+static std::vector<std::vector<uint8_t> >
+export_messages(const char *ie_name, uint64_t factor, unsigned int n,
+                uint32_t observation_domain = 1) {
+  uint64_t value;
+  PlacementTemplate tmpl;
+  tmpl.register_placement(InfoModel::instance().lookupIE(ie_name), &value, 0);
+
+  MemoryExportDestination d;
+  {
+    PlacementExporter e(d, observation_domain);
+    for (unsigned int i = 0; i < n; i++) {
+      value = factor * i;
+      e.place_values(&tmpl);
+      if (i % 7 == 6)
+        e.flush();
+    }
+  }
+
+  /* Split the buffer into messages by their length fields. */
+  std::vector<std::vector<uint8_t> > messages;
+  const std::vector<uint8_t> &b = d.get_buffer();
+  for (size_t i = 0; i < b.size();) {
+    size_t length = (b[i + 2] << 8) | b[i + 3];
+    messages.push_back(std::vector<uint8_t>(&b[i], &b[i] + length));
+    i += length;
+  }
+  return messages;
+}
+
+static void put16(std::vector<uint8_t> &m, uint16_t v) {
+  m.push_back(v >> 8);
+  m.push_back(v & 0xff);
+}
+
+static void put32(std::vector<uint8_t> &m, uint32_t v) {
+  put16(m, v >> 16);
+  put16(m, v & 0xffff);
+}
+
+/* Makes a NetFlow v9 datagram with n_records IN_BYTES records, the
+ * first of them with the value first, preceded by their template if
+ * with_template is set. */
+static std::vector<uint8_t> v9_message(uint32_t sequence, bool with_template,
+                                       uint64_t first,
+                                       unsigned int n_records) {
+  std::vector<uint8_t> m;
+  put16(m, 9);
+  put16(m, n_records + (with_template ? 1 : 0));
+  put32(m, 1000);       // sysUpTime
+  put32(m, 1398697200); // UNIX seconds
+  put32(m, sequence);
+  put32(m, 42);         // source ID
+  if (with_template) {
+    put16(m, 0);
+    put16(m, 12);
+    put16(m, 256);
+    put16(m, 1);
+    put16(m, 1); // IN_BYTES
+    put16(m, 8);
+  }
+  put16(m, 256);
+  put16(m, 4 + 8 * n_records);
+  for (unsigned int i = 0; i < n_records; i++) {
+    put32(m, 0);
+    put32(m, static_cast<uint32_t>(first + i));
+  }
+  return m;
+}
+
+/* Writes the datagrams of a capture to a dat file and a stat file,
+ * each datagram given with its exporter. */
+static void
+write_capture(const std::string &dat_name,
+              const std::vector<std::pair<std::string, std::vector<uint8_t> > >
+                  &datagrams) {
+  FILE *dat = fopen(dat_name.c_str(), "wb");
+  FILE *stat = fopen(StatDatInputSource::stat_name_for(dat_name).c_str(), "w");
+  BOOST_REQUIRE(dat != 0 && stat != 0);
+  fprintf(stat, " Format:\n P <p.-number> <relative time> <p.-lenght> "
+                "<src IP:port>\n\n");
+  for (size_t i = 0; i < datagrams.size(); i++) {
+    fwrite(datagrams[i].second.data(), 1, datagrams[i].second.size(), dat);
+    fprintf(stat, "P  %zu      0.000000   %zu  %s\n", i,
+            datagrams[i].second.size(), datagrams[i].first.c_str());
+  }
+  fclose(dat);
+  fclose(stat);
+}
+
+static std::string make_dat_name() {
+  char dat_name[] = "/tmp/TestStatDatXXXXXX";
+  int fd = mkstemp(dat_name);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+  return dat_name;
+}
+
+BOOST_AUTO_TEST_CASE(Demultiplex) {
+  InfoModel::instance().default5103();
+
+  std::vector<std::vector<uint8_t> > a =
+      export_messages("octetDeltaCount", 3, 100);
+  std::vector<std::vector<uint8_t> > b =
+      export_messages("packetDeltaCount", 5, 100);
+
+  std::string dat_name = make_dat_name();
+  std::string stat_name = StatDatInputSource::stat_name_for(dat_name);
+  BOOST_CHECK_EQUAL(stat_name, dat_name + ".stat");
+
+  /* Interleave the messages of both exporters. */
+  std::vector<std::pair<std::string, std::vector<uint8_t> > > datagrams;
+  for (size_t i = 0; i < std::max(a.size(), b.size()); i++) {
+    if (i < a.size())
+      datagrams.push_back(std::make_pair("10.0.0.1:4739", a[i]));
+    if (i < b.size())
+      datagrams.push_back(std::make_pair("10.0.0.2:4740", b[i]));
+  }
+  write_capture(dat_name, datagrams);
+
+  ValueCollector ca("octetDeltaCount");
+  ValueCollector cb("packetDeltaCount");
+  std::map<std::string, PlacementCollector *> collectors;
+  collectors["10.0.0.1:4739"] = &ca;
+  collectors["10.0.0.2:4740"] = &cb;
+
+  StatDatInputSource is(dat_name);
+  BOOST_REQUIRE(is.get_error() == 0);
+  std::shared_ptr<ErrorContext> e =
+      is.demultiplex([&collectors](const char *exporter) {
+        auto c = collectors.find(exporter);
+        return c == collectors.end() ? 0 : c->second;
+      });
+  BOOST_CHECK(e == 0);
+
+  BOOST_REQUIRE_EQUAL(ca.values.size(), 100);
+  BOOST_REQUIRE_EQUAL(cb.values.size(), 100);
+  for (unsigned int i = 0; i < 100; i++) {
+    BOOST_CHECK_EQUAL(ca.values[i], 3 * i);
+    BOOST_CHECK_EQUAL(cb.values[i], 5 * i);
+  }
+
+  const SequenceTracker::Stats *s =
+      ca.get_sequence_tracker().get_stats("10.0.0.1:4739", 1);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->records, 100);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+
+  /* A dat file that ends early is an error. */
+  BOOST_REQUIRE(truncate(dat_name.c_str(), a[0].size() + 10) == 0);
+  ValueCollector cc("octetDeltaCount");
+  StatDatInputSource truncated(dat_name);
+  e = truncated.demultiplex([&cc](const char *exporter) { return &cc; });
+  BOOST_REQUIRE(e != 0);
+  BOOST_CHECK_EQUAL(e->get_error(), Error::short_body);
+  BOOST_CHECK_EQUAL(cc.values.size(), 7);
+
+  unlink(dat_name.c_str());
+  unlink(stat_name.c_str());
+
+  StatDatInputSource missing("/nonexistent/file.dat");
+  BOOST_CHECK(missing.get_error() != 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReadAcrossDatagrams) {
+  /* Read as a whole, with one collector; the exporters use different
+   * observation domains, so that their templates don't clash. */
+  std::vector<std::vector<uint8_t> > a =
+      export_messages("octetDeltaCount", 3, 100, 1);
+  std::vector<std::vector<uint8_t> > b =
+      export_messages("packetDeltaCount", 5, 60, 2);
+
+  std::vector<std::pair<std::string, std::vector<uint8_t> > > datagrams;
+  for (size_t i = 0; i < std::max(a.size(), b.size()); i++) {
+    if (i < a.size())
+      datagrams.push_back(std::make_pair("10.0.0.1:4739", a[i]));
+    if (i < b.size())
+      datagrams.push_back(std::make_pair("10.0.0.2:4740", b[i]));
+  }
+  std::string dat_name = make_dat_name();
+  write_capture(dat_name, datagrams);
+
+  CountsCollector c;
+  StatDatInputSource is(dat_name);
+  BOOST_REQUIRE(is.get_error() == 0);
+  std::shared_ptr<ErrorContext> e = c.collect(is);
+  BOOST_CHECK(e == 0);
+  BOOST_CHECK(is.get_error() == 0);
+
+  BOOST_REQUIRE_EQUAL(c.octet_values.size(), 100);
+  BOOST_REQUIRE_EQUAL(c.packet_values.size(), 60);
+  for (unsigned int i = 0; i < 100; i++)
+    BOOST_CHECK_EQUAL(c.octet_values[i], 3 * i);
+  for (unsigned int i = 0; i < 60; i++)
+    BOOST_CHECK_EQUAL(c.packet_values[i], 5 * i);
+
+  /* Sequence numbers are tracked per exporter, as named by the
+   * datagram being read. */
+  const SequenceTracker &t = c.get_sequence_tracker();
+  const SequenceTracker::Stats *s = t.get_stats("10.0.0.1:4739", 1);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->records, 100);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+  s = t.get_stats("10.0.0.2:4740", 2);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->records, 60);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+
+  unlink(dat_name.c_str());
+  unlink(StatDatInputSource::stat_name_for(dat_name).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(NetFlowV9) {
+  /* A v9 message has no length of its own, so it must end where its
+   * datagram ends. */
+  std::vector<std::pair<std::string, std::vector<uint8_t> > > datagrams;
+  unsigned int n_records = 0;
+  for (uint32_t i = 0; i < 20; i++) {
+    unsigned int n = 1 + i % 5;
+    datagrams.push_back(std::make_pair(
+        "10.0.0.3:2055", v9_message(i, i % 8 == 0, n_records, n)));
+    n_records += n;
+  }
+  std::string dat_name = make_dat_name();
+  write_capture(dat_name, datagrams);
+
+  ValueCollector c("octetDeltaCount", PlacementCollector::netflowv9);
+  StatDatInputSource is(dat_name);
+  BOOST_REQUIRE(is.get_error() == 0);
+  std::shared_ptr<ErrorContext> e = c.collect(is);
+  BOOST_CHECK(e == 0);
+
+  BOOST_REQUIRE_EQUAL(c.values.size(), n_records);
+  for (unsigned int i = 0; i < n_records; i++)
+    BOOST_CHECK_EQUAL(c.values[i], i);
+
+  const SequenceTracker::Stats *s =
+      c.get_sequence_tracker().get_stats("10.0.0.3:2055", 42);
+  BOOST_REQUIRE(s != 0);
+  BOOST_CHECK_EQUAL(s->lost, 0);
+
+  unlink(dat_name.c_str());
+  unlink(StatDatInputSource::stat_name_for(dat_name).c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -27,8 +27,11 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
  */
 
+#include <cstring>
 #include <iostream>
 
+#include <unistd.h>
+
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
@@ -67,4 +70,59 @@ BOOST_AUTO_TEST_CASE(StatParser) {
   BOOST_CHECK(sp.eof());
 }
 
+BOOST_AUTO_TEST_CASE(StatParserBatch) {
+  libfc::StatParser single("../example.stat");
+  libfc::StatParser batched("../example.stat");
+  libfc::StatParser::PLine lines[16];
+  size_t n_lines = 0;
+  size_t n;
+
+  do {
+    n = batched.next_ps(lines, 16);
+    for (size_t i = 0; i < n; i++) {
+      uint8_t ip[4];
+      uint16_t length;
+      uint16_t port;
+
+      BOOST_REQUIRE(single.next_p(&length, &ip[0], &port));
+      BOOST_CHECK_EQUAL(lines[i].length, length);
+      BOOST_CHECK(memcmp(lines[i].source_address, ip, sizeof ip) == 0);
+      BOOST_CHECK_EQUAL(lines[i].port, port);
+    }
+    n_lines += n;
+  } while (n == 16);
+
+  BOOST_CHECK_EQUAL(n_lines, 91);
+  BOOST_CHECK(batched.eof());
+  BOOST_CHECK_EQUAL(batched.next_ps(lines, 16), 0);
+}
+
+BOOST_AUTO_TEST_CASE(StatParserErrors) {
+  char name[] = "/tmp/TestStatParserXXXXXX";
+  int fd = mkstemp(name);
+  BOOST_REQUIRE(fd >= 0);
+
+  const char text[] =
+    " Format:\n"
+    "P  1      0.000000   1349  192.168.13.65:63428\n"
+    "P  2      0.000000   1349  192.168.13.256:63428\n"
+    "P  3      0.000000   1349  192.168.13.65:63428\n";
+  BOOST_REQUIRE(write(fd, text, sizeof text - 1) == sizeof text - 1);
+  close(fd);
+
+  libfc::StatParser sp(name);
+  libfc::StatParser::PLine lines[4];
+  BOOST_CHECK_EQUAL(sp.next_ps(lines, 4), 1);
+  BOOST_CHECK_EQUAL(lines[0].length, 1349);
+  BOOST_CHECK_EQUAL(lines[0].source_address[3], 65);
+  BOOST_CHECK_EQUAL(lines[0].port, 63428);
+  BOOST_CHECK_EQUAL(sp.get_state(), libfc::StatParser::parse_error);
+  BOOST_CHECK(sp.get_message().find(":3: fourth IP address octet would "
+                                    "overflow") != std::string::npos);
+  unlink(name);
+
+  libfc::StatParser missing("/nonexistent/file.stat");
+  BOOST_CHECK_EQUAL(missing.get_state(), libfc::StatParser::io_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+/* Copyright (c) 2011-2014 ETH Zürich. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *    * Neither the name of ETH Zürich, nor the names of its contributors 
+ *      may be used to endorse or promote products derived from this software 
+ *      without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL ETH 
+ * ZURICH BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+ * PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER 
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE
+ */
+
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/test_tools.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include <unistd.h>
+
+#include "OutputBuffer.h"
+#include "text_format.h"
+
+using namespace libfc;
+
+BOOST_AUTO_TEST_SUITE(TextFormat)
+
+static std::string unsigned_string(uint64_t v) {
+  char buf[kMaxIntegerChars];
+  return std::string(buf, format_unsigned(buf, v));
+}
+
+static std::string signed_string(int64_t v) {
+  char buf[kMaxIntegerChars];
+  return std::string(buf, format_signed(buf, v));
+}
+
+static std::string ipv4_string(uint32_t v) {
+  char buf[kMaxIpv4Chars];
+  return std::string(buf, format_ipv4(buf, v));
+}
+
+static std::string ipv6_string(const char *hex) {
+  uint8_t addr[16];
+  for (unsigned int i = 0; i < 16; i++) {
+    unsigned int octet;
+    sscanf(hex + 2 * i, "%2x", &octet);
+    addr[i] = static_cast<uint8_t>(octet);
+  }
+  char buf[kMaxIpv6Chars];
+  return std::string(buf, format_ipv6(buf, addr));
+}
+
+static std::string datetime_string(uint64_t nanos) {
+  char buf[kMaxDatetimeChars];
+  return std::string(buf, format_iso_datetime(buf, nanos));
+}
+
+BOOST_AUTO_TEST_CASE(Integers) {
+  BOOST_CHECK_EQUAL(unsigned_string(0), "0");
+  BOOST_CHECK_EQUAL(unsigned_string(7), "7");
+  BOOST_CHECK_EQUAL(unsigned_string(42), "42");
+  BOOST_CHECK_EQUAL(unsigned_string(100), "100");
+  BOOST_CHECK_EQUAL(unsigned_string(65535), "65535");
+  BOOST_CHECK_EQUAL(unsigned_string(std::numeric_limits<uint64_t>::max()),
+                    "18446744073709551615");
+
+  BOOST_CHECK_EQUAL(signed_string(0), "0");
+  BOOST_CHECK_EQUAL(signed_string(-1), "-1");
+  BOOST_CHECK_EQUAL(signed_string(1234), "1234");
+  BOOST_CHECK_EQUAL(signed_string(std::numeric_limits<int64_t>::min()),
+                    "-9223372036854775808");
+}
+
+BOOST_AUTO_TEST_CASE(Addresses) {
+  BOOST_CHECK_EQUAL(ipv4_string(0), "0.0.0.0");
+  BOOST_CHECK_EQUAL(ipv4_string(0xc0a8010a), "192.168.1.10");
+  BOOST_CHECK_EQUAL(ipv4_string(0xffffffff), "255.255.255.255");
+
+  BOOST_CHECK_EQUAL(ipv6_string("00000000000000000000000000000000"), "::");
+  BOOST_CHECK_EQUAL(ipv6_string("00000000000000000000000000000001"), "::1");
+  BOOST_CHECK_EQUAL(ipv6_string("20010db8000000000000000000000001"),
+                    "2001:db8::1");
+  BOOST_CHECK_EQUAL(ipv6_string("20010db8000000010001000100010001"),
+                    "2001:db8:0:1:1:1:1:1");
+  BOOST_CHECK_EQUAL(ipv6_string("20010db8000000000001000000000001"),
+                    "2001:db8::1:0:0:1");
+  BOOST_CHECK_EQUAL(ipv6_string("fe800000000000000000000000000000"),
+                    "fe80::");
+  BOOST_CHECK_EQUAL(ipv6_string("ffffffffffffffffffffffffffffffff"),
+                    "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff");
+
+  const uint8_t mac[6] = { 0x00, 0x1b, 0x21, 0xaa, 0x0f, 0xff };
+  char buf[kMaxMacChars];
+  BOOST_CHECK_EQUAL(std::string(buf, format_mac(buf, mac)),
+                    "00:1b:21:aa:0f:ff");
+}
+
+BOOST_AUTO_TEST_CASE(Datetimes) {
+  BOOST_CHECK_EQUAL(datetime_string(0), "1970-01-01T00:00:00.0");
+  BOOST_CHECK_EQUAL(datetime_string(1398816000000000000ULL),
+                    "2014-04-30T00:00:00.0");
+  BOOST_CHECK_EQUAL(datetime_string(951782400500000000ULL),
+                    "2000-02-29T00:00:00.5");
+  BOOST_CHECK_EQUAL(datetime_string(4107542399005000000ULL),
+                    "2100-02-28T23:59:59.005");
+  BOOST_CHECK_EQUAL(datetime_string(1000000001ULL), "1970-01-01T00:00:01.000000001");
+}
+
+BOOST_AUTO_TEST_CASE(BufferedOutput) {
+  int fds[2];
+  BOOST_REQUIRE(pipe(fds) == 0);
+
+  {
+    OutputBuffer out(fds[1], 16);
+    out.append("hello, ", 7);
+    char *p = out.reserve(kMaxIpv4Chars);
+    out.commit(format_ipv4(p, 0x7f000001));
+    out.put('\n');
+    /* Longer than the buffer. */
+    out.append("0123456789012345678901234567890123456789", 40);
+    BOOST_CHECK_EQUAL(out.flush(), 0);
+  }
+  close(fds[1]);
+
+  std::string s;
+  char buf[64];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+    s.append(buf, n);
+  close(fds[0]);
+
+  BOOST_CHECK_EQUAL(s, "hello, 127.0.0.1\n"
+                       "0123456789012345678901234567890123456789");
+}
+
+BOOST_AUTO_TEST_CASE(WriteError) {
+  int fds[2];
+  BOOST_REQUIRE(pipe(fds) == 0);
+  close(fds[1]);
+
+  /* Writing to a descriptor that isn't open fails. */
+  OutputBuffer out(fds[1]);
+  out.put('x');
+  BOOST_CHECK_EQUAL(out.flush(), -1);
+  out.put('y');
+  BOOST_CHECK_EQUAL(out.flush(), -1);
+  close(fds[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()